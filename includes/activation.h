@@ -9,8 +9,10 @@
 
 // INCLUDES ===================================================================
 
-// External libraries
-#include "Arduino.h"
+#include <stdint.h>
+
+#include "../includes/board_state.h"
+#include "../includes/checkpoint.h"
 
 // CLASS ======================================================================
 
@@ -48,6 +50,13 @@ class ActivationController {
      */
     void onStopButton();
 
+    /**
+     * Save or restore the activation state
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
  private:
     enum State {
         /// Breathing is OFF
@@ -70,4 +79,4 @@ class ActivationController {
 // INITIALISATION =============================================================
 
 /// Instance of the activation controller
-extern ActivationController activationController;
+extern BOARD_STATE ActivationController activationController;
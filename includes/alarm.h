@@ -12,6 +12,9 @@
 // Externals
 #include <stdint.h>
 
+// Internals
+#include "../includes/checkpoint.h"
+
 // ENUMS =====================================================================
 
 /// Priority levels of an alarm
@@ -64,6 +67,13 @@ class Alarm {
     /// True if this alarm is enabled
     bool isEnabled();
 
+    /**
+     * Save or restore the detections of the alarm, its priority and code do not change
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
  private:
     /// Alarm priority
     AlarmPriority m_priority;
@@ -112,6 +112,13 @@ class AlarmController {
      */
     void updateEnabledAlarms(Alarms enabledAlarms);
 
+    /**
+     * Save or restore the alarms, their snooze and the last core data
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
  private:
     /// Highest priority of the currently triggered alarms
     AlarmPriority m_highestPriority;
@@ -143,8 +150,3 @@ class AlarmController {
     /// Is unsnoozed right now
     bool m_unsnooze;
 };
-
-// INITIALISATION =============================================================
-
-/// Instance of the alarm controller
-extern AlarmController alarmController;
@@ -7,7 +7,9 @@
 
 #pragma once
 
-#include "Arduino.h"
+#include <stdint.h>
+
+#include "../includes/checkpoint.h"
 
 /**
  * The divider between real battery voltage and STM32 input is 8.2K-1k resistors
@@ -124,3 +126,10 @@ bool isMainsConnected();
 
 /// Check if the cable between power supply and expander input is connected
 bool isMainsAvailable();
+
+/**
+ * Save or restore the battery samples and the mains state
+ *
+ * @param p_archive Checkpoint archive
+ */
+void batteryCheckpoint(CheckpointArchive* p_archive);
@@ -10,7 +10,9 @@
 // INCLUDES ===================================================================
 
 // Internal libraries
+#include "../includes/checkpoint.h"
 #include "../includes/debug.h"
+#include "../includes/hal.h"
 #include "../includes/parameters.h"
 
 /**
@@ -32,13 +34,11 @@ class Blower {
     /**
      * Parameterized constructor
      *
-     * @param p_hardwareTimer Hardware time for the blower
-     * @param p_timerChannel TIM channel for this blower
-     * @param p_blowerPin Data pin for this blower
+     * @param p_output Output driving the ESC of this blower
      */
-    Blower(HardwareTimer* p_hardwareTimer, uint16_t p_timerChannel, uint16_t p_blowerPin);
+    explicit Blower(HalPwmOutput p_output);
 
-    /// Initialize the hardware timer used to control the blower
+    /// Initialize the output used to control the blower
     void setup();
 
     /**
@@ -73,15 +73,25 @@ class Blower {
      */
     int32_t getBlowerPressure(int32_t p_flow);
 
- private:
-    /// Hardware timer used to control the blower
-    HardwareTimer* actuator;
+    /**
+     * Same characteristic as getBlowerPressure(), for a blower running at a given speed
+     *
+     * @param p_speed Speed of the blower, between 0 and MAX_BLOWER_SPEED
+     * @param p_flow inspiratory flow in mL/min
+     * @return Pressure in mmH2O
+     */
+    static int32_t getBlowerPressure(uint16_t p_speed, int32_t p_flow);
 
-    /// Channel of the hardware timer used to control the blower
-    uint16_t timerChannel;
+    /**
+     * Save or restore the speed and the ramp-up, a restored speed is sent to the ESC
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
 
-    /// Pin of the blower
-    uint16_t blowerPin;
+ private:
+    /// Output driving the ESC of the blower
+    HalPwmOutput output;
 
     /// Current speed
     uint16_t m_speed;
@@ -93,7 +103,5 @@ class Blower {
     bool m_stopped;
 
     // Last call of the runspeed function of the blower
-    uint32_t m_lastCallDate;
+    uint64_t m_lastCallDate;
 };
-
-extern Blower blower;
@@ -0,0 +1,27 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file board_state.h
+ * @brief Storage of the state of the board
+ *
+ * The board runs one ventilator, whose state lives in global variables. On the host, every thread
+ * runs a board of its own: the globals that the host build shares with the board (ventilator
+ * context, sensors, flow meter driver, main state machine, deferred work, clock, host side of the
+ * HAL) are declared BOARD_STATE, which makes them thread-local. Simulations can then run in
+ * parallel threads of one process.
+ *
+ * The firmware build is unchanged. So is the task model of RTOS_TASKS, whose tasks are threads of
+ * the POSIX port on the host and must share the state of their board.
+ *****************************************************************************/
+
+#pragma once
+
+// INITIALISATION =============================================================
+
+#if defined(UNIT_TEST) && !defined(RTOS_TASKS)
+/// Storage of a global of the board, one per thread on the host
+#define BOARD_STATE thread_local
+#else
+/// Storage of a global of the board
+#define BOARD_STATE
+#endif
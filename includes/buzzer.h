@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 /// Watchdog timeout in microseconds
 #define WATCHDOG_TIMEOUT 1000000
 
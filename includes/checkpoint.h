@@ -0,0 +1,182 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file checkpoint.h
+ * @brief Checkpoint and restore of the runtime state of the ventilation
+ *
+ * A checkpoint holds everything the breathing depends on: the commands, next commands and
+ * measures of the main controller, the PID integrals and error rings of the controllers of the
+ * modes, the alarms, the valves and the blower ramp, the flow meter integrators, the pressure
+ * sensor filter, the battery, the breathing activation and the control clock of the main state
+ * machine. Restoring it resumes the ventilation at the exact point it was taken, even in the
+ * middle of a breath.
+ *
+ * Every stateful object lists its members once in a checkpoint() method, that the archive runs
+ * either to measure, to save or to restore them. A checkpoint is a header then the members, in
+ * big endian so that a checkpoint of the board can be restored on a host:
+ * - magic (u32), version (u16), size of the members in bytes (u32)
+ * - members, every integer on its own size, booleans on 1 byte, enumerations on 4 bytes, the
+ *   controllers of the modes by their VentilationModes number
+ *
+ * The dates it holds are the ones of the clock it was taken with: the clock must be restored
+ * with it (see simulator.h on the host).
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+// INITIALISATION =============================================================
+
+/// Magic number of a checkpoint, "MKCP"
+#define CHECKPOINT_MAGIC 0x4D4B4350u
+
+/// Version of the checkpoint members, to raise when a member is added, removed or resized
+#define CHECKPOINT_VERSION 1u
+
+/// Size of the header of a checkpoint
+#define CHECKPOINT_HEADER_SIZE 10u
+
+/// What an archive does with the members
+enum CheckpointDirection {
+    /// Count their size
+    CHECKPOINT_MEASURE,
+    /// Copy them to the archive
+    CHECKPOINT_SAVE,
+    /// Copy them from the archive
+    CHECKPOINT_RESTORE
+};
+
+// CLASS ======================================================================
+
+/// Archive the stateful objects list their members to
+class CheckpointArchive {
+ public:
+    /// Archive that measures the size of the members
+    CheckpointArchive();
+
+    /**
+     * Archive that saves the members
+     *
+     * @param p_data Buffer to fill
+     * @param p_size Size of the buffer
+     */
+    CheckpointArchive(uint8_t* p_data, size_t p_size);
+
+    /**
+     * Archive that restores the members
+     *
+     * @param p_data Members saved
+     * @param p_size Size of the members
+     */
+    CheckpointArchive(const uint8_t* p_data, size_t p_size);
+
+    /// True if the members are copied from the archive
+    bool isRestoring() const { return m_direction == CHECKPOINT_RESTORE; }
+
+    /// Number of bytes measured, saved or restored
+    size_t size() const { return m_offset; }
+
+    /// True if the members did not fit the buffer, the members past its end were not copied
+    bool overflowed() const { return m_overflowed; }
+
+    /**
+     * Archive a member
+     *
+     * @param p_value Member, replaced by the saved value when restoring
+     */
+    void field(bool& p_value);
+    void field(int8_t& p_value);
+    void field(uint8_t& p_value);
+    void field(int16_t& p_value);
+    void field(uint16_t& p_value);
+    void field(int32_t& p_value);
+    void field(uint32_t& p_value);
+    void field(int64_t& p_value);
+    void field(uint64_t& p_value);
+
+    /// Archive a member shared with an interrupt
+    template <typename T>
+    void field(volatile T& p_value) {
+        T value = p_value;
+        field(value);
+        if (isRestoring()) {
+            p_value = value;
+        }
+    }
+
+    /// Archive every element of an array
+    template <typename T, size_t N>
+    void field(T (&p_values)[N]) {
+        for (size_t i = 0u; i < N; i++) {
+            field(p_values[i]);
+        }
+    }
+
+    /// Archive an enumeration, as a signed 32 bits number
+    template <typename T>
+    void enumField(T& p_value) {
+        int32_t value = static_cast<int32_t>(p_value);
+        field(value);
+        if (isRestoring()) {
+            p_value = static_cast<T>(value);
+        }
+    }
+
+ private:
+    /**
+     * Copy a number in big endian
+     *
+     * @param p_value Number, replaced by the saved one when restoring
+     * @param p_size Number of bytes of the number
+     */
+    void number(uint64_t* p_value, uint8_t p_size);
+
+    CheckpointDirection m_direction;
+
+    /// Buffer written when saving
+    uint8_t* m_output;
+
+    /// Buffer read when restoring
+    const uint8_t* m_input;
+
+    /// Size of the buffer
+    size_t m_capacity;
+
+    /// Offset of the next member
+    size_t m_offset;
+
+    bool m_overflowed;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Size of a checkpoint of the ventilator
+ *
+ * @return Size in bytes, header included
+ */
+size_t checkpointSize(void);
+
+/**
+ * Save the runtime state of the ventilator
+ *
+ * @param p_data Buffer of at least checkpointSize() bytes
+ * @param p_size Size of the buffer
+ * @return Size of the checkpoint, 0 if the buffer is too small
+ * @warning It must be called with the control locked and the flow meter acquisition paused
+ */
+size_t saveCheckpoint(uint8_t* p_data, size_t p_size);
+
+/**
+ * Restore the runtime state of the ventilator
+ *
+ * @param p_data Checkpoint
+ * @param p_size Size of the checkpoint
+ * @return False if it is not a checkpoint of this version, nothing is restored then
+ * @warning It must be called with the control locked and the flow meter acquisition paused
+ */
+bool restoreCheckpoint(const uint8_t* p_data, size_t p_size);
@@ -56,3 +56,13 @@
 
 // Uncomment when compiling for the simulator
 // #define SIMULATOR
+
+/**
+ * Uncomment to run the control, the flow meter acquisition, the serial control and the UI as
+ * FreeRTOS tasks instead of hardware timer interrupts
+ *
+ * It requires the STM32FreeRTOS library, or a FreeRTOS POSIX port when RTOS_POSIX_PORT is also
+ * defined. The FreeRTOS configuration must set configUSE_TICK_HOOK to 1, as the one of the host
+ * build does (test/host/freertos/FreeRTOSConfig.h).
+ */
+// #define RTOS_TASKS
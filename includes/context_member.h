@@ -0,0 +1,71 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file context_member.h
+ * @brief Access of an object to the other objects of its ventilator context
+ *
+ * The board runs one ventilator: context() then returns the global one, at a fixed address, and
+ * the objects of the context reach each other as directly as global variables. On the host,
+ * several contexts can live in the same process, so every object keeps the context it belongs
+ * to.
+ *
+ * Only the actuators and the controllers belong to a context. The flow meter driver, the HAL, the
+ * clock, the main state machine and the deferred work are globals of the board: the contexts of a
+ * thread share them, and only its `ventilator` can ventilate. On the host, those globals and
+ * `ventilator` itself are BOARD_STATE, one per thread (see board_state.h): sessions run in
+ * parallel on threads of one process, each with its own ventilator.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include "../includes/board_state.h"
+
+// INITIALISATION =============================================================
+
+class VentilatorContext;
+
+/// Context of the ventilator the board runs
+extern BOARD_STATE VentilatorContext ventilator;
+
+// CLASS ======================================================================
+
+/// Base class of the objects that reach the other objects of their context
+class ContextMember {
+ public:
+#ifdef UNIT_TEST
+    /**
+     * Constructor
+     *
+     * @param p_context Context the object belongs to
+     */
+    explicit ContextMember(VentilatorContext* p_context) : m_context(p_context) {}
+
+    /// Copy constructor, the copy belongs to the same context
+    ContextMember(const ContextMember& p_other) = default;
+
+    /// An object assigned the state of another one stays in its own context
+    ContextMember& operator=(const ContextMember& p_other) {
+        (void)p_other;
+        return *this;
+    }
+
+    /// Context the object belongs to
+    inline VentilatorContext& context() const { return *m_context; }
+
+ private:
+    /// Context the object belongs to
+    VentilatorContext* m_context;
+#else
+    /**
+     * Constructor
+     *
+     * @param p_context Context the object belongs to, only the global one exists on the board
+     */
+    explicit ContextMember(VentilatorContext* p_context) { (void)p_context; }
+
+    /// Context the object belongs to
+    inline VentilatorContext& context() const { return ventilator; }
+#endif
+};
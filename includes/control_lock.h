@@ -0,0 +1,39 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file control_lock.h
+ * @brief Short critical sections of the background tasks against the control
+ *
+ * The control interrupt (or the control task with RTOS_TASKS) reads the settings and raises the
+ * alarms. Background tasks only hold this lock while they read or write that shared state, never
+ * while they scan the keys, sample the ADC, parse the serial input or refresh the screen: the
+ * control stays enabled during the rest of their work.
+ *****************************************************************************/
+
+#pragma once
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Prevent the control from running
+ *
+ * A control tick that expires meanwhile is kept pending and runs as soon as the lock is released.
+ *
+ * @warning The lock is not recursive, and must be held for a few µs only
+ */
+void lockControl(void);
+
+/// Allow the control to run again
+void unlockControl(void);
+
+// CLASS ======================================================================
+
+/// Hold the control lock between its construction and its destruction
+class ControlCriticalSection {
+ public:
+    /// Take the lock
+    ControlCriticalSection();
+
+    /// Release the lock
+    ~ControlCriticalSection();
+};
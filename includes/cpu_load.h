@@ -16,22 +16,91 @@
 /// Duration in ms after which the CPU cycle count is reset and the result is stored
 #define TIME_CPU_CYCLE_RESET 1000u
 
+/// Subsystems whose busy time is accounted separately
+enum CpuLoadSubsystem {
+    /// Main state machine interrupt, without the telemetry it sends
+    CPU_LOAD_CONTROL = 0,
+    /// Mass flow meter I2C interrupt
+    CPU_LOAD_MFM,
+    /// Telemetry messages
+    CPU_LOAD_TELEMETRY,
+    /// Serial control messages reception
+    CPU_LOAD_SERIAL_RX,
+    /// LCD screen refreshes
+    CPU_LOAD_LCD,
+    /// Buzzer pattern interrupt
+    CPU_LOAD_BUZZER,
+    /// Other background tasks (battery, keyboard, alarm effects, RPi watchdog)
+    CPU_LOAD_OTHER,
+    /// Number of subsystems
+    CPU_LOAD_SUBSYSTEMS
+};
+
+// CLASS ======================================================================
+
+/**
+ * Account the CPU cycles spent between its construction and its destruction to a subsystem
+ *
+ * Sections can be nested, for example when an interrupt preempts a background task, or when the
+ * control sends telemetry: the cycles of the inner section are only accounted to the inner
+ * subsystem.
+ */
+class CpuLoadSection {
+ public:
+    /**
+     * Start the section
+     *
+     * @param p_subsystem Subsystem to which the cycles are accounted
+     */
+    explicit CpuLoadSection(CpuLoadSubsystem p_subsystem);
+
+    /// End the section
+    ~CpuLoadSection();
+
+ private:
+    /// Subsystem to which the cycles are accounted
+    CpuLoadSubsystem m_subsystem;
+
+    /// Cycle counter value at the start of the section
+    uint32_t m_startCycles;
+
+    /// Cycles already accounted to any section at the start of the section
+    uint32_t m_startAccountedCycles;
+};
+
 // FUNCTIONS ==================================================================
 
 /**
- * Increment the idle cycles counter
+ * Start the CPU cycle counter
  *
- * @note This must be called in the main loop() with nothing else in the loop
+ * @note The number of cycles per second is measured against the systick, so there is nothing to
+ *       tune when the clock, the compiler or the core changes
+ * @warning It blocks for about 10 ms, and must be called before the background loop sleeps
  */
-#define COUNT_IDLE_CYCLE idleCyclesCount++
+void initCpuLoad(void);
 
 /**
  * Get the value of the CPU load
  *
- * @return CPU load in percent
+ * @return CPU load in percent, sum of the load of all subsystems
  * @note If this raises to 100%, there is some blocking code somewhere
  */
 uint8_t readCpuLoadPercent(void);
 
-/// Access to idleCyclesCount needed by the COUNT_IDLE_CYCLE macro
-extern volatile uint32_t idleCyclesCount;
+/**
+ * Get the CPU load of a subsystem
+ *
+ * @param p_subsystem Subsystem
+ * @return CPU load in per mille over the last second
+ */
+uint16_t readCpuLoadPerMille(CpuLoadSubsystem p_subsystem);
+
+#if defined(UNIT_TEST) && defined(RTOS_TASKS)
+/**
+ * Count the RTOS ticks seen by the CPU load
+ *
+ * @return Number of calls of the tick hook of the RTOS
+ * @note On the host, the tick hook counts the ticks instead of computing the load
+ */
+uint32_t readCpuLoadTicks(void);
+#endif
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file deferred_work.h
+ * @brief Queue of work posted by interrupts and run in the background loop
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../includes/periodic_task.h"
+
+// INITIALISATION =============================================================
+
+/// Number of slots in the deferred work queue (must be a power of 2)
+#define DEFERRED_WORK_QUEUE_SIZE 16u
+
+/**
+ * Duration in ms after which pending work that has not been picked up by the background loop
+ * is considered stalled
+ */
+#define DEFERRED_WORK_MAX_LATENCY_MS 500u
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Post a task to be run by the background loop
+ *
+ * If the task is already waiting in the queue, it is not posted a second time.
+ *
+ * @param p_task Task to run
+ * @return False if the task could not be queued
+ * @warning Only one interrupt context may post work (single producer)
+ */
+bool postDeferredWork(PeriodicTask* p_task);
+
+/**
+ * Run every task waiting in the queue
+ *
+ * @warning It must be called from the program loop only (single consumer)
+ */
+void runDeferredWork(void);
+
+/**
+ * Check if some work is waiting to be run
+ *
+ * @return True if the queue is not empty
+ */
+bool hasDeferredWork(void);
+
+/**
+ * Check that the background loop keeps picking up posted work
+ *
+ * @param p_elapsedMs Time elapsed since the previous call in ms
+ * @return False if some work has been waiting for more than DEFERRED_WORK_MAX_LATENCY_MS
+ * @warning It must be called on every period of the interrupt that posts work
+ */
+bool isDeferredWorkProgressing(uint32_t p_elapsedMs);
+
+/**
+ * Get the number of tasks dropped since boot
+ *
+ * @return Number of tasks dropped, either because they were still pending or the queue was full
+ */
+uint32_t deferredWorkDroppedCount(void);
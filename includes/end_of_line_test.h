@@ -11,6 +11,7 @@
 
 // Internal
 
+#include "../includes/board_state.h"
 #include "../includes/blower.h"
 #include "../includes/pressure_valve.h"
 
@@ -82,7 +83,7 @@ class EolTest {
     /// Default constructor
     EolTest();
 
-    /// Enable test mode
+    /// Enable test mode, from its first step
     void activate();
 
     /**
@@ -92,6 +93,12 @@ class EolTest {
      */
     bool isRunning();
 
+    /// Step the test is at
+    TestStep currentStep();
+
+    /// Outcome of the test so far
+    TestState currentState();
+
     /// Handle EOL confirm control setting from telemetry
     void onConfirm();
 
@@ -103,4 +110,4 @@ class EolTest {
     uint32_t testActive;
 };
 
-extern EolTest eolTest;
+extern BOARD_STATE EolTest eolTest;
@@ -0,0 +1,527 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file hal.h
+ * @brief Thin interfaces between the ventilation code and the hardware
+ *
+ * The ventilation code (controllers, alarms, telemetry, flow meter acquisition) only reaches the
+ * board through this file and the clock (timebase.h). On the board, they are implemented with the
+ * Arduino core. In unit tests, they are implemented on the host: inputs are
+ * set by the test and outputs are kept so that the test can check them. Host timers do not count
+ * by themselves: they follow the host clock, and a simulation (test/host/simulator.h) runs their
+ * period elapsed events in date order.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef UNIT_TEST
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+
+#include "../includes/checkpoint.h"
+#else
+// Externals
+#include "Arduino.h"
+#endif
+
+// INITIALISATION =============================================================
+
+#ifdef UNIT_TEST
+// The few helpers of the Arduino core the ventilation code relies on
+typedef uint8_t byte;
+using std::max;
+using std::min;
+
+#define LOW 0x0
+#define HIGH 0x1
+
+inline int32_t map(int32_t p_value,
+                   int32_t p_fromLow,
+                   int32_t p_fromHigh,
+                   int32_t p_toLow,
+                   int32_t p_toHigh) {
+    return ((p_value - p_fromLow) * (p_toHigh - p_toLow) / (p_fromHigh - p_fromLow)) + p_toLow;
+}
+#endif
+
+/// Pulse width modulated outputs
+enum HalPwmOutput {
+    /// Inspiratory valve motor (TIM3, channel 1)
+    HAL_PWM_INSPIRATORY_VALVE = 0,
+    /// Expiratory valve motor (TIM3, channel 2)
+    HAL_PWM_EXPIRATORY_VALVE,
+    /// Blower ESC (TIM1, channel 3)
+    HAL_PWM_BLOWER,
+    /// Number of outputs
+    HAL_PWM_OUTPUTS
+};
+
+/// LEDs of the front panel
+enum HalLed {
+    /// Below the start button
+    HAL_LED_START = 0,
+    /// High priority alarm
+    HAL_LED_RED,
+    /// Medium priority alarm
+    HAL_LED_YELLOW,
+    /// No alarm
+    HAL_LED_GREEN,
+    /// Number of LEDs
+    HAL_LEDS
+};
+
+/// Buttons of the front panel, out of the matrix keyboard
+enum HalButton {
+    /// Alarm snooze
+    HAL_BUTTON_ALARM_OFF = 0,
+    /// Start of the ventilation
+    HAL_BUTTON_START,
+    /// Stop of the ventilation, "PAUSE" on the panel
+    HAL_BUTTON_STOP,
+    /// Number of buttons
+    HAL_BUTTONS
+};
+
+/// Columns and rows of the matrix keyboard, a key closes the contact of its column and its row
+#define HAL_KEYBOARD_COLUMNS 3u
+#define HAL_KEYBOARD_ROWS 3u
+
+/// Timers whose period elapsed event runs a part of the ventilation code
+enum HalTimer {
+    /// Main state machine (TIM9)
+    HAL_TIMER_CONTROL = 0,
+    /// Flow meter acquisition (MASS_FLOW_TIMER)
+    HAL_TIMER_FLOW_METER,
+    /// Buzzer patterns (BUZZER_TIMER)
+    HAL_TIMER_BUZZER,
+    /// Number of timers
+    HAL_TIMERS
+};
+
+/// Function run on the period elapsed event of a timer, in interrupt context
+typedef void (*HalTimerCallback)(void);
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Read the raw value of the pressure sensor ADC
+ *
+ * @return Raw value on ADC_RESOLUTION_MAKAIR bits
+ */
+uint16_t halReadPressureAdc(void);
+
+/// Configure the battery ADC and the mains inputs
+void initHalBatteryInputs(void);
+
+/**
+ * Read the raw value of the battery voltage ADC
+ *
+ * @return Raw value on ADC_RESOLUTION_MAKAIR bits
+ */
+uint16_t halReadBatteryAdc(void);
+
+/// True if the mains are connected, only meaningful if halReadMainsSensed() is true
+bool halReadMainsConnected(void);
+
+/// True if the mains sensing wire of the power supply connector is plugged
+bool halReadMainsSensed(void);
+
+/// Start the timers of the pulse width modulated outputs
+void initHalPwmOutputs(void);
+
+/**
+ * Enable a pulse width modulated output
+ *
+ * @param p_output Output
+ * @param p_pulseUs Initial pulse width in µs
+ */
+void halSetupPwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs);
+
+/**
+ * Change the pulse width of an output
+ *
+ * @param p_output Output
+ * @param p_pulseUs Pulse width in µs
+ */
+void halWritePwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs);
+
+/**
+ * Turn a LED on or off
+ *
+ * @param p_led LED
+ * @param p_active True to turn it on
+ */
+void halWriteLed(HalLed p_led, bool p_active);
+
+/**
+ * Switch the power supply of the Raspberry Pi
+ *
+ * @param p_powered True to power it
+ */
+void halWriteRaspberryPower(bool p_powered);
+
+/**
+ * Read a button of the front panel
+ *
+ * @param p_button Button
+ * @return True while it is pressed
+ */
+bool halReadButton(HalButton p_button);
+
+/// Configure the column outputs and the row inputs of the matrix keyboard, no column selected
+void initHalKeyboardMatrix(void);
+
+/**
+ * Power a column of the matrix keyboard, and only that one
+ *
+ * @param p_column Column, from 0 to HAL_KEYBOARD_COLUMNS - 1
+ */
+void halSelectKeyboardColumn(uint8_t p_column);
+
+/**
+ * Read a row of the matrix keyboard
+ *
+ * @param p_row Row, from 0 to HAL_KEYBOARD_ROWS - 1
+ * @return True if the key of the selected column on this row is pressed
+ */
+bool halReadKeyboardRow(uint8_t p_row);
+
+/**
+ * Configure a timer and attach its period elapsed callback, the timer is left paused
+ *
+ * @param p_timer Timer
+ * @param p_frequency Frequency of the counter in Hz
+ * @param p_overflow Period in counts
+ * @param p_callback Function run at the end of every period
+ */
+void halSetupTimer(HalTimer p_timer,
+                   uint32_t p_frequency,
+                   uint32_t p_overflow,
+                   HalTimerCallback p_callback);
+
+/**
+ * Change the period of a timer
+ *
+ * @param p_timer Timer
+ * @param p_overflow Period in counts
+ * @note The flow meter timer applies it at the end of the running period, the others at once
+ */
+void halSetTimerOverflow(HalTimer p_timer, uint32_t p_overflow);
+
+/**
+ * Set the counter of a timer
+ *
+ * @param p_timer Timer
+ * @param p_count Count
+ */
+void halSetTimerCount(HalTimer p_timer, uint32_t p_count);
+
+/**
+ * Read the counter of a timer
+ *
+ * @param p_timer Timer
+ * @return Counts since the beginning of the period
+ */
+uint32_t halReadTimerCount(HalTimer p_timer);
+
+/// Start or restart the counter of a timer
+void halResumeTimer(HalTimer p_timer);
+
+/// Stop the counter of a timer, it keeps its count
+void halPauseTimer(HalTimer p_timer);
+
+/// Hold the period elapsed interrupt of a timer, a period that ends meanwhile is kept pending
+void halLockTimer(HalTimer p_timer);
+
+/// Release the period elapsed interrupt of a timer
+void halUnlockTimer(HalTimer p_timer);
+
+/// Reload the independent watchdog, it resets the board after WATCHDOG_TIMEOUT µs otherwise
+void halReloadWatchdog(void);
+
+/**
+ * Read a word of the unique ID of the microcontroller
+ *
+ * @param p_word Index of the word, from 0 to 2
+ * @return Word of the 96-bit ID
+ */
+uint32_t halReadUniqueIdWord(uint8_t p_word);
+
+/**
+ * Open the telemetry serial link
+ *
+ * @param p_baudRate Speed in bauds
+ */
+void halTelemetryBegin(uint32_t p_baudRate);
+
+/**
+ * Send a byte on the telemetry serial link
+ *
+ * @param p_byte Byte to send
+ */
+void halTelemetryWrite(uint8_t p_byte);
+
+/**
+ * Send bytes on the telemetry serial link
+ *
+ * @param p_data Bytes to send
+ * @param p_size Number of bytes
+ */
+void halTelemetryWrite(const uint8_t* p_data, size_t p_size);
+
+/**
+ * Send characters on the telemetry serial link
+ *
+ * @param p_data Characters to send
+ * @param p_size Number of characters
+ */
+void halTelemetryWrite(const char* p_data, size_t p_size);
+
+/// Number of bytes that can be sent on the telemetry serial link without waiting
+int32_t halTelemetryAvailableForWrite(void);
+
+/// Number of bytes received on the telemetry serial link and not read yet
+int32_t halTelemetryAvailable(void);
+
+/// Next received byte without removing it, or -1 if there is none
+int32_t halTelemetryPeek(void);
+
+/// Next received byte, or -1 if there is none
+int32_t halTelemetryRead(void);
+
+/**
+ * Read received bytes
+ *
+ * @param p_data Buffer to fill
+ * @param p_size Number of bytes to read
+ * @return Number of bytes actually read
+ */
+size_t halTelemetryReadBytes(uint8_t* p_data, size_t p_size);
+
+/**
+ * Wait, only the interrupts run meanwhile
+ *
+ * @param p_ms Duration in ms
+ * @note On the host, the interrupts are only run by the simulation: it returns at once
+ */
+void halDelay(uint32_t p_ms);
+
+/// Configure the power supply of the flow meters, powered, and the pins of their I2C bus
+void initHalFlowMeterBus(void);
+
+/**
+ * Switch the power supply of the flow meters
+ *
+ * @param p_powered True to power them and release the I2C lines, false to cut it and pull the
+ *                  lines low, so that the sensors are not powered through the bus
+ */
+void halWriteFlowMeterPower(bool p_powered);
+
+/// Open the I2C bus of the flow meters, Wire.begin()
+void halI2cBegin(void);
+
+/// Close the I2C bus of the flow meters and free its buffers, Wire.end()
+void halI2cEnd(void);
+
+/// Wait for the bytes written on the I2C bus to be sent, Wire.flush()
+void halI2cFlush(void);
+
+/**
+ * Read bytes from an I2C device, Wire.requestFrom()
+ *
+ * @param p_address Address of the device
+ * @param p_count Number of bytes to read
+ * @return Number of bytes received, then read one by one with halI2cRead()
+ */
+uint8_t halI2cRequestFrom(uint8_t p_address, uint8_t p_count);
+
+/// Next byte received on the I2C bus, or -1 if there is none
+int32_t halI2cRead(void);
+
+/**
+ * Start a command to an I2C device, Wire.beginTransmission()
+ *
+ * @param p_address Address of the device
+ */
+void halI2cBeginTransmission(uint8_t p_address);
+
+/**
+ * Queue a byte of the command, Wire.write()
+ *
+ * @param p_byte Byte
+ */
+void halI2cWrite(uint8_t p_byte);
+
+/**
+ * Send the command, Wire.endTransmission()
+ *
+ * @return 0 on success, 2 if the address was not acknowledged, another error code of Wire else
+ */
+uint8_t halI2cEndTransmission(void);
+
+#ifdef UNIT_TEST
+/// Reset every host input and output to its power-on value
+void resetHostHal(void);
+
+/**
+ * Set the value the pressure sensor ADC returns
+ *
+ * @param p_raw Raw value on ADC_RESOLUTION_MAKAIR bits
+ */
+void setHostPressureAdc(uint16_t p_raw);
+
+/**
+ * Set the value the battery ADC returns, RAW_VOLTAGE_MAINS after a reset
+ *
+ * @param p_raw Raw value on ADC_RESOLUTION_MAKAIR bits
+ */
+void setHostBatteryAdc(uint16_t p_raw);
+
+/**
+ * Set the mains inputs
+ *
+ * @param p_connected True if the mains are connected
+ * @param p_sensed True if the mains sensing wire is plugged
+ */
+void setHostMainsInputs(bool p_connected, bool p_sensed);
+
+/**
+ * Press a button of the front panel
+ *
+ * @param p_button Button
+ * @note The press is seen by the next read of the button, which releases it: the code that waits
+ *       for the release of a button in a loop does not wait forever on the host
+ */
+void pressHostButton(HalButton p_button);
+
+/**
+ * Press a key of the matrix keyboard
+ *
+ * @param p_column Column of the key
+ * @param p_row Row of the key
+ * @note The press is seen by the next read of its row while its column is selected, which
+ *       releases it
+ */
+void pressHostKeyboardKey(uint8_t p_column, uint8_t p_row);
+
+/**
+ * Get the last pulse width of an output
+ *
+ * @param p_output Output
+ * @return Pulse width in µs, 0 while the output is not set up
+ */
+uint16_t hostPwmOutputPulse(HalPwmOutput p_output);
+
+/**
+ * Get the state of a LED
+ *
+ * @param p_led LED
+ * @return True if the LED is on
+ */
+bool hostLedState(HalLed p_led);
+
+/// True if the Raspberry Pi is powered
+bool hostRaspberryPowered(void);
+
+/**
+ * Find the next period elapsed event of the running timers
+ *
+ * @param p_timer Timer of the event, when there is one
+ * @param p_dateUs Date of the event in µs on the host clock, when there is one
+ * @return True if a timer is running with its interrupt released
+ * @note Among events on the same date, the one of the highest priority interrupt comes first
+ */
+bool hostNextTimerEvent(HalTimer* p_timer, uint64_t* p_dateUs);
+
+/**
+ * Run the period elapsed event of a timer, on the current date of the host clock
+ *
+ * @param p_timer Timer
+ */
+void fireHostTimer(HalTimer p_timer);
+
+/// Number of times the watchdog was reloaded
+uint32_t hostWatchdogReloads(void);
+
+/// Date in µs on the host clock of the last watchdog reload
+uint64_t hostWatchdogLastReload(void);
+
+/**
+ * Save or restore the host inputs, outputs, timers and watchdog
+ *
+ * @param p_archive Checkpoint archive
+ * @note The telemetry bytes, the presses of buttons and the devices of the I2C bus are not part
+ *       of it, and the timers keep their callbacks
+ */
+void hostHalCheckpoint(CheckpointArchive* p_archive);
+
+/**
+ * Queue bytes to be received on the telemetry serial link
+ *
+ * @param p_data Bytes
+ * @param p_size Number of bytes
+ */
+void pushHostTelemetryInput(const uint8_t* p_data, size_t p_size);
+
+/**
+ * Take the bytes sent on the telemetry serial link
+ *
+ * @param p_data Buffer to fill
+ * @param p_size Size of the buffer
+ * @return Number of bytes taken, the oldest first
+ * @note Only the last HOST_TELEMETRY_OUTPUT_SIZE bytes are kept
+ */
+size_t popHostTelemetryOutput(uint8_t* p_data, size_t p_size);
+
+/// How a device answers on the I2C bus of the host
+enum HostI2cAnswer {
+    /// Every request is answered
+    HOST_I2C_ANSWERS,
+    /// The address is not acknowledged: no byte is read and no command is written
+    HOST_I2C_NACK,
+    /// Commands are acknowledged, but the reads stop after the first byte
+    HOST_I2C_SHORT_READ
+};
+
+/**
+ * Plug a device on the I2C bus of the host, or change it
+ *
+ * @param p_address Address of the device
+ * @param p_word Word it answers to every read, most significant byte first, the next bytes read
+ *               as 0
+ * @param p_answer How it answers
+ * @note Devices only answer while the flow meters are powered, none is plugged after a reset
+ */
+void setHostI2cDevice(uint8_t p_address, uint16_t p_word, HostI2cAnswer p_answer);
+
+/// True if the flow meters are powered
+bool hostFlowMeterPowered(void);
+
+/**
+ * Interrupt the telemetry writes with a handler
+ *
+ * Once p_afterBytes more bytes are sent on the telemetry serial link outside the event of the
+ * timer, the handler runs between two bytes, as the interrupt of the timer would. While the timer
+ * is locked, the handler is kept pending until the timer is unlocked.
+ *
+ * @param p_timer Timer whose interrupt the handler stands for
+ * @param p_handler Handler, run once
+ * @param p_afterBytes Number of bytes sent before the interrupt, at least 1
+ */
+void interruptHostTelemetryWrite(HalTimer p_timer,
+                                 HalTimerCallback p_handler,
+                                 uint32_t p_afterBytes);
+
+/// Number of sent bytes kept on the host, like the transmit buffer of the UART
+#define HOST_TELEMETRY_OUTPUT_SIZE 65536u
+
+/// Size of the transmit buffer of the UART on the board, see build_opt.h
+#define HOST_TELEMETRY_TX_BUFFER_SIZE 256
+#endif
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file interrupt_timing.h
+ * @brief Latency and period jitter histograms of the timer interrupts
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../includes/board_state.h"
+
+// INITIALISATION =============================================================
+
+/// Number of buckets of a timing histogram
+#define TIMING_HISTOGRAM_BUCKETS 10u
+
+/**
+ * Upper bounds in µs (excluded) of the buckets of a timing histogram
+ *
+ * The last bucket has no upper bound.
+ */
+extern const uint32_t TIMING_HISTOGRAM_BOUNDS_US[TIMING_HISTOGRAM_BUCKETS - 1u];
+
+/// Sources of timing measures, in the order they are sent on telemetry
+enum InterruptTimingSource {
+    /// Main state machine timer (TIM9)
+    INTERRUPT_TIMING_CONTROL = 0,
+    /// Mass flow meter timer (TIM10)
+    INTERRUPT_TIMING_FLOW_METER,
+    /// Number of sources
+    INTERRUPT_TIMING_SOURCES
+};
+
+// CLASS ======================================================================
+
+/// Histogram of durations with fixed buckets
+class TimingHistogram {
+ public:
+    /// Default constructor
+    TimingHistogram();
+
+    /**
+     * Add a duration to the histogram
+     *
+     * @param p_durationUs Duration in µs
+     */
+    void record(uint32_t p_durationUs);
+
+    /// Clear the histogram
+    void reset();
+
+    /**
+     * Get the number of durations in a bucket
+     *
+     * @param p_bucket Index of the bucket
+     * @return Number of durations
+     */
+    inline uint32_t bucket(uint8_t p_bucket) const { return m_buckets[p_bucket]; }
+
+    /// Longest duration recorded in µs
+    inline uint32_t maxUs() const { return m_maxUs; }
+
+    /// Number of durations recorded
+    inline uint32_t count() const { return m_count; }
+
+ private:
+    /// Number of durations in each bucket
+    volatile uint32_t m_buckets[TIMING_HISTOGRAM_BUCKETS];
+
+    /// Longest duration recorded
+    volatile uint32_t m_maxUs;
+
+    /// Number of durations recorded
+    volatile uint32_t m_count;
+};
+
+/// Latency and period jitter of a periodic interrupt
+class InterruptTiming {
+ public:
+    /**
+     * Parameterized constructor
+     *
+     * @param p_nominalPeriodUs Period of the timer in µs
+     */
+    explicit InterruptTiming(uint32_t p_nominalPeriodUs);
+
+    /**
+     * Record the entry in the interrupt
+     *
+     * @param p_latencyUs Time elapsed since the timer update event, in µs
+     * @warning It must be called first thing in the interrupt
+     */
+    void onEntry(uint32_t p_latencyUs);
+
+    /**
+     * Change the period of the timer
+     *
+     * @param p_nominalPeriodUs New period in µs
+     * @note The next period is not measured, as it spans both periods
+     */
+    void setNominalPeriod(uint32_t p_nominalPeriodUs);
+
+    /**
+     * Clear the histograms on the next entry in the interrupt
+     *
+     * @note The interrupt is the only one to write the histograms, so that another interrupt can
+     *       not preempt it in the middle of a reset: the background loop requests it instead
+     */
+    void requestReset();
+
+    /// Histogram of the delays between the timer update events and the interrupt entries
+    inline const TimingHistogram& latency() const { return m_latency; }
+
+    /// Histogram of the differences between the measured periods and the nominal one
+    inline const TimingHistogram& jitter() const { return m_jitter; }
+
+ private:
+    /// Period of the timer in µs
+    uint32_t m_nominalPeriodUs;
+
+    /// Date of the last entry in µs
+    uint64_t m_lastEntryUs;
+
+    /// False until an entry has been recorded at the current period
+    bool m_hasLastEntry;
+
+    /// True if the histograms are cleared on the next entry
+    volatile bool m_resetRequested;
+
+    /// Latency histogram
+    TimingHistogram m_latency;
+
+    /// Period jitter histogram
+    TimingHistogram m_jitter;
+};
+
+// INITIALISATION =============================================================
+
+/// Timing of each source
+extern BOARD_STATE InterruptTiming interruptTimings[INTERRUPT_TIMING_SOURCES];
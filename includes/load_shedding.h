@@ -0,0 +1,124 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file load_shedding.h
+ * @brief Detect overruns of the 1 ms control interrupt and shed non-critical work
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../includes/board_state.h"
+
+// INITIALISATION =============================================================
+
+/// Execution time in µs above which a run of the 1 ms control interrupt is an overrun
+#define LOAD_SHEDDING_OVERRUN_THRESHOLD_US 800u
+
+/// Duration in ms of the window used to count overruns
+#define LOAD_SHEDDING_WINDOW_MS 100u
+
+/// Number of overruns in a window above which one more tier is shed
+#define LOAD_SHEDDING_ESCALATION_OVERRUNS 2u
+
+/// Number of consecutive windows without overrun after which one tier is restored
+#define LOAD_SHEDDING_RECOVERY_WINDOWS 10u
+
+/// Time budget in ms of the serial control loop when it is not shed
+#define SERIAL_CONTROL_BUDGET_MS 2u
+
+/// Tiers of shed work, each tier also sheds the work of the previous ones
+enum LoadSheddingTier {
+    /// Nothing is shed
+    LOAD_SHEDDING_NONE = 0,
+    /// Only one data snapshot out of two is sent on telemetry
+    LOAD_SHEDDING_TELEMETRY = 1,
+    /// LCD refreshes are postponed
+    LOAD_SHEDDING_SCREEN = 2,
+    /// The serial control loop only reads the frames received in the current ms
+    LOAD_SHEDDING_SERIAL = 3
+};
+
+/// Number of tiers where some work is shed
+#define LOAD_SHEDDING_TIERS 3u
+
+// CLASS ======================================================================
+
+/// Overrun detector of the control interrupt, driving the load shedding tiers
+class LoadShedder {
+ public:
+    /// Default constructor
+    LoadShedder();
+
+    /**
+     * Account for a run of the control interrupt
+     *
+     * @param p_executionTimeUs Execution time of the run in µs
+     * @param p_missedTicks Number of timer periods that elapsed without being served before it
+     * @warning It must be called at the end of every run of the control interrupt
+     */
+    void update(uint32_t p_executionTimeUs, uint32_t p_missedTicks);
+
+    /**
+     * Check if a data snapshot must be dropped
+     *
+     * @param p_tick Tick of the data snapshot
+     * @return True if the snapshot must not be sent
+     */
+    bool shouldDropDataSnapshot(uint32_t p_tick);
+
+    /**
+     * Check if a LCD refresh must be postponed
+     *
+     * @return True if the screen must not be refreshed now
+     */
+    bool shouldPostponeScreenUpdate();
+
+    /**
+     * Get the time budget of the serial control loop
+     *
+     * @return Budget in ms
+     */
+    uint32_t serialControlBudgetMs();
+
+    /// Current tier
+    inline LoadSheddingTier tier() const { return m_tier; }
+
+    /// Number of overruns since boot
+    inline uint32_t overrunCount() const { return m_overrunCount; }
+
+    /**
+     * Number of times some work was shed by a tier since boot
+     *
+     * @param p_tier Tier, must not be LOAD_SHEDDING_NONE
+     * @return Number of dropped snapshots, postponed screen updates or shortened serial loops
+     */
+    uint32_t shedCount(LoadSheddingTier p_tier) const;
+
+ private:
+    /// Current tier
+    volatile LoadSheddingTier m_tier;
+
+    /// Number of overruns since boot
+    uint32_t m_overrunCount;
+
+    /// Number of overruns in the current window
+    uint32_t m_windowOverruns;
+
+    /// Number of ms elapsed in the current window
+    uint32_t m_windowDuration;
+
+    /// Number of consecutive windows without overrun
+    uint32_t m_quietWindows;
+
+    /// Shed counters, indexed by tier minus one
+    volatile uint32_t m_shedCounts[LOAD_SHEDDING_TIERS];
+};
+
+// INITIALISATION =============================================================
+
+/// Instance of the load shedder
+extern BOARD_STATE LoadShedder loadShedder;
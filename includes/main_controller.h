@@ -14,7 +14,9 @@
 #include "../includes/alarm_controller.h"
 #include "../includes/battery.h"
 #include "../includes/blower.h"
+#include "../includes/checkpoint.h"
 #include "../includes/config.h"
+#include "../includes/context_member.h"
 #include "../includes/cycle.h"
 #include "../includes/debug.h"
 #include "../includes/parameters.h"
@@ -33,10 +35,14 @@
 
 /// Controls breathing cycle
 // cppcheck-suppress misra-c2012-5.2 ; false positive
-class MainController {
+class MainController : public ContextMember {
  public:
-    /// Default constructor
-    MainController();
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit MainController(VentilatorContext* p_context = &ventilator);
 
     /// Initialize actuators
     void setup();
@@ -85,6 +91,17 @@ class MainController {
      */
     void compute();
 
+    /**
+     * Perform the valves pressure control on every pressure sample
+     *
+     * Phase management, blower regulation, alarms and telemetry stay in compute(), which runs
+     * every MAIN_CONTROLLER_COMPUTE_PERIOD_MS. This inner loop only runs the valve regulation of
+     * the current phase and sends the valve commands.
+     *
+     * @param p_dt Duration since the last call in microsecond
+     */
+    void computeInnerLoop(int32_t p_dt);
+
     /// Set ventilation mode
     void onVentilationModeSet(uint16_t p_ventilationControllerMode);
 
@@ -422,6 +439,13 @@ class MainController {
     /// Send a "machine state snapshot" telemetry message
     void sendMachineState();
 
+    /**
+     * Save or restore the commands, the measures and the cycle progress
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
  private:
     /**
      * Update the cycle phase
@@ -451,6 +475,9 @@ class MainController {
     /// Send the computed commands to actuators
     void executeCommands();
 
+    /// Send the computed commands to the valves, overriding them in case of overpressure
+    void executeValveCommands();
+
     /// At the end of a respiratory cycle, check if some alarms are triggered
     void checkCycleAlarm();
 
@@ -727,5 +754,3 @@ class MainController {
     // Gender of patient 0 = male, 1 = female
     int32_t m_patientGender;
 };
-
-extern MainController mainController;
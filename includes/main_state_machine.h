@@ -9,7 +9,10 @@
 
 #include "../includes/alarm_controller.h"
 #include "../includes/blower.h"
+#include "../includes/board_state.h"
+#include "../includes/checkpoint.h"
 #include "../includes/main_controller.h"
+#include "../includes/periodic_task.h"
 #include "../includes/pressure_valve.h"
 
 /// Main state machine
@@ -25,15 +28,57 @@ class MainStateMachine {
      */
     bool isRunning();
 
+    /**
+     * Get the number of 1 ms timer periods whose interrupt was not served on time
+     *
+     * @return Number of missed timer periods since boot
+     */
+    uint32_t missedTimerTicks() const;
+
+    /**
+     * Get the number of main controller computations that missed their deadline
+     *
+     * @return Number of skipped computations since boot
+     */
+    uint32_t missedControlDeadlines() const;
+
     /// Display information on screen
     void ScreenUpdate();
 
     /// Run the state machine
     void setupAndStart();
 
+    /**
+     * Save or restore the state and the control clock, a restored timer period is applied
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
  private:
     /// Main state machine activation state
     bool isMsmActive;
 };
 
-extern MainStateMachine mainStateMachine;
+extern BOARD_STATE MainStateMachine mainStateMachine;
+
+/**
+ * Run one period of the main state machine
+ *
+ * @warning It must be called every ms, by the main state machine timer or the control task
+ */
+void runMainStateMachine(void);
+
+/// Periodic tasks run by the main state machine timer, with their execution statistics
+extern BOARD_STATE PeriodicTaskTable msmTaskTable;
+
+#ifdef UNIT_TEST
+/**
+ * Change the period of the valve regulation during BREATH
+ *
+ * @param p_periodMs Period in ms: 1 by default, to regulate on every pressure sample, or
+ *                   MAIN_CONTROLLER_COMPUTE_PERIOD_MS to regulate at the rate of the main
+ *                   controller
+ */
+void setInnerLoopPeriod(uint32_t p_periodMs);
+#endif
@@ -7,7 +7,18 @@
 
 #pragma once
 
-#include <Arduino.h>
+#include <stdint.h>
+
+#include "../includes/board_state.h"
+#include "../includes/checkpoint.h"
+
+// 1 MHz => the counter tells the interrupt latency in µs, and a 10 ms period still fits in the
+// 16 bit timer
+#define MASS_FLOW_TIMER_FREQ 1000000
+
+// The timer period in 100 us multiple
+#define MASS_FLOW_PERIOD 100
+
 /**
  * Initialize Mass Flow Meter
  *
@@ -16,6 +27,16 @@
  */
 bool MFM_init(void);
 
+/**
+ * Read the flow meters and integrate the volumes
+ *
+ * @warning It must be called every 10 ms, by the flow meter timer or task
+ */
+void MFM_acquire(void);
+
+/// Period elapsed callback of the flow meter timer, it runs MFM_acquire()
+void MFM_Timer_Callback(void);
+
 /**
  * Get the number of milliliters since last reset
  *
@@ -35,6 +56,12 @@ int32_t MFM_expi_read_milliliters(bool reset_after_read);
 /// Reset the volume counter
 void MFM_reset(void);
 
+/// Suspend the acquisition, the last measures are kept
+void MFM_pause(void);
+
+/// Resume the acquisition, starting with the next period
+void MFM_resume(void);
+
 /**
  * Calibrate the zero of the sensor
  *
@@ -80,12 +107,40 @@ uint32_t MFM_read_serial_number(void);
  */
 uint32_t MFM_expi_read_serial_number(void);
 
+/**
+ * Save or restore the volume integrators, the calibration offsets and the last measures
+ *
+ * @param p_archive Checkpoint archive
+ * @note The serial numbers of the sensors are not part of it
+ */
+void MFM_checkpoint(CheckpointArchive* p_archive);
+
+#ifdef UNIT_TEST
+/// Put the driver back in its power-on state, before MFM_init(), as a reset of the board does
+void MFM_resetState(void);
+
+/**
+ * Set the calibration offset of the inspiratory flow meter, as MFM_calibrateZero() measures it
+ *
+ * @param p_offset Offset in mL/min, removed from the flows and the volumes
+ */
+void MFM_setOffset(int32_t p_offset);
+
+/**
+ * Raise or clear the fault condition of the flow meters at once
+ *
+ * @param p_fault True to raise it, the reset sequence then starts on the next acquisition. False
+ *        to clear it as if the reset sequence ended: the flow meters are powered again
+ */
+void MFM_setFaultCondition(bool p_fault);
+#endif
+
 #define MFM_SFM_3300D_I2C_ADDRESS 0x40
 #define MFM_HONEYWELL_HAF_I2C_ADDRESS 0x49
 #define MFM_SDP703_02_I2C_ADDRESS 0x40
 #define MFM_SFM3019_I2C_ADDRESS 0x2E
 
 // exposed for other peripherals sharing I2C bus pause the timer.
-extern volatile uint16_t MFM_force_release_I2C;
+extern BOARD_STATE volatile uint16_t MFM_force_release_I2C;
 #define MFM_FORCE_RELEASE_I2C_TRUE 0xb00b
 #define MFM_FORCE_RELEASE_I2C_FALSE 0
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * @file mass_flow_meter_utl.h
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Mass flow meter computing utility functions
+ *
+ * The flow meters answer on I2C with a 16 bits word, the first byte received being the most
+ * significant one. These functions convert the words of the sensors chosen in config.h to flows.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../includes/config.h"
+
+// INITIALISATION =============================================================
+
+/// Inspiratory flows from this one in mL/min are spurious values of the sensor, they are dropped
+#define MFM_INSPIRATORY_MAX_FLOW (MFM_RANGE * 1100)
+
+/// Flows from -this to this in mL/min are noise, they are not integrated in the volumes
+#define MFM_NOISE_FLOW 500
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Convert the word read from the inspiratory flow meter to a flow
+ *
+ * @param p_sensorWord Word received from the sensor
+ * @return Flow in mL/min, before the calibration offset is removed
+ */
+int32_t convertInspiratoryFlowSensor(uint16_t p_sensorWord);
+
+/**
+ * Convert the word read from the expiratory flow meter to a flow
+ *
+ * @param p_sensorWord Word received from the sensor
+ * @return Flow in mL/min, before the calibration offset is removed
+ */
+int32_t convertExpiratoryFlowSensor(uint16_t p_sensorWord);
+
+/**
+ * Convert a flow to the word the inspiratory flow meter gives for it
+ *
+ * @param p_flow Flow in mL/min
+ * @return Smallest word that convertInspiratoryFlowSensor() brings to this flow or above, within
+ *         the range of the sensor
+ * @note Used to feed a simulated sensor
+ */
+uint16_t convertInspiratoryFlow2Sensor(int32_t p_flow);
+
+/**
+ * Convert a flow to the word the expiratory flow meter gives for it
+ *
+ * @param p_flow Flow in mL/min
+ * @return Smallest word that convertExpiratoryFlowSensor() brings to this flow or above, within
+ *         the range of the sensor
+ * @note Used to feed a simulated sensor
+ */
+uint16_t convertExpiratoryFlow2Sensor(int32_t p_flow);
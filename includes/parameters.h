@@ -8,11 +8,9 @@
 
 // INCLUDES ===================================================================
 
-// External
-#include "Arduino.h"
-
 // Internal
 #include "../includes/config.h"
+#include "../includes/hal.h"
 
 // PARAMETERS =================================================================
 
@@ -13,6 +13,14 @@
 /// Controller for the AC mode
 class PC_AC_Controller final : public PC_CMV_Controller {
  public:
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit PC_AC_Controller(VentilatorContext* p_context = &ventilator)
+        : PC_CMV_Controller(p_context) {}
+
     /// Control the exhalation
     void exhale() override;
 
@@ -26,5 +34,3 @@ class PC_AC_Controller final : public PC_CMV_Controller {
         return a;
     }
 };
-
-extern PC_AC_Controller pcAcController;
@@ -8,13 +8,76 @@
 #pragma once
 
 #include "../includes/parameters.h"
+#include "../includes/pc_cmv_tuning.h"
 #include "../includes/ventilation_controller.h"
 
+/// Steps of the valve PID integrals per unit of the per-mille valve command
+#define PC_PID_INTEGRAL_RESOLUTION 1000
+
+/// Coefficients of the valve PIDs and of the blower regulation, see pc_cmv_tuning.h
+struct PcCmvTuning {
+    /// Proportional gain of the inspiratory valve PID
+    int32_t inspiratoryKp;
+    /// Integral gain of the inspiratory valve PID, above the pressure command
+    int32_t inspiratoryKiAbove;
+    /// Integral gain of the inspiratory valve PID, below the pressure command
+    int32_t inspiratoryKiBelow;
+    /// Proportional gain of the expiratory valve PID
+    int32_t expiratoryKp;
+    /// Integral gain of the expiratory valve PID, above the PEEP command
+    int32_t expiratoryKiAbove;
+    /// Integral gain of the expiratory valve PID, below a PEEP command of 50 mmH2O
+    int32_t expiratoryKiLowPeep;
+    /// Integral gain of the expiratory valve PID, below a PEEP command of 100 mmH2O or more
+    int32_t expiratoryKiHighPeep;
+    /// Duration of the half pressure ramp, in ms
+    int32_t blowerHalfRampMs;
+    /// Part of the inspiration, in %, before which a plateau may decrease the blower speed
+    int32_t blowerEarlyPlateauPercent;
+    /// Part of the inspiration, in %, before which a small overshoot decreases the blower speed
+    int32_t blowerOvershootPercent;
+    /// Peak pressure above the plateau command, in mmH2O, that is a small overshoot
+    int32_t blowerSmallOvershoot;
+    /// Peak pressure above the plateau command, in mmH2O, that is a large overshoot
+    int32_t blowerLargeOvershoot;
+    /// Blower speed decrease after a fast ramp or an overshoot
+    int32_t blowerDecrement;
+    /// Part of the inspiration, in %, before which a plateau keeps the blower speed
+    int32_t blowerHoldPercent;
+    /// Part of the inspiration, in %, before which a plateau slightly increases the blower speed
+    int32_t blowerSmallStepPercent;
+    /// Blower speed increase after a slightly late plateau
+    int32_t blowerSmallIncrement;
+    /// Part of the inspiration, in %, before which a plateau increases the blower speed
+    int32_t blowerMediumStepPercent;
+    /// Blower speed increase after a late plateau
+    int32_t blowerMediumIncrement;
+    /// Blower speed increase after a very late plateau, or no plateau
+    int32_t blowerLargeIncrement;
+};
+
+/// Coefficients compiled in the firmware, from pc_cmv_tuning.h
+static const PcCmvTuning PC_CMV_DEFAULT_TUNING = {
+    PC_CMV_INSPIRATORY_PID_KP,          PC_CMV_INSPIRATORY_PID_KI_ABOVE,
+    PC_CMV_INSPIRATORY_PID_KI_BELOW,    PC_CMV_EXPIRATORY_PID_KP,
+    PC_CMV_EXPIRATORY_PID_KI_ABOVE,     PC_CMV_EXPIRATORY_PID_KI_LOW_PEEP,
+    PC_CMV_EXPIRATORY_PID_KI_HIGH_PEEP, PC_CMV_BLOWER_HALF_RAMP_MS,
+    PC_CMV_BLOWER_EARLY_PLATEAU_PERCENT, PC_CMV_BLOWER_OVERSHOOT_PERCENT,
+    PC_CMV_BLOWER_SMALL_OVERSHOOT,      PC_CMV_BLOWER_LARGE_OVERSHOOT,
+    PC_CMV_BLOWER_DECREMENT,            PC_CMV_BLOWER_HOLD_PERCENT,
+    PC_CMV_BLOWER_SMALL_STEP_PERCENT,   PC_CMV_BLOWER_SMALL_INCREMENT,
+    PC_CMV_BLOWER_MEDIUM_STEP_PERCENT,  PC_CMV_BLOWER_MEDIUM_INCREMENT,
+    PC_CMV_BLOWER_LARGE_INCREMENT};
+
 /// Controller for the CMV mode
 class PC_CMV_Controller : public VentilationController {
  public:
-    /// Default constructor
-    PC_CMV_Controller();
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit PC_CMV_Controller(VentilatorContext* p_context = &ventilator);
 
     /// Initialize controller
     void setup() override;
@@ -28,9 +91,33 @@ class PC_CMV_Controller : public VentilationController {
     /// Control the exhalation
     void exhale() override;
 
+    /// Control the inspiratory valve on every pressure sample
+    void inhaleInnerLoop(int32_t p_dt) override;
+
+    /// Control the expiratory valve on every pressure sample
+    void exhaleInnerLoop(int32_t p_dt) override;
+
     /// End the current breathing cycle
     void endCycle() override;
 
+    /**
+     * Save or restore the PID integrals and error rings, and the blower regulation
+     *
+     * @param p_archive Checkpoint archive
+     * @note The tuning is not part of it: a checkpoint can be resumed with other coefficients
+     */
+    void checkpoint(CheckpointArchive* p_archive) override;
+
+    /**
+     * Replace the coefficients of the PIDs and of the blower regulation
+     *
+     * @param p_tuning Coefficients, PC_CMV_DEFAULT_TUNING unless a tuner is searching them
+     */
+    void setTuning(const PcCmvTuning& p_tuning) { m_tuning = p_tuning; }
+
+    /// Coefficients of the PIDs and of the blower regulation
+    const PcCmvTuning& tuning() const { return m_tuning; }
+
     /// List of alarms that must be enabled for this mode
     struct Alarms enabledAlarms() const override {
         struct Alarms a = {RCM_SW_1,  RCM_SW_2,  RCM_SW_3,  RCM_SW_4,  RCM_SW_5,
@@ -75,7 +162,7 @@ class PC_CMV_Controller : public VentilationController {
     /// Current blower speed increment (to apply at the beginning of the next cycle)
     int32_t m_blowerIncrement;
 
-    /// Error of the last computation of the blower PID
+    /// Integral of the blower PID, in 1/PC_PID_INTEGRAL_RESOLUTION of the per-mille command
     int32_t m_inspiratoryPidIntegral;
 
     /// Fast mode at start of expiration
@@ -84,7 +171,13 @@ class PC_CMV_Controller : public VentilationController {
     /// Fast mode at start of inspiration
     bool m_inspiratoryPidFastMode;
 
-    /// Integral gain of the patient PID
+    /// Time spent in inspiratory fast mode since the beginning of the cycle (in microsecond)
+    int32_t m_inspiratoryPidFastModeDuration;
+
+    /// Time spent in expiratory fast mode since the beginning of the exhalation (in microsecond)
+    int32_t m_expiratoryPidFastModeDuration;
+
+    /// Integral of the patient PID, in 1/PC_PID_INTEGRAL_RESOLUTION of the per-mille command
     int32_t m_expiratoryPidIntegral;
 
     /// Last aperture of the blower valve
@@ -106,6 +199,7 @@ class PC_CMV_Controller : public VentilationController {
     int32_t m_inspiratoryPidLastErrors[PC_NUMBER_OF_SAMPLE_DERIVATIVE_MOVING_MEAN];
     /// Last error index in inspiratory PID
     int32_t m_inspiratoryPidLastErrorsIndex;
-};
 
-extern PC_CMV_Controller pcCmvController;
+    /// Coefficients of the PIDs and of the blower regulation
+    PcCmvTuning m_tuning;
+};
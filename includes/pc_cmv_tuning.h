@@ -0,0 +1,55 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file pc_cmv_tuning.h
+ * @brief Coefficients of the valve PIDs and of the blower regulation of the PC modes
+ *
+ * Generated by tune_pc_cmv (see test/README.md): hand-picked values.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+// INITIALISATION =============================================================
+
+/// Proportional gain of the inspiratory valve PID
+static const int32_t PC_CMV_INSPIRATORY_PID_KP = 2500;
+/// Integral gain of the inspiratory valve PID, above the pressure command
+static const int32_t PC_CMV_INSPIRATORY_PID_KI_ABOVE = 200;
+/// Integral gain of the inspiratory valve PID, below the pressure command
+static const int32_t PC_CMV_INSPIRATORY_PID_KI_BELOW = 50;
+/// Proportional gain of the expiratory valve PID
+static const int32_t PC_CMV_EXPIRATORY_PID_KP = 2500;
+/// Integral gain of the expiratory valve PID, above the PEEP command
+static const int32_t PC_CMV_EXPIRATORY_PID_KI_ABOVE = 50;
+/// Integral gain of the expiratory valve PID, below a PEEP command of 50 mmH2O
+static const int32_t PC_CMV_EXPIRATORY_PID_KI_LOW_PEEP = 250;
+/// Integral gain of the expiratory valve PID, below a PEEP command of 100 mmH2O or more
+static const int32_t PC_CMV_EXPIRATORY_PID_KI_HIGH_PEEP = 120;
+/// Duration of the half pressure ramp, in ms, a faster plateau decreases the blower speed
+static const int32_t PC_CMV_BLOWER_HALF_RAMP_MS = 120;
+/// Part of the inspiration, in %, before which a plateau may decrease the blower speed
+static const int32_t PC_CMV_BLOWER_EARLY_PLATEAU_PERCENT = 30;
+/// Part of the inspiration, in %, before which a small overshoot decreases the blower speed
+static const int32_t PC_CMV_BLOWER_OVERSHOOT_PERCENT = 20;
+/// Peak pressure above the plateau command, in mmH2O, that is a small overshoot
+static const int32_t PC_CMV_BLOWER_SMALL_OVERSHOOT = 15;
+/// Peak pressure above the plateau command, in mmH2O, that is a large overshoot
+static const int32_t PC_CMV_BLOWER_LARGE_OVERSHOOT = 25;
+/// Blower speed decrease after a fast ramp or an overshoot
+static const int32_t PC_CMV_BLOWER_DECREMENT = 100;
+/// Part of the inspiration, in %, before which a plateau keeps the blower speed
+static const int32_t PC_CMV_BLOWER_HOLD_PERCENT = 40;
+/// Part of the inspiration, in %, before which a plateau slightly increases the blower speed
+static const int32_t PC_CMV_BLOWER_SMALL_STEP_PERCENT = 50;
+/// Blower speed increase after a slightly late plateau
+static const int32_t PC_CMV_BLOWER_SMALL_INCREMENT = 25;
+/// Part of the inspiration, in %, before which a plateau increases the blower speed
+static const int32_t PC_CMV_BLOWER_MEDIUM_STEP_PERCENT = 60;
+/// Blower speed increase after a late plateau
+static const int32_t PC_CMV_BLOWER_MEDIUM_INCREMENT = 50;
+/// Blower speed increase after a very late plateau, or no plateau
+static const int32_t PC_CMV_BLOWER_LARGE_INCREMENT = 100;
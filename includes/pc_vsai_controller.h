@@ -13,8 +13,12 @@
 /// Controller for the VSAI mode
 class PC_VSAI_Controller final : public VentilationController {
  public:
-    /// Default constructor
-    PC_VSAI_Controller();
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit PC_VSAI_Controller(VentilatorContext* p_context = &ventilator);
 
     /// Initialize controller
     void setup() override;
@@ -31,6 +35,13 @@ class PC_VSAI_Controller final : public VentilationController {
     /// End the current breathing cycle
     void endCycle() override;
 
+    /**
+     * Save or restore the PID integrals and error rings, and the blower regulation
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive) override;
+
     /// List of alarms that must be enabled for this mode
     struct Alarms enabledAlarms() const override {
         struct Alarms a = {RCM_SW_1,  RCM_SW_2,  RCM_SW_3,  RCM_SW_4,  RCM_SW_5,
@@ -121,5 +132,3 @@ class PC_VSAI_Controller final : public VentilationController {
     /// Max flow during inspiration
     int32_t m_maxInspiratoryFlow;
 };
-
-extern PC_VSAI_Controller pcVsaiController;
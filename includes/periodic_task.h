@@ -0,0 +1,121 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file periodic_task.h
+ * @brief Table of periodic tasks run from a millisecond timer
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+// STRUCTURES =================================================================
+
+/// Description and execution statistics of a periodic task
+struct PeriodicTask {
+    /**
+     * Parameterized constructor, the execution statistics start cleared
+     *
+     * @param p_callback Function to call when the task is due
+     * @param p_periodMs Period of the task in ms
+     * @param p_phaseMs Offset in ms inside the period at which the task runs
+     * @param p_priority Priority of the task, 0 is the most urgent
+     */
+    PeriodicTask(void (*p_callback)(void),
+                 uint32_t p_periodMs,
+                 uint32_t p_phaseMs,
+                 uint8_t p_priority);
+
+    /// Function to call when the task is due
+    void (*callback)(void);
+
+    /// Period of the task in ms
+    uint32_t periodMs;
+
+    /// Offset in ms inside the period at which the task runs (must be lower than periodMs)
+    uint32_t phaseMs;
+
+    /// Priority of the task, 0 is the most urgent
+    uint8_t priority;
+
+    /// Longest execution time observed in µs
+    uint32_t worstExecutionTimeUs;
+
+    /// Sum of all execution times in µs, used to compute the mean
+    uint64_t totalExecutionTimeUs;
+
+    /// Number of executions since boot
+    uint32_t executionCount;
+
+    /// True while the task waits in the deferred work queue
+    volatile bool pending;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Run a task and update its execution statistics
+ *
+ * @param p_task Task to run
+ * @note Execution times include the time spent in interrupts preempting the task
+ */
+void executePeriodicTask(PeriodicTask* p_task);
+
+// CLASS ======================================================================
+
+/**
+ * Dispatcher of a static table of periodic tasks
+ *
+ * Each task is due when the millisecond clock modulo its period equals its phase. Due tasks are
+ * not run from the caller: they are posted to the deferred work queue, and executed by the
+ * background loop. Phases are meant to spread the tasks over different ticks, and when several
+ * tasks are due on the same tick, they are posted by increasing priority value.
+ */
+class PeriodicTaskTable {
+ public:
+    /**
+     * Parameterized constructor
+     *
+     * @param p_tasks Table of tasks, it is sorted in place by priority
+     * @param p_size Number of tasks in the table
+     */
+    PeriodicTaskTable(PeriodicTask* p_tasks, uint8_t p_size);
+
+    /**
+     * Post every task that is due at the given clock value to the deferred work queue
+     *
+     * @param p_clockMs Millisecond clock of the caller
+     */
+    void run(uint32_t p_clockMs);
+
+    /// Number of tasks in the table
+    uint8_t size() const { return m_size; }
+
+    /**
+     * Get a task of the table, to read its statistics
+     *
+     * @param p_index Index of the task, in priority order
+     * @return The task
+     */
+    const PeriodicTask& task(uint8_t p_index) const { return m_tasks[p_index]; }
+
+    /**
+     * Get the mean execution time of a task
+     *
+     * @param p_index Index of the task, in priority order
+     * @return Mean execution time in µs, 0 if the task never ran
+     */
+    uint32_t meanExecutionTimeUs(uint8_t p_index) const;
+
+    /// Clear the execution statistics of all tasks
+    void resetStatistics();
+
+ private:
+    /// Table of tasks, sorted by priority
+    PeriodicTask* m_tasks;
+
+    /// Number of tasks
+    uint8_t m_size;
+};
@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 
+#include "../includes/board_state.h"
+
 /// Offset aware reading class for the pressure sensor
 class PressureSensor {
  public:
@@ -22,6 +24,14 @@ class PressureSensor {
      */
     int32_t read();
 
+    /**
+     * Convert a value of the pressure sensor ADC, like read() does
+     *
+     * @param p_rawValue Value read from the ADC
+     * @return The pressure in mmH2O
+     */
+    int32_t convert(uint16_t p_rawValue);
+
     /**
      * Set the pressure sensor offset
      *
@@ -31,9 +41,12 @@ class PressureSensor {
         m_PressureSensorOffset = p_pressureSensorOffest;
     }
 
+    /// Get the pressure sensor offset in mmH2O
+    int32_t pressureSensorOffset() const { return m_PressureSensorOffset; }
+
  private:
     /// Pressure sensor offset in mmH2O
     int32_t m_PressureSensorOffset;
 };
 
-extern PressureSensor inspiratoryPressureSensor;
+extern BOARD_STATE PressureSensor inspiratoryPressureSensor;
@@ -21,9 +21,34 @@
  */
 int16_t convertSensor2Pressure(uint32_t sensorValue);
 
+/**
+ * Convert a pressure to the analog value the sensor gives for it, without filtering
+ *
+ * @param p_pressure Pressure in mmH2O
+ * @return Value of the analog input, on ADC_RESOLUTION_MAKAIR bits
+ * @note Used to feed a simulated sensor
+ */
+uint32_t convertPressure2Sensor(int32_t p_pressure);
+
 /**
  * Reset the value of void filteredRawPressure to 0
  *
  * @note Mainly for testing purpose
  */
 void resetFilteredRawPressure();
+
+/**
+ * Get the state of the filter of convertSensor2Pressure()
+ *
+ * @return Filtered raw value of the sensor
+ * @note Used to capture the sensor samples
+ */
+int32_t getFilteredRawPressure();
+
+/**
+ * Restore the state of the filter of convertSensor2Pressure()
+ *
+ * @param p_filteredRawPressure State given by getFilteredRawPressure()
+ * @note Used to replay captured sensor samples
+ */
+void restoreFilteredRawPressure(int32_t p_filteredRawPressure);
@@ -10,7 +10,9 @@
 // INCLUDES ===================================================================
 
 // Internal libraries
+#include "../includes/checkpoint.h"
 #include "../includes/config.h"
+#include "../includes/hal.h"
 #include "../includes/parameters.h"
 
 // MACROS =================================================================
@@ -34,15 +36,11 @@ class PressureValve {
     /**
      * Parameterized constructor
      *
-     * @param p_hardwareTimer       Hardware time for this valve
-     * @param p_timerChannel        TIM channel for this valve
-     * @param p_valvePin            Data pin for this valve
+     * @param p_output            Output driving the motor of this valve
      * @param p_openApertureAngle   Open aperture angle in degrees
      * @param p_closeApertureAngle  Close aperture angle in degrees
      */
-    PressureValve(HardwareTimer* p_hardwareTimer,
-                  uint16_t p_timerChannel,
-                  uint16_t p_valvePin,
+    PressureValve(HalPwmOutput p_output,
                   uint16_t p_openApertureAngle,
                   uint16_t p_closeApertureAngle);
     /**
@@ -97,8 +95,7 @@ class PressureValve {
         }
 
         if (command != position) {
-            actuator->setCaptureCompare(timerChannel, valveAngle2MicroSeconds(command),
-                                        MICROSEC_COMPARE_FORMAT);
+            halWritePwmOutput(output, valveAngle2MicroSeconds(command));
             position = command;
         }
     }
@@ -109,6 +106,13 @@ class PressureValve {
     /// Maximum valve aperture angle in degrees
     inline uint16_t maxAperture() const { return maxApertureAngle; }
 
+    /**
+     * Save or restore the command and the position, a restored position is sent to the motor
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
     /// Value of the requested aperture
     uint16_t command;
 
@@ -131,15 +135,6 @@ class PressureValve {
     /// Close aperture angle in degrees
     uint16_t closeApertureAngle;
 
-    /// Hardware time for this valve
-    HardwareTimer* actuator;
-
-    /// TIM channel for this valve
-    uint16_t timerChannel;
-
-    /// Data pin for this valve
-    uint16_t valvePin;
+    /// Output driving the motor of this valve
+    HalPwmOutput output;
 };
-
-extern PressureValve expiratoryValve;
-extern PressureValve inspiratoryValve;
@@ -6,6 +6,7 @@
  *****************************************************************************/
 
 #pragma once
+#include "../includes/board_state.h"
 #include "../includes/parameters.h"
 
 /// Number of seconds with no heartbeat after which the RPi should be restarted
@@ -38,4 +39,4 @@ class RpiWatchdog {
     RpiWatchdogStep m_rpiWatchdogStep;
 };
 
-extern RpiWatchdog rpiWatchdog;
+extern BOARD_STATE RpiWatchdog rpiWatchdog;
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file rtos_tasks.h
+ * @brief Optional FreeRTOS task model of the firmware
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include "../includes/config.h"
+
+#ifdef RTOS_TASKS
+
+#include "../includes/periodic_task.h"
+
+// INITIALISATION =============================================================
+
+/// Number of RTOS tasks
+#define RTOS_TASK_COUNT 4u
+
+/**
+ * Stack size of each RTOS task, in words
+ *
+ * The POSIX port runs each task on a thread, whose stack is larger: the host build sets it.
+ */
+#ifndef RTOS_TASK_STACK_SIZE
+#define RTOS_TASK_STACK_SIZE 512u
+#endif
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Create the RTOS tasks and start the scheduler
+ *
+ * Tasks, by decreasing priority:
+ * - flow meter acquisition, every 10 ms
+ * - control (main state machine), every 1 ms, once startRtosControlTask() has been called
+ * - serial control, every 10 ms
+ * - UI (LCD, keyboard, battery, alarm effects, RPi watchdog), every 1 ms
+ *
+ * @param p_startup Function run by the UI task before its periodic work, it may block
+ * @warning It never returns
+ */
+void startRtosTasks(void (*p_startup)(void));
+
+/// Let the control task start running the main state machine
+void startRtosControlTask(void);
+
+/**
+ * Change the period of the control task
+ *
+ * @param p_periodMs New period in ms, applied from the next period
+ */
+void setRtosControlPeriod(uint32_t p_periodMs);
+
+/**
+ * Prevent the control task from running
+ *
+ * @note The control task holds the same mutex during each period, so a tick that expires while
+ *       the lock is held runs as soon as it is released
+ */
+void lockRtosControl(void);
+
+/// Allow the control task to run again
+void unlockRtosControl(void);
+
+/**
+ * Get a RTOS task, to read its execution statistics
+ *
+ * @param p_index Index of the task, by decreasing priority
+ * @return The task
+ */
+const PeriodicTask& rtosTask(uint8_t p_index);
+
+#endif
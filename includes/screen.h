@@ -12,16 +12,20 @@
 
 // INCLUDES ===================================================================
 
+#ifndef UNIT_TEST
 // External
 #include <LiquidCrystal.h>
+#endif
 
 // Internal
 #include "../includes/parameters.h"
 
 // INITIALISATION =============================================================
 
+#ifndef UNIT_TEST
 /// Instance of the screen controller
 extern LiquidCrystal screen;
+#endif
 
 // FUNCTIONS ==================================================================
 
@@ -115,6 +119,15 @@ void displayPatientMustBeUnplugged();
 /// Show that EOL mode was triggered
 void displayEndOfLineTestMode();
 
+/**
+ * Display the message of a step of the end of line test
+ *
+ * @param p_message Message, its lines separated by '\n', 3 lines at most
+ * @param p_testNumber Number of the test, 0 before the first one
+ * @param p_isFailed True if the test failed
+ */
+void displayEndOfLineTestMessage(const char* p_message, uint32_t p_testNumber, bool p_isFailed);
+
 /// Display error when battery level is too discharged
 void displayBatteryDeepDischarge();
 
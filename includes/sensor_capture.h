@@ -0,0 +1,211 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_capture.h
+ * @brief Capture of the raw sensor samples, to replay them on a host
+ *
+ * While a capture runs, every run of the control interrupt records its date and the raw value of
+ * the pressure sensor ADC, every flow meter acquisition records the words read from the sensors,
+ * and the control messages that change the settings are recorded where they are applied. The
+ * records go into a buffer that the background loop sends on the telemetry link. Replaying them
+ * through the same conversions and controllers gives back every command bit for bit.
+ *
+ * A capture must start from a stopped machine: the controllers then only depend on the settings,
+ * the calibrations and the pressure filter state, that the start record and the records following
+ * it hold.
+ *
+ * Records are a tag byte followed by big endian fields:
+ * - 'S' start: version (u8), date of the last timer period (u64), date of the first control tick
+ *   (u64), pressure sensor offset (i32), pressure filter state (i32), inspiratory flow meter
+ *   offset (i32), then one 'C' record per setting received since boot, oldest first
+ * - 'T' control tick: date delta to the previous tick in µs (12 bits), raw pressure (12 bits)
+ * - 'L' control tick with a long delta: date delta (u32), raw pressure (u16)
+ * - 'F' flow meter acquisition, before the next control tick: inspiratory word (u16), expiratory
+ *   word (u16), fault (u8)
+ * - 'C' control setting, before the next control tick: setting (u8), value (u16)
+ * - 'A' breathing activation, before the next control tick: running (u8)
+ * - 'E' end: reason (u8), see SensorCaptureEnd
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../includes/board_state.h"
+#include "../includes/serial_control.h"
+
+// INITIALISATION =============================================================
+
+/// Version of the capture records
+#define SENSOR_CAPTURE_VERSION 1u
+
+/// Size in bytes of the buffer of the records waiting to be sent
+#define SENSOR_CAPTURE_BUFFER_SIZE 2048u
+
+/// Largest number of bytes of records sent in one telemetry message
+#define SENSOR_CAPTURE_MESSAGE_SIZE 512u
+
+/// Number of flow meter acquisitions kept until the next control tick
+#define SENSOR_CAPTURE_FLOW_SAMPLES 4u
+
+/// Largest date delta of a 'T' record, in µs
+#define SENSOR_CAPTURE_SHORT_DELTA_MAX 0xFFFu
+
+/// Size of a start record, without the setting records that follow it
+#define SENSOR_CAPTURE_START_SIZE 30u
+
+/// Record tags
+#define SENSOR_CAPTURE_START 'S'
+#define SENSOR_CAPTURE_TICK 'T'
+#define SENSOR_CAPTURE_LONG_TICK 'L'
+#define SENSOR_CAPTURE_FLOW 'F'
+#define SENSOR_CAPTURE_SETTING 'C'
+#define SENSOR_CAPTURE_ACTIVATION 'A'
+#define SENSOR_CAPTURE_END 'E'
+
+/// Reason of the end of a capture
+enum SensorCaptureEnd {
+    /// Stopped by a control message
+    SENSOR_CAPTURE_STOPPED = 0,
+    /// The records were produced faster than they were sent, the next ones were lost
+    SENSOR_CAPTURE_OVERFLOW = 1,
+};
+
+// CLASS ======================================================================
+
+/// Recorder of the raw sensor samples and of the control messages
+class SensorCapture {
+ public:
+    /// Default constructor
+    SensorCapture();
+
+    /// Start a capture on the next control tick where the machine is stopped
+    void arm();
+
+    /// End the capture, or cancel it if it did not start yet
+    void stop();
+
+    /// True if a capture is armed or running
+    bool isActive() const { return m_armed || m_running; }
+
+    /**
+     * Record a run of the control interrupt
+     *
+     * @param p_entryMicros Date of the start of the run in µs
+     * @param p_lastTimerMicros Date in µs of the last timer period accounted by the main state
+     *                          machine
+     * @param p_rawPressure Value read from the pressure sensor ADC
+     * @param p_stopped True if the main state machine is in the stopped state
+     * @warning It must be called by the control interrupt, before the pressure is converted
+     */
+    void onControlTick(uint64_t p_entryMicros,
+                       uint64_t p_lastTimerMicros,
+                       uint16_t p_rawPressure,
+                       bool p_stopped);
+
+    /**
+     * Record a flow meter acquisition
+     *
+     * @param p_inspiratoryWord Word read from the inspiratory flow meter
+     * @param p_expiratoryWord Word read from the expiratory flow meter
+     * @param p_fault True if the flow meters do not answer
+     * @warning It must be called by the flow meter interrupt, at the end of an acquisition
+     */
+    void onFlowSample(uint16_t p_inspiratoryWord, uint16_t p_expiratoryWord, bool p_fault);
+
+    /**
+     * Record a control setting that is about to be applied
+     *
+     * @param p_setting Setting of the control protocol
+     * @param p_value Value of the setting
+     * @note Settings that do not change the ventilation (heartbeat, alarm snooze...) are ignored
+     * @warning It must be called with the control locked
+     */
+    void onControlSetting(uint8_t p_setting, uint16_t p_value);
+
+    /**
+     * Take the records waiting to be sent
+     *
+     * @param p_data Buffer to fill
+     * @param p_size Size of the buffer
+     * @return Number of bytes taken, the oldest first
+     * @warning It must be called with the control locked
+     */
+    size_t take(uint8_t* p_data, size_t p_size);
+
+    /// Number of captures that ended on an overflow
+    uint32_t overflows() const { return m_overflows; }
+
+ private:
+    /// Start the capture
+    void start(uint64_t p_entryMicros, uint64_t p_lastTimerMicros);
+
+    /// End the capture with a record
+    void end(SensorCaptureEnd p_reason);
+
+    /**
+     * Append a record to the buffer
+     *
+     * @param p_record Bytes of the record, tag first
+     * @param p_size Size of the record
+     * @return False if there was no room for it, the capture then ends on an overflow
+     */
+    bool append(const uint8_t* p_record, uint16_t p_size);
+
+    /// Append the flow meter acquisitions done since the last control tick
+    bool appendFlowSamples();
+
+    /// Records waiting to be sent
+    uint8_t m_buffer[SENSOR_CAPTURE_BUFFER_SIZE];
+
+    /// Index of the oldest byte waiting to be sent
+    uint16_t m_tail;
+
+    /// Number of bytes waiting to be sent
+    uint16_t m_size;
+
+    /// Flow meter acquisitions done since the last control tick, written by the flow meter
+    /// interrupt and read by the control one
+    uint16_t m_flowSamples[SENSOR_CAPTURE_FLOW_SAMPLES][3];
+
+    /// Number of flow meter acquisitions written, wraps
+    volatile uint8_t m_flowSamplesHead;
+
+    /// Number of flow meter acquisitions read, wraps
+    volatile uint8_t m_flowSamplesTail;
+
+    /// True if flow meter acquisitions were lost
+    volatile bool m_flowSamplesLost;
+
+    /// Last value of every setting received since boot
+    uint16_t m_settingValues[CONTROL_SETTINGS];
+
+    /// Order of the last change of every setting, 0 if it was never received
+    uint32_t m_settingOrders[CONTROL_SETTINGS];
+
+    /// Order of the last setting received
+    uint32_t m_lastSettingOrder;
+
+    /// True if the capture starts on the next control tick where the machine is stopped
+    volatile bool m_armed;
+
+    /// True if the capture runs
+    volatile bool m_running;
+
+    /// Date in µs of the last recorded control tick
+    uint64_t m_lastTickMicros;
+
+    /// Breathing activation of the last recorded control tick
+    bool m_lastActivation;
+
+    /// Number of captures that ended on an overflow
+    uint32_t m_overflows;
+};
+
+// INITIALISATION =============================================================
+
+/// Instance of the sensor capture
+extern BOARD_STATE SensorCapture sensorCapture;
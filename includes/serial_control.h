@@ -7,6 +7,10 @@
 
 #pragma once
 
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
 /// Special value that can be used in a heartbeat control message to disable RPi watchdog
 #define DISABLE_RPI_WATCHDOG 43690u
 
@@ -91,8 +95,24 @@ enum ControlSetting {
     PeakPressureAlarmThreshold = 30,
     /// Confirm end-of-line test step (value bounds must be between 0 and 0)
     EolConfirm = 31,
+    /// Request the interrupt timing histograms (0 = send them, 1 = send and clear them)
+    TimingHistograms = 32,
+    /// Raw sensor capture (value must be 1 to start it on the next stopped state and 0 to stop it)
+    SensorCaptureEnabled = 33,
 };
 
+/// Number of settings in the control protocol
+#define CONTROL_SETTINGS 34u
+
+/**
+ * Apply a setting received in a control message
+ *
+ * @param p_setting Setting, one of ControlSetting
+ * @param p_value Value of the setting
+ * @warning It must be called with the control locked
+ */
+void applyControlSetting(uint8_t p_setting, uint16_t p_value);
+
 /**
  * Parse input and handle changes of settings
  *
@@ -10,13 +10,20 @@
 
 #include "../includes/alarm_controller.h"
 #include "../includes/config.h"
+#include "../includes/cpu_load.h"
 #include "../includes/cycle.h"
 #ifndef SIMULATOR
 #include "../includes/end_of_line_test.h"
 #endif
 
-/// Current version of the telemetry protocol
-#define PROTOCOL_VERSION 2u
+/**
+ * Current version of the telemetry protocol
+ *
+ * Version 3 adds the unsolicited "load report" (P:), "timing histograms" (H:) and "sensor capture"
+ * (R:) messages, that a UI of version 2 does not know. Version 4 appends the CPU load of each
+ * subsystem to the "machine state snapshot" message
+ */
+#define PROTOCOL_VERSION 4u
 
 /// Prepare Serial6 to send telemetry data
 void initTelemetry(void);
@@ -111,7 +118,8 @@ void sendMachineStateSnapshot(uint32_t cycleValue,
                               uint16_t localeValue,
                               uint8_t patientHeight,
                               uint8_t patientGender,
-                              uint16_t peakPressureAlarmThresholdValue);
+                              uint16_t peakPressureAlarmThresholdValue,
+                              const uint16_t subsystemLoadValues[CPU_LOAD_SUBSYSTEMS]);
 
 /// Send a "alarm trap" message
 void sendAlarmTrap(uint16_t centileValue,
@@ -128,6 +136,32 @@ void sendAlarmTrap(uint16_t centileValue,
 /// Send a "control ack" message
 void sendControlAck(uint8_t setting, uint16_t value);
 
+/// Send a "load report" message
+void sendLoadReport(uint8_t tierValue,
+                    uint32_t overrunCountValue,
+                    uint32_t droppedSnapshotsValue,
+                    uint32_t postponedScreenUpdatesValue,
+                    uint32_t shortenedSerialLoopsValue);
+
+/// Send a "timing histograms" message, with the histograms of every interrupt timing source
+void sendTimingHistograms(void);
+
+/**
+ * Send a "sensor capture" message
+ *
+ * @param p_records Records of the sensor capture, see sensor_capture.h
+ * @param p_size Number of bytes of records
+ */
+void sendSensorCapture(const uint8_t* p_records, uint16_t p_size);
+
+/**
+ * Number of bytes of records a "sensor capture" message can hold without waiting for the link
+ *
+ * @param p_maxSize Largest number of bytes of records of the message
+ * @return Bytes of records that fit in the free room of the transmit buffer, at most p_maxSize
+ */
+uint16_t sensorCaptureRoom(uint16_t p_maxSize);
+
 /// Send a "watchdog restart" fatal error
 void sendWatchdogRestartFatalError(void);
 
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file timebase.h
+ * @brief Monotonic 64-bit microsecond clock
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+// INITIALISATION =============================================================
+
+/// Number of counts of the hardware counter between two overflows (it counts up to 0xFFFFFFFE)
+#define TIMEBASE_PERIOD_COUNTS 0xFFFFFFFFull
+
+/// Below this count, the hardware counter is considered to have just wrapped
+#define TIMEBASE_HALF_PERIOD_COUNTS 0x80000000u
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Start the hardware counter of the clock
+ *
+ * @warning It must be called once, before any other function of the firmware reads the clock
+ */
+void initTimebase(void);
+
+/**
+ * Read the clock
+ *
+ * @return Microseconds since initTimebase(), it never wraps
+ * @note It can be called from any interrupt
+ */
+uint64_t monotonicMicros(void);
+
+/**
+ * Read the clock in milliseconds
+ *
+ * @return Milliseconds since initTimebase(), truncated to 32 bits
+ * @note Only differences between two values are meaningful, they stay right across the 32-bit
+ *       wrap as long as they are computed with unsigned 32-bit arithmetic
+ */
+uint32_t monotonicMillis(void);
+
+/**
+ * Extend a reading of the 32-bit hardware counter to 64 bits
+ *
+ * @param p_overflows Number of overflows handled by the overflow interrupt
+ * @param p_count Value of the hardware counter
+ * @param p_overflowPending True if an overflow is flagged but not handled yet
+ * @return Number of counts since the counter started
+ */
+uint64_t extendTimebaseCount(uint32_t p_overflows, uint32_t p_count, bool p_overflowPending);
+
+#ifdef UNIT_TEST
+/**
+ * Set the host clock
+ *
+ * @param p_micros New value of the clock in µs, it must not be lower than the current one
+ */
+void setMonotonicMicros(uint64_t p_micros);
+
+/**
+ * Move the host clock forward
+ *
+ * @param p_micros Duration in µs
+ */
+void advanceMonotonicMicros(uint64_t p_micros);
+#endif
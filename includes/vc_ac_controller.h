@@ -13,6 +13,14 @@
 /// Controller for the AC mode
 class VC_AC_Controller final : public VC_CMV_Controller {
  public:
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit VC_AC_Controller(VentilatorContext* p_context = &ventilator)
+        : VC_CMV_Controller(p_context) {}
+
     /// Control the exhalation
     void exhale() override;
 
@@ -26,5 +34,3 @@ class VC_AC_Controller final : public VC_CMV_Controller {
         return a;
     }
 };
-
-extern VC_AC_Controller vcAcController;
@@ -13,8 +13,12 @@
 /// Controller for the Volume Controled mode
 class VC_CMV_Controller : public VentilationController {
  public:
-    /// Default constructor
-    VC_CMV_Controller();
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit VC_CMV_Controller(VentilatorContext* p_context = &ventilator);
 
     /// Initialize controller
     void setup() override;
@@ -31,6 +35,13 @@ class VC_CMV_Controller : public VentilationController {
     /// End the current breathing cycle
     void endCycle() override;
 
+    /**
+     * Save or restore the PID integral and error ring, and the flow regulation
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive) override;
+
     /// List of alarms that must be enabled for this mode
     struct Alarms enabledAlarms() const override {
         struct Alarms a = {0u, RCM_SW_2,  RCM_SW_3,  0u,        0u,        0u,
@@ -96,5 +107,3 @@ class VC_CMV_Controller : public VentilationController {
     /// Blower ticks
     int32_t m_blowerTicks;
 };
-
-extern VC_CMV_Controller vcCmvController;
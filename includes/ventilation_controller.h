@@ -8,12 +8,21 @@
 #pragma once
 
 #include "../includes/alarm_controller.h"
+#include "../includes/checkpoint.h"
+#include "../includes/context_member.h"
 #include "../includes/parameters.h"
 
 /// Abstract class for ventilation controllers
 // = 0 means that the method is not implemented in this class
-class VentilationController {
+class VentilationController : public ContextMember {
  public:
+    /**
+     * Constructor
+     *
+     * @param p_context Context the controller belongs to
+     */
+    explicit VentilationController(VentilatorContext* p_context) : ContextMember(p_context) {}
+
     /// Initialize controller
     virtual void setup() = 0;
 
@@ -26,11 +35,38 @@ class VentilationController {
     /// Control the exhalation
     virtual void exhale() = 0;
 
+    /**
+     * Control the valves during the inhalation, on every pressure sample
+     *
+     * It runs at the pressure sampling rate, between two calls to inhale(). Controllers that
+     * regulate the valves in inhale() do not need to implement it.
+     *
+     * @param p_dt Duration since the last call in microsecond
+     */
+    virtual void inhaleInnerLoop(int32_t p_dt) { (void)p_dt; }
+
+    /**
+     * Control the valves during the exhalation, on every pressure sample
+     *
+     * It runs at the pressure sampling rate, between two calls to exhale(). Controllers that
+     * regulate the valves in exhale() do not need to implement it.
+     *
+     * @param p_dt Duration since the last call in microsecond
+     */
+    virtual void exhaleInnerLoop(int32_t p_dt) { (void)p_dt; }
+
     /// End the current breathing cycle
     virtual void endCycle() = 0;
 
     /// List of alarms that must be enabled for this mode
     virtual struct Alarms enabledAlarms() const = 0;
 
+    /**
+     * Save or restore the state of the controller
+     *
+     * @param p_archive Checkpoint archive
+     */
+    virtual void checkpoint(CheckpointArchive* p_archive) = 0;
+
  private:
 };
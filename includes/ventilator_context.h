@@ -0,0 +1,82 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file ventilator_context.h
+ * @brief Actuators and controllers of one ventilator
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include "../includes/alarm_controller.h"
+#include "../includes/blower.h"
+#include "../includes/checkpoint.h"
+#include "../includes/context_member.h"
+#include "../includes/main_controller.h"
+#include "../includes/pc_ac_controller.h"
+#include "../includes/pc_cmv_controller.h"
+#include "../includes/pc_vsai_controller.h"
+#include "../includes/pressure_valve.h"
+#include "../includes/vc_ac_controller.h"
+#include "../includes/vc_cmv_controller.h"
+
+// CLASS ======================================================================
+
+/**
+ * Actuators and controllers of one ventilator
+ *
+ * The controllers reach the other objects of the ventilator through their context. The members
+ * are built in their declaration order: the actuators and the main controller exist when the
+ * controllers of the modes are built.
+ *
+ * @warning The sensors, the timers and the main state machine are not part of it, see
+ *          context_member.h: only the `ventilator` of a thread runs, in parallel with the ones of
+ *          the other threads on the host
+ */
+class VentilatorContext {
+ public:
+    /// Default constructor
+    VentilatorContext();
+
+    /// Objects of a context belong to it, a context cannot be copied
+    VentilatorContext(const VentilatorContext&) = delete;
+    VentilatorContext& operator=(const VentilatorContext&) = delete;
+
+    /**
+     * Save or restore the state of every object of the context
+     *
+     * @param p_archive Checkpoint archive
+     */
+    void checkpoint(CheckpointArchive* p_archive);
+
+    /// Valve on the inspiratory branch
+    PressureValve inspiratoryValve;
+
+    /// Valve on the expiratory branch
+    PressureValve expiratoryValve;
+
+    /// Blower pushing air in the inspiratory branch
+    Blower blower;
+
+    /// Alarms of the ventilator
+    AlarmController alarmController;
+
+    /// Controller of the breathing cycle
+    MainController mainController;
+
+    /// Controller of the PC_CMV mode
+    PC_CMV_Controller pcCmvController;
+
+    /// Controller of the PC_AC mode
+    PC_AC_Controller pcAcController;
+
+    /// Controller of the VC_CMV mode
+    VC_CMV_Controller vcCmvController;
+
+    /// Controller of the VC_AC mode
+    VC_AC_Controller vcAcController;
+
+    /// Controller of the PC_VSAI mode
+    PC_VSAI_Controller pcVsaiController;
+};
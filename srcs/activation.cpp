@@ -12,13 +12,14 @@
 
 // Internal libraries
 #include "../includes/buzzer.h"
+#include "../includes/timebase.h"
 
 /// Maximum delay in seconds between two pushes on the stop button to actually stop the machine
 const uint32_t SECOND_STOP_MAX_DELAY_MS = 5000;
 
 // INITIALISATION =============================================================
 
-ActivationController activationController;
+BOARD_STATE ActivationController activationController;
 
 // FUNCTIONS ==================================================================
 
@@ -36,10 +37,10 @@ void ActivationController::changeState(uint16_t state) {
 
 void ActivationController::onStopButton() {
     if ((m_state == RUNNING_READY_TO_STOP)
-        && ((millis() - m_timeOfLastStopPushed) < SECOND_STOP_MAX_DELAY_MS)) {
+        && ((monotonicMillis() - m_timeOfLastStopPushed) < SECOND_STOP_MAX_DELAY_MS)) {
         m_state = STOPPED;
     } else if ((m_state == RUNNING_READY_TO_STOP) || (m_state == RUNNING)) {
-        m_timeOfLastStopPushed = millis();
+        m_timeOfLastStopPushed = monotonicMillis();
         m_state = RUNNING_READY_TO_STOP;
     } else {
         // Stay in STOPPED state
@@ -48,10 +49,15 @@ void ActivationController::onStopButton() {
 
 void ActivationController::refreshState() {
     // If the 2nd STOP deadline is exceeded, switch back
-    // to running state. This is needed to make sure millis() counter
+    // to running state. This is needed to make sure monotonicMillis() counter
     // overflow does not make the test invalid
     if ((m_state == RUNNING_READY_TO_STOP)
-        && ((millis() - m_timeOfLastStopPushed) >= SECOND_STOP_MAX_DELAY_MS)) {
+        && ((monotonicMillis() - m_timeOfLastStopPushed) >= SECOND_STOP_MAX_DELAY_MS)) {
         m_state = RUNNING;
     }
 }
+
+void ActivationController::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->enumField(m_state);
+    p_archive->field(m_timeOfLastStopPushed);
+}
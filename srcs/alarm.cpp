@@ -9,9 +9,6 @@
 
 // INCLUDES ===================================================================
 
-// Externals
-#include "Arduino.h"
-
 // Internals
 #include "../includes/alarm.h"
 
@@ -59,3 +56,10 @@ void Alarm::enable() { m_enabled = true; }
 void Alarm::disable() { m_enabled = false; }
 
 bool Alarm::isEnabled() { return m_enabled; }
+
+void Alarm::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(m_detectionNumber);
+    p_archive->field(m_cycleNumber);
+    p_archive->field(m_cyclesSinceTrigger);
+    p_archive->field(m_enabled);
+}
@@ -14,13 +14,12 @@
 // Internals
 #include "../includes/alarm_controller.h"
 #include "../includes/buzzer.h"
+#include "../includes/control_lock.h"
 #include "../includes/cycle.h"
+#include "../includes/hal.h"
 #include "../includes/screen.h"
 #include "../includes/telemetry.h"
-
-// INITIALISATION =============================================================
-
-AlarmController alarmController;
+#include "../includes/timebase.h"
 
 // FUNCTIONS ==================================================================
 
@@ -188,8 +187,8 @@ AlarmController::AlarmController()
 void AlarmController::snooze() {
     if (m_unsnooze) {
         m_unsnooze = false;
-        digitalWrite(PIN_LED_GREEN, LED_GREEN_ACTIVE);
-        m_snoozeTime = millis();
+        halWriteLed(HAL_LED_GREEN, true);
+        m_snoozeTime = monotonicMillis();
         for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
             Alarm* current = &m_alarms[i];
             if (current->isTriggered()) {
@@ -270,8 +269,11 @@ void AlarmController::runAlarmEffects(uint32_t p_tick) {
     uint8_t triggeredAlarmCodes[ALARMS_SIZE];
     uint8_t numberOfTriggeredAlarms = 0;
     bool justUnsnoozed = false;
+    bool unsnoozed = true;
 
-    //
+    // The control raises the alarms: their state is read under the lock, and the buzzer, the LEDs
+    // and the screen are then driven while the control runs
+    lockControl();
     for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
         Alarm* current = &m_alarms[i];
         if (current->isTriggered()) {
@@ -291,10 +293,12 @@ void AlarmController::runAlarmEffects(uint32_t p_tick) {
         }
     }
 
-    uint32_t millisSinceSnooze = millis() - m_snoozeTime;
+    uint32_t millisSinceSnooze = monotonicMillis() - m_snoozeTime;
     if (!m_unsnooze && (m_snoozeTime > 0u) && (millisSinceSnooze >= 120000u)) {
         unsnooze();
     }
+    unsnoozed = m_unsnooze;
+    unlockControl();
 
     if ((p_tick % (LCD_UPDATE_PERIOD_US / MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS)) == 0u) {
         displayAlarmInformation(triggeredAlarmCodes, numberOfTriggeredAlarms);
@@ -302,45 +306,45 @@ void AlarmController::runAlarmEffects(uint32_t p_tick) {
 
     if (highestPriority == AlarmPriority::ALARM_HIGH) {
         if ((m_highestPriority != highestPriority) || justUnsnoozed) {
-            if (m_unsnooze) {
+            if (unsnoozed) {
                 Buzzer_High_Prio_Start();
             }
         }
 
         if ((p_tick % 100u) == 50u) {
-            digitalWrite(PIN_LED_RED, LED_RED_ACTIVE);
+            halWriteLed(HAL_LED_RED, true);
         } else if ((p_tick % 100u) == 0u) {
-            digitalWrite(PIN_LED_RED, LED_RED_INACTIVE);
+            halWriteLed(HAL_LED_RED, false);
         } else {
         }
-        digitalWrite(PIN_LED_YELLOW, LED_YELLOW_INACTIVE);
+        halWriteLed(HAL_LED_YELLOW, false);
     } else if (highestPriority == AlarmPriority::ALARM_MEDIUM) {
         if ((m_highestPriority != highestPriority) || justUnsnoozed) {
-            if (m_unsnooze) {
+            if (unsnoozed) {
                 Buzzer_Medium_Prio_Start();
             }
         }
-        digitalWrite(PIN_LED_RED, LED_RED_INACTIVE);
+        halWriteLed(HAL_LED_RED, false);
         if ((p_tick % 100u) == 50u) {
-            digitalWrite(PIN_LED_YELLOW, LED_YELLOW_ACTIVE);
+            halWriteLed(HAL_LED_YELLOW, true);
         } else if ((p_tick % 100u) == 0u) {
-            digitalWrite(PIN_LED_YELLOW, LED_YELLOW_INACTIVE);
+            halWriteLed(HAL_LED_YELLOW, false);
         } else {
         }
     } else if (highestPriority == AlarmPriority::ALARM_LOW) {
         if ((m_highestPriority != highestPriority) || justUnsnoozed) {
-            if (m_unsnooze) {
+            if (unsnoozed) {
                 Buzzer_Low_Prio_Start();
             }
         }
 
-        digitalWrite(PIN_LED_RED, LED_RED_INACTIVE);
-        digitalWrite(PIN_LED_YELLOW, LED_YELLOW_ACTIVE);
+        halWriteLed(HAL_LED_RED, false);
+        halWriteLed(HAL_LED_YELLOW, true);
     } else {
         Buzzer_Stop();
 
-        digitalWrite(PIN_LED_RED, LED_RED_INACTIVE);
-        digitalWrite(PIN_LED_YELLOW, LED_YELLOW_INACTIVE);
+        halWriteLed(HAL_LED_RED, false);
+        halWriteLed(HAL_LED_YELLOW, false);
     }
 
     m_highestPriority = highestPriority;
@@ -348,7 +352,7 @@ void AlarmController::runAlarmEffects(uint32_t p_tick) {
 
 // cppcheck-suppress unusedFunction
 void AlarmController::unsnooze() {
-    digitalWrite(PIN_LED_GREEN, LED_GREEN_INACTIVE);
+    halWriteLed(HAL_LED_GREEN, false);
     m_snoozeTime = 0u;
     for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
         m_snoozedAlarms[i] = false;
@@ -391,3 +395,18 @@ void AlarmController::updateEnabledAlarms(Alarms enabledAlarms) {
         }
     }
 }
+
+void AlarmController::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->enumField(m_highestPriority);
+    p_archive->field(m_snoozeTime);
+    for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
+        m_alarms[i].checkpoint(p_archive);
+    }
+    p_archive->field(m_snoozedAlarms);
+    p_archive->field(m_triggeredAlarms);
+    p_archive->field(m_tick);
+    p_archive->field(m_pressure);
+    p_archive->enumField(m_phase);
+    p_archive->field(m_cycle_number);
+    p_archive->field(m_unsnooze);
+}
@@ -12,29 +12,30 @@
 // Associated header
 #include "../includes/battery.h"
 
-// Externals
-#include "Arduino.h"
-
 // Internal
 #include "../includes/alarm_controller.h"
+#include "../includes/board_state.h"
 #include "../includes/debug.h"
+#include "../includes/hal.h"
 #include "../includes/parameters.h"
+#include "../includes/ventilator_context.h"
 
 // PROGRAM =====================================================================
 
-static uint32_t rawBatterySample[BATTERY_MAX_SAMPLES];  // Array to store battery voltage samples
-static uint32_t batteryCurrentSample = 0;               // Current battery sample index
-static uint32_t batteryTotalSamples = 0;                // Battery total samples
-static uint32_t rawBatteryMeanVoltage = RAW_VOLTAGE_MAINS;  // Mean battery voltage in volts
-static bool isRunningOnBattery = false;
-static bool mainsConnected = false;
-static bool mainsConnectedAvailable = false;
+// Array to store battery voltage samples
+static BOARD_STATE uint32_t rawBatterySample[BATTERY_MAX_SAMPLES];
+// Current battery sample index
+static BOARD_STATE uint32_t batteryCurrentSample = 0;
+// Battery total samples
+static BOARD_STATE uint32_t batteryTotalSamples = 0;
+// Mean battery voltage in volts
+static BOARD_STATE uint32_t rawBatteryMeanVoltage = RAW_VOLTAGE_MAINS;
+static BOARD_STATE bool isRunningOnBattery = false;
+static BOARD_STATE bool mainsConnected = false;
+static BOARD_STATE bool mainsConnectedAvailable = false;
 
 void initBattery() {
-    // hardware v3 expander is connected to AC ON relay. that remains an optionnal wiring.
-    pinMode(PIN_IN_MAINS_CONNECTED, INPUT_PULLUP);
-    pinMode(PIN_IN_CONNECTION_TO_SUPPLY_OK, INPUT_PULLUP);
-    analogReadResolution(ADC_RESOLUTION_MAKAIR);
+    initHalBatteryInputs();
 
     for (uint8_t i = 0; i < BATTERY_MAX_SAMPLES; i++) {
         rawBatterySample[i] = 0;
@@ -47,7 +48,7 @@ void initBattery() {
 }
 
 void updateBatterySample() {
-    uint16_t rawVout = analogRead(PIN_BATTERY);
+    uint16_t rawVout = halReadBatteryAdc();
 
     // Assign sample from Vout
     rawBatterySample[batteryCurrentSample] = rawVout;
@@ -72,20 +73,20 @@ void updateBatteryState(uint32_t p_cycleNumber) {
     // The connector includes a small wire between gnd and PIN_IN_CONNECTION_TO_SUPPLY_OK.
     // If this is not detected, there may be a end of line connection problem,
     // and there is a fallback to Vbat value
-    mainsConnectedAvailable = (LOW == digitalRead(PIN_IN_CONNECTION_TO_SUPPLY_OK));
-    mainsConnected = (LOW == digitalRead(PIN_IN_MAINS_CONNECTED));
+    mainsConnectedAvailable = halReadMainsSensed();
+    mainsConnected = halReadMainsConnected();
 
     if ((mainsConnectedAvailable && !mainsConnected)
         || (!mainsConnectedAvailable
             && (rawBatteryMeanVoltage < (RAW_VOLTAGE_ON_BATTERY_HIGH - RAW_VOLTAGE_HYSTERESIS)))) {
-        alarmController.detectedAlarm(RCM_SW_16, p_cycleNumber,
-                                      (RAW_VOLTAGE_ON_BATTERY_HIGH - RAW_VOLTAGE_HYSTERESIS),
-                                      rawBatteryMeanVoltage);
+        ventilator.alarmController.detectedAlarm(
+            RCM_SW_16, p_cycleNumber, (RAW_VOLTAGE_ON_BATTERY_HIGH - RAW_VOLTAGE_HYSTERESIS),
+            rawBatteryMeanVoltage);
         isRunningOnBattery = true;
     } else if ((mainsConnectedAvailable && mainsConnected)
                || (!mainsConnectedAvailable
                    && (rawBatteryMeanVoltage > RAW_VOLTAGE_ON_BATTERY_HIGH))) {
-        alarmController.notDetectedAlarm(RCM_SW_16);
+        ventilator.alarmController.notDetectedAlarm(RCM_SW_16);
         isRunningOnBattery = false;
     } else {
         // This is an hysteresis, so do nothing here
@@ -93,22 +94,22 @@ void updateBatteryState(uint32_t p_cycleNumber) {
 
     if (!mainsConnected
         && (rawBatteryMeanVoltage < (RAW_VOLTAGE_ON_BATTERY - RAW_VOLTAGE_HYSTERESIS))) {
-        alarmController.detectedAlarm(RCM_SW_11, p_cycleNumber,
-                                      (RAW_VOLTAGE_ON_BATTERY - RAW_VOLTAGE_HYSTERESIS),
-                                      rawBatteryMeanVoltage);
+        ventilator.alarmController.detectedAlarm(RCM_SW_11, p_cycleNumber,
+                                                 (RAW_VOLTAGE_ON_BATTERY - RAW_VOLTAGE_HYSTERESIS),
+                                                 rawBatteryMeanVoltage);
     } else if (mainsConnected || (rawBatteryMeanVoltage > RAW_VOLTAGE_ON_BATTERY)) {
-        alarmController.notDetectedAlarm(RCM_SW_11);
+        ventilator.alarmController.notDetectedAlarm(RCM_SW_11);
     } else {
         // This is an hysteresis, so do nothing here
     }
 
     if (!mainsConnected
         && (rawBatteryMeanVoltage < (RAW_VOLTAGE_ON_BATTERY_LOW - RAW_VOLTAGE_HYSTERESIS))) {
-        alarmController.detectedAlarm(RCM_SW_12, p_cycleNumber,
-                                      (RAW_VOLTAGE_ON_BATTERY_LOW - RAW_VOLTAGE_HYSTERESIS),
-                                      rawBatteryMeanVoltage);
+        ventilator.alarmController.detectedAlarm(
+            RCM_SW_12, p_cycleNumber, (RAW_VOLTAGE_ON_BATTERY_LOW - RAW_VOLTAGE_HYSTERESIS),
+            rawBatteryMeanVoltage);
     } else if (mainsConnected || (rawBatteryMeanVoltage > RAW_VOLTAGE_ON_BATTERY_LOW)) {
-        alarmController.notDetectedAlarm(RCM_SW_12);
+        ventilator.alarmController.notDetectedAlarm(RCM_SW_12);
     } else {
         // This is an hysteresis, so do nothing here
     }
@@ -142,3 +143,13 @@ bool isMainsConnected() { return (!isRunningOnBattery); }
 
 // cppcheck-suppress unusedFunction
 bool isMainsAvailable() { return mainsConnectedAvailable; }
+
+void batteryCheckpoint(CheckpointArchive* p_archive) {
+    p_archive->field(rawBatterySample);
+    p_archive->field(batteryCurrentSample);
+    p_archive->field(batteryTotalSamples);
+    p_archive->field(rawBatteryMeanVoltage);
+    p_archive->field(isRunningOnBattery);
+    p_archive->field(mainsConnected);
+    p_archive->field(mainsConnectedAvailable);
+}
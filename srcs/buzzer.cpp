@@ -9,13 +9,13 @@
 
 // INCLUDES ===================================================================
 
-// Externals
-#include "Arduino.h"
-
 /// Internals
 
+#include "../includes/board_state.h"
 #include "../includes/buzzer.h"
 #include "../includes/buzzer_control.h"
+#include "../includes/cpu_load.h"
+#include "../includes/hal.h"
 #include "../includes/parameters.h"
 
 // PROGRAM =====================================================================
@@ -81,36 +81,26 @@ const uint32_t Buzzer_Boot[BUZZER_BOOT_SIZE] = {BZ_ON, BEEEEP, BZ_OFF, BEEEEP_PA
 
 // INITIALISATION =============================================================
 
-const uint32_t* Active_Buzzer = nullptr;
-uint32_t Active_Buzzer_Index = 0;
-uint32_t Active_Buzzer_Size = 2;
-bool Active_Buzzer_Repeat = false;
-bool Active_Buzzer_Has_Begun = false;
-bool Buzzer_Muted = false;
-
-HardwareTimer* BuzzerTim;
-uint32_t BuzzerTimerChannel;
+BOARD_STATE const uint32_t* Active_Buzzer = nullptr;
+BOARD_STATE uint32_t Active_Buzzer_Index = 0;
+BOARD_STATE uint32_t Active_Buzzer_Size = 2;
+BOARD_STATE bool Active_Buzzer_Repeat = false;
+BOARD_STATE bool Active_Buzzer_Has_Begun = false;
+BOARD_STATE bool Buzzer_Muted = false;
 
 // FUNCTIONS ==================================================================
 
-/**
- * When timer period expires, switch to next state in the pattern of the buzzer
- * @note API update since version 1.9.0 of Arduino_Core_STM32
- */
-#if (STM32_CORE_VERSION < 0x01090000)
-// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
-void Update_IT_callback(HardwareTimer*)  // NOLINT(readability/casting)
-#else
-void Update_IT_callback(void)
-#endif
-{
+/// When timer period expires, switch to next state in the pattern of the buzzer
+void Update_IT_callback(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_BUZZER);
+
     if (Buzzer_Muted == true) {
         // If the buzzer was muted, then we must resume the previous alarm
         Buzzer_Resume();
     } else if ((Active_Buzzer_Index == 0u) && (Active_Buzzer_Repeat == false)
                && (Active_Buzzer_Has_Begun == true)) {
         // If we are at start of pattern, check for repeating mode
-        BuzzerTim->pause();
+        halPauseTimer(HAL_TIMER_BUZZER);
         BuzzerControl_Off();
     } else {
         // Previous state is finished, switch to next one
@@ -119,26 +109,21 @@ void Update_IT_callback(void)
         } else {
             BuzzerControl_Off();
         }
-        BuzzerTim->setOverflow(Active_Buzzer[Active_Buzzer_Index + 1u], TICK_FORMAT);
+        halSetTimerOverflow(HAL_TIMER_BUZZER, Active_Buzzer[Active_Buzzer_Index + 1u]);
         Active_Buzzer_Index = (Active_Buzzer_Index + 2u) % Active_Buzzer_Size;
         Active_Buzzer_Has_Begun = true;
     }
 }
 
 void Buzzer_Init() {
-    // Buzzer HardwareTimer object creation
-    BuzzerTim = new HardwareTimer(BUZZER_TIMER);
-
     BuzzerControl_Off();
-    // CPU Clock down to 10 kHz
-    BuzzerTim->setPrescaleFactor((BuzzerTim->getTimerClkFreq() / (TIMER_TICK_PER_MS * 1000)));
-    BuzzerTim->setOverflow(1);  // don't care right now, timer is not started in init
-    BuzzerTim->setMode(BUZZER_TIM_CHANNEL, TIMER_OUTPUT_COMPARE, NC);
-    BuzzerTim->attachInterrupt(Update_IT_callback);
+    // CPU Clock down to 10 kHz, without preload so that a new duration applies at once
+    // Overflow: don't care right now, timer is not started in init
+    halSetupTimer(HAL_TIMER_BUZZER, TIMER_TICK_PER_MS * 1000, 1, &Update_IT_callback);
 }
 
 void Buzzer_Start(const uint32_t* Buzzer, uint32_t Size, bool RepeatBuzzer) {
-    BuzzerTim->setCount(0);
+    halSetTimerCount(HAL_TIMER_BUZZER, 0);
     Active_Buzzer = Buzzer;
     Active_Buzzer_Index = 0;
     Active_Buzzer_Size = Size;
@@ -146,11 +131,10 @@ void Buzzer_Start(const uint32_t* Buzzer, uint32_t Size, bool RepeatBuzzer) {
     Active_Buzzer_Has_Begun = false;
     Buzzer_Muted = false;
 
-    BuzzerTim->setPreloadEnable(false);
-    BuzzerTim->setOverflow(100, TICK_FORMAT);
+    halSetTimerOverflow(HAL_TIMER_BUZZER, 100);
 
     // Timer starts
-    BuzzerTim->resume();
+    halResumeTimer(HAL_TIMER_BUZZER);
 }
 
 void Buzzer_Mute() {
@@ -159,28 +143,28 @@ void Buzzer_Mute() {
         // Set the buzzer as muted
         Buzzer_Muted = true;
         // Reset the timer
-        BuzzerTim->setCount(0);
+        halSetTimerCount(HAL_TIMER_BUZZER, 0);
         // Reset the index, so that we will restart after the mute period
         Active_Buzzer_Index = 0;
 
         // Configuration of mute pattern
         BuzzerControl_Off();
-        BuzzerTim->setOverflow(PAUSE_120S, TICK_FORMAT);
+        halSetTimerOverflow(HAL_TIMER_BUZZER, PAUSE_120S);
 
         // Timer starts. Required to configure output on GPIO
-        BuzzerTim->resume();
+        halResumeTimer(HAL_TIMER_BUZZER);
     }
 }
 
 void Buzzer_Resume() {
-    BuzzerTim->setCount(0);
+    halSetTimerCount(HAL_TIMER_BUZZER, 0);
     Buzzer_Muted = false;
     Active_Buzzer_Index = 0;
 
-    BuzzerTim->setOverflow(Active_Buzzer[Active_Buzzer_Index + 1u], TICK_FORMAT);
+    halSetTimerOverflow(HAL_TIMER_BUZZER, Active_Buzzer[Active_Buzzer_Index + 1u]);
 
     // Timer starts. Required to configure output on GPIO
-    BuzzerTim->resume();
+    halResumeTimer(HAL_TIMER_BUZZER);
 }
 
 void Buzzer_High_Prio_Start(void) { Buzzer_Start(Buzzer_High_Prio, BUZZER_HIGH_PRIO_SIZE, true); }
@@ -198,5 +182,5 @@ void Buzzer_Stop(void) {
 
     // Avoid unexpected infinite buzzing
     BuzzerControl_Off();
-    BuzzerTim->pause();
+    halPauseTimer(HAL_TIMER_BUZZER);
 }
@@ -21,6 +21,8 @@
 #include "../includes/pressure_valve.h"
 #include "../includes/screen.h"
 #include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
 
 // External
 #include "Arduino.h"
@@ -101,12 +103,12 @@ void Calibration_Init() {
 #else
             int32_t flowMeterFlowAtStarting = 0;
 #endif
-            inspiratoryValve.open();
-            inspiratoryValve.execute();
-            expiratoryValve.open();
-            expiratoryValve.execute();
+            ventilator.inspiratoryValve.open();
+            ventilator.inspiratoryValve.execute();
+            ventilator.expiratoryValve.open();
+            ventilator.expiratoryValve.execute();
             delay(500);
-            blower.runSpeed(DEFAULT_BLOWER_SPEED);
+            ventilator.blower.runSpeed(DEFAULT_BLOWER_SPEED);
             delay(1000);
 #ifdef MASS_FLOW_METER_ENABLED
             int32_t flowMeterFlowWithBlowerOn = MFM_read_airflow();
@@ -114,7 +116,7 @@ void Calibration_Init() {
             int32_t flowMeterFlowWithBlowerOn = 30000;
 #endif
 
-            blower.stop();
+            ventilator.blower.stop();
 
             // Happens when flow meter fails
             bool isMassFlowMeterOutOfRange = ((flowMeterFlowAtStarting < -1000)
@@ -169,21 +171,21 @@ void Calibration_Init() {
 }
 
 void Calibration_Wait_Measure_Pressure(uint16_t ms) {
-    uint16_t start = millis();
+    uint32_t start = monotonicMillis();
     minOffsetValue = inspiratoryPressureSensor.read();
     maxOffsetValue = inspiratoryPressureSensor.read();
     pressureOffsetSum = 0;
     pressureOffsetCount = 0;
 
     // Open valves
-    inspiratoryValve.close();
-    inspiratoryValve.execute();
-    expiratoryValve.open();
-    expiratoryValve.execute();
+    ventilator.inspiratoryValve.close();
+    ventilator.inspiratoryValve.execute();
+    ventilator.expiratoryValve.open();
+    ventilator.expiratoryValve.execute();
 
-    while ((millis() - start) < ms) {
+    while ((monotonicMillis() - start) < ms) {
         // Measure 1 pressure per ms we wait
-        if ((millis() - start) > pressureOffsetCount) {
+        if ((monotonicMillis() - start) > pressureOffsetCount) {
             int32_t pressureValue = inspiratoryPressureSensor.read();
             pressureOffsetSum += pressureValue;
             minOffsetValue = min(pressureValue, minOffsetValue);
@@ -0,0 +1,193 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file checkpoint.cpp
+ * @brief Checkpoint and restore of the runtime state of the ventilation
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/checkpoint.h"
+
+// Internal
+#include "../includes/activation.h"
+#include "../includes/battery.h"
+#include "../includes/config.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/mass_flow_meter.h"
+#include "../includes/pressure.h"
+#include "../includes/pressure_utl.h"
+#include "../includes/ventilator_context.h"
+
+// FUNCTIONS ==================================================================
+
+CheckpointArchive::CheckpointArchive()
+    : m_direction(CHECKPOINT_MEASURE),
+      m_output(nullptr),
+      m_input(nullptr),
+      m_capacity(0u),
+      m_offset(0u),
+      m_overflowed(false) {}
+
+CheckpointArchive::CheckpointArchive(uint8_t* p_data, size_t p_size)
+    : m_direction(CHECKPOINT_SAVE),
+      m_output(p_data),
+      m_input(nullptr),
+      m_capacity(p_size),
+      m_offset(0u),
+      m_overflowed(false) {}
+
+CheckpointArchive::CheckpointArchive(const uint8_t* p_data, size_t p_size)
+    : m_direction(CHECKPOINT_RESTORE),
+      m_output(nullptr),
+      m_input(p_data),
+      m_capacity(p_size),
+      m_offset(0u),
+      m_overflowed(false) {}
+
+void CheckpointArchive::number(uint64_t* p_value, uint8_t p_size) {
+    if ((m_direction != CHECKPOINT_MEASURE) && ((m_offset + p_size) > m_capacity)) {
+        m_overflowed = true;
+    }
+
+    if (m_overflowed) {
+        // Nothing is copied past the end of the buffer, the member keeps its value
+    } else if (m_direction == CHECKPOINT_SAVE) {
+        for (uint8_t i = 0u; i < p_size; i++) {
+            m_output[m_offset + i] = static_cast<uint8_t>(*p_value >> (8u * (p_size - 1u - i)));
+        }
+    } else if (m_direction == CHECKPOINT_RESTORE) {
+        uint64_t value = 0u;
+        for (uint8_t i = 0u; i < p_size; i++) {
+            value = (value << 8u) | m_input[m_offset + i];
+        }
+        *p_value = value;
+    } else {
+    }
+    m_offset += p_size;
+}
+
+void CheckpointArchive::field(bool& p_value) {
+    uint64_t value = p_value ? 1u : 0u;
+    number(&value, 1u);
+    p_value = (value != 0u);
+}
+
+void CheckpointArchive::field(int8_t& p_value) {
+    uint64_t value = static_cast<uint8_t>(p_value);
+    number(&value, 1u);
+    p_value = static_cast<int8_t>(value);
+}
+
+void CheckpointArchive::field(uint8_t& p_value) {
+    uint64_t value = p_value;
+    number(&value, 1u);
+    p_value = static_cast<uint8_t>(value);
+}
+
+void CheckpointArchive::field(int16_t& p_value) {
+    uint64_t value = static_cast<uint16_t>(p_value);
+    number(&value, 2u);
+    p_value = static_cast<int16_t>(value);
+}
+
+void CheckpointArchive::field(uint16_t& p_value) {
+    uint64_t value = p_value;
+    number(&value, 2u);
+    p_value = static_cast<uint16_t>(value);
+}
+
+void CheckpointArchive::field(int32_t& p_value) {
+    uint64_t value = static_cast<uint32_t>(p_value);
+    number(&value, 4u);
+    p_value = static_cast<int32_t>(value);
+}
+
+void CheckpointArchive::field(uint32_t& p_value) {
+    uint64_t value = p_value;
+    number(&value, 4u);
+    p_value = static_cast<uint32_t>(value);
+}
+
+void CheckpointArchive::field(int64_t& p_value) {
+    uint64_t value = static_cast<uint64_t>(p_value);
+    number(&value, 8u);
+    p_value = static_cast<int64_t>(value);
+}
+
+void CheckpointArchive::field(uint64_t& p_value) { number(&p_value, 8u); }
+
+/**
+ * Archive the members of every stateful object of the ventilation
+ *
+ * @param p_archive Archive
+ */
+static void checkpointMembers(CheckpointArchive* p_archive) {
+    ventilator.checkpoint(p_archive);
+    mainStateMachine.checkpoint(p_archive);
+    activationController.checkpoint(p_archive);
+    batteryCheckpoint(p_archive);
+
+    int32_t pressureSensorOffset = inspiratoryPressureSensor.pressureSensorOffset();
+    int32_t filteredRawPressure = getFilteredRawPressure();
+    p_archive->field(pressureSensorOffset);
+    p_archive->field(filteredRawPressure);
+    if (p_archive->isRestoring()) {
+        inspiratoryPressureSensor.setPressureSensorOffset(pressureSensorOffset);
+        restoreFilteredRawPressure(filteredRawPressure);
+    }
+
+#ifdef MASS_FLOW_METER_ENABLED
+    MFM_checkpoint(p_archive);
+#endif
+}
+
+size_t checkpointSize(void) {
+    CheckpointArchive archive;
+    checkpointMembers(&archive);
+    return CHECKPOINT_HEADER_SIZE + archive.size();
+}
+
+size_t saveCheckpoint(uint8_t* p_data, size_t p_size) {
+    size_t size = checkpointSize();
+    if (p_size < size) {
+        return 0u;
+    }
+
+    CheckpointArchive header(p_data, CHECKPOINT_HEADER_SIZE);
+    uint32_t magic = CHECKPOINT_MAGIC;
+    uint16_t version = CHECKPOINT_VERSION;
+    uint32_t membersSize = static_cast<uint32_t>(size - CHECKPOINT_HEADER_SIZE);
+    header.field(magic);
+    header.field(version);
+    header.field(membersSize);
+
+    CheckpointArchive members(&p_data[CHECKPOINT_HEADER_SIZE], membersSize);
+    checkpointMembers(&members);
+    return size;
+}
+
+bool restoreCheckpoint(const uint8_t* p_data, size_t p_size) {
+    size_t size = checkpointSize();
+    if (p_size != size) {
+        return false;
+    }
+
+    CheckpointArchive header(p_data, CHECKPOINT_HEADER_SIZE);
+    uint32_t magic = 0u;
+    uint16_t version = 0u;
+    uint32_t membersSize = 0u;
+    header.field(magic);
+    header.field(version);
+    header.field(membersSize);
+    // The members are only restored once the checkpoint is known to hold all of them
+    if ((magic != CHECKPOINT_MAGIC) || (version != CHECKPOINT_VERSION)
+        || ((CHECKPOINT_HEADER_SIZE + membersSize) != size)) {
+        return false;
+    }
+
+    CheckpointArchive members(&p_data[CHECKPOINT_HEADER_SIZE], membersSize);
+    checkpointMembers(&members);
+    return true;
+}
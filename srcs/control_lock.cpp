@@ -0,0 +1,32 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file control_lock.cpp
+ * @brief Short critical sections of the background tasks against the control
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/control_lock.h"
+
+// Internals
+#include "../includes/config.h"
+#include "../includes/hal.h"
+#include "../includes/rtos_tasks.h"
+
+// FUNCTIONS ==================================================================
+
+#ifdef RTOS_TASKS
+void lockControl(void) { lockRtosControl(); }
+
+void unlockControl(void) { unlockRtosControl(); }
+#else
+void lockControl(void) { halLockTimer(HAL_TIMER_CONTROL); }
+
+void unlockControl(void) { halUnlockTimer(HAL_TIMER_CONTROL); }
+#endif
+
+ControlCriticalSection::ControlCriticalSection() { lockControl(); }
+
+ControlCriticalSection::~ControlCriticalSection() { unlockControl(); }
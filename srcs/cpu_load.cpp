@@ -12,51 +12,159 @@
 // Associated header
 #include "../includes/cpu_load.h"
 
+#ifndef UNIT_TEST
 #include "Arduino.h"
+#endif
+
+#include "../includes/board_state.h"
+#include "../includes/config.h"
 
 // INITIALISATION =============================================================
 
-// idleCyclesCount will be incremented in the loop, and read in the systick IRQ
-// If the systick IRQ set idleCyclesCount to 0, there is no guarantee it returns to 0,
-// because chances are high to be in the middle of the increment operation, which is not atomic.
-volatile uint32_t idleCyclesCount = 0;
+// Computed CPU load
+static BOARD_STATE volatile uint8_t cpuLoadPercent = 0;
+static BOARD_STATE volatile uint16_t cpuLoadPerMille[CPU_LOAD_SUBSYSTEMS];
+
+#ifndef UNIT_TEST
+// Busy cycles of each subsystem in the current window, updated with interrupts masked so that
+// nested sections and the systick never see a half-done update
+static volatile uint32_t cpuLoadBusyCycles[CPU_LOAD_SUBSYSTEMS];
 
-// Computed CPU load in percent
-volatile uint8_t cpuLoadPercent = 0;
+// Cycles accounted to any section since boot, used to remove nested sections from the outer one
+static volatile uint32_t cpuLoadAccountedCycles = 0;
 
-// As there is no Free RTOS here, we can use is for CPU load estimator
-uint16_t cpuLoadTimeCount = TIME_CPU_CYCLE_RESET;
+// Counts down the systick periods of the current window
+static uint16_t cpuLoadTimeCount = TIME_CPU_CYCLE_RESET;
 
-uint32_t cpuLoadLatestCycleCount = 0;
+// Number of cycles in a window, measured at boot
+static uint32_t cpuLoadWindowCycles = 0;
 
-// When nothing is enabled, the increment in the loop is done xx /second
-// To measure it, remove all the code in setup except Serial initialization,
-// and uncomment Serial output below
-#define CPU_MAX_LOOP_PER_SECOND 8327007u
+/// Duration in ms of the measure of the cycle counter frequency
+#define CPU_LOAD_CALIBRATION_MS 10u
+#endif
 
 // FUNCTIONS ==================================================================
 
 uint8_t readCpuLoadPercent(void) { return cpuLoadPercent; }
 
+uint16_t readCpuLoadPerMille(CpuLoadSubsystem p_subsystem) {
+    return cpuLoadPerMille[p_subsystem];
+}
+
+#ifdef UNIT_TEST
+
+// On the host there is no cycle counter: sections account nothing and the load stays at 0
+void initCpuLoad(void) {
+    for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+        cpuLoadPerMille[i] = 0u;
+    }
+    cpuLoadPercent = 0u;
+}
+
+CpuLoadSection::CpuLoadSection(CpuLoadSubsystem p_subsystem) {
+    m_subsystem = p_subsystem;
+    m_startCycles = 0u;
+    m_startAccountedCycles = 0u;
+}
+
+CpuLoadSection::~CpuLoadSection() {}
+
+#ifdef RTOS_TASKS
+// Ticks of the RTOS seen by the tick hook
+static volatile uint32_t cpuLoadTicks = 0u;
+
+uint32_t readCpuLoadTicks(void) { return cpuLoadTicks; }
+
+extern "C" {
+// The POSIX port of FreeRTOS calls this hook every 1 ms (configUSE_TICK_HOOK)
+// cppcheck-suppress unusedFunction
+void vApplicationTickHook() { cpuLoadTicks++; }
+}
+#endif
+
+#else
+
+void initCpuLoad(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+        cpuLoadBusyCycles[i] = 0u;
+        cpuLoadPerMille[i] = 0u;
+    }
+
+    // The cycle counter stops while the core sleeps, so the length of a window cannot be read from
+    // it at run time: measure its frequency once, against the systick, before anything sleeps
+    uint32_t startTick = HAL_GetTick();
+    while (HAL_GetTick() == startTick) {
+        continue;
+    }
+    startTick = HAL_GetTick();
+    uint32_t startCycles = DWT->CYCCNT;
+    while ((HAL_GetTick() - startTick) < CPU_LOAD_CALIBRATION_MS) {
+        continue;
+    }
+    uint32_t cyclesPerMs = (DWT->CYCCNT - startCycles) / CPU_LOAD_CALIBRATION_MS;
+    cpuLoadWindowCycles = cyclesPerMs * TIME_CPU_CYCLE_RESET;
+
+    cpuLoadTimeCount = TIME_CPU_CYCLE_RESET;
+}
+
+CpuLoadSection::CpuLoadSection(CpuLoadSubsystem p_subsystem) {
+    m_subsystem = p_subsystem;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    m_startCycles = DWT->CYCCNT;
+    m_startAccountedCycles = cpuLoadAccountedCycles;
+    __set_PRIMASK(primask);
+}
+
+CpuLoadSection::~CpuLoadSection() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    // Overflows won't be a problem, same type
+    uint32_t totalCycles = DWT->CYCCNT - m_startCycles;
+    uint32_t ownCycles = totalCycles - (cpuLoadAccountedCycles - m_startAccountedCycles);
+    cpuLoadBusyCycles[m_subsystem] += ownCycles;
+    cpuLoadAccountedCycles += ownCycles;
+    __set_PRIMASK(primask);
+}
+
 void cpuLoadCallback(void) {
     cpuLoadTimeCount--;
     if (cpuLoadTimeCount == 0u) {
         cpuLoadTimeCount = TIME_CPU_CYCLE_RESET;
-        // Overflow won't be a problem, same type
-        uint32_t delta = idleCyclesCount - cpuLoadLatestCycleCount;
-        cpuLoadLatestCycleCount = idleCyclesCount;
-        if (delta > CPU_MAX_LOOP_PER_SECOND) {
-            delta = CPU_MAX_LOOP_PER_SECOND;
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t windowCycles = cpuLoadWindowCycles;
+
+        uint32_t totalPerMille = 0u;
+        for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+            uint64_t perMille = 0u;
+            if (windowCycles != 0u) {
+                perMille = (1000u * static_cast<uint64_t>(cpuLoadBusyCycles[i])) / windowCycles;
+            }
+            cpuLoadBusyCycles[i] = 0u;
+            cpuLoadPerMille[i] = static_cast<uint16_t>(min(perMille, static_cast<uint64_t>(1000u)));
+            totalPerMille += cpuLoadPerMille[i];
         }
-        cpuLoadPercent = static_cast<uint8_t>(100u - (100u * delta) / CPU_MAX_LOOP_PER_SECOND);
+        __set_PRIMASK(primask);
 
-        // Uncomment to tune CPU_MAX_LOOP_PER_SECOND value
-        // Serial.println(delta);
+        cpuLoadPercent = static_cast<uint8_t>(min(totalPerMille / 10u, 100u));
     }
 }
 
 extern "C" {
+#ifdef RTOS_TASKS
+// The systick belongs to FreeRTOS, which calls this hook every 1 ms (configUSE_TICK_HOOK)
+// cppcheck-suppress unusedFunction
+void vApplicationTickHook() { cpuLoadCallback(); }
+#else
 // This is the highest priority 1 ms callback
 // cppcheck-suppress unusedFunction
 void osSystickHandler() { cpuLoadCallback(); }
+#endif
 }
+
+#endif
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file deferred_work.cpp
+ * @brief Queue of work posted by interrupts and run in the background loop
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/deferred_work.h"
+
+// Internal
+#include "../includes/board_state.h"
+
+// INITIALISATION =============================================================
+
+#define DEFERRED_WORK_QUEUE_MASK (DEFERRED_WORK_QUEUE_SIZE - 1u)
+
+// Single producer, single consumer ring buffer: the interrupt only writes the head, the loop only
+// writes the tail. Both indexes are 8 bits wide so that reads and writes are atomic.
+static BOARD_STATE PeriodicTask* volatile deferredWorkQueue[DEFERRED_WORK_QUEUE_SIZE];
+static BOARD_STATE volatile uint8_t deferredWorkHead = 0u;
+static BOARD_STATE volatile uint8_t deferredWorkTail = 0u;
+
+// Number of consecutive ms during which pending work has not been picked up
+static BOARD_STATE uint32_t deferredWorkWaitingMs = 0u;
+static BOARD_STATE uint8_t deferredWorkLastTail = 0u;
+
+static BOARD_STATE volatile uint32_t deferredWorkDropped = 0u;
+
+// FUNCTIONS ==================================================================
+
+bool postDeferredWork(PeriodicTask* p_task) {
+    bool posted = false;
+    uint8_t head = deferredWorkHead;
+    uint8_t nextHead = (head + 1u) & DEFERRED_WORK_QUEUE_MASK;
+
+    if (p_task->pending) {
+        // Previous run has not been executed yet, there is no point running it twice
+        deferredWorkDropped++;
+    } else if (nextHead == deferredWorkTail) {
+        // Queue is full
+        deferredWorkDropped++;
+    } else {
+        p_task->pending = true;
+        deferredWorkQueue[head] = p_task;
+        // Publish the slot only once it is filled
+        deferredWorkHead = nextHead;
+        posted = true;
+    }
+
+    return posted;
+}
+
+void runDeferredWork(void) {
+    while (deferredWorkTail != deferredWorkHead) {
+        uint8_t tail = deferredWorkTail;
+        PeriodicTask* task = deferredWorkQueue[tail];
+        deferredWorkTail = (tail + 1u) & DEFERRED_WORK_QUEUE_MASK;
+
+        executePeriodicTask(task);
+        task->pending = false;
+    }
+}
+
+bool hasDeferredWork(void) { return deferredWorkTail != deferredWorkHead; }
+
+bool isDeferredWorkProgressing(uint32_t p_elapsedMs) {
+    uint8_t tail = deferredWorkTail;
+
+    if ((tail == deferredWorkHead) || (tail != deferredWorkLastTail)) {
+        // Queue is empty, or the loop picked up some work since last check
+        deferredWorkLastTail = tail;
+        deferredWorkWaitingMs = 0u;
+    } else if (deferredWorkWaitingMs < (UINT32_MAX - p_elapsedMs)) {
+        deferredWorkWaitingMs += p_elapsedMs;
+    } else {
+        // Saturate
+        deferredWorkWaitingMs = UINT32_MAX;
+    }
+
+    return deferredWorkWaitingMs <= DEFERRED_WORK_MAX_LATENCY_MS;
+}
+
+// cppcheck-suppress unusedFunction
+uint32_t deferredWorkDroppedCount(void) { return deferredWorkDropped; }
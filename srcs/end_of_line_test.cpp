@@ -9,33 +9,55 @@
 
 // INCLUDES ===================================================================
 
-#include "../includes/parameters.h"
-#include "Arduino.h"
+// Associated header
+#include "../includes/end_of_line_test.h"
 
+// External
+#include <stdio.h>
+
+// Internal
 #include "../includes/battery.h"
 #include "../includes/buzzer_control.h"
-#include "../includes/end_of_line_test.h"
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/mass_flow_meter.h"
+#include "../includes/parameters.h"
 #include "../includes/pressure.h"
 #include "../includes/screen.h"
 #include "../includes/serial_control.h"
 #include "../includes/telemetry.h"
+#include "../includes/ventilator_context.h"
 
 // INITIALISATION =============================================================
 
-uint32_t clockEOLTimer = 0;
-uint32_t eolMSCount = 0;
-uint32_t eolTestNumber = 0;
-int32_t pressureValue = 0;
-int32_t flowValue = 0;
-int32_t minPressureValue = INT32_MAX;
-int32_t maxPressureValue = 0;
-int32_t minFlowValue = INT32_MAX;
-int32_t maxFlowValue = 0;
+/// Frequency of the counter of the timer of the event loop, in Hz
+#define EOL_TIMER_FREQUENCY 10000u
+
+BOARD_STATE uint32_t clockEOLTimer = 0;
+BOARD_STATE uint32_t eolMSCount = 0;
+BOARD_STATE uint32_t eolTestNumber = 0;
+BOARD_STATE int32_t pressureValue = 0;
+BOARD_STATE int32_t flowValue = 0;
+BOARD_STATE int32_t minPressureValue = INT32_MAX;
+BOARD_STATE int32_t maxPressureValue = 0;
+BOARD_STATE int32_t minFlowValue = INT32_MAX;
+BOARD_STATE int32_t maxFlowValue = 0;
+
+BOARD_STATE TestState eolState = STATE_IN_PROGRESS;
+BOARD_STATE TestStep eolstep = START;
+BOARD_STATE TestStep previousEolStep = START;
+BOARD_STATE bool eolFail = false;
+BOARD_STATE bool eolStepConfirmed = false;
+#define EOLTRACESIZE 60
+#define EOLSCREENSIZE 100
+BOARD_STATE char eolScreenBuffer[EOLSCREENSIZE + 1];
+BOARD_STATE char eolTrace[EOLTRACESIZE];
+#define EOL_TOTALBUTTONS 11
+BOARD_STATE int16_t eolMatrixCurrentColumn = 1;
+static BOARD_STATE int batlevel = 0;
+static BOARD_STATE int buttonsPushed[EOL_TOTALBUTTONS];
 
-EolTest eolTest = EolTest();
-HardwareTimer* eolTimer;
+BOARD_STATE EolTest eolTest = EolTest();
 
 // FUNCTIONS ==================================================================
 
@@ -46,79 +68,41 @@ EolTest::EolTest() { testActive = 0; }
 void EolTest::activate() {
     testActive = EOL_TEST_ACTIVE;
     ::clockEOLTimer = 0;
-    ::eolTimer = new HardwareTimer(TIM9);
+    ::eolMSCount = 0;
+    ::eolTestNumber = 0;
+    ::pressureValue = 0;
+    ::flowValue = 0;
+    ::minPressureValue = INT32_MAX;
+    ::maxPressureValue = 0;
+    ::minFlowValue = INT32_MAX;
+    ::maxFlowValue = 0;
+    ::eolState = STATE_IN_PROGRESS;
+    ::eolstep = START;
+    ::previousEolStep = START;
+    ::eolFail = false;
+    ::eolStepConfirmed = false;
+    ::eolScreenBuffer[0] = 0;
+    ::eolTrace[0] = 0;
+    ::eolMatrixCurrentColumn = 1;
+    ::batlevel = 0;
+    for (int i = 0; i < EOL_TOTALBUTTONS; i++) {
+        ::buttonsPushed[i] = 0;
+    }
 }
 
 bool EolTest::isRunning() { return (EOL_TEST_ACTIVE == testActive); }
 
-// Message display helper function
-// cppcheck-suppress unusedFunction
-void eolScreenMessage(char* message, bool isFailed) {
-    screen.clear();
-    // cppcheck-suppress misra-c2012-12.3
-    if (eolTestNumber == (uint32_t)0 && !isFailed) {
-        screen.setCursor(0, 0);
-        screen.print("EOL TEST");
-    } else {
-        screen.setCursor(0, 0);
-        screen.print("EOL TEST  #");
-        screen.print(eolTestNumber);
-        if (isFailed) {
-            screen.setCursor(15, 0);
-            screen.print("FAIL");
-        } else {
-            screen.setCursor(18, 0);
-            screen.print("OK");
-        }
-    }
-
-    // Print line by line, respect newlines
-    int line = 1;
-    // cppcheck-suppress misra-c2012-12.3 ; call to unknown external: screen.setCursor
-    screen.setCursor(0, line);
-    int i = 0;
-    while (i < 62) {
-        if (message[i] == '\n') {
-            line++;
-            screen.setCursor(0, line);
-            i++;
-        }
-        if ((message[i] == 0) || (line > 3)) {
-            break;
-        }
-        screen.print(message[i]);
-        i++;
-    }
-}
+TestStep EolTest::currentStep() { return ::eolstep; }
 
-TestState eolState = STATE_IN_PROGRESS;
-TestStep eolstep = START;
-TestStep previousEolStep = START;
-boolean eolFail = false;
-boolean eolStepConfirmed = false;
-#define EOLTRACESIZE 60
-#define EOLSCREENSIZE 100
-char eolScreenBuffer[EOLSCREENSIZE + 1];
-char eolTrace[EOLTRACESIZE];
-#define EOL_TOTALBUTTONS 11
-int16_t eolMatrixCurrentColumn = 1;
+TestState EolTest::currentState() { return ::eolState; }
 
-// API update since version 1.9.0 of Arduino_Core_STM32
-#if (STM32_CORE_VERSION < 0x01090000)
-// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
-void millisecondTimerEOL(HardwareTimer*)  // NOLINT(readability/casting)
-#else
-void millisecondTimerEOL(void)
-#endif
-{
+void millisecondTimerEOL(void) {
     clockEOLTimer++;
     eolMSCount++;
-    static int batlevel = 0;
-    static int buttonsPushed[EOL_TOTALBUTTONS];
 
     if ((clockEOLTimer % 100u) == 0u) {
         // Refresh screen every 100 ms, no more
-        eolScreenMessage(eolScreenBuffer, eolFail);
+        displayEndOfLineTestMessage(eolScreenBuffer, eolTestNumber, eolFail);
     }
     if ((clockEOLTimer % 500u) == 0u) {
         // Send EOL snapshot to telemetry every 500 ms, no more
@@ -137,8 +121,8 @@ void millisecondTimerEOL(void)
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "\nTo begin press\nbutton START");
 
         // Wait the operator to press start to begin the EOL test
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
 
@@ -153,7 +137,7 @@ void millisecondTimerEOL(void)
                 eolstep = CHECK_FAN;
 
                 // Important: setup main controller for later use (ONCE!)
-                mainController.setup();
+                ventilator.mainController.setup();
             }
         }
     } else if (eolstep == SUPPLY_TO_EXPANDER_NOT_CONNECTED) {
@@ -167,8 +151,8 @@ void millisecondTimerEOL(void)
         // The operator should check that both fans are running, and hit "start" to confirm
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Check fans\nthen press\nbutton START");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolTestNumber++;
@@ -177,7 +161,7 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == TEST_BAT_DEAD) {
         // Check if the voltage is acceptable
-        blower.runSpeed(1799);  // Run blower to drain more current
+        ventilator.blower.runSpeed(1799);  // Run blower to drain more current
         batlevel = getBatteryLevelX100();
         if (eolMSCount < 5000u) {
             (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Test Vbat\n  V=%02d.%02d",
@@ -192,7 +176,7 @@ void millisecondTimerEOL(void)
                 eolState = STATE_ERROR;
             } else {
                 eolTestNumber++;
-                blower.stop();
+                ventilator.blower.stop();
                 eolstep = CONNECT_MAINS;
             }
         }
@@ -229,14 +213,14 @@ void millisecondTimerEOL(void)
         if (isMainsConnected()) {
             BuzzerControl_On();
             eolTestNumber++;
-            blower.stop();
+            ventilator.blower.stop();
             eolstep = CHECK_BUZZER;
         }
     } else if (eolstep == CHECK_BUZZER) {
         // Run the buzzer (previous step) and ask the operator to hit the STOP button
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Check Buzzer\nthen press\nbutton PAUSE");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_STOP) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_STOP)) {
             BuzzerControl_Off();
             eolTestNumber++;
 
@@ -249,36 +233,36 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == CHECK_ALL_BUTTONS) {
         // Ask the operator to hit each button
-        if (digitalRead(PIN_BTN_ALARM_OFF) == HIGH) {
+        if (halReadButton(HAL_BUTTON_ALARM_OFF)) {
             buttonsPushed[0] = 1;
         }
         // this buttons are in a matrix
         if (1 == eolMatrixCurrentColumn) {
             // Increase counter for each column and row
-            if (HIGH == digitalRead(PIN_IN_ROW1)) {
+            if (halReadKeyboardRow(0u)) {
                 buttonsPushed[1] = 1;
             }
-            if (HIGH == digitalRead(PIN_IN_ROW2)) {
+            if (halReadKeyboardRow(1u)) {
                 buttonsPushed[2] = 1;
             }
-            if (HIGH == digitalRead(PIN_IN_ROW3)) {
+            if (halReadKeyboardRow(2u)) {
                 buttonsPushed[3] = 1;
             }
         } else if (2 == eolMatrixCurrentColumn) {
-            if (HIGH == digitalRead(PIN_IN_ROW1)) {
+            if (halReadKeyboardRow(0u)) {
                 buttonsPushed[4] = 1;
             }
-            if (HIGH == digitalRead(PIN_IN_ROW2)) {
+            if (halReadKeyboardRow(1u)) {
                 buttonsPushed[5] = 1;
             }
-            if (HIGH == digitalRead(PIN_IN_ROW3)) {
+            if (halReadKeyboardRow(2u)) {
                 buttonsPushed[6] = 1;
             }
         } else if (3 == eolMatrixCurrentColumn) {
-            if (HIGH == digitalRead(PIN_IN_ROW1)) {
+            if (halReadKeyboardRow(0u)) {
                 buttonsPushed[7] = 1;
             }
-            if (HIGH == digitalRead(PIN_IN_ROW2)) {
+            if (halReadKeyboardRow(1u)) {
                 buttonsPushed[8] = 1;
             }
             // there is no button on col3 x row3
@@ -290,14 +274,12 @@ void millisecondTimerEOL(void)
         if (4 == eolMatrixCurrentColumn) {
             eolMatrixCurrentColumn = 1;
         }
-        digitalWrite(PIN_OUT_COL1, (1 == eolMatrixCurrentColumn) ? HIGH : LOW);
-        digitalWrite(PIN_OUT_COL2, (2 == eolMatrixCurrentColumn) ? HIGH : LOW);
-        digitalWrite(PIN_OUT_COL3, (3 == eolMatrixCurrentColumn) ? HIGH : LOW);
+        halSelectKeyboardColumn(static_cast<uint8_t>(eolMatrixCurrentColumn - 1));
 
-        if (digitalRead(PIN_BTN_START) == HIGH) {
+        if (halReadButton(HAL_BUTTON_START)) {
             buttonsPushed[9] = 1;
         }
-        if (digitalRead(PIN_BTN_STOP) == HIGH) {
+        if (halReadButton(HAL_BUTTON_STOP)) {
             buttonsPushed[10] = 1;
         }
         int totalPushed = 0;
@@ -309,7 +291,7 @@ void millisecondTimerEOL(void)
         (void)snprintf(eolTrace, EOLTRACESIZE, "Pressed: %d / %d", totalPushed, EOL_TOTALBUTTONS);
         if (totalPushed == EOL_TOTALBUTTONS) {
             eolTestNumber++;
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;  // Wait release if still pressed in previous test
             }
             eolstep = CHECK_UI_SCREEN;
@@ -330,8 +312,8 @@ void millisecondTimerEOL(void)
         // start
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Plug testing\npipes then press\nSTART");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolMSCount = 0;
@@ -339,12 +321,12 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == REACH_MAX_PRESSURE) {
         // Turn on the blower and check if able to reach the max pressure 650 mmH2O
-        expiratoryValve.close();
-        expiratoryValve.execute();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
+        ventilator.expiratoryValve.close();
+        ventilator.expiratoryValve.execute();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
         pressureValue = inspiratoryPressureSensor.read();
-        blower.runSpeed(1790);
+        ventilator.blower.runSpeed(1790);
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Increasing pressure\n  \nP = %d mmH2O",
                        pressureValue);
         (void)snprintf(eolTrace, EOLTRACESIZE, "Pressure: %d mmH2O", pressureValue);
@@ -360,14 +342,14 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == MAX_PRESSURE_NOT_REACHED) {
         // FAIL: Case max pressure was not reached
-        blower.stop();
+        ventilator.blower.stop();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Pressure increase\nimpossible! ");
     } else if (eolstep == MAX_PRESSURE_REACHED_OK) {
         // Close the valves and wait 1000 ms
-        inspiratoryValve.close();
-        inspiratoryValve.execute();
-        expiratoryValve.close();
-        expiratoryValve.execute();
+        ventilator.inspiratoryValve.close();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.close();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Closing valves...");
         if (eolMSCount > 1000u) {
             eolMSCount = 0;
@@ -375,11 +357,11 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == START_LEAK_MESURE) {
         // Stop the blower and measure leak with the pressure sensor
-        blower.stop();
-        inspiratoryValve.close();
-        inspiratoryValve.execute();
-        expiratoryValve.close();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.close();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.close();
+        ventilator.expiratoryValve.execute();
         pressureValue = inspiratoryPressureSensor.read();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Leak Test...\n  \nP = %d mmH2O",
                        pressureValue);
@@ -402,10 +384,10 @@ void millisecondTimerEOL(void)
         (void)snprintf(eolTrace, EOLTRACESIZE, "Pressure: %d mmH2O", pressureValue);
     } else if (eolstep == REACH_NULL_PRESSURE) {
         // Open the valves to empty the lung system
-        expiratoryValve.open();
-        expiratoryValve.execute();
-        inspiratoryValve.close();
-        inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
+        ventilator.inspiratoryValve.close();
+        ventilator.inspiratoryValve.execute();
         pressureValue = inspiratoryPressureSensor.read();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Opening valves...\n  \nP = %d mmH2O",
                        pressureValue);
@@ -428,8 +410,8 @@ void millisecondTimerEOL(void)
         // Ask the operator to open the oxygen entrance, and wait for confirmation
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Open oxygen\nthen press\nbutton START");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolMSCount = 0;
@@ -438,11 +420,11 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == START_O2_TEST) {
         // Close the valves, run the blower, and wait for pressure to go above 100 mmH2O
-        blower.runSpeed(1790);
-        inspiratoryValve.close();
-        inspiratoryValve.execute();
-        expiratoryValve.close();
-        expiratoryValve.execute();
+        ventilator.blower.runSpeed(1790);
+        ventilator.inspiratoryValve.close();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.close();
+        ventilator.expiratoryValve.execute();
         pressureValue = inspiratoryPressureSensor.read();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Test O2...\n  \nP = %d mmH2O",
                        pressureValue);
@@ -461,15 +443,15 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == O2_PRESSURE_NOT_REACH) {
         // FAIL: the pressure did not bo above 100 mmh2O during O2 test
-        blower.stop();
+        ventilator.blower.stop();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Pipe O2\nBlocked! ");
     } else if (eolstep == WAIT_USER_BEFORE_LONG_RUN) {
         // Wait for user to press start before long run.
-        blower.stop();
+        ventilator.blower.stop();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Close oxygen\nthen press\nbutton START");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolMSCount = 0;
@@ -478,11 +460,13 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == START_LONG_RUN_BLOWER) {
         // Run the blower during 5 minutes and check stability
-        blower.runSpeed(1790);
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open((expiratoryValve.minAperture() + expiratoryValve.maxAperture()) / 2u);
-        expiratoryValve.execute();
+        ventilator.blower.runSpeed(1790);
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open(
+            (ventilator.expiratoryValve.minAperture() + ventilator.expiratoryValve.maxAperture())
+            / 2u);
+        ventilator.expiratoryValve.execute();
         pressureValue = inspiratoryPressureSensor.read();
 #ifdef MASS_FLOW_METER_ENABLED
         flowValue = MFM_read_airflow();
@@ -504,7 +488,9 @@ void millisecondTimerEOL(void)
                 eolState = STATE_ERROR;
                 eolMSCount = 0;
             }
-            if ((maxFlowValue - minFlowValue) > 5500) {  // 5500 mL/min
+            // A flow meter that does not answer cannot tell a stable flow
+            if (((maxFlowValue - minFlowValue) > 5500)  // 5500 mL/min
+                || (flowValue == MASS_FLOW_ERROR_VALUE)) {
                 eolstep = FLOW_NOT_STABLE;
                 eolState = STATE_ERROR;
                 eolMSCount = 0;
@@ -525,11 +511,11 @@ void millisecondTimerEOL(void)
         }
     } else if (eolstep == PRESSURE_NOT_STABLE) {
         // FAIL: pressure was not stable during long run test
-        blower.stop();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Pressure not stable\nMax= %d mmH2O \nMin= %d mmH2O", maxPressureValue,
                        minPressureValue);
@@ -537,26 +523,26 @@ void millisecondTimerEOL(void)
                        maxPressureValue, minPressureValue);
     } else if (eolstep == FLOW_NOT_STABLE) {
         // FAIL: flow was not stable during long run test
-        blower.stop();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "Flow not stable\nMax= %d SLM \nMin= %d SLM", maxFlowValue, minFlowValue);
         (void)snprintf(eolTrace, EOLTRACESIZE, "Maximum: %d SLM; Minimum: %d SLM", maxFlowValue,
                        minFlowValue);
     } else if (eolstep == END_SUCCESS) {
         // SUCESS: end of the procedure
-        blower.stop();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE,
                        "********************\n**** SUCCESS !! ****\n********************");
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolMSCount = 0;
@@ -566,17 +552,17 @@ void millisecondTimerEOL(void)
 
     } else if (eolstep == DISPLAY_PRESSURE) {
         // SUCESS: end of the procedure
-        blower.stop();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Pressure \nMax= %d mmH2O \nMin= %d mmH2O",
                        maxPressureValue, minPressureValue);
         (void)snprintf(eolTrace, EOLTRACESIZE, "Maximum: %d mmH2O; Minimum: %d mmH2O",
                        maxPressureValue, minPressureValue);
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolstep = DISPLAY_FLOW;
@@ -585,17 +571,17 @@ void millisecondTimerEOL(void)
 
     } else if (eolstep == DISPLAY_FLOW) {
         // SUCESS: end of the procedure
-        blower.stop();
-        inspiratoryValve.open();
-        inspiratoryValve.execute();
-        expiratoryValve.open();
-        expiratoryValve.execute();
+        ventilator.blower.stop();
+        ventilator.inspiratoryValve.open();
+        ventilator.inspiratoryValve.execute();
+        ventilator.expiratoryValve.open();
+        ventilator.expiratoryValve.execute();
         (void)snprintf(eolScreenBuffer, EOLSCREENSIZE, "Flow\nMax= %d SLM \nMin= %d SLM",
                        maxFlowValue, minFlowValue);
         (void)snprintf(eolTrace, EOLTRACESIZE, "Maximum: %d SLM; Minimum: %d SLM", maxFlowValue,
                        minFlowValue);
-        if (eolStepConfirmed || digitalRead(PIN_BTN_START) == HIGH) {
-            while (digitalRead(PIN_BTN_START) == HIGH) {
+        if (eolStepConfirmed || halReadButton(HAL_BUTTON_START)) {
+            while (halReadButton(HAL_BUTTON_START)) {
                 continue;
             }
             eolstep = DISPLAY_PRESSURE;
@@ -624,27 +610,15 @@ void EolTest::onConfirm() {
 
 void EolTest::setupAndStart() {
     // Set a 1 ms timer for the event loop
-    // Prescaler at 10 kHz; stm32f411 clock is 100 mHz
-    ::eolTimer->setPrescaleFactor((::eolTimer->getTimerClkFreq() / 10000) - 1);
-    // Set the period at 1 ms
-    ::eolTimer->setOverflow(10);
-    ::eolTimer->setMode(1, TIMER_OUTPUT_COMPARE, NC);
-    ::eolTimer->attachInterrupt(millisecondTimerEOL);
-    ::eolTimer->resume();
-
-    expiratoryValve.close();
-    expiratoryValve.execute();
-    inspiratoryValve.close();
-    inspiratoryValve.execute();
+    halSetupTimer(HAL_TIMER_CONTROL, EOL_TIMER_FREQUENCY, EOL_TIMER_FREQUENCY / 1000u,
+                  &millisecondTimerEOL);
+    halResumeTimer(HAL_TIMER_CONTROL);
+
+    ventilator.expiratoryValve.close();
+    ventilator.expiratoryValve.execute();
+    ventilator.inspiratoryValve.close();
+    ventilator.inspiratoryValve.execute();
 
     // define the 3x3 matrix keyboard input and output
-    pinMode(PIN_OUT_COL1, OUTPUT);
-    pinMode(PIN_OUT_COL2, OUTPUT);
-    pinMode(PIN_OUT_COL3, OUTPUT);
-    digitalWrite(PIN_OUT_COL1, LOW);
-    digitalWrite(PIN_OUT_COL2, LOW);
-    digitalWrite(PIN_OUT_COL3, LOW);
-    pinMode(PIN_IN_ROW1, INPUT);
-    pinMode(PIN_IN_ROW2, INPUT);
-    pinMode(PIN_IN_ROW3, INPUT);
+    initHalKeyboardMatrix();
 }
@@ -0,0 +1,784 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file hal.cpp
+ * @brief Thin interfaces between the ventilation code and the hardware
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/hal.h"
+
+#ifdef UNIT_TEST
+// Externals
+#include <deque>
+#else
+// Externals
+#include <HardwareSerial.h>
+#include <IWatchdog.h>
+#include <Wire.h>
+#include "LL/stm32yyxx_ll_utils.h"
+#endif
+
+// Internal
+#include "../includes/battery.h"
+#include "../includes/board_state.h"
+#include "../includes/buzzer.h"
+#include "../includes/parameters.h"
+#include "../includes/timebase.h"
+
+// INITIALISATION =============================================================
+
+/// Interrupt priority and auto-reload preload of a timer
+struct TimerSettings {
+    uint32_t priority;
+    bool preload;
+};
+
+// Priority levels are documented here:
+// https://stm32f4-discovery.net/2014/05/stm32f4-stm32f429-nvic-or-nested-vector-interrupt-controller/
+// The flow meter must stay under the I2C interrupt (level 2 since the 1.9.0 core), and preempts
+// the main state machine. The buzzer keeps the default priority of the core.
+// The main state machine and the buzzer change their period from their callback, right after the
+// update event, for the period that just started: their new period must apply at once.
+static const TimerSettings timerSettings[HAL_TIMERS] = {
+    {6u, false},
+    {3u, true},
+    {14u, false},
+};
+
+#ifdef UNIT_TEST
+/// Host timer, its counter follows the host clock while it runs
+struct HostTimer {
+    HalTimerCallback callback;
+    uint32_t frequency;
+    uint32_t overflow;
+    // Period that applies at the end of the running one
+    uint32_t nextOverflow;
+    // Date in µs when the counter was 0
+    uint64_t periodStart;
+    uint32_t pausedCount;
+    bool running;
+    bool locked;
+    // True while the period elapsed event runs
+    bool inEvent;
+};
+
+/// Size of the receive buffer of Wire
+#define HOST_I2C_RECEIVE_SIZE 32u
+
+/// Number of 7 bits I2C addresses
+#define HOST_I2C_ADDRESSES 128u
+
+/// Device on the I2C bus of the host
+struct HostI2cDevice {
+    bool plugged;
+    uint16_t word;
+    HostI2cAnswer answer;
+};
+
+/// Handler interrupting the telemetry writes, see interruptHostTelemetryWrite()
+struct HostTelemetryInterrupt {
+    HalTimer timer;
+    HalTimerCallback handler;
+    uint32_t remainingBytes;
+    bool pending;
+};
+
+static BOARD_STATE uint16_t hostPressureAdc = 0;
+static BOARD_STATE uint16_t hostBatteryAdc = RAW_VOLTAGE_MAINS;
+static BOARD_STATE bool hostMainsConnected = true;
+static BOARD_STATE bool hostMainsSensed = true;
+static BOARD_STATE uint16_t hostPwmPulses[HAL_PWM_OUTPUTS];
+static BOARD_STATE bool hostLeds[HAL_LEDS];
+static BOARD_STATE std::deque<uint8_t> hostTelemetryInput;
+static BOARD_STATE std::deque<uint8_t> hostTelemetryOutput;
+static BOARD_STATE bool hostRaspberryPower = true;
+static BOARD_STATE bool hostButtonPresses[HAL_BUTTONS];
+static BOARD_STATE bool hostKeyPresses[HAL_KEYBOARD_COLUMNS][HAL_KEYBOARD_ROWS];
+// Column of the matrix keyboard that is powered, HAL_KEYBOARD_COLUMNS for none
+static BOARD_STATE uint8_t hostKeyboardColumn = HAL_KEYBOARD_COLUMNS;
+static BOARD_STATE HostTimer hostTimers[HAL_TIMERS];
+static BOARD_STATE HostTelemetryInterrupt hostTelemetryInterrupt;
+static BOARD_STATE HostI2cDevice hostI2cDevices[HOST_I2C_ADDRESSES];
+static BOARD_STATE bool hostFlowMeterPower = true;
+// Bytes received by the last read, and the next one to give
+static BOARD_STATE uint8_t hostI2cReceived[HOST_I2C_RECEIVE_SIZE];
+static BOARD_STATE uint8_t hostI2cReceivedCount = 0;
+static BOARD_STATE uint8_t hostI2cReceivedIndex = 0;
+// Address of the command being written
+static BOARD_STATE uint8_t hostI2cTransmissionAddress = 0;
+static BOARD_STATE uint32_t hostWatchdogReloadCount = 0;
+static BOARD_STATE uint64_t hostWatchdogReloadDate = 0;
+#else
+HardwareSerial Serial6(PIN_TELEMETRY_SERIAL_RX, PIN_TELEMETRY_SERIAL_TX);
+
+HardwareTimer* hardwareTimer1;  // ESC command
+HardwareTimer* hardwareTimer3;  // valves command
+
+/// Pin of each button, and of the columns and the rows of the matrix keyboard
+static const uint32_t buttonPins[HAL_BUTTONS] = {PIN_BTN_ALARM_OFF, PIN_BTN_START, PIN_BTN_STOP};
+static const uint32_t keyboardColumnPins[HAL_KEYBOARD_COLUMNS] = {PIN_OUT_COL1, PIN_OUT_COL2,
+                                                                  PIN_OUT_COL3};
+static const uint32_t keyboardRowPins[HAL_KEYBOARD_ROWS] = {PIN_IN_ROW1, PIN_IN_ROW2,
+                                                            PIN_IN_ROW3};
+
+/// Timer, channel and pin of each pulse width modulated output
+struct PwmOutputPin {
+    HardwareTimer** timer;
+    uint32_t channel;
+    uint32_t pin;
+};
+
+static const PwmOutputPin pwmOutputPins[HAL_PWM_OUTPUTS] = {
+    {&hardwareTimer3, TIM_CHANNEL_INSPIRATORY_VALVE, PIN_INSPIRATORY_VALVE},
+    {&hardwareTimer3, TIM_CHANNEL_EXPIRATORY_VALVE, PIN_EXPIRATORY_VALVE},
+    {&hardwareTimer1, TIM_CHANNEL_ESC_BLOWER, PIN_ESC_BLOWER},
+};
+
+/// Pin and active level of each LED
+static const uint32_t ledPins[HAL_LEDS] = {PIN_LED_START, PIN_LED_RED, PIN_LED_YELLOW,
+                                           PIN_LED_GREEN};
+static const uint32_t ledActiveLevels[HAL_LEDS] = {LED_START_ACTIVE, LED_RED_ACTIVE,
+                                                   LED_YELLOW_ACTIVE, LED_GREEN_ACTIVE};
+static const uint32_t ledInactiveLevels[HAL_LEDS] = {LED_START_INACTIVE, LED_RED_INACTIVE,
+                                                     LED_YELLOW_INACTIVE, LED_GREEN_INACTIVE};
+
+/// Instance, channel and interrupt line of each timer
+static TIM_TypeDef* const timerInstances[HAL_TIMERS] = {TIM9, MASS_FLOW_TIMER, BUZZER_TIMER};
+static const uint32_t timerChannels[HAL_TIMERS] = {1u, MASS_FLOW_CHANNEL, BUZZER_TIM_CHANNEL};
+// TIM9 shares its line with TIM1 break, TIM10 with TIM1 update
+static const IRQn_Type timerIrqs[HAL_TIMERS] = {TIM1_BRK_TIM9_IRQn, TIM1_UP_TIM10_IRQn, TIM5_IRQn};
+
+static HardwareTimer* timers[HAL_TIMERS];
+static HalTimerCallback timerCallbacks[HAL_TIMERS];
+
+// API update since version 1.9.0 of Arduino_Core_STM32: callbacks used to take the timer
+#if (STM32_CORE_VERSION < 0x01090000)
+// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
+static void controlTimerCallback(HardwareTimer*) {  // NOLINT(readability/casting)
+    timerCallbacks[HAL_TIMER_CONTROL]();
+}
+
+// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
+static void flowMeterTimerCallback(HardwareTimer*) {  // NOLINT(readability/casting)
+    timerCallbacks[HAL_TIMER_FLOW_METER]();
+}
+
+// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
+static void buzzerTimerCallback(HardwareTimer*) {  // NOLINT(readability/casting)
+    timerCallbacks[HAL_TIMER_BUZZER]();
+}
+
+static void (*const timerCoreCallbacks[HAL_TIMERS])(HardwareTimer*) = {
+    &controlTimerCallback, &flowMeterTimerCallback, &buzzerTimerCallback};
+#endif
+#endif
+
+// FUNCTIONS ==================================================================
+
+#ifdef UNIT_TEST
+
+uint16_t halReadPressureAdc(void) { return hostPressureAdc; }
+
+void initHalBatteryInputs(void) {}
+
+uint16_t halReadBatteryAdc(void) { return hostBatteryAdc; }
+
+bool halReadMainsConnected(void) { return hostMainsConnected; }
+
+bool halReadMainsSensed(void) { return hostMainsSensed; }
+
+void initHalPwmOutputs(void) {}
+
+void halSetupPwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs) {
+    hostPwmPulses[p_output] = p_pulseUs;
+}
+
+void halWritePwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs) {
+    hostPwmPulses[p_output] = p_pulseUs;
+}
+
+void halWriteLed(HalLed p_led, bool p_active) { hostLeds[p_led] = p_active; }
+
+void halWriteRaspberryPower(bool p_powered) { hostRaspberryPower = p_powered; }
+
+bool halReadButton(HalButton p_button) {
+    bool pressed = hostButtonPresses[p_button];
+    hostButtonPresses[p_button] = false;
+    return pressed;
+}
+
+void initHalKeyboardMatrix(void) { hostKeyboardColumn = HAL_KEYBOARD_COLUMNS; }
+
+void halSelectKeyboardColumn(uint8_t p_column) { hostKeyboardColumn = p_column; }
+
+bool halReadKeyboardRow(uint8_t p_row) {
+    bool pressed = false;
+    if (hostKeyboardColumn < HAL_KEYBOARD_COLUMNS) {
+        pressed = hostKeyPresses[hostKeyboardColumn][p_row];
+        hostKeyPresses[hostKeyboardColumn][p_row] = false;
+    }
+    return pressed;
+}
+
+/// Convert counts of a host timer to µs
+static uint64_t hostTimerCountsToMicros(const HostTimer& p_timer, uint64_t p_counts) {
+    return (p_counts * 1000000u) / p_timer.frequency;
+}
+
+/// Date in µs of the end of the running period of a host timer
+static uint64_t hostTimerEndOfPeriod(const HostTimer& p_timer) {
+    return p_timer.periodStart + hostTimerCountsToMicros(p_timer, p_timer.overflow);
+}
+
+void halSetupTimer(HalTimer p_timer,
+                   uint32_t p_frequency,
+                   uint32_t p_overflow,
+                   HalTimerCallback p_callback) {
+    HostTimer& timer = hostTimers[p_timer];
+    timer.callback = p_callback;
+    timer.frequency = p_frequency;
+    timer.overflow = p_overflow;
+    timer.nextOverflow = p_overflow;
+    timer.periodStart = monotonicMicros();
+    timer.pausedCount = 0;
+    timer.running = false;
+    timer.locked = false;
+    timer.inEvent = false;
+}
+
+void halSetTimerOverflow(HalTimer p_timer, uint32_t p_overflow) {
+    hostTimers[p_timer].nextOverflow = p_overflow;
+    if (!timerSettings[p_timer].preload) {
+        hostTimers[p_timer].overflow = p_overflow;
+    }
+}
+
+void halSetTimerCount(HalTimer p_timer, uint32_t p_count) {
+    HostTimer& timer = hostTimers[p_timer];
+    if (timer.running) {
+        timer.periodStart = monotonicMicros() - hostTimerCountsToMicros(timer, p_count);
+    } else {
+        timer.pausedCount = p_count;
+    }
+}
+
+uint32_t halReadTimerCount(HalTimer p_timer) {
+    const HostTimer& timer = hostTimers[p_timer];
+    uint32_t count = timer.pausedCount;
+    if (timer.running) {
+        count = static_cast<uint32_t>(((monotonicMicros() - timer.periodStart) * timer.frequency)
+                                      / 1000000u);
+    }
+    return count;
+}
+
+void halResumeTimer(HalTimer p_timer) {
+    HostTimer& timer = hostTimers[p_timer];
+    if (!timer.running) {
+        timer.running = true;
+        halSetTimerCount(p_timer, timer.pausedCount);
+    }
+}
+
+void halPauseTimer(HalTimer p_timer) {
+    HostTimer& timer = hostTimers[p_timer];
+    if (timer.running) {
+        timer.pausedCount = halReadTimerCount(p_timer);
+        timer.running = false;
+    }
+}
+
+/// Run the handler interrupting the telemetry writes if it is pending and its timer allows it
+static void serveHostTelemetryInterrupt(void) {
+    HostTelemetryInterrupt& interrupt = hostTelemetryInterrupt;
+    const HostTimer& timer = hostTimers[interrupt.timer];
+    if (interrupt.pending && !timer.locked && !timer.inEvent) {
+        interrupt.pending = false;
+        hostTimers[interrupt.timer].inEvent = true;
+        interrupt.handler();
+        hostTimers[interrupt.timer].inEvent = false;
+    }
+}
+
+void halLockTimer(HalTimer p_timer) { hostTimers[p_timer].locked = true; }
+
+void halUnlockTimer(HalTimer p_timer) {
+    hostTimers[p_timer].locked = false;
+    serveHostTelemetryInterrupt();
+}
+
+void halReloadWatchdog(void) {
+    hostWatchdogReloadCount++;
+    hostWatchdogReloadDate = monotonicMicros();
+}
+
+uint32_t halReadUniqueIdWord(uint8_t p_word) { return 0x4D414B00u + p_word; }
+
+void halTelemetryBegin(uint32_t p_baudRate) { (void)p_baudRate; }
+
+void halTelemetryWrite(uint8_t p_byte) {
+    if (hostTelemetryOutput.size() >= HOST_TELEMETRY_OUTPUT_SIZE) {
+        hostTelemetryOutput.pop_front();
+    }
+    hostTelemetryOutput.push_back(p_byte);
+
+    if ((hostTelemetryInterrupt.remainingBytes > 0u)
+        && !hostTimers[hostTelemetryInterrupt.timer].inEvent) {
+        hostTelemetryInterrupt.remainingBytes--;
+        hostTelemetryInterrupt.pending = (hostTelemetryInterrupt.remainingBytes == 0u);
+    }
+    serveHostTelemetryInterrupt();
+}
+
+void halTelemetryWrite(const uint8_t* p_data, size_t p_size) {
+    for (size_t i = 0; i < p_size; i++) {
+        halTelemetryWrite(p_data[i]);
+    }
+}
+
+void halTelemetryWrite(const char* p_data, size_t p_size) {
+    halTelemetryWrite(reinterpret_cast<const uint8_t*>(p_data), p_size);
+}
+
+// The bytes are sent at once, the transmit buffer is always empty
+int32_t halTelemetryAvailableForWrite(void) { return HOST_TELEMETRY_TX_BUFFER_SIZE; }
+
+int32_t halTelemetryAvailable(void) { return static_cast<int32_t>(hostTelemetryInput.size()); }
+
+int32_t halTelemetryPeek(void) {
+    return hostTelemetryInput.empty() ? -1 : static_cast<int32_t>(hostTelemetryInput.front());
+}
+
+int32_t halTelemetryRead(void) {
+    int32_t value = halTelemetryPeek();
+    if (!hostTelemetryInput.empty()) {
+        hostTelemetryInput.pop_front();
+    }
+    return value;
+}
+
+size_t halTelemetryReadBytes(uint8_t* p_data, size_t p_size) {
+    size_t count = 0;
+    while ((count < p_size) && !hostTelemetryInput.empty()) {
+        p_data[count] = hostTelemetryInput.front();
+        hostTelemetryInput.pop_front();
+        count++;
+    }
+    return count;
+}
+
+void halDelay(uint32_t p_ms) { (void)p_ms; }
+
+void initHalFlowMeterBus(void) { hostFlowMeterPower = true; }
+
+void halWriteFlowMeterPower(bool p_powered) { hostFlowMeterPower = p_powered; }
+
+void halI2cBegin(void) {}
+
+void halI2cEnd(void) {
+    hostI2cReceivedCount = 0;
+    hostI2cReceivedIndex = 0;
+}
+
+void halI2cFlush(void) {}
+
+/**
+ * Tell how a device answers, a device that is not plugged or not powered does not
+ *
+ * @param p_address Address of the device
+ * @return How it answers
+ */
+static HostI2cAnswer hostI2cAnswer(uint8_t p_address) {
+    const HostI2cDevice& device = hostI2cDevices[p_address % HOST_I2C_ADDRESSES];
+    return (device.plugged && hostFlowMeterPower) ? device.answer : HOST_I2C_NACK;
+}
+
+uint8_t halI2cRequestFrom(uint8_t p_address, uint8_t p_count) {
+    const HostI2cDevice& device = hostI2cDevices[p_address % HOST_I2C_ADDRESSES];
+    uint8_t count = min(p_count, static_cast<uint8_t>(HOST_I2C_RECEIVE_SIZE));
+    switch (hostI2cAnswer(p_address)) {
+    case HOST_I2C_NACK:
+        count = 0u;
+        break;
+    case HOST_I2C_SHORT_READ:
+        count = min(count, static_cast<uint8_t>(1u));
+        break;
+    default:
+        break;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        hostI2cReceived[i] = 0u;
+    }
+    if (count > 0u) {
+        hostI2cReceived[0] = static_cast<uint8_t>(device.word >> 8u);
+    }
+    if (count > 1u) {
+        hostI2cReceived[1] = static_cast<uint8_t>(device.word & 0xFFu);
+    }
+    hostI2cReceivedCount = count;
+    hostI2cReceivedIndex = 0;
+    return count;
+}
+
+int32_t halI2cRead(void) {
+    int32_t value = -1;
+    if (hostI2cReceivedIndex < hostI2cReceivedCount) {
+        value = hostI2cReceived[hostI2cReceivedIndex];
+        hostI2cReceivedIndex++;
+    }
+    return value;
+}
+
+void halI2cBeginTransmission(uint8_t p_address) { hostI2cTransmissionAddress = p_address; }
+
+void halI2cWrite(uint8_t p_byte) { (void)p_byte; }
+
+uint8_t halI2cEndTransmission(void) {
+    return (hostI2cAnswer(hostI2cTransmissionAddress) == HOST_I2C_NACK) ? 2u : 0u;
+}
+
+void resetHostHal(void) {
+    hostPressureAdc = 0;
+    hostBatteryAdc = RAW_VOLTAGE_MAINS;
+    hostMainsConnected = true;
+    hostMainsSensed = true;
+    for (uint8_t i = 0; i < HAL_PWM_OUTPUTS; i++) {
+        hostPwmPulses[i] = 0;
+    }
+    for (uint8_t i = 0; i < HAL_LEDS; i++) {
+        hostLeds[i] = false;
+    }
+    hostTelemetryInput.clear();
+    hostTelemetryOutput.clear();
+    hostTelemetryInterrupt = HostTelemetryInterrupt();
+    for (uint8_t i = 0; i < HOST_I2C_ADDRESSES; i++) {
+        hostI2cDevices[i] = HostI2cDevice();
+    }
+    hostFlowMeterPower = true;
+    hostI2cReceivedCount = 0;
+    hostI2cReceivedIndex = 0;
+    hostI2cTransmissionAddress = 0;
+    hostRaspberryPower = true;
+    for (uint8_t i = 0; i < HAL_BUTTONS; i++) {
+        hostButtonPresses[i] = false;
+    }
+    for (uint8_t i = 0; i < HAL_KEYBOARD_COLUMNS; i++) {
+        for (uint8_t j = 0; j < HAL_KEYBOARD_ROWS; j++) {
+            hostKeyPresses[i][j] = false;
+        }
+    }
+    hostKeyboardColumn = HAL_KEYBOARD_COLUMNS;
+    for (uint8_t i = 0; i < HAL_TIMERS; i++) {
+        hostTimers[i] = HostTimer();
+        hostTimers[i].frequency = 1000000u;
+    }
+    hostWatchdogReloadCount = 0;
+    hostWatchdogReloadDate = 0;
+}
+
+void setHostPressureAdc(uint16_t p_raw) { hostPressureAdc = p_raw; }
+
+void setHostBatteryAdc(uint16_t p_raw) { hostBatteryAdc = p_raw; }
+
+void setHostMainsInputs(bool p_connected, bool p_sensed) {
+    hostMainsConnected = p_connected;
+    hostMainsSensed = p_sensed;
+}
+
+void pressHostButton(HalButton p_button) { hostButtonPresses[p_button] = true; }
+
+void pressHostKeyboardKey(uint8_t p_column, uint8_t p_row) {
+    hostKeyPresses[p_column][p_row] = true;
+}
+
+uint16_t hostPwmOutputPulse(HalPwmOutput p_output) { return hostPwmPulses[p_output]; }
+
+bool hostLedState(HalLed p_led) { return hostLeds[p_led]; }
+
+bool hostRaspberryPowered(void) { return hostRaspberryPower; }
+
+bool hostNextTimerEvent(HalTimer* p_timer, uint64_t* p_dateUs) {
+    bool found = false;
+    for (uint8_t i = 0; i < HAL_TIMERS; i++) {
+        const HostTimer& timer = hostTimers[i];
+        if (timer.running && !timer.locked && (timer.callback != nullptr)) {
+            // A period that ended while the interrupt was held is served at once
+            uint64_t due = max(hostTimerEndOfPeriod(timer), monotonicMicros());
+            // A lower priority level preempts, so it is served first
+            if (!found || (due < *p_dateUs)
+                || ((due == *p_dateUs) && (timerSettings[i].priority
+                                           < timerSettings[*p_timer].priority))) {
+                *p_timer = static_cast<HalTimer>(i);
+                *p_dateUs = due;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void fireHostTimer(HalTimer p_timer) {
+    HostTimer& timer = hostTimers[p_timer];
+    // The counter restarts from 0 on the update event, whatever the latency of the interrupt
+    timer.periodStart = min(hostTimerEndOfPeriod(timer), monotonicMicros());
+    timer.overflow = timer.nextOverflow;
+    timer.inEvent = true;
+    timer.callback();
+    timer.inEvent = false;
+    serveHostTelemetryInterrupt();
+}
+
+void setHostI2cDevice(uint8_t p_address, uint16_t p_word, HostI2cAnswer p_answer) {
+    HostI2cDevice& device = hostI2cDevices[p_address % HOST_I2C_ADDRESSES];
+    device.plugged = true;
+    device.word = p_word;
+    device.answer = p_answer;
+}
+
+bool hostFlowMeterPowered(void) { return hostFlowMeterPower; }
+
+uint32_t hostWatchdogReloads(void) { return hostWatchdogReloadCount; }
+
+uint64_t hostWatchdogLastReload(void) { return hostWatchdogReloadDate; }
+
+void hostHalCheckpoint(CheckpointArchive* p_archive) {
+    p_archive->field(hostPressureAdc);
+    p_archive->field(hostBatteryAdc);
+    p_archive->field(hostMainsConnected);
+    p_archive->field(hostMainsSensed);
+    p_archive->field(hostPwmPulses);
+    p_archive->field(hostLeds);
+    p_archive->field(hostRaspberryPower);
+    p_archive->field(hostFlowMeterPower);
+    for (uint8_t i = 0; i < HAL_TIMERS; i++) {
+        HostTimer& timer = hostTimers[i];
+        p_archive->field(timer.frequency);
+        p_archive->field(timer.overflow);
+        p_archive->field(timer.nextOverflow);
+        p_archive->field(timer.periodStart);
+        p_archive->field(timer.pausedCount);
+        p_archive->field(timer.running);
+        p_archive->field(timer.locked);
+    }
+    p_archive->field(hostWatchdogReloadCount);
+    p_archive->field(hostWatchdogReloadDate);
+}
+
+void pushHostTelemetryInput(const uint8_t* p_data, size_t p_size) {
+    for (size_t i = 0; i < p_size; i++) {
+        hostTelemetryInput.push_back(p_data[i]);
+    }
+}
+
+size_t popHostTelemetryOutput(uint8_t* p_data, size_t p_size) {
+    size_t count = 0;
+    while ((count < p_size) && !hostTelemetryOutput.empty()) {
+        p_data[count] = hostTelemetryOutput.front();
+        hostTelemetryOutput.pop_front();
+        count++;
+    }
+    return count;
+}
+
+void interruptHostTelemetryWrite(HalTimer p_timer,
+                                 HalTimerCallback p_handler,
+                                 uint32_t p_afterBytes) {
+    hostTelemetryInterrupt.timer = p_timer;
+    hostTelemetryInterrupt.handler = p_handler;
+    hostTelemetryInterrupt.remainingBytes = p_afterBytes;
+    hostTelemetryInterrupt.pending = false;
+}
+
+#else
+
+uint16_t halReadPressureAdc(void) { return analogRead(PIN_PRESSURE_SENSOR); }
+
+void initHalBatteryInputs(void) {
+    // hardware v3 expander is connected to AC ON relay. that remains an optionnal wiring.
+    pinMode(PIN_IN_MAINS_CONNECTED, INPUT_PULLUP);
+    pinMode(PIN_IN_CONNECTION_TO_SUPPLY_OK, INPUT_PULLUP);
+    analogReadResolution(ADC_RESOLUTION_MAKAIR);
+}
+
+uint16_t halReadBatteryAdc(void) { return analogRead(PIN_BATTERY); }
+
+bool halReadMainsConnected(void) { return (LOW == digitalRead(PIN_IN_MAINS_CONNECTED)); }
+
+bool halReadMainsSensed(void) { return (LOW == digitalRead(PIN_IN_CONNECTION_TO_SUPPLY_OK)); }
+
+void initHalPwmOutputs(void) {
+    // Timer for valves
+    hardwareTimer3 = new HardwareTimer(TIM3);
+    hardwareTimer3->setOverflow(VALVE_PERIOD, MICROSEC_FORMAT);
+
+    // Timer for the blower
+    hardwareTimer1 = new HardwareTimer(TIM1);
+    hardwareTimer1->setOverflow(ESC_PPM_PERIOD, MICROSEC_FORMAT);
+}
+
+void halSetupPwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs) {
+    HardwareTimer* timer = *pwmOutputPins[p_output].timer;
+    timer->setMode(pwmOutputPins[p_output].channel, TIMER_OUTPUT_COMPARE_PWM1,
+                   pwmOutputPins[p_output].pin);
+    timer->setCaptureCompare(pwmOutputPins[p_output].channel, p_pulseUs, MICROSEC_COMPARE_FORMAT);
+    timer->resume();
+}
+
+void halWritePwmOutput(HalPwmOutput p_output, uint16_t p_pulseUs) {
+    (*pwmOutputPins[p_output].timer)
+        ->setCaptureCompare(pwmOutputPins[p_output].channel, p_pulseUs, MICROSEC_COMPARE_FORMAT);
+}
+
+void halWriteLed(HalLed p_led, bool p_active) {
+    digitalWrite(ledPins[p_led], p_active ? ledActiveLevels[p_led] : ledInactiveLevels[p_led]);
+}
+
+void halWriteRaspberryPower(bool p_powered) {
+    digitalWrite(PIN_ENABLE_PWR_RASP, p_powered ? PWR_RASP_ACTIVE : PWR_RASP_INACTIVE);
+}
+
+bool halReadButton(HalButton p_button) { return (HIGH == digitalRead(buttonPins[p_button])); }
+
+void initHalKeyboardMatrix(void) {
+    for (uint8_t i = 0; i < HAL_KEYBOARD_COLUMNS; i++) {
+        pinMode(keyboardColumnPins[i], OUTPUT);
+        digitalWrite(keyboardColumnPins[i], LOW);
+    }
+    for (uint8_t i = 0; i < HAL_KEYBOARD_ROWS; i++) {
+        pinMode(keyboardRowPins[i], INPUT);
+    }
+}
+
+void halSelectKeyboardColumn(uint8_t p_column) {
+    for (uint8_t i = 0; i < HAL_KEYBOARD_COLUMNS; i++) {
+        digitalWrite(keyboardColumnPins[i], (i == p_column) ? HIGH : LOW);
+    }
+}
+
+bool halReadKeyboardRow(uint8_t p_row) { return (HIGH == digitalRead(keyboardRowPins[p_row])); }
+
+void halSetupTimer(HalTimer p_timer,
+                   uint32_t p_frequency,
+                   uint32_t p_overflow,
+                   HalTimerCallback p_callback) {
+    HardwareTimer* timer = new HardwareTimer(timerInstances[p_timer]);
+    timers[p_timer] = timer;
+    timerCallbacks[p_timer] = p_callback;
+
+    timer->setPrescaleFactor(timer->getTimerClkFreq() / p_frequency);
+    timer->setOverflow(p_overflow, TICK_FORMAT);
+    timer->setPreloadEnable(timerSettings[p_timer].preload);
+    timer->setInterruptPriority(timerSettings[p_timer].priority, 0);
+    timer->setMode(timerChannels[p_timer], TIMER_OUTPUT_COMPARE, NC);
+#if (STM32_CORE_VERSION < 0x01090000)
+    timer->attachInterrupt(timerCoreCallbacks[p_timer]);
+#else
+    timer->attachInterrupt(p_callback);
+#endif
+}
+
+void halSetTimerOverflow(HalTimer p_timer, uint32_t p_overflow) {
+    timers[p_timer]->setOverflow(p_overflow, TICK_FORMAT);
+}
+
+void halSetTimerCount(HalTimer p_timer, uint32_t p_count) { timers[p_timer]->setCount(p_count); }
+
+uint32_t halReadTimerCount(HalTimer p_timer) { return timers[p_timer]->getCount(); }
+
+void halResumeTimer(HalTimer p_timer) { timers[p_timer]->resume(); }
+
+void halPauseTimer(HalTimer p_timer) { timers[p_timer]->pause(); }
+
+void halLockTimer(HalTimer p_timer) { HAL_NVIC_DisableIRQ(timerIrqs[p_timer]); }
+
+void halUnlockTimer(HalTimer p_timer) { HAL_NVIC_EnableIRQ(timerIrqs[p_timer]); }
+
+void halReloadWatchdog(void) { IWatchdog.reload(); }
+
+uint32_t halReadUniqueIdWord(uint8_t p_word) {
+    uint32_t word;
+    if (p_word == 0u) {
+        word = LL_GetUID_Word0();
+    } else if (p_word == 1u) {
+        word = LL_GetUID_Word1();
+    } else {
+        word = LL_GetUID_Word2();
+    }
+    return word;
+}
+
+void halTelemetryBegin(uint32_t p_baudRate) { Serial6.begin(p_baudRate); }
+
+void halTelemetryWrite(uint8_t p_byte) { (void)Serial6.write(p_byte); }
+
+void halTelemetryWrite(const uint8_t* p_data, size_t p_size) {
+    (void)Serial6.write(p_data, p_size);
+}
+
+void halTelemetryWrite(const char* p_data, size_t p_size) { (void)Serial6.write(p_data, p_size); }
+
+int32_t halTelemetryAvailableForWrite(void) { return Serial6.availableForWrite(); }
+
+int32_t halTelemetryAvailable(void) { return Serial6.available(); }
+
+int32_t halTelemetryPeek(void) { return Serial6.peek(); }
+
+int32_t halTelemetryRead(void) { return Serial6.read(); }
+
+size_t halTelemetryReadBytes(uint8_t* p_data, size_t p_size) {
+    return Serial6.readBytes(p_data, p_size);
+}
+
+void halDelay(uint32_t p_ms) { delay(p_ms); }
+
+void initHalFlowMeterBus(void) {
+    // Set power on (hardware v3)
+    pinMode(MFM_POWER_CONTROL, OUTPUT);
+    digitalWrite(MFM_POWER_CONTROL, MFM_POWER_ON);
+
+    // default Wire instance is on PB8 BP9, anyway
+    Wire.setSDA(PIN_I2C_SDA);
+    Wire.setSCL(PIN_I2C_SCL);
+    // Wire.setClock(400000); // honeywell do support, but no information about sfm3300d
+}
+
+void halWriteFlowMeterPower(bool p_powered) {
+    if (p_powered) {
+        // Set power on (available since hw v3)
+        digitalWrite(MFM_POWER_CONTROL, MFM_POWER_ON);
+        pinMode(PIN_I2C_SDA, INPUT);
+        pinMode(PIN_I2C_SCL, INPUT);
+    } else {
+        // Set power off (available since hw3)
+        digitalWrite(MFM_POWER_CONTROL, MFM_POWER_OFF);
+        // also set SDA and SCL to 0 to avoid sensor to be powered by I2C bus.
+        pinMode(PIN_I2C_SDA, OUTPUT);
+        pinMode(PIN_I2C_SCL, OUTPUT);
+        digitalWrite(PIN_I2C_SCL, LOW);
+        __NOP();
+        digitalWrite(PIN_I2C_SDA, LOW);
+    }
+}
+
+void halI2cBegin(void) { Wire.begin(); }
+
+void halI2cEnd(void) { Wire.end(); }
+
+void halI2cFlush(void) { Wire.flush(); }
+
+uint8_t halI2cRequestFrom(uint8_t p_address, uint8_t p_count) {
+    return Wire.requestFrom(p_address, p_count);
+}
+
+int32_t halI2cRead(void) { return Wire.read(); }
+
+void halI2cBeginTransmission(uint8_t p_address) { Wire.beginTransmission(p_address); }
+
+void halI2cWrite(uint8_t p_byte) { (void)Wire.write(p_byte); }
+
+uint8_t halI2cEndTransmission(void) { return Wire.endTransmission(); }
+
+#endif
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file interrupt_timing.cpp
+ * @brief Latency and period jitter histograms of the timer interrupts
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/interrupt_timing.h"
+
+// Internal
+#include "../includes/timebase.h"
+
+// INITIALISATION =============================================================
+
+const uint32_t TIMING_HISTOGRAM_BOUNDS_US[TIMING_HISTOGRAM_BUCKETS - 1u] = {
+    1u, 2u, 5u, 10u, 20u, 50u, 100u, 200u, 500u};
+
+BOARD_STATE InterruptTiming interruptTimings[INTERRUPT_TIMING_SOURCES] = {
+    InterruptTiming(1000u),   // Control, 1 ms
+    InterruptTiming(10000u),  // Flow meter, 10 ms
+};
+
+// FUNCTIONS ==================================================================
+
+TimingHistogram::TimingHistogram() { reset(); }
+
+void TimingHistogram::record(uint32_t p_durationUs) {
+    uint8_t bucket = 0u;
+    while ((bucket < (TIMING_HISTOGRAM_BUCKETS - 1u))
+           && (p_durationUs >= TIMING_HISTOGRAM_BOUNDS_US[bucket])) {
+        bucket++;
+    }
+
+    m_buckets[bucket]++;
+    m_count++;
+    if (p_durationUs > m_maxUs) {
+        m_maxUs = p_durationUs;
+    }
+}
+
+void TimingHistogram::reset() {
+    for (uint8_t i = 0u; i < TIMING_HISTOGRAM_BUCKETS; i++) {
+        m_buckets[i] = 0u;
+    }
+    m_maxUs = 0u;
+    m_count = 0u;
+}
+
+InterruptTiming::InterruptTiming(uint32_t p_nominalPeriodUs) {
+    m_nominalPeriodUs = p_nominalPeriodUs;
+    m_lastEntryUs = 0u;
+    m_hasLastEntry = false;
+    m_resetRequested = false;
+}
+
+void InterruptTiming::onEntry(uint32_t p_latencyUs) {
+    uint64_t now = monotonicMicros();
+
+    if (m_resetRequested) {
+        m_latency.reset();
+        m_jitter.reset();
+        m_hasLastEntry = false;
+        m_resetRequested = false;
+    }
+
+    m_latency.record(p_latencyUs);
+
+    if (m_hasLastEntry) {
+        uint32_t period = static_cast<uint32_t>(now - m_lastEntryUs);
+        uint32_t deviation = (period > m_nominalPeriodUs) ? (period - m_nominalPeriodUs)
+                                                          : (m_nominalPeriodUs - period);
+        m_jitter.record(deviation);
+    }
+
+    m_lastEntryUs = now;
+    m_hasLastEntry = true;
+}
+
+void InterruptTiming::setNominalPeriod(uint32_t p_nominalPeriodUs) {
+    m_nominalPeriodUs = p_nominalPeriodUs;
+    m_hasLastEntry = false;
+}
+
+void InterruptTiming::requestReset() { m_resetRequested = true; }
@@ -22,9 +22,11 @@
 #include "../includes/buzzer.h"
 #include "../includes/calibration.h"
 #include "../includes/config.h"
+#include "../includes/control_lock.h"
 #include "../includes/debug.h"
 #include "../includes/main_controller.h"
 #include "../includes/parameters.h"
+#include "../includes/ventilator_context.h"
 
 // INITIALISATION =============================================================
 
@@ -34,35 +36,66 @@ static OneButton buttonStop(PIN_BTN_STOP, false, false);
 
 // FUNCTIONS ==================================================================
 
+// The handlers change the settings read by the control, so they hold the control lock while the
+// scan of the keys and the debouncing run with the control enabled
+
 /// Handler of the button to increase the crete pressure
-void onPeakPressureIncrease() { mainController.onPeakPressureIncrease(); }
+void onPeakPressureIncrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPeakPressureIncrease();
+}
 
 /// Handler of the button to decrease the crete pressure
-void onPeakPressureDecrease() { mainController.onPeakPressureDecrease(); }
+void onPeakPressureDecrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPeakPressureDecrease();
+}
 
 /// Handler of the button to increase the plateau pressure
-void onPlateauPressureIncrease() { mainController.onPlateauPressureIncrease(); }
+void onPlateauPressureIncrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPlateauPressureIncrease();
+}
 
 /// Handler of the button to decrease the plateau pressure
-void onPlateauPressureDecrease() { mainController.onPlateauPressureDecrease(); }
+void onPlateauPressureDecrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPlateauPressureDecrease();
+}
 
 /// Handler of the button to increase the PEP pressure
-void onPeepPressureIncrease() { mainController.onPeepPressureIncrease(); }
+void onPeepPressureIncrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPeepPressureIncrease();
+}
 
 /// Handler of the button to decrease the PEP pressure
-void onPeepPressureDecrease() { mainController.onPeepPressureDecrease(); }
+void onPeepPressureDecrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onPeepPressureDecrease();
+}
 
 /// Handler of the button to increase the number of breathing cycles
-void onCycleIncrease() { mainController.onCycleIncrease(); }
+void onCycleIncrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onCycleIncrease();
+}
 
 /// Handler of the button to decrease the number of breathing cycles
-void onCycleDecrease() { mainController.onCycleDecrease(); }
+void onCycleDecrease() {
+    ControlCriticalSection criticalSection;
+    ventilator.mainController.onCycleDecrease();
+}
 
 /// Handler of the button to stop alarm
-void onAlarmOff() { alarmController.snooze(); }
+void onAlarmOff() {
+    ControlCriticalSection criticalSection;
+    ventilator.alarmController.snooze();
+}
 
 /// Handler of the button to start
 void onStart() {
+    ControlCriticalSection criticalSection;
     if (Calibration_Started()) {
         // Restart calibration
         Calibration_Restart();
@@ -73,7 +106,10 @@ void onStart() {
 }
 
 /// Handler of the button to stop
-void onStop() { activationController.onStopButton(); }
+void onStop() {
+    ControlCriticalSection criticalSection;
+    activationController.onStopButton();
+}
 
 void initKeyboard() {
     // define the 3x3 matrix keyboard input and output
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file load_shedding.cpp
+ * @brief Detect overruns of the 1 ms control interrupt and shed non-critical work
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/load_shedding.h"
+
+// Internal
+#include "../includes/debug.h"
+#include "../includes/hal.h"
+
+// INITIALISATION =============================================================
+
+BOARD_STATE LoadShedder loadShedder = LoadShedder();
+
+// FUNCTIONS ==================================================================
+
+LoadShedder::LoadShedder() {
+    m_tier = LOAD_SHEDDING_NONE;
+    m_overrunCount = 0u;
+    m_windowOverruns = 0u;
+    m_windowDuration = 0u;
+    m_quietWindows = 0u;
+
+    for (uint8_t i = 0u; i < LOAD_SHEDDING_TIERS; i++) {
+        m_shedCounts[i] = 0u;
+    }
+}
+
+void LoadShedder::update(uint32_t p_executionTimeUs, uint32_t p_missedTicks) {
+    uint32_t overruns = p_missedTicks;
+    if (p_executionTimeUs > LOAD_SHEDDING_OVERRUN_THRESHOLD_US) {
+        overruns++;
+    }
+
+    m_overrunCount += overruns;
+    m_windowOverruns += overruns;
+    m_windowDuration += 1u + p_missedTicks;
+
+    if (m_windowDuration >= LOAD_SHEDDING_WINDOW_MS) {
+        if (m_windowOverruns >= LOAD_SHEDDING_ESCALATION_OVERRUNS) {
+            // Shed one more tier
+            m_quietWindows = 0u;
+            if (m_tier < LOAD_SHEDDING_SERIAL) {
+                m_tier = static_cast<LoadSheddingTier>(m_tier + 1);
+                DBG_DO(Serial.print("Load shedding tier ");)
+                DBG_DO(Serial.println(m_tier);)
+            }
+        } else if (m_windowOverruns == 0u) {
+            // Restore one tier after a long enough quiet period
+            m_quietWindows++;
+            if ((m_quietWindows >= LOAD_SHEDDING_RECOVERY_WINDOWS)
+                && (m_tier > LOAD_SHEDDING_NONE)) {
+                m_tier = static_cast<LoadSheddingTier>(m_tier - 1);
+                m_quietWindows = 0u;
+                DBG_DO(Serial.print("Load shedding tier ");)
+                DBG_DO(Serial.println(m_tier);)
+            }
+        } else {
+            // A few overruns: stay on this tier
+            m_quietWindows = 0u;
+        }
+
+        m_windowOverruns = 0u;
+        m_windowDuration = 0u;
+    }
+}
+
+bool LoadShedder::shouldDropDataSnapshot(uint32_t p_tick) {
+    bool drop = (m_tier >= LOAD_SHEDDING_TELEMETRY) && ((p_tick % 2u) != 0u);
+
+    if (drop) {
+        m_shedCounts[LOAD_SHEDDING_TELEMETRY - 1]++;
+    }
+
+    return drop;
+}
+
+bool LoadShedder::shouldPostponeScreenUpdate() {
+    bool postpone = (m_tier >= LOAD_SHEDDING_SCREEN);
+
+    if (postpone) {
+        m_shedCounts[LOAD_SHEDDING_SCREEN - 1]++;
+    }
+
+    return postpone;
+}
+
+uint32_t LoadShedder::serialControlBudgetMs() {
+    uint32_t budget = SERIAL_CONTROL_BUDGET_MS;
+
+    if (m_tier >= LOAD_SHEDDING_SERIAL) {
+        budget = 0u;
+        m_shedCounts[LOAD_SHEDDING_SERIAL - 1]++;
+    }
+
+    return budget;
+}
+
+uint32_t LoadShedder::shedCount(LoadSheddingTier p_tier) const {
+    uint32_t count = 0u;
+
+    if ((p_tier > LOAD_SHEDDING_NONE) && (p_tier <= LOAD_SHEDDING_SERIAL)) {
+        count = m_shedCounts[p_tier - 1];
+    }
+
+    return count;
+}
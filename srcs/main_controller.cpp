@@ -14,16 +14,17 @@
 
 // Internal
 #include "../includes/cpu_load.h"
+#include "../includes/hal.h"
+#include "../includes/load_shedding.h"
+#include "../includes/ventilator_context.h"
 
 // INITIALISATION =============================================================
 
-MainController mainController;
-
 static const int32_t INVALID_ERROR_MARKER = INT32_MIN;
 
 // FUNCTIONS ==================================================================
 
-MainController::MainController() {
+MainController::MainController(VentilatorContext* p_context) : ContextMember(p_context) {
     m_tick = 0;
     m_phase = CyclePhases::INHALATION;
 
@@ -105,11 +106,11 @@ MainController::MainController() {
     m_peakPressureAlarmThresholdCommand = DEFAULT_PEAK_PRESSURE_ALARM_THRESHOLD;
     m_peakPressureAlarmThresholdNextCommand = DEFAULT_PEAK_PRESSURE_ALARM_THRESHOLD;
 
-    m_ventilationControllersTable[PC_CMV] = &pcCmvController;
-    m_ventilationControllersTable[PC_AC] = &pcAcController;
-    m_ventilationControllersTable[VC_CMV] = &vcCmvController;
-    m_ventilationControllersTable[PC_VSAI] = &pcVsaiController;
-    m_ventilationControllersTable[VC_AC] = &vcAcController;
+    m_ventilationControllersTable[PC_CMV] = &context().pcCmvController;
+    m_ventilationControllersTable[PC_AC] = &context().pcAcController;
+    m_ventilationControllersTable[VC_CMV] = &context().vcCmvController;
+    m_ventilationControllersTable[PC_VSAI] = &context().pcVsaiController;
+    m_ventilationControllersTable[VC_AC] = &context().vcAcController;
 
     m_ventilationControllerMode = PC_AC;
 
@@ -162,6 +163,8 @@ MainController::MainController() {
 }
 
 void MainController::setup() {
+    AlarmController& alarmController = context().alarmController;
+
     DBG_DO(Serial.println(VERSION);)
     DBG_DO(Serial.println("Setup the controller");)
 
@@ -173,6 +176,8 @@ void MainController::setup() {
 }
 
 void MainController::initRespiratoryCycle() {
+    AlarmController& alarmController = context().alarmController;
+
     m_expiratoryVolume = 0;
     DBG_DO(Serial.println("Init respiratory cycle");)
     m_cycleNb++;
@@ -243,9 +248,19 @@ void MainController::initRespiratoryCycle() {
     m_maxExpiratoryFlow = 0;
 
     m_ventilationController->initCycle();
+
+    // Start the cycle in inhalation, so that the inner loop regulates the right valve before the
+    // first computation
+    m_tick = 0;
+    updatePhase();
 }
 
 void MainController::compute() {
+    AlarmController& alarmController = context().alarmController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     // Update the cycle phase
     updatePhase();
 
@@ -284,8 +299,9 @@ void MainController::compute() {
 
     alarmController.updateCoreData(m_tick, m_pressure, m_phase, m_cycleNb);
 
-    // Send data snaphshot only every 10 ms
-    if ((m_tick % moduloValue) == 0u) {
+    // Send data snaphshot only every 10 ms, or every 20 ms when the control is overloaded
+    if (((m_tick % moduloValue) == 0u)
+        && !loadShedder.shouldDropDataSnapshot(m_tick / moduloValue)) {
         sendDataSnapshot(m_tick, max((int16_t)0, m_pressure), m_phase, inspiratoryValve.position,
                          expiratoryValve.position, blower.getSpeed() / 100u, getBatteryLevel(),
                          max(int32_t(0), m_inspiratoryFlow / 10),
@@ -311,6 +327,24 @@ void MainController::compute() {
     printDebugValues();
 }
 
+void MainController::computeInnerLoop(int32_t p_dt) {
+    switch (m_phase) {
+    case CyclePhases::INHALATION:
+        m_ventilationController->inhaleInnerLoop(p_dt);
+        break;
+
+    case CyclePhases::EXHALATION:
+        m_ventilationController->exhaleInnerLoop(p_dt);
+        break;
+
+    default:
+        // Do nothing
+        break;
+    }
+
+    executeValveCommands();
+}
+
 void MainController::updatePhase() {
     if (m_tick < m_ticksPerInhalation) {
         m_phase = CyclePhases::INHALATION;
@@ -402,6 +436,10 @@ void MainController::endRespiratoryCycle(uint32_t p_currentMillis) {
 
 void MainController::printDebugValues() {
 #if DEBUG == 2
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     Serial.print(m_pressure);
     Serial.print(",");
     Serial.print(m_pressureCommand);
@@ -448,6 +486,8 @@ void MainController::updateExpiratoryFlow(int32_t p_currentExpiratoryFlow) {
 
 // cppcheck-suppress unusedFunction
 void MainController::updateFakeExpiratoryFlow() {
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     // get section in mm2 x 100
     int32_t A2MultiplyBy100 = expiratoryValve.getSectionBigHoseX100();
     int32_t A1MultiplyBy100 = 7853;
@@ -508,10 +548,11 @@ void MainController::computeTickParameters() {
 }
 
 void MainController::executeCommands() {
+    AlarmController& alarmController = context().alarmController;
+    Blower& blower = context().blower;
+
     if (m_pressure
         > (m_peakPressureAlarmThresholdCommand + AIR_EXHAUST_THRESHOLD_FROM_PEAK_PRESSURE_ALARM)) {
-        inspiratoryValve.close();
-        expiratoryValve.open();
         alarmController.detectedAlarm(RCM_SW_18, m_cycleNb,
                                       m_peakPressureAlarmThresholdCommand
                                           + AIR_EXHAUST_THRESHOLD_FROM_PEAK_PRESSURE_ALARM,
@@ -520,12 +561,29 @@ void MainController::executeCommands() {
         alarmController.notDetectedAlarm(RCM_SW_18);
     }
 
+    executeValveCommands();
+    blower.execute();
+}
+
+void MainController::executeValveCommands() {
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
+    // RCM-SW-18: release the air as soon as the pressure is too high, whatever the controller
+    // asked for
+    if (m_pressure
+        > (m_peakPressureAlarmThresholdCommand + AIR_EXHAUST_THRESHOLD_FROM_PEAK_PRESSURE_ALARM)) {
+        inspiratoryValve.close();
+        expiratoryValve.open();
+    }
+
     inspiratoryValve.execute();
     expiratoryValve.execute();
-    blower.execute();
 }
 
 void MainController::checkCycleAlarm() {
+    AlarmController& alarmController = context().alarmController;
+
     // RCM-SW-1 + RCM-SW-14: check if plateau is reached
     int16_t minPlateauBeforeAlarm =
         (m_plateauPressureCommand * (100 - ALARM_THRESHOLD_DIFFERENCE_PERCENT)) / 100;
@@ -658,12 +716,17 @@ void MainController::checkCycleAlarm() {
 }
 
 void MainController::reachSafetyPosition() {
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     inspiratoryValve.open();
     expiratoryValve.open();
     executeCommands();
 }
 
 void MainController::sendStopMessageToUi() {
+    AlarmController& alarmController = context().alarmController;
+
     sendStoppedMessage(
         mmH2OtoCmH2O(m_peakPressureNextCommand), mmH2OtoCmH2O(m_plateauPressureNextCommand),
         mmH2OtoCmH2O(m_peepNextCommand), m_cyclesPerMinuteNextCommand, m_expiratoryTermNextCommand,
@@ -684,6 +747,9 @@ void MainController::sendStopMessageToUi() {
 }
 
 void MainController::stop(uint32_t p_currentMillis) {
+    AlarmController& alarmController = context().alarmController;
+    Blower& blower = context().blower;
+
     blower.stop();
     sendStopMessageToUi();
     // When stopped, open the valves
@@ -709,10 +775,17 @@ void MainController::stop(uint32_t p_currentMillis) {
     alarmController.notDetectedAlarm(RCM_SW_21);
     alarmController.notDetectedAlarm(RCM_SW_22);
     alarmController.notDetectedAlarm(RCM_SW_23);
-    digitalWrite(PIN_LED_START, LED_START_INACTIVE);
+    halWriteLed(HAL_LED_START, false);
 }
 
 void MainController::sendMachineState() {
+    AlarmController& alarmController = context().alarmController;
+
+    uint16_t subsystemLoads[CPU_LOAD_SUBSYSTEMS];
+    for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+        subsystemLoads[i] = readCpuLoadPerMille(static_cast<CpuLoadSubsystem>(i));
+    }
+
     // Send the next command, because command has not been updated yet (will be at the beginning of
     // the next cycle)
     sendMachineStateSnapshot(
@@ -735,7 +808,12 @@ void MainController::sendMachineState() {
         static_cast<uint8_t>(m_targetInspiratoryFlowNextCommand / 1000),
         m_inspiratoryDurationNextCommand, m_ticksPerInhalation * MAIN_CONTROLLER_COMPUTE_PERIOD_MS,
         getBatteryLevelX100(), 26226u, m_patientHeight, m_patientGender,
-        m_peakPressureAlarmThresholdNextCommand);
+        m_peakPressureAlarmThresholdNextCommand, subsystemLoads);
+
+    sendLoadReport(static_cast<uint8_t>(loadShedder.tier()), loadShedder.overrunCount(),
+                   loadShedder.shedCount(LOAD_SHEDDING_TELEMETRY),
+                   loadShedder.shedCount(LOAD_SHEDDING_SCREEN),
+                   loadShedder.shedCount(LOAD_SHEDDING_SERIAL));
 }
 
 void MainController::onVentilationModeSet(uint16_t p_ventilationControllerMode) {
@@ -1213,7 +1291,7 @@ void MainController::onPatientHeight(int16_t p_patientHeight) {
     // Send acknowledgment to the UI
     sendControlAck(28, m_patientHeight);
 
-    mainController.onPatientComputePreset();
+    onPatientComputePreset();
 }
 
 // cppcheck-suppress unusedFunction
@@ -1228,7 +1306,7 @@ void MainController::onPatientGender(int16_t p_patientGender) {
     // Send acknowledgment to the UI
     sendControlAck(29, m_patientGender);
 
-    mainController.onPatientComputePreset();
+    onPatientComputePreset();
 }
 
 // cppcheck-suppress unusedFunction
@@ -1267,3 +1345,127 @@ void MainController::onPatientComputePreset() {
     m_peakPressureAlarmThresholdNextCommand =
         m_plateauPressureNextCommand + PEAK_PRESSURE_ALARM_THRESHOLD_OFFSET_FROM_PLATEAU;
 }
+
+/**
+ * Find the mode of a ventilation controller
+ *
+ * @param p_table Controllers of the modes, by VentilationModes number
+ * @param p_controller Controller
+ * @return Number of its mode, 0 if it is not in the table
+ */
+static uint8_t ventilationControllerMode(VentilationController* const* p_table,
+                                         const VentilationController* p_controller) {
+    uint8_t mode = 0u;
+    for (uint8_t i = 1u; i <= NUMBER_OF_VENTILATION_MODES; i++) {
+        if (p_table[i] == p_controller) {
+            mode = i;
+        }
+    }
+    return mode;
+}
+
+void MainController::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(m_tick);
+    p_archive->field(m_cyclesPerMinuteCommand);
+    p_archive->field(m_cyclesPerMinuteNextCommand);
+    p_archive->field(m_cyclesPerMinuteMeasure);
+    p_archive->field(m_lastBreathPeriodsMs);
+    p_archive->field(m_lastBreathPeriodsMsIndex);
+    p_archive->field(m_lastEndOfRespirationDateMs);
+    p_archive->field(m_peakPressureCommand);
+    p_archive->field(m_peakPressureMeasure);
+    p_archive->field(m_rebouncePeakPressureMeasure);
+    p_archive->field(m_peakPressureNextCommand);
+    p_archive->field(m_plateauPressureCommand);
+    p_archive->field(m_plateauPressureNextCommand);
+    p_archive->field(m_plateauPressureMeasure);
+    p_archive->field(m_plateauPressureToDisplay);
+    p_archive->field(m_PlateauMeasureSum);
+    p_archive->field(m_PlateauMeasureCount);
+    p_archive->field(m_plateauDurationMs);
+    p_archive->field(m_peepCommand);
+    p_archive->field(m_peepNextCommand);
+    p_archive->field(m_peepMeasure);
+    p_archive->field(m_isPeepDetected);
+    p_archive->field(m_pressureTriggerOffsetCommand);
+    p_archive->field(m_pressureTriggerOffsetNextCommand);
+    p_archive->field(m_triggered);
+    p_archive->field(m_triggerModeEnabledCommand);
+    p_archive->field(m_triggerModeEnabledNextCommand);
+    p_archive->field(m_tidalVolumeAlreadyRead);
+    p_archive->field(m_expiratoryTermCommand);
+    p_archive->field(m_expiratoryTermNextCommand);
+    p_archive->field(m_inspiratoryTriggerFlowCommand);
+    p_archive->field(m_inspiratoryTriggerFlowNextCommand);
+    p_archive->field(m_expiratoryTriggerFlowCommand);
+    p_archive->field(m_expiratoryTriggerFlowNextCommand);
+    p_archive->field(m_tiMinCommand);
+    p_archive->field(m_tiMaxCommand);
+    p_archive->field(m_tiMinNextCommand);
+    p_archive->field(m_tiMaxNextCommand);
+    p_archive->enumField(m_ventilationControllerMode);
+    p_archive->field(m_tidalVolumeMeasure);
+    p_archive->field(m_tidalVolumeCommand);
+    p_archive->field(m_tidalVolumeNextCommand);
+    p_archive->field(m_plateauDurationCommand);
+    p_archive->field(m_plateauDurationNextCommand);
+    p_archive->field(m_targetInspiratoryFlowCommand);
+    p_archive->field(m_targetInspiratoryFlowNextCommand);
+    p_archive->field(m_inspiratoryDurationCommand);
+    p_archive->field(m_inspiratoryDurationNextCommand);
+    p_archive->field(m_lowInspiratoryMinuteVolumeAlarmThresholdCommand);
+    p_archive->field(m_lowInspiratoryMinuteVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_highInspiratoryMinuteVolumeAlarmThresholdCommand);
+    p_archive->field(m_highInspiratoryMinuteVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_lowExpiratoryMinuteVolumeAlarmThresholdCommand);
+    p_archive->field(m_lowExpiratoryMinuteVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_highExpiratoryMinuteVolumeAlarmThresholdCommand);
+    p_archive->field(m_highExpiratoryMinuteVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_lowRespiratoryRateAlarmThresholdCommand);
+    p_archive->field(m_lowRespiratoryRateAlarmThresholdNextCommand);
+    p_archive->field(m_highRespiratoryRateAlarmThresholdCommand);
+    p_archive->field(m_highRespiratoryRateAlarmThresholdNextCommand);
+    p_archive->field(m_lowTidalVolumeAlarmThresholdCommand);
+    p_archive->field(m_lowTidalVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_highTidalVolumeAlarmThresholdCommand);
+    p_archive->field(m_highTidalVolumeAlarmThresholdNextCommand);
+    p_archive->field(m_leakAlarmThresholdCommand);
+    p_archive->field(m_leakAlarmThresholdNextCommand);
+    p_archive->field(m_peakPressureAlarmThresholdCommand);
+    p_archive->field(m_peakPressureAlarmThresholdNextCommand);
+    p_archive->field(m_expiratoryVolume);
+    p_archive->field(m_ticksPerCycle);
+    p_archive->field(m_ticksPerInhalation);
+    p_archive->field(m_pressure);
+    p_archive->field(m_inspiratoryFlow);
+    p_archive->field(m_maxInspiratoryFlow);
+    p_archive->field(m_expiratoryFlow);
+    p_archive->field(m_maxExpiratoryFlow);
+    p_archive->field(m_lastMaxExpiratoryFlow);
+    p_archive->field(m_currentDeliveredVolume);
+    p_archive->field(m_inhalationLastPressure);
+    p_archive->field(m_inspiratoryValveAngle);
+    p_archive->enumField(m_phase);
+    p_archive->field(m_cycleNb);
+    p_archive->field(m_dt);
+    p_archive->field(m_pressureCommand);
+    p_archive->field(m_lastPressureValues);
+    p_archive->field(m_lastPressureValuesIndex);
+    p_archive->field(m_sumOfPressures);
+    p_archive->field(m_numberOfPressures);
+    p_archive->field(m_patientHeight);
+    p_archive->field(m_patientGender);
+
+    // The controllers of the modes belong to the context, they are archived by their mode
+    uint8_t mode = ventilationControllerMode(m_ventilationControllersTable,
+                                             m_ventilationController);
+    uint8_t nextMode = ventilationControllerMode(m_ventilationControllersTable,
+                                                 m_ventilationControllerNextCommand);
+    p_archive->field(mode);
+    p_archive->field(nextMode);
+    if (p_archive->isRestoring() && (mode > 0u) && (mode <= NUMBER_OF_VENTILATION_MODES)
+        && (nextMode > 0u) && (nextMode <= NUMBER_OF_VENTILATION_MODES)) {
+        m_ventilationController = m_ventilationControllersTable[mode];
+        m_ventilationControllerNextCommand = m_ventilationControllersTable[nextMode];
+    }
+}
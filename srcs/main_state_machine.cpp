@@ -10,39 +10,183 @@
 // INCLUDES ===================================================================
 
 #include "../includes/parameters.h"
-#include "Arduino.h"
-#include <IWatchdog.h>
 
 #include "../includes/activation.h"
 #include "../includes/battery.h"
 #include "../includes/buzzer_control.h"
+#include "../includes/control_lock.h"
+#include "../includes/cpu_load.h"
 #include "../includes/debug.h"
+#include "../includes/deferred_work.h"
+#include "../includes/hal.h"
+#include "../includes/interrupt_timing.h"
 #include "../includes/keyboard.h"
+#include "../includes/load_shedding.h"
 #include "../includes/main_controller.h"
 #include "../includes/main_state_machine.h"
 #include "../includes/mass_flow_meter.h"
+#include "../includes/periodic_task.h"
 #include "../includes/pressure.h"
 #include "../includes/rpi_watchdog.h"
+#include "../includes/rtos_tasks.h"
 #include "../includes/screen.h"
+#include "../includes/sensor_capture.h"
 #include "../includes/serial_control.h"
 #include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
 
 // INITIALISATION =============================================================
 
-MainStateMachine mainStateMachine = MainStateMachine();
+BOARD_STATE MainStateMachine mainStateMachine = MainStateMachine();
 
-uint32_t clockMsmTimer = 0;
-uint32_t lastMillis = 0;
-uint32_t lastMainControllerCall = 0;
-HardwareTimer* msmTimer;
-uint32_t lastMicro = 0;
-uint32_t tick = 0;
+BOARD_STATE uint32_t clockMsmTimer = 0;
+BOARD_STATE uint32_t tick = 0;
+
+// Control clock: every computation of the main controller is scheduled on a fixed multiple of
+// the timer period, counted from the beginning of the cycle
+BOARD_STATE uint32_t cycleStartClock = 0;
+BOARD_STATE bool isCycleChained = false;
+BOARD_STATE uint32_t nextControlTick = 0;
+BOARD_STATE uint32_t lastControlTick = 0;
+BOARD_STATE uint32_t lastInnerLoopClock = 0;
+
+// Period of the valve regulation during BREATH, on every pressure sample
+BOARD_STATE uint32_t innerLoopPeriodMs = 1u;
+
+// Date in microsecond of the last timer period accounted in clockMsmTimer
+BOARD_STATE uint64_t lastTimerMicro = 0;
+
+// Number of timer periods that elapsed without their interrupt being served
+BOARD_STATE uint32_t missedTimerTicks = 0;
+
+// Number of main controller computations that could not run on time
+BOARD_STATE uint32_t missedControlDeadlines = 0;
+
+// Low power profile of the STOPPED state: the timer period is raised, the flow meters are not
+// polled and the stopped message is sent less often
+#define STOPPED_TIMER_PERIOD_MS 10u
+#define STOPPED_MESSAGE_PERIOD_MS 500u
+BOARD_STATE uint32_t timerPeriodMs = 1u;
+BOARD_STATE uint32_t lastStoppedMessageClock = 0;
+BOARD_STATE uint32_t lastStoppedTickClock = 0;
 
 // cppcheck-suppress misra-c2012-12.3 ; cppcheck error
 enum Step { SETUP, STOPPED, INIT_CYCLE, BREATH, TRIGGER_RAISED, END_CYCLE };
 
-Step msmstep = SETUP;
-Step previousmsmstep = SETUP;
+BOARD_STATE Step msmstep = SETUP;
+BOARD_STATE Step previousmsmstep = SETUP;
+
+// PERIODIC TASKS =============================================================
+
+/// Frequency of the main state machine timer counter
+#define MSM_TIMER_FREQUENCY 1000000u
+
+/// Check if some buttons have been pushed
+void keyboardTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_OTHER);
+    keyboardLoop();
+}
+
+/// Check if battery state has changed
+void batteryTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_OTHER);
+    // The ADC is sampled while the control runs, the alarms are raised under the lock
+    updateBatterySample();
+    ControlCriticalSection criticalSection;
+    updateBatteryState(ventilator.mainController.cycleNumber());
+}
+
+/// Check serial input
+void serialTask(void) { serialControlLoop(); }
+
+/// Run buzzer and LEDs of the active alarms
+void alarmEffectsTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_OTHER);
+    ventilator.alarmController.runAlarmEffects(tick);
+}
+
+/// Refresh screen every 300 ms, no more
+void screenTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_LCD);
+
+    // Under load, the LCD waits for the control to catch up
+    if (!loadShedder.shouldPostponeScreenUpdate()) {
+        mainStateMachine.ScreenUpdate();
+    }
+}
+
+/// Because this kind of LCD screen is not reliable, we need to reset it every 5 min or so
+void screenResetTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_LCD);
+    DBG_DO(Serial.println("resetting LCD screen");)
+    resetScreen();
+    clearAlarmDisplayCache();
+}
+
+/// Check that the UI software on the Raspberry PI has sent a heartbeat in the last 60s
+/// Otherwise restart the power
+void rpiWatchdogTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_OTHER);
+    rpiWatchdog.update();
+}
+
+/// Send the raw sensor samples captured since the last run
+void sensorCaptureTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+    static BOARD_STATE uint8_t records[SENSOR_CAPTURE_MESSAGE_SIZE];
+
+    // The control interrupt sends its own messages on the same link: the records are sent under
+    // the lock, and only as many as the transmit buffer takes without waiting for the link
+    ControlCriticalSection criticalSection;
+    size_t size = sensorCapture.take(records, sensorCaptureRoom(SENSOR_CAPTURE_MESSAGE_SIZE));
+    if (size > 0u) {
+        sendSensorCapture(records, static_cast<uint16_t>(size));
+    }
+}
+
+/// Display the stopped state screen
+void stoppedScreenTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_LCD);
+    mainStateMachine.ScreenUpdate();
+    displayMachineStopped();
+}
+
+/// Display the measures of the cycle that just ended
+void endOfCycleScreenTask(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_LCD);
+    displayCurrentInformation(ventilator.mainController.peakPressureMeasure(),
+                              ventilator.mainController.plateauPressureMeasure(),
+                              ventilator.mainController.peepMeasure());
+}
+
+/**
+ * Periodic tasks of the main state machine
+ *
+ * Phases are chosen so that no two tasks are posted on the same millisecond tick (every period is
+ * a multiple of 10 ms, so the phase modulo 10 tells on which tick of the 10 ms frame a task is
+ * posted).
+ */
+BOARD_STATE PeriodicTask msmTasks[] = {
+    // callback, period (ms), phase (ms), priority
+    {&batteryTask, 10u, 1u, 0u},
+#ifndef RTOS_TASKS
+    // With RTOS tasks, the serial control has its own task
+    {&serialTask, 10u, 3u, 1u},
+#endif
+    {&keyboardTask, 10u, 5u, 2u},
+    {&alarmEffectsTask, 10u, 7u, 3u},
+    {&rpiWatchdogTask, 1000u, 2u, 4u},
+    {&screenTask, 300u, 9u, 5u},
+    {&screenResetTask, 300000u, 4u, 6u},
+    {&sensorCaptureTask, 10u, 6u, 7u},
+};
+
+/// Tasks posted by the state machine on state changes
+BOARD_STATE PeriodicTask stoppedScreen = {&stoppedScreenTask, 0u, 0u, 0u};
+BOARD_STATE PeriodicTask endOfCycleScreen = {&endOfCycleScreenTask, 0u, 0u, 0u};
+
+BOARD_STATE PeriodicTaskTable msmTaskTable(msmTasks, sizeof(msmTasks) / sizeof(msmTasks[0]));
 
 // FUNCTIONS ==================================================================
 
@@ -51,95 +195,133 @@ MainStateMachine::MainStateMachine() { isMsmActive = false; }
 
 bool MainStateMachine::isRunning() { return isMsmActive; }
 
+// cppcheck-suppress unusedFunction
+uint32_t MainStateMachine::missedTimerTicks() const { return ::missedTimerTicks; }
+
+// cppcheck-suppress unusedFunction
+uint32_t MainStateMachine::missedControlDeadlines() const { return ::missedControlDeadlines; }
+
 void MainStateMachine::ScreenUpdate() {
-    displayCurrentVolume(mainController.tidalVolumeMeasure(),
-                         mainController.cyclesPerMinuteNextCommand());
-    displayCurrentSettings(mainController.peakPressureNextCommand(),
-                           mainController.plateauPressureNextCommand(),
-                           mainController.peepNextCommand());
+    displayCurrentVolume(ventilator.mainController.tidalVolumeMeasure(),
+                         ventilator.mainController.cyclesPerMinuteNextCommand());
+    displayCurrentSettings(ventilator.mainController.peakPressureNextCommand(),
+                           ventilator.mainController.plateauPressureNextCommand(),
+                           ventilator.mainController.peepNextCommand());
     if (msmstep == STOPPED) {
         displayMachineStopped();
     }
 }
 
-// API update since version 1.9.0 of Arduino_Core_STM32
-#if (STM32_CORE_VERSION < 0x01090000)
-// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
-void millisecondTimerMSM(HardwareTimer*)  // NOLINT(readability/casting)
+/**
+ * Change the period of the main state machine timer
+ *
+ * @param p_periodMs New period in ms
+ * @warning It must be called from the main state machine, right after a period started
+ */
+void setTimerPeriod(uint32_t p_periodMs) {
+    timerPeriodMs = p_periodMs;
+    interruptTimings[INTERRUPT_TIMING_CONTROL].setNominalPeriod(1000u * p_periodMs);
+#ifdef RTOS_TASKS
+    setRtosControlPeriod(p_periodMs);
 #else
-void millisecondTimerMSM(void)
+    halSetTimerOverflow(HAL_TIMER_CONTROL, (MSM_TIMER_FREQUENCY / 1000u) * p_periodMs);
 #endif
-{
-    IWatchdog.reload();
-    clockMsmTimer++;
-    int32_t pressure = inspiratoryPressureSensor.read();
-    mainController.updatePressure(pressure);
-
-    if ((clockMsmTimer % 10u) == 0u) {
-        // Check if some buttons have been pushed
-        keyboardLoop();
-        // Check if battery state has changed
-        batteryLoop(mainController.cycleNumber());
-        // Check serial input
-        serialControlLoop();
-
-        if (isBatteryDeepDischarged()) {
-            // Delay will trigger the watchdog and the machine will restart with a message
-            // on screen
-            delay(10000);
-        }
-        alarmController.runAlarmEffects(tick);
-    }
+}
+
+/// Switch to the low power profile of the STOPPED state
+void enterLowPowerMode(void) {
+    setTimerPeriod(STOPPED_TIMER_PERIOD_MS);
+#ifdef MASS_FLOW_METER_ENABLED
+    MFM_pause();
+#endif
+}
 
-    // Because this kind of LCD screen is not reliable, we need to reset it every 5 min or
-    // so
-    if ((clockMsmTimer % 300000u) == 0u) {
-        DBG_DO(Serial.println("resetting LCD screen");)
-        resetScreen();
-        clearAlarmDisplayCache();
+/// Switch back to full speed, the next timer period is 1 ms long
+void leaveLowPowerMode(void) {
+    setTimerPeriod(1u);
+#ifdef MASS_FLOW_METER_ENABLED
+    MFM_resume();
+#endif
+}
+
+void runMainStateMachine(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_CONTROL);
+    uint64_t timerEntryMicro = monotonicMicros();
+    uint16_t rawPressure = halReadPressureAdc();
+    sensorCapture.onControlTick(timerEntryMicro, lastTimerMicro, rawPressure, msmstep == STOPPED);
+
+    // Keep the clock locked on real time: if the interrupt was held off for more than one period
+    // (e.g. while a background task locked the control), account for every elapsed ms
+    uint32_t elapsedTimerTicks =
+        static_cast<uint32_t>((timerEntryMicro - lastTimerMicro + 500u) / 1000u);
+    if (elapsedTimerTicks == 0u) {
+        elapsedTimerTicks = 1u;
     }
+    uint32_t lateTimerTicks = 0u;
+    if (elapsedTimerTicks > timerPeriodMs) {
+        lateTimerTicks = elapsedTimerTicks - timerPeriodMs;
+    }
+    missedTimerTicks += lateTimerTicks;
+    lastTimerMicro += elapsedTimerTicks * 1000u;
 
-    // Refresh screen every 300 ms, no more
-    if ((clockMsmTimer % 300u) == 0u) {
-        mainStateMachine.ScreenUpdate();
+    // Stop reloading the watchdog when the background loop is stuck, or when the battery is
+    // deeply discharged: the machine will restart with a message on screen
+    if (isDeferredWorkProgressing(elapsedTimerTicks) && !isBatteryDeepDischarged()) {
+        halReloadWatchdog();
     }
 
-    // Check that the UI software on the Raspberry PI has sent a heartbeat in the last 60s
-    // Otherwise restart the power
-    if ((clockMsmTimer % 1000u) == 0u) {
-        rpiWatchdog.update();
+    int32_t pressure = inspiratoryPressureSensor.convert(rawPressure);
+    ventilator.mainController.updatePressure(pressure);
+
+    for (uint32_t i = 0u; i < elapsedTimerTicks; i++) {
+        clockMsmTimer++;
+        msmTaskTable.run(clockMsmTimer);
     }
 
     if (msmstep == SETUP) {
-        mainController.setup();
-        mainStateMachine.ScreenUpdate();
-        displayMachineStopped();
+        ventilator.mainController.setup();
+        isCycleChained = false;
         msmstep = STOPPED;
+        lastStoppedMessageClock = clockMsmTimer;
+        lastStoppedTickClock = clockMsmTimer;
+        enterLowPowerMode();
+        (void)postDeferredWork(&stoppedScreen);
     } else if (msmstep == STOPPED) {
         // Executed just after booting, until the first start
-        if ((clockMsmTimer % 100u) == 0u) {
-            mainController.stop(millis());
-            displayMachineStopped();
+        if ((clockMsmTimer - lastStoppedMessageClock) >= STOPPED_MESSAGE_PERIOD_MS) {
+            lastStoppedMessageClock = clockMsmTimer;
+            ventilator.mainController.stop(monotonicMillis());
+            (void)postDeferredWork(&stoppedScreen);
         }
 
-        if ((clockMsmTimer % 10u) == 0u) {
-            tick++;  // Also increase ticks during stop, for alarm controller
+        // Also increase ticks during stop, for alarm controller
+        while ((clockMsmTimer - lastStoppedTickClock) >= 10u) {
+            lastStoppedTickClock += 10u;
+            tick++;
         }
 
         activationController.refreshState();
         if (activationController.isRunning()) {
+            leaveLowPowerMode();
             msmstep = INIT_CYCLE;
             // set patient height to default value
-            if (mainController.patientHeight() == 0) {
-                mainController.onPatientHeight(DEFAULT_PATIENT_HEIGHT);
+            if (ventilator.mainController.patientHeight() == 0) {
+                ventilator.mainController.onPatientHeight(DEFAULT_PATIENT_HEIGHT);
             }
         }
 
     } else if (msmstep == INIT_CYCLE) {
-        mainController.initRespiratoryCycle();
-        lastMillis = millis();
-        lastMainControllerCall = millis();
+        ventilator.mainController.initRespiratoryCycle();
         tick = 0;
+        // When the previous cycle ended on time, this one starts exactly where it ended, so that
+        // the cycle lasts ticksPerCycle computation periods, whatever the state changes took
+        if (!isCycleChained) {
+            cycleStartClock = clockMsmTimer;
+        }
+        isCycleChained = false;
+        nextControlTick = 0;
+        lastControlTick = 0;
+        lastInnerLoopClock = clockMsmTimer;
         msmstep = BREATH;
 #ifdef MASS_FLOW_METER_ENABLED
         (void)MFM_read_milliliters(true);  // Reset volume integral
@@ -150,39 +332,59 @@ void millisecondTimerMSM(void)
 
     } else if (msmstep == BREATH) {
         // If breathing
-        uint32_t currentMillis = millis();
-        tick = (currentMillis - lastMillis) / MAIN_CONTROLLER_COMPUTE_PERIOD_MS;
+        // Tick number whose computation is due, on the fixed step control clock
+        uint32_t dueControlTick =
+            (clockMsmTimer - cycleStartClock) / MAIN_CONTROLLER_COMPUTE_PERIOD_MS;
 
-        if ((currentMillis - lastMainControllerCall) > MAIN_CONTROLLER_COMPUTE_PERIOD_MS) {
-            if (tick >= mainController.ticksPerCycle()) {
+        if (dueControlTick >= nextControlTick) {
+            // Catch-up policy: computations that missed their deadline are not replayed. The
+            // tick jumps to the due one, so that breath timing keeps matching the clock, and the
+            // duration given to the controller covers every skipped period
+            if (dueControlTick > nextControlTick) {
+                missedControlDeadlines += dueControlTick - nextControlTick;
+            }
+            tick = dueControlTick;
+
+            if (tick >= ventilator.mainController.ticksPerCycle()) {
                 msmstep = END_CYCLE;
+                cycleStartClock +=
+                    ventilator.mainController.ticksPerCycle() * MAIN_CONTROLLER_COMPUTE_PERIOD_MS;
+                isCycleChained = true;
             } else {
-                uint32_t currentMicro = micros();
                 int32_t inspiratoryflow = 0;
                 int32_t expiratoryflow = 0;
 #ifdef MASS_FLOW_METER_ENABLED
                 inspiratoryflow = MFM_read_airflow();
-                mainController.updateCurrentDeliveredVolume(MFM_read_milliliters(false));
+                ventilator.mainController.updateCurrentDeliveredVolume(MFM_read_milliliters(false));
 #endif
-                mainController.updateInspiratoryFlow(inspiratoryflow);
+                ventilator.mainController.updateInspiratoryFlow(inspiratoryflow);
 
 #ifdef MASS_FLOW_METER_ENABLED&& MASS_FLOW_METER_SENSOR_EXPI
                 expiratoryflow = MFM_expi_read_airflow();
-                mainController.updateExpiratoryFlow(expiratoryflow);
-                mainController.updateCurrentExpiratoryVolume(MFM_expi_read_milliliters(false));
+                ventilator.mainController.updateExpiratoryFlow(expiratoryflow);
+                ventilator.mainController.updateCurrentExpiratoryVolume(
+                    MFM_expi_read_milliliters(false));
 #else
-                mainController.updateFakeExpiratoryFlow();
+                ventilator.mainController.updateFakeExpiratoryFlow();
 #endif
-                mainController.updateDt(currentMicro - lastMicro);
-                lastMicro = currentMicro;
-                mainController.updateTick(tick);
-                mainController.compute();
-                lastMainControllerCall = currentMillis;
-                tick++;
+                uint32_t elapsedControlTicks = (tick == 0u) ? 1u : (tick - lastControlTick);
+                ventilator.mainController.updateDt(static_cast<int32_t>(
+                    elapsedControlTicks * MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS));
+                ventilator.mainController.updateTick(tick);
+                ventilator.mainController.compute();
+                lastControlTick = tick;
+                nextControlTick = tick + 1u;
             }
         }
 
-        if (mainController.triggered()) {
+        // Regulate the valves on every pressure sample, between two main controller computations
+        if ((msmstep == BREATH) && ((clockMsmTimer - lastInnerLoopClock) >= innerLoopPeriodMs)) {
+            ventilator.mainController.computeInnerLoop(
+                static_cast<int32_t>((clockMsmTimer - lastInnerLoopClock) * 1000u));
+            lastInnerLoopClock = clockMsmTimer;
+        }
+
+        if (ventilator.mainController.triggered()) {
             msmstep = TRIGGER_RAISED;
         }
 
@@ -198,10 +400,8 @@ void millisecondTimerMSM(void)
             msmstep = SETUP;
         }
     } else if (msmstep == END_CYCLE) {
-        mainController.endRespiratoryCycle(millis());
-        displayCurrentInformation(mainController.peakPressureMeasure(),
-                                  mainController.plateauPressureMeasure(),
-                                  mainController.peepMeasure());
+        ventilator.mainController.endRespiratoryCycle(monotonicMillis());
+        (void)postDeferredWork(&endOfCycleScreen);
         if (activationController.isRunning()) {
             msmstep = INIT_CYCLE;
         } else {
@@ -212,21 +412,62 @@ void millisecondTimerMSM(void)
     }
 
     previousmsmstep = msmstep;
+
+    loadShedder.update(static_cast<uint32_t>(monotonicMicros() - timerEntryMicro), lateTimerTicks);
 }
 
+#ifndef RTOS_TASKS
+void millisecondTimerMSM(void) {
+    // The counter restarted from 0 on the update event, and counts µs
+    interruptTimings[INTERRUPT_TIMING_CONTROL].onEntry(halReadTimerCount(HAL_TIMER_CONTROL));
+    runMainStateMachine();
+}
+#endif
+
 void MainStateMachine::setupAndStart() {
     isMsmActive = true;
     ::clockMsmTimer = 0;
-    ::msmTimer = new HardwareTimer(TIM9);
+    ::tick = 0;
+    ::msmstep = SETUP;
+    ::previousmsmstep = SETUP;
+    ::timerPeriodMs = 1u;
+    ::missedTimerTicks = 0;
+    ::missedControlDeadlines = 0;
+#ifdef RTOS_TASKS
+    ::lastTimerMicro = monotonicMicros();
+    startRtosControlTask();
+#else
     // Set a 1 ms timer for the event loop
-    // Prescaler at 10 kHz; stm32f411 clock is 100 mHz
-    ::msmTimer->setPrescaleFactor((::msmTimer->getTimerClkFreq() / 10000) - 1);
-    // Set the period at 1 ms
-    ::msmTimer->setOverflow(10);
-    // priority level :
-    // https://stm32f4-discovery.net/2014/05/stm32f4-stm32f429-nvic-or-nested-vector-interrupt-controller/
-    ::msmTimer->setInterruptPriority(6, 0);
-    ::msmTimer->setMode(1, TIMER_OUTPUT_COMPARE, NC);
-    ::msmTimer->attachInterrupt(millisecondTimerMSM);
-    ::msmTimer->resume();
+    // Counter at 1 MHz, so that it tells the interrupt latency in µs
+    halSetupTimer(HAL_TIMER_CONTROL, MSM_TIMER_FREQUENCY, MSM_TIMER_FREQUENCY / 1000u,
+                  &millisecondTimerMSM);
+    ::lastTimerMicro = monotonicMicros();
+    halResumeTimer(HAL_TIMER_CONTROL);
+#endif
+}
+
+#ifdef UNIT_TEST
+void setInnerLoopPeriod(uint32_t p_periodMs) { innerLoopPeriodMs = p_periodMs; }
+#endif
+
+void MainStateMachine::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(isMsmActive);
+    p_archive->enumField(::msmstep);
+    p_archive->enumField(::previousmsmstep);
+    p_archive->field(::clockMsmTimer);
+    p_archive->field(::tick);
+    p_archive->field(::cycleStartClock);
+    p_archive->field(::isCycleChained);
+    p_archive->field(::nextControlTick);
+    p_archive->field(::lastControlTick);
+    p_archive->field(::lastInnerLoopClock);
+    p_archive->field(::lastTimerMicro);
+    p_archive->field(::missedTimerTicks);
+    p_archive->field(::missedControlDeadlines);
+    p_archive->field(::timerPeriodMs);
+    p_archive->field(::lastStoppedMessageClock);
+    p_archive->field(::lastStoppedTickClock);
+    if (p_archive->isRestoring()) {
+        setTimerPeriod(::timerPeriodMs);
+    }
 }
@@ -13,66 +13,70 @@
 // Associated header
 #include "../includes/mass_flow_meter.h"
 
-// External
-#include <Arduino.h>
-#include <HardwareSerial.h>
-#include <IWatchdog.h>
-#include <OneButton.h>
-#include <Wire.h>
-#include <math.h>
-
 // Internal
 #include "../includes/buzzer_control.h"
 #include "../includes/config.h"
+#include "../includes/cpu_load.h"
+#include "../includes/hal.h"
+#include "../includes/interrupt_timing.h"
+#include "../includes/mass_flow_meter_utl.h"
 #include "../includes/parameters.h"
+#include "../includes/sensor_capture.h"
+
+// For the debugging program of the board
+#if MODE == MODE_MFM_TESTS
+#include <HardwareSerial.h>
+#include <OneButton.h>
+
 #include "../includes/screen.h"
+#endif
 
 // INITIALISATION =============================================================
 
-volatile uint16_t MFM_force_release_I2C = MFM_FORCE_RELEASE_I2C_FALSE;
+BOARD_STATE volatile uint16_t MFM_force_release_I2C = MFM_FORCE_RELEASE_I2C_FALSE;
 
 // Hardware is ensured to be at least v2
 #ifdef MASS_FLOW_METER_ENABLED
 
-// 2 kHz => prescaler = 50000 => still OK for a 16 bit timer. it cannnot be slower
-// 10 kHz => nice
-#define MASS_FLOW_TIMER_FREQ 10000
+BOARD_STATE uint32_t mfmHoneywellHafSerialNumber = 0;
 
-// The timer period in 100 us multiple (because 10 kHz prescale)
-#define MASS_FLOW_PERIOD 100
+BOARD_STATE uint32_t mfmSfm3300SerialNumberExpi = 0;
+BOARD_STATE uint32_t mfmSfm3019SerialNumber = 0;
+BOARD_STATE bool isMassFlowTimerSetUp = false;
 
-uint32_t mfmHoneywellHafSerialNumber = 0;
+BOARD_STATE volatile bool mfmFaultCondition = false;
 
-uint32_t mfmSfm3300SerialNumberExpi = 0;
-uint32_t mfmSfm3019SerialNumber = 0;
-HardwareTimer* massFlowTimer = NULL;
-
-volatile bool mfmFaultCondition = false;
+// When true, the acquisition is suspended to save power
+BOARD_STATE volatile bool mfmPaused = false;
 
 // Calibration offset is substracted to MFM instant flow:
 // - before volume integral
 // - before sending MFM_read_airflow result
-volatile int32_t mfmInspiratoryCalibrationOffset = 0;
-volatile int32_t mfmInspiratoryAirVolumeSumMilliliters = 0;
-volatile int32_t mfmInspiratorySensorDetected = 0;
-volatile int32_t mfmInspiratoryInstantAirFlow = 0;
+BOARD_STATE volatile int32_t mfmInspiratoryCalibrationOffset = 0;
+BOARD_STATE volatile int32_t mfmInspiratoryAirVolumeSumMilliliters = 0;
+BOARD_STATE volatile int32_t mfmInspiratorySensorDetected = 0;
+BOARD_STATE volatile int32_t mfmInspiratoryInstantAirFlow = 0;
 
-volatile int32_t mfmExpiratoryCalibrationOffset = 0;
-volatile int32_t mfmExpiratoryAirVolumeSumMilliliters = 0;
-volatile int32_t mfmExpiratorySensorDetected = 0;
-volatile int32_t mfmExpiratoryInstantAirFlow = 0;
+BOARD_STATE volatile int32_t mfmExpiratoryCalibrationOffset = 0;
+BOARD_STATE volatile int32_t mfmExpiratoryAirVolumeSumMilliliters = 0;
+BOARD_STATE volatile int32_t mfmExpiratorySensorDetected = 0;
+BOARD_STATE volatile int32_t mfmExpiratoryInstantAirFlow = 0;
 
 // Size of the table used to compute average
 #define MFM_MEAN_SAMPLES 40
-volatile bool mfmInspiratoryInstantAirFlowRecord = false;
-volatile int32_t mfmInspiratoryInstantAirFlowLastValues[MFM_MEAN_SAMPLES];
+BOARD_STATE volatile bool mfmInspiratoryInstantAirFlowRecord = false;
+BOARD_STATE volatile int32_t mfmInspiratoryInstantAirFlowLastValues[MFM_MEAN_SAMPLES];
 // cppcheck-suppress misra-c2012-5.1
-volatile int16_t mfmInspiratoryInstantAirFlowLastValuesIndex = 0;
+BOARD_STATE volatile int16_t mfmInspiratoryInstantAirFlowLastValuesIndex = 0;
+
+BOARD_STATE int32_t mfmInspiratoryLastValue = 0;
+BOARD_STATE volatile int32_t mfmInspiratoryLastValueFixedFloat = 0;
 
-int32_t mfmInspiratoryLastValue = 0;
-volatile int32_t mfmInspiratoryLastValueFixedFloat = 0;
+BOARD_STATE volatile int32_t mfmExpiratoryLastValueFixedFloat = 0;
 
-volatile int32_t mfmExpiratoryLastValueFixedFloat = 0;
+// Last words read from the flow meters, first byte received as the most significant one
+BOARD_STATE uint16_t mfmInspiratoryLastWord = 0;
+BOARD_STATE uint16_t mfmExpiratoryLastWord = 0;
 
 // Time to reset the sensor after I2C restart, in periods => 100 ms
 // the restart time is 50 ms (warm up time in the datasheet)
@@ -82,12 +86,12 @@ volatile int32_t mfmExpiratoryLastValueFixedFloat = 0;
 #define MFM_WAIT_SOFTRESET_PERIODS 3
 #define MFM_WAIT_READSERIALR1_PERIODS 1
 
-int32_t mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
+BOARD_STATE int32_t mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
 
-uint16_t mfmExpiSFM3300FailCounter = 0;
+BOARD_STATE uint16_t mfmExpiSFM3300FailCounter = 0;
 
 // cppcheck-suppress misra-c2012-19.2 ; union correctly used
-union {
+BOARD_STATE union {
     uint16_t i;
     int16_t si;
     unsigned char c[2];
@@ -96,14 +100,9 @@ union {
 
 // FUNCTIONS ==================================================================
 
-// API update since version 1.9.0 of Arduino_Core_STM32
-#if (STM32_CORE_VERSION < 0x01090000)
-// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
-void MFM_Timer_Callback(HardwareTimer*)  // NOLINT(readability/casting)
-#else
-void MFM_Timer_Callback(void)
-#endif
-{
+/// Read the flow meters once and integrate the volumes
+void mfmAcquireSample(void) {
+
 #if MODE == MODE_MFM_TESTS
     // cppcheck-suppress misra-c2012-12.3
     digitalWrite(PIN_LED_START, HIGH);
@@ -112,31 +111,33 @@ void MFM_Timer_Callback(void)
     if (MFM_force_release_I2C != static_cast<uint16_t>(MFM_FORCE_RELEASE_I2C_TRUE)) {
         if (!mfmFaultCondition) {
 #if MASS_FLOW_METER_SENSOR == MFM_SFM3019
-            Wire.begin();
-            uint8_t readCountbis = Wire.requestFrom(MFM_SFM3019_I2C_ADDRESS, 3);
-            mfmLastData.c[1] = Wire.read();
-            mfmLastData.c[0] = Wire.read();
-            Wire.end();
+            halI2cBegin();
+            uint8_t readCountbis = halI2cRequestFrom(MFM_SFM3019_I2C_ADDRESS, 3);
+            mfmLastData.c[1] = halI2cRead();
+            mfmLastData.c[0] = halI2cRead();
+            halI2cEnd();
             // Hardware reset if not able to read two bytes.
             if (readCountbis != 3u) {
                 mfmFaultCondition = true;
                 mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
                 mfmInspiratoryAirVolumeSumMilliliters = 1000000000;  // 1e9
             }
-            mfmInspiratoryLastValueFixedFloat = (1000 * (mfmLastData.si + 24576)) / 170;
+            mfmInspiratoryLastWord = mfmLastData.i;
+            mfmInspiratoryLastValueFixedFloat =
+                convertInspiratoryFlowSensor(mfmInspiratoryLastWord);
 
 #endif
 #if MASS_FLOW_METER_SENSOR == MFM_HONEYWELL_HAF
 
             // begin() and end() everytime you read... the lib never free buffers if you don't do
             // this.
-            Wire.begin();
-            uint8_t readCount = Wire.requestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
-            mfmLastData.c[0] = Wire.read();
-            mfmLastData.c[1] = Wire.read();
+            halI2cBegin();
+            uint8_t readCount = halI2cRequestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
+            mfmLastData.c[0] = halI2cRead();
+            mfmLastData.c[1] = halI2cRead();
             // Wire.endTransmission() send a new write order followed by a stop. Useless and the
             // sensor often nack it.
-            Wire.end();
+            halI2cEnd();
 
             // Hardware reset if not able to read two bytes.
             if (readCount != 2u) {
@@ -147,16 +148,11 @@ void MFM_Timer_Callback(void)
 
             mfmInspiratoryLastValue = (uint32_t)(mfmLastData.c[1] & 0xFFu);
             mfmInspiratoryLastValue |= (((uint32_t)mfmLastData.c[0]) << 8) & 0x0000FF00u;
+            mfmInspiratoryLastWord = static_cast<uint16_t>(mfmInspiratoryLastValue);
 
-            // Theorical formula: Flow(slpm) = 200*((rawvalue/16384)-0.1)/0.8
-            // float implementation, 1 liter per minute unit
-            // mfmLastValueFloat =
-            //    MFM_RANGE * (((uint32_t)mfmInspiratoryLastValue / 16384.0) - 0.1) / 0.8;
-            // (Output value in SLPM)
-
-            // fixed float implementation, 1 milliliter per minute unit
+            // 1 milliliter per minute unit
             mfmInspiratoryLastValueFixedFloat =
-                (((10 * mfmInspiratoryLastValue) - 16384) * 1526) / 1000;
+                convertInspiratoryFlowSensor(mfmInspiratoryLastWord);
 
             // 100 value per second, 100 slpm during 10 minutes: sum will be 1.2e9. it fits in a
             // int32 int32 max with milliliters = 2e6 liters.
@@ -167,9 +163,9 @@ void MFM_Timer_Callback(void)
             // The sensor (100 SPLM version anyway) tends to output spurrious values located at
             // around 500 SLM, which are obviously not correct. Let's filter them out based on the
             // range of the sensor + 10%.
-            if (mfmInspiratoryLastValueFixedFloat < (MFM_RANGE * 1100)) {
+            if (mfmInspiratoryLastValueFixedFloat < MFM_INSPIRATORY_MAX_FLOW) {
                 mfmInspiratoryInstantAirFlow = mfmInspiratoryLastValueFixedFloat;
-                if (mfmInspiratoryLastValueFixedFloat > 500) {  // less than 0.5 SPLM is noise
+                if (mfmInspiratoryLastValueFixedFloat > MFM_NOISE_FLOW) {  // less is noise
                     mfmInspiratoryAirVolumeSumMilliliters +=
                         (mfmInspiratoryLastValueFixedFloat - mfmInspiratoryCalibrationOffset);
                 }
@@ -191,17 +187,15 @@ void MFM_Timer_Callback(void)
 #if MASS_FLOW_METER_SENSOR_EXPI == MFM_SFM_3300D
             // begin() and end() everytime you read... the lib never free buffers if you don't do
             // this.
-            Wire.begin();
+            halI2cBegin();
             // do not request crc, only two bytes
-            uint8_t readCountExpi = Wire.requestFrom(MFM_SFM_3300D_I2C_ADDRESS, 2);
-            mfmLastData.c[1] = Wire.read();
-            mfmLastData.c[0] = Wire.read();
-            Wire.end();
+            uint8_t readCountExpi = halI2cRequestFrom(MFM_SFM_3300D_I2C_ADDRESS, 2);
+            mfmLastData.c[1] = halI2cRead();
+            mfmLastData.c[0] = halI2cRead();
+            halI2cEnd();
 
-            // conversion in milliter per minute flow: ((int32_t)(mfmLastData.i) - 32768) * 1000 /
-            // 120 but 1000/120 = 8.333. So  *8 and *1/3
-            mfmExpiratoryLastValueFixedFloat =
-                (((int32_t)(mfmLastData.i) - 32768) * 8) + (((int32_t)(mfmLastData.i) - 32768) / 3);
+            // conversion in milliter per minute flow
+            mfmExpiratoryLastValueFixedFloat = convertExpiratoryFlowSensor(mfmLastData.i);
 
             if (readCountExpi != 2u) {
                 mfmExpiSFM3300FailCounter++;
@@ -214,9 +208,10 @@ void MFM_Timer_Callback(void)
                 }
             } else {
                 // valid data
+                mfmExpiratoryLastWord = mfmLastData.i;
                 mfmExpiratoryInstantAirFlow = mfmExpiratoryLastValueFixedFloat;
-                if ((mfmExpiratoryLastValueFixedFloat > 500)
-                    || (mfmExpiratoryLastValueFixedFloat < -500)) {  // less than 0.5 SPLM is noise
+                if ((mfmExpiratoryLastValueFixedFloat > MFM_NOISE_FLOW)
+                    || (mfmExpiratoryLastValueFixedFloat < -MFM_NOISE_FLOW)) {  // less is noise
                     mfmExpiratoryAirVolumeSumMilliliters +=
                         (mfmExpiratoryLastValueFixedFloat - mfmExpiratoryCalibrationOffset);
                 }
@@ -227,57 +222,46 @@ void MFM_Timer_Callback(void)
             if (mfmResetStateMachine == MFM_WAIT_RESET_PERIODS) {
                 // Reset attempt
                 // I2C sensors
-                Wire.flush();
-                Wire.end();
-
-                // Set power off (available since hw3)
-                digitalWrite(MFM_POWER_CONTROL, MFM_POWER_OFF);
-                // also set SDA and SCL to 0 to avoid sensor to be powered by I2C bus.
-                pinMode(PIN_I2C_SDA, OUTPUT);
-                pinMode(PIN_I2C_SCL, OUTPUT);
-                digitalWrite(PIN_I2C_SCL, LOW);
-                __NOP();
-                digitalWrite(PIN_I2C_SDA, LOW);
+                halI2cFlush();
+                halI2cEnd();
+                halWriteFlowMeterPower(false);
             }
 
             mfmResetStateMachine--;
 
             // x period before end of reset cycle, power on again
             if (mfmResetStateMachine == MFM_WAIT_WARMUP_PERIODS) {
-                // Set power on (available since hw v3)
-                digitalWrite(MFM_POWER_CONTROL, MFM_POWER_ON);
-                pinMode(PIN_I2C_SDA, INPUT);
-                pinMode(PIN_I2C_SCL, INPUT);
+                halWriteFlowMeterPower(true);
             }
 
 #if MASS_FLOW_METER_SENSOR == MFM_SFM3019
             if (mfmResetStateMachine == MFM_WAIT_SOFTRESET_PERIODS) {
                 // start air continuous measurement
-                Wire.begin();
-                Wire.beginTransmission(MFM_SFM3019_I2C_ADDRESS);
-                Wire.write(0x36);
-                Wire.write(0x08);
-                mfmFaultCondition = (0 != Wire.endTransmission()) || mfmFaultCondition;
-                Wire.end();
+                halI2cBegin();
+                halI2cBeginTransmission(MFM_SFM3019_I2C_ADDRESS);
+                halI2cWrite(0x36);
+                halI2cWrite(0x08);
+                mfmFaultCondition = (0 != halI2cEndTransmission()) || mfmFaultCondition;
+                halI2cEnd();
             }
 
 #endif
 #if MASS_FLOW_METER_SENSOR == MFM_HONEYWELL_HAF
             if (mfmResetStateMachine == MFM_WAIT_SOFTRESET_PERIODS) {
-                Wire.begin();
-                Wire.beginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
-                Wire.write(0x02);                         // Force reset
-                uint8_t status = Wire.endTransmission();  // actually send the data
-                Wire.end();
+                halI2cBegin();
+                halI2cBeginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
+                halI2cWrite(0x02);                         // Force reset
+                uint8_t status = halI2cEndTransmission();  // actually send the data
+                halI2cEnd();
                 if (status != 0u) {  // still a problem
                     mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
                 }
             }
             if (mfmResetStateMachine == MFM_WAIT_READSERIALR1_PERIODS) {
-                Wire.begin();
+                halI2cBegin();
                 // read first serial number register
-                uint8_t rxcount = Wire.requestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
-                Wire.end();
+                uint8_t rxcount = halI2cRequestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
+                halI2cEnd();
                 if (rxcount != 2u) {  // still a problem
                     mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
                 }
@@ -289,21 +273,21 @@ void MFM_Timer_Callback(void)
                 // MFM_WAIT_RESET_PERIODS cycles later, try again to init the sensor
 
 #if MASS_FLOW_METER_SENSOR == MFM_HONEYWELL_HAF
-                Wire.begin();
+                halI2cBegin();
                 // read second serial number register
-                uint8_t rxcount = Wire.requestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
-                Wire.end();
+                uint8_t rxcount = halI2cRequestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
+                halI2cEnd();
                 mfmFaultCondition = (rxcount != 2u) || mfmFaultCondition;
 #endif
 
 #if MASS_FLOW_METER_SENSOR_EXPI == MFM_SFM_3300D
-                Wire.begin();
-                Wire.beginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
-                Wire.write(0x10);
-                Wire.write(0x00);
-                mfmFaultCondition = (0 != Wire.endTransmission()) || mfmFaultCondition;
+                halI2cBegin();
+                halI2cBeginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
+                halI2cWrite(0x10);
+                halI2cWrite(0x00);
+                mfmFaultCondition = (0 != halI2cEndTransmission()) || mfmFaultCondition;
                 mfmExpiSFM3300FailCounter = 0;
-                Wire.end();
+                halI2cEnd();
 #endif
 
                 if (mfmFaultCondition) {
@@ -312,49 +296,51 @@ void MFM_Timer_Callback(void)
             }
         }
     }
+    sensorCapture.onFlowSample(mfmInspiratoryLastWord, mfmExpiratoryLastWord, mfmFaultCondition);
 #if MODE == MODE_MFM_TESTS
     digitalWrite(PIN_LED_START, LOW);
     digitalWrite(PIN_LED_GREEN, mfmFaultCondition ? HIGH : LOW);
 #endif
 }
 
+void MFM_acquire(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_MFM);
+
+    if (!mfmPaused) {
+        mfmAcquireSample();
+    }
+}
+
+#ifndef RTOS_TASKS
+void MFM_Timer_Callback(void) {
+    // The counter restarted from 0 on the update event, and counts µs
+    interruptTimings[INTERRUPT_TIMING_FLOW_METER].onEntry(halReadTimerCount(HAL_TIMER_FLOW_METER));
+    MFM_acquire();
+}
+#endif
+
 bool MFM_init(void) {
     mfmInspiratoryAirVolumeSumMilliliters = 0;
     // cppcheck-suppress unreadVariable
     uint32_t errorCount = 0;
-    // Set power on (hardware v3)
-    pinMode(MFM_POWER_CONTROL, OUTPUT);
-    digitalWrite(MFM_POWER_CONTROL, MFM_POWER_ON);
-    delay(100);  // sfm3300 worst case boot time.
-
-    // Set the timer
-    massFlowTimer = new HardwareTimer(MASS_FLOW_TIMER);
-
-    // Prescaler; stm32f411 clock is 100 mHz
-    massFlowTimer->setPrescaleFactor((massFlowTimer->getTimerClkFreq() / MASS_FLOW_TIMER_FREQ) - 1);
-
-    // Set the period
-    massFlowTimer->setOverflow(MASS_FLOW_PERIOD);
-    massFlowTimer->setMode(MASS_FLOW_CHANNEL, TIMER_OUTPUT_COMPARE, NC);
-    massFlowTimer->attachInterrupt(MFM_Timer_Callback);
-
-    // Interrupt priority is documented here:
-    // https://stm32f4-discovery.net/2014/05/stm32f4-stm32f429-nvic-or-nested-vector-interrupt-controller/
-    // WARNING : since 1.9.0 lib, I2C is on level 2. must be under...
-    massFlowTimer->setInterruptPriority(3, 0);
-
-    // default Wire instance is on PB8 BP9, anyway
-    Wire.setSDA(PIN_I2C_SDA);
-    Wire.setSCL(PIN_I2C_SCL);
-    // Wire.setClock(400000); // honeywell do support, but no information about sfm3300d
+    initHalFlowMeterBus();
+    halDelay(100);  // sfm3300 worst case boot time.
+
+#ifndef RTOS_TASKS
+    // Set the timer (with RTOS tasks, the acquisition is run by a task instead)
+    // WARNING : since 1.9.0 lib, I2C is on level 2, the timer priority (see hal.cpp) must be under
+    halSetupTimer(HAL_TIMER_FLOW_METER, MASS_FLOW_TIMER_FREQ,
+                  MASS_FLOW_PERIOD * (MASS_FLOW_TIMER_FREQ / 10000), &MFM_Timer_Callback);
+    isMassFlowTimerSetUp = true;
+#endif
 
 #if MASS_FLOW_METER_SENSOR == MFM_SFM3019
-    Wire.begin();
-    Wire.beginTransmission(0x00);
-    Wire.write(0x06);
-    Wire.endTransmission();
-    Wire.end();
-    delay(4);
+    halI2cBegin();
+    halI2cBeginTransmission(0x00);
+    halI2cWrite(0x06);
+    halI2cEndTransmission();
+    halI2cEnd();
+    halDelay(4);
 
     //     // start air continuous measurement
     //     Wire.begin();
@@ -397,16 +383,16 @@ bool MFM_init(void) {
 
     //     Wire.end();
 
-    delay(5);
+    halDelay(5);
     // Read serial number
-    Wire.begin();
-    Wire.beginTransmission(MFM_SFM3019_I2C_ADDRESS);
-    Wire.write(0xE1);
-    Wire.write(0x02);
-    errorCount = Wire.endTransmission();
-
-    delay(1);
-    errorCount += ((18u == Wire.requestFrom(MFM_SFM3019_I2C_ADDRESS, 18)) ? 0u : 1u);
+    halI2cBegin();
+    halI2cBeginTransmission(MFM_SFM3019_I2C_ADDRESS);
+    halI2cWrite(0xE1);
+    halI2cWrite(0x02);
+    errorCount = halI2cEndTransmission();
+
+    halDelay(1);
+    errorCount += ((18u == halI2cRequestFrom(MFM_SFM3019_I2C_ADDRESS, 18)) ? 0u : 1u);
     if (errorCount == 0u) {
         // the serial number is 64 bits wide, but it will never be used until year 2042.
         // The serial number can be converted from binary into decimal,
@@ -415,41 +401,41 @@ bool MFM_init(void) {
         // calibration week, xxxxxx: unique 6-digit sequential number
         // within the calibration week.
         uint32_t sn_inspi = 0;
-        Wire.read();
-        Wire.read();  // product number part 1
-        Wire.read();  // crc
-        Wire.read();
-        Wire.read();  // product number part 2
-        Wire.read();  // crc
-
-        Wire.read();
-        Wire.read();  // ignore this part of serial
-        Wire.read();  // ignore inlined crc
-        Wire.read();
-        Wire.read();  // ignore this part of serial
-        Wire.read();  // ignore inlined crc
-        sn_inspi |= Wire.read();
+        halI2cRead();
+        halI2cRead();  // product number part 1
+        halI2cRead();  // crc
+        halI2cRead();
+        halI2cRead();  // product number part 2
+        halI2cRead();  // crc
+
+        halI2cRead();
+        halI2cRead();  // ignore this part of serial
+        halI2cRead();  // ignore inlined crc
+        halI2cRead();
+        halI2cRead();  // ignore this part of serial
+        halI2cRead();  // ignore inlined crc
+        sn_inspi |= halI2cRead();
         sn_inspi <<= 8;
-        sn_inspi |= Wire.read();
+        sn_inspi |= halI2cRead();
         sn_inspi <<= 8;
-        Wire.read();  // ignore inlined crc
-        sn_inspi |= Wire.read();
+        halI2cRead();  // ignore inlined crc
+        sn_inspi |= halI2cRead();
         sn_inspi <<= 8;
-        sn_inspi |= Wire.read();
-        Wire.read();  // ignore inlined crc
+        sn_inspi |= halI2cRead();
+        halI2cRead();  // ignore inlined crc
         mfmSfm3019SerialNumber = sn_inspi;
     }
-    delay(1);
+    halDelay(1);
 
     // start air continuous measurement
-    Wire.begin();
-    Wire.beginTransmission(MFM_SFM3019_I2C_ADDRESS);
-    Wire.write(0x36);
-    Wire.write(0x08);
-    errorCount += Wire.endTransmission();
-    Wire.end();
-
-    delay(40);  // the first measurement result will be available after 12ms
+    halI2cBegin();
+    halI2cBeginTransmission(MFM_SFM3019_I2C_ADDRESS);
+    halI2cWrite(0x36);
+    halI2cWrite(0x08);
+    errorCount += halI2cEndTransmission();
+    halI2cEnd();
+
+    halDelay(40);  // the first measurement result will be available after 12ms
     // small accuracy deviations (few % of reading) can occur during the first 30ms
 
     // delay(10000);
@@ -460,39 +446,39 @@ bool MFM_init(void) {
 #endif
 
 #if MASS_FLOW_METER_SENSOR_EXPI == MFM_SFM_3300D
-    Wire.begin();  // Join I2C bus (address is optional for master)
-    Wire.beginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
-    Wire.write(0x20);  // 0x2000 soft reset
-    Wire.write(0x00);
-    errorCount = Wire.endTransmission();
-    delay(5);  // end of reset
-
-    Wire.beginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
-    Wire.write(0x31);  // 0x31AE read serial
-    Wire.write(0xAE);
-    errorCount += Wire.endTransmission();
-
-    errorCount += ((6u == Wire.requestFrom(MFM_SFM_3300D_I2C_ADDRESS, 6)) ? 0u : 1u);
+    halI2cBegin();  // Join I2C bus (address is optional for master)
+    halI2cBeginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
+    halI2cWrite(0x20);  // 0x2000 soft reset
+    halI2cWrite(0x00);
+    errorCount = halI2cEndTransmission();
+    halDelay(5);  // end of reset
+
+    halI2cBeginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
+    halI2cWrite(0x31);  // 0x31AE read serial
+    halI2cWrite(0xAE);
+    errorCount += halI2cEndTransmission();
+
+    errorCount += ((6u == halI2cRequestFrom(MFM_SFM_3300D_I2C_ADDRESS, 6)) ? 0u : 1u);
     if (errorCount == 0u) {
         u_int32_t sn_expi = 0;
-        sn_expi = Wire.read();
+        sn_expi = halI2cRead();
         sn_expi <<= 8;
-        sn_expi |= Wire.read();
+        sn_expi |= halI2cRead();
         sn_expi <<= 8;
-        Wire.read();  // ignore inlined crc
-        sn_expi |= Wire.read();
+        halI2cRead();  // ignore inlined crc
+        sn_expi |= halI2cRead();
         sn_expi <<= 8;
-        sn_expi |= Wire.read();
-        Wire.read();  // ignore inlined crc
+        sn_expi |= halI2cRead();
+        halI2cRead();  // ignore inlined crc
         mfmSfm3300SerialNumberExpi = sn_expi;
     }
-    delay(10);
-    Wire.beginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
-    Wire.write(0x10);  // 0x1000 start measurement
-    Wire.write(0x00);
-    errorCount += Wire.endTransmission();
-    Wire.end();
-    delay(100);  // wait 100ms before having available data.
+    halDelay(10);
+    halI2cBeginTransmission(MFM_SFM_3300D_I2C_ADDRESS);
+    halI2cWrite(0x10);  // 0x1000 start measurement
+    halI2cWrite(0x00);
+    errorCount += halI2cEndTransmission();
+    halI2cEnd();
+    halDelay(100);  // wait 100ms before having available data.
 
     if (errorCount != 0u) {
         mfmFaultCondition = true;
@@ -510,26 +496,26 @@ bool MFM_init(void) {
     Subsequent read operations: the sensor will send calibrated mass air flow values with two
     leading 0
     */
-    Wire.begin();
-    Wire.beginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
-    Wire.write(0x02);  // Force reset
-    uint8_t txOk = Wire.endTransmission();
-    Wire.end();
-    delay(30);
+    halI2cBegin();
+    halI2cBeginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
+    halI2cWrite(0x02);  // Force reset
+    uint8_t txOk = halI2cEndTransmission();
+    halI2cEnd();
+    halDelay(30);
 
     u_int32_t sn = 0;
-    Wire.begin();
-    Wire.beginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
-    uint8_t rxcount = Wire.requestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
-    sn = Wire.read();
+    halI2cBegin();
+    halI2cBeginTransmission(MFM_HONEYWELL_HAF_I2C_ADDRESS);
+    uint8_t rxcount = halI2cRequestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
+    sn = halI2cRead();
     sn <<= 8;
-    sn |= Wire.read();  // first transmission is serial number register 0
+    sn |= halI2cRead();  // first transmission is serial number register 0
     sn <<= 8;
-    delay(2);  // if you do not wait, sensor will send again register 0
-    rxcount += Wire.requestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
-    sn |= Wire.read();
+    halDelay(2);  // if you do not wait, sensor will send again register 0
+    rxcount += halI2cRequestFrom(MFM_HONEYWELL_HAF_I2C_ADDRESS, 2);
+    sn |= halI2cRead();
     sn <<= 8;
-    sn |= Wire.read();  // second transmission is serial number register 1
+    sn |= halI2cRead();  // second transmission is serial number register 1
 
     if ((txOk != 0u) || (rxcount != 4u)) {  // If transmission failed
         mfmFaultCondition = true;
@@ -537,7 +523,7 @@ bool MFM_init(void) {
     } else {
         mfmHoneywellHafSerialNumber = sn;
     }
-    Wire.end();
+    halI2cEnd();
 
 #if MODE == MODE_MFM_TESTS
     Serial.println("Read 1");
@@ -545,10 +531,12 @@ bool MFM_init(void) {
     Serial.println("fault condition:");
     Serial.println(mfmFaultCondition ? "failure" : "no failure");
 #endif
-    delay(100);
+    halDelay(100);
 #endif
 
-    massFlowTimer->resume();
+#ifndef RTOS_TASKS
+    halResumeTimer(HAL_TIMER_FLOW_METER);
+#endif
     return !mfmFaultCondition;
 }
 
@@ -573,6 +561,26 @@ int32_t MFM_expi_read_airflow(void) {
     return r;
 }
 
+void MFM_pause(void) {
+    mfmPaused = true;
+#ifndef RTOS_TASKS
+    if (isMassFlowTimerSetUp) {
+        halPauseTimer(HAL_TIMER_FLOW_METER);
+    }
+#endif
+}
+
+void MFM_resume(void) {
+#ifndef RTOS_TASKS
+    // The first period after the pause is not a sample of the jitter
+    interruptTimings[INTERRUPT_TIMING_FLOW_METER].setNominalPeriod(10000u);
+    if (isMassFlowTimerSetUp) {
+        halResumeTimer(HAL_TIMER_FLOW_METER);
+    }
+#endif
+    mfmPaused = false;
+}
+
 void MFM_reset(void) { mfmInspiratoryAirVolumeSumMilliliters = 0; }
 
 void MFM_expi_reset(void) { mfmExpiratoryAirVolumeSumMilliliters = 0; }
@@ -607,7 +615,7 @@ int8_t MFM_calibrateZero(void) {
     mfmInspiratoryInstantAirFlowLastValuesIndex = 0;
     mfmInspiratoryInstantAirFlowRecord = true;
     // wait for the table to fill in
-    delay(2 + (MFM_MEAN_SAMPLES * (MASS_FLOW_PERIOD / 10)));
+    halDelay(2 + (MFM_MEAN_SAMPLES * (MASS_FLOW_PERIOD / 10)));
     // Check that table is full (record must be false)
     // If it is not, there is a sensor problem
     // In case of problem, do not update mfmInspiratoryCalibrationOffset
@@ -666,6 +674,71 @@ int32_t MFM_expi_read_milliliters(bool reset_after_read) {
     return result;
 }
 
+void MFM_checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(mfmFaultCondition);
+    p_archive->field(mfmPaused);
+    p_archive->field(mfmInspiratoryCalibrationOffset);
+    p_archive->field(mfmInspiratoryAirVolumeSumMilliliters);
+    p_archive->field(mfmInspiratoryInstantAirFlow);
+    p_archive->field(mfmExpiratoryCalibrationOffset);
+    p_archive->field(mfmExpiratoryAirVolumeSumMilliliters);
+    p_archive->field(mfmExpiratoryInstantAirFlow);
+    p_archive->field(mfmInspiratoryInstantAirFlowRecord);
+    p_archive->field(mfmInspiratoryInstantAirFlowLastValues);
+    p_archive->field(mfmInspiratoryInstantAirFlowLastValuesIndex);
+    p_archive->field(mfmInspiratoryLastValue);
+    p_archive->field(mfmInspiratoryLastValueFixedFloat);
+    p_archive->field(mfmExpiratoryLastValueFixedFloat);
+    p_archive->field(mfmInspiratoryLastWord);
+    p_archive->field(mfmExpiratoryLastWord);
+    p_archive->field(mfmResetStateMachine);
+    p_archive->field(mfmExpiSFM3300FailCounter);
+}
+
+#ifdef UNIT_TEST
+void MFM_resetState(void) {
+    MFM_force_release_I2C = MFM_FORCE_RELEASE_I2C_FALSE;
+    mfmHoneywellHafSerialNumber = 0;
+    mfmSfm3300SerialNumberExpi = 0;
+    mfmSfm3019SerialNumber = 0;
+    isMassFlowTimerSetUp = false;
+    mfmFaultCondition = false;
+    mfmPaused = false;
+    mfmInspiratoryCalibrationOffset = 0;
+    mfmInspiratoryAirVolumeSumMilliliters = 0;
+    mfmInspiratoryInstantAirFlow = 0;
+    mfmExpiratoryCalibrationOffset = 0;
+    mfmExpiratoryAirVolumeSumMilliliters = 0;
+    mfmExpiratoryInstantAirFlow = 0;
+    mfmInspiratoryInstantAirFlowRecord = false;
+    for (int16_t i = 0; i < MFM_MEAN_SAMPLES; i++) {
+        mfmInspiratoryInstantAirFlowLastValues[i] = 0;
+    }
+    mfmInspiratoryInstantAirFlowLastValuesIndex = 0;
+    mfmInspiratoryLastValue = 0;
+    mfmInspiratoryLastValueFixedFloat = 0;
+    mfmExpiratoryLastValueFixedFloat = 0;
+    mfmInspiratoryLastWord = 0;
+    mfmExpiratoryLastWord = 0;
+    mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
+    mfmExpiSFM3300FailCounter = 0;
+}
+
+void MFM_setOffset(int32_t p_offset) { mfmInspiratoryCalibrationOffset = p_offset; }
+
+void MFM_setFaultCondition(bool p_fault) {
+    if (p_fault && !mfmFaultCondition) {
+        mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
+    }
+    if (!p_fault && mfmFaultCondition) {
+        halWriteFlowMeterPower(true);
+        mfmResetStateMachine = MFM_WAIT_RESET_PERIODS;
+        mfmExpiSFM3300FailCounter = 0;
+    }
+    mfmFaultCondition = p_fault;
+}
+#endif
+
 #if MODE == MODE_MFM_TESTS
 
 void onStartClick() {
@@ -0,0 +1,94 @@
+/******************************************************************************
+ * @file mass_flow_meter_utl.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Mass flow meter computing utility functions
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+#include "../includes/mass_flow_meter_utl.h"
+
+// FUNCTIONS ==================================================================
+
+#if MASS_FLOW_METER_SENSOR == MFM_SFM3019
+// The word is a signed value
+static const int32_t INSPIRATORY_SENSOR_MIN = -32768;
+static const int32_t INSPIRATORY_SENSOR_MAX = 32767;
+
+static int32_t inspiratorySensorValue(uint16_t p_sensorWord) {
+    return static_cast<int16_t>(p_sensorWord);
+}
+
+static int32_t inspiratoryFlow(int32_t p_sensorValue) {
+    return (1000 * (p_sensorValue + 24576)) / 170;
+}
+#else
+// Honeywell HAF: the 2 high bits of the 16 bits word are status bits, at 0 on a valid measure
+static const int32_t INSPIRATORY_SENSOR_MIN = 0;
+static const int32_t INSPIRATORY_SENSOR_MAX = 0x3FFF;
+
+static int32_t inspiratorySensorValue(uint16_t p_sensorWord) { return p_sensorWord; }
+
+// Theorical formula: Flow(slpm) = 200*((rawvalue/16384)-0.1)/0.8
+// fixed float implementation, 1 milliliter per minute unit
+static int32_t inspiratoryFlow(int32_t p_sensorValue) {
+    return (((10 * p_sensorValue) - 16384) * 1526) / 1000;
+}
+#endif
+
+// SFM3300-D: offset binary word
+static const int32_t EXPIRATORY_SENSOR_MIN = 0;
+static const int32_t EXPIRATORY_SENSOR_MAX = 0xFFFF;
+
+// conversion in milliter per minute flow: (word - 32768) * 1000 / 120
+// but 1000/120 = 8.333. So  *8 and *1/3
+static int32_t expiratoryFlow(int32_t p_sensorValue) {
+    return ((p_sensorValue - 32768) * 8) + ((p_sensorValue - 32768) / 3);
+}
+
+/**
+ * Find the smallest value of a sensor that reaches a flow, by bisection
+ *
+ * @param p_convert Conversion of the sensor, non-decreasing
+ * @param p_min Smallest value of the sensor
+ * @param p_max Largest value of the sensor
+ * @param p_flow Flow in mL/min
+ * @return The value, or p_max when the flow is out of the range of the sensor
+ */
+static int32_t smallestSensorValue(int32_t (*p_convert)(int32_t),
+                                   int32_t p_min,
+                                   int32_t p_max,
+                                   int32_t p_flow) {
+    int32_t low = p_min;
+    int32_t high = p_max;
+    while (low < high) {
+        int32_t middle = low + ((high - low) / 2);
+        if (p_convert(middle) >= p_flow) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+int32_t convertInspiratoryFlowSensor(uint16_t p_sensorWord) {
+    return inspiratoryFlow(inspiratorySensorValue(p_sensorWord));
+}
+
+int32_t convertExpiratoryFlowSensor(uint16_t p_sensorWord) {
+    return expiratoryFlow(p_sensorWord);
+}
+
+// cppcheck-suppress unusedFunction
+uint16_t convertInspiratoryFlow2Sensor(int32_t p_flow) {
+    return static_cast<uint16_t>(smallestSensorValue(&inspiratoryFlow, INSPIRATORY_SENSOR_MIN,
+                                                     INSPIRATORY_SENSOR_MAX, p_flow));
+}
+
+// cppcheck-suppress unusedFunction
+uint16_t convertExpiratoryFlow2Sensor(int32_t p_flow) {
+    return static_cast<uint16_t>(
+        smallestSensorValue(&expiratoryFlow, EXPIRATORY_SENSOR_MIN, EXPIRATORY_SENSOR_MAX, p_flow));
+}
@@ -11,21 +11,20 @@
 #include "../includes/pc_ac_controller.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
 
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/pressure_valve.h"
-
-// INITIALISATION =============================================================
-
-PC_AC_Controller pcAcController;
+#include "../includes/ventilator_context.h"
 
 // FUNCTIONS ==================================================================
 
 void PC_AC_Controller::exhale() {
+    MainController& mainController = context().mainController;
+
     PC_CMV_Controller::exhale();
 
     // Calculate max pressure for the last samples
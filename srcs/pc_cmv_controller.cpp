@@ -11,22 +11,24 @@
 #include "../includes/pc_cmv_controller.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
 
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/pressure_valve.h"
-
-// INITIALISATION =============================================================
-
-PC_CMV_Controller pcCmvController;
+#include "../includes/ventilator_context.h"
 
 // FUNCTIONS ==================================================================
 
 // cppcheck-suppress misra-c2012-5.2 ; false positive
-PC_CMV_Controller::PC_CMV_Controller() {
+PC_CMV_Controller::PC_CMV_Controller(VentilatorContext* p_context)
+    : VentilationController(p_context) {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     m_inspiratoryValveLastAperture = inspiratoryValve.maxAperture();
     m_expiratoryValveLastAperture = expiratoryValve.maxAperture();
     m_plateauPressureReached = false;
@@ -45,13 +47,21 @@ PC_CMV_Controller::PC_CMV_Controller() {
     m_inspiratoryPidLastError = 0;
     m_expiratoryPidFastMode = true;
     m_inspiratoryPidFastMode = true;
+    m_inspiratoryPidFastModeDuration = 0;
+    m_expiratoryPidFastModeDuration = 0;
     m_expiratoryPidIntegral = 0;
     m_expiratoryPidLastError = 0;
+    m_tuning = PC_CMV_DEFAULT_TUNING;
 }
 
 void PC_CMV_Controller::setup() { m_blowerSpeed = DEFAULT_BLOWER_SPEED; }
 
 void PC_CMV_Controller::initCycle() {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     m_plateauPressureReached = false;
     m_plateauStartTime = mainController.ticksPerInhalation();
 
@@ -68,6 +78,8 @@ void PC_CMV_Controller::initCycle() {
         mainController.peepCommand() - mainController.plateauPressureCommand();
     m_inspiratoryPidFastMode = true;
     m_expiratoryPidFastMode = true;
+    m_inspiratoryPidFastModeDuration = 0;
+    m_expiratoryPidFastModeDuration = 0;
     for (uint8_t i = 0; i < PC_NUMBER_OF_SAMPLE_DERIVATIVE_MOVING_MEAN; i++) {
         m_inspiratoryPidLastErrors[i] = 0;
         m_expiratoryPidLastErrors[i] =
@@ -92,12 +104,9 @@ void PC_CMV_Controller::initCycle() {
 }
 
 void PC_CMV_Controller::inhale() {
-    // Keep the inspiratory valve open using a PID
-    int32_t inspiratoryPidValue = PCinspiratoryPID(mainController.pressureCommand(),
-                                                   mainController.pressure(), mainController.dt());
+    MainController& mainController = context().mainController;
 
-    inspiratoryValve.open(inspiratoryPidValue);
-    expiratoryValve.close();
+    // Valves are regulated in inhaleInnerLoop()
 
     // m_plateauStartTime is used for blower regulations, -5 is added to help blower convergence
     if ((mainController.pressure() > (mainController.plateauPressureCommand() - 5))
@@ -108,49 +117,86 @@ void PC_CMV_Controller::inhale() {
 }
 
 void PC_CMV_Controller::exhale() {
+    // Valves are regulated in exhaleInnerLoop()
+}
+
+void PC_CMV_Controller::inhaleInnerLoop(int32_t p_dt) {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
+    // Keep the inspiratory valve open using a PID
+    int32_t inspiratoryPidValue =
+        PCinspiratoryPID(mainController.pressureCommand(), mainController.pressure(), p_dt);
+
+    inspiratoryValve.open(inspiratoryPidValue);
+    expiratoryValve.close();
+}
+
+void PC_CMV_Controller::exhaleInnerLoop(int32_t p_dt) {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     // Close the inspiratory valve
     inspiratoryValve.close();
 
     // Open the expiratos valve so the patient can exhale outside
-    expiratoryValve.open(PCexpiratoryPID(mainController.pressureCommand(),
-                                         mainController.pressure(), mainController.dt()));
+    expiratoryValve.open(
+        PCexpiratoryPID(mainController.pressureCommand(), mainController.pressure(), p_dt));
 }
 
 void PC_CMV_Controller::endCycle() { calculateBlowerIncrement(); }
 
 void PC_CMV_Controller::calculateBlowerIncrement() {
+    MainController& mainController = context().mainController;
+
     int16_t peakDelta =
         mainController.peakPressureMeasure() - mainController.plateauPressureCommand();
 
-    // Number of tick for the half ramp (120 ms)
+    // Number of tick for the half ramp (120 ms by default)
     int32_t halfRampNumberfTick =
-        1000 * 120 / static_cast<int32_t>(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS);
+        1000 * m_tuning.blowerHalfRampMs
+        / static_cast<int32_t>(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS);
+
+    // Parts of the inspiration, in ticks
+    uint32_t ticksPerInhalation = mainController.ticksPerInhalation();
+    uint32_t earlyPlateauTicks =
+        (ticksPerInhalation * static_cast<uint32_t>(m_tuning.blowerEarlyPlateauPercent)) / 100u;
+    uint32_t overshootTicks =
+        (ticksPerInhalation * static_cast<uint32_t>(m_tuning.blowerOvershootPercent)) / 100u;
+    uint32_t holdTicks =
+        (ticksPerInhalation * static_cast<uint32_t>(m_tuning.blowerHoldPercent)) / 100u;
+    uint32_t smallStepTicks =
+        (ticksPerInhalation * static_cast<uint32_t>(m_tuning.blowerSmallStepPercent)) / 100u;
+    uint32_t mediumStepTicks =
+        (ticksPerInhalation * static_cast<uint32_t>(m_tuning.blowerMediumStepPercent)) / 100u;
 
     // Update blower only if patient is plugged on the machine
     if (mainController.peakPressureMeasure() > 20) {
-        if (m_plateauStartTime < ((mainController.ticksPerInhalation() * 30u) / 100u)) {
+        if (m_plateauStartTime < earlyPlateauTicks) {
             // Only case for decreasing the blower: ramping is too fast or overshooting is too high
             if ((m_plateauStartTime < static_cast<uint32_t>(abs(halfRampNumberfTick)))
-                || ((peakDelta > 15)
-                    && (m_plateauStartTime < ((mainController.ticksPerInhalation() * 20u) / 100u)))
-                || (peakDelta > 25)) {
-                m_blowerIncrement = -100;
+                || ((peakDelta > m_tuning.blowerSmallOvershoot)
+                    && (m_plateauStartTime < overshootTicks))
+                || (peakDelta > m_tuning.blowerLargeOvershoot)) {
+                m_blowerIncrement = -m_tuning.blowerDecrement;
                 DBG_DO(Serial.println("BLOWER -100");)
             } else {
                 m_blowerIncrement = 0;
                 DBG_DO(Serial.println("BLOWER 0");)
             }
-        } else if (m_plateauStartTime < ((mainController.ticksPerInhalation() * 40u) / 100u)) {
+        } else if (m_plateauStartTime < holdTicks) {
             DBG_DO(Serial.println("BLOWER +0");)
             m_blowerIncrement = 0;
-        } else if (m_plateauStartTime < ((mainController.ticksPerInhalation() * 50u) / 100u)) {
-            m_blowerIncrement = +25;
+        } else if (m_plateauStartTime < smallStepTicks) {
+            m_blowerIncrement = m_tuning.blowerSmallIncrement;
             DBG_DO(Serial.println("BLOWER +25"));
-        } else if (m_plateauStartTime < ((mainController.ticksPerInhalation() * 60u) / 100u)) {
-            m_blowerIncrement = +50;
+        } else if (m_plateauStartTime < mediumStepTicks) {
+            m_blowerIncrement = m_tuning.blowerMediumIncrement;
             DBG_DO(Serial.println("BLOWER +50"));
         } else {
-            m_blowerIncrement = +100;
+            m_blowerIncrement = m_tuning.blowerLargeIncrement;
             DBG_DO(Serial.println("BLOWER +100"));
         }
     }
@@ -161,6 +207,8 @@ void PC_CMV_Controller::calculateBlowerIncrement() {
 
 int32_t
 PC_CMV_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPressure, int32_t dt) {
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+
     int32_t minAperture = inspiratoryValve.minAperture();
     int32_t maxAperture = inspiratoryValve.maxAperture();
     int32_t inspiratoryValveAperture;
@@ -181,12 +229,12 @@ PC_CMV_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPress
 
     // Windowing (it overrides the parameter.h coefficients)
     if (error < 0) {
-        coefficientI = 200;
-        coefficientP = 2500;
+        coefficientI = m_tuning.inspiratoryKiAbove;
+        coefficientP = m_tuning.inspiratoryKp;
         coefficientD = 0;
     } else {
-        coefficientI = 50;
-        coefficientP = 2500;
+        coefficientI = m_tuning.inspiratoryKiBelow;
+        coefficientP = m_tuning.inspiratoryKp;
         coefficientD = 0;
     }
 
@@ -209,10 +257,11 @@ PC_CMV_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPress
         if (m_inspiratoryPidFastMode) {
             proportionnalWeight = (coefficientP * error) / 1000;
             derivativeWeight = (coefficientD * derivative / 1000);
-            m_inspiratoryPidIntegral = 1000
-                                           * ((int32_t)m_inspiratoryValveLastAperture - maxAperture)
-                                           / (minAperture - maxAperture)
-                                       - (proportionnalWeight + derivativeWeight);
+            m_inspiratoryPidIntegral =
+                PC_PID_INTEGRAL_RESOLUTION
+                * (1000 * ((int32_t)m_inspiratoryValveLastAperture - maxAperture)
+                       / (minAperture - maxAperture)
+                   - (proportionnalWeight + derivativeWeight));
         }
         m_inspiratoryPidFastMode = false;
     }
@@ -220,25 +269,26 @@ PC_CMV_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPress
     // In fast mode: everything is openned (open loop)
     if (m_inspiratoryPidFastMode) {
         // Ramp from 125 to 0 angle during 250 ms
-        int32_t increment =
-            (5 * static_cast<int32_t>(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS)) / 10000;
-        if (m_inspiratoryValveLastAperture >= abs(increment)) {
-            inspiratoryValveAperture =
-                max(minAperture, min(maxAperture, m_inspiratoryValveLastAperture - increment));
-        } else {
-            inspiratoryValveAperture = 0;
-        }
+        // It is computed from the time spent in fast mode, because at 1 kHz the increment
+        // per call would be less than 1 degree
+        m_inspiratoryPidFastModeDuration += dt;
+        int32_t rampAperture = maxAperture - ((5 * m_inspiratoryPidFastModeDuration) / 10000);
+        inspiratoryValveAperture = max(minAperture, min(maxAperture, rampAperture));
     } else {  // If not in fast mode, the PID is used
         derivative = ((dt == 0)) ? 0 : ((1000000 * (m_inspiratoryPidLastError - smoothError)) / dt);
 
+        // The integral is kept at a finer resolution than the command, so that a small error
+        // still adds up over 1 ms steps
         temporarym_inspiratoryPidIntegral =
-            m_inspiratoryPidIntegral + ((coefficientI * error * dt) / 1000000);
+            m_inspiratoryPidIntegral
+            + ((coefficientI * error * dt) / (1000000 / PC_PID_INTEGRAL_RESOLUTION));
         temporarym_inspiratoryPidIntegral =
-            max(PID_BLOWER_INTEGRAL_MIN,
-                min(PID_BLOWER_INTEGRAL_MAX, temporarym_inspiratoryPidIntegral));
+            max(PID_BLOWER_INTEGRAL_MIN * PC_PID_INTEGRAL_RESOLUTION,
+                min(PID_BLOWER_INTEGRAL_MAX * PC_PID_INTEGRAL_RESOLUTION,
+                    temporarym_inspiratoryPidIntegral));
 
         proportionnalWeight = ((coefficientP * error) / 1000);
-        int32_t integralWeight = temporarym_inspiratoryPidIntegral;
+        int32_t integralWeight = temporarym_inspiratoryPidIntegral / PC_PID_INTEGRAL_RESOLUTION;
         derivativeWeight = coefficientD * derivative / 1000;
 
         int32_t blowerCommand = proportionnalWeight + integralWeight + derivativeWeight;
@@ -260,6 +310,9 @@ PC_CMV_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPress
 
 int32_t
 PC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressure, int32_t dt) {
+    MainController& mainController = context().mainController;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     int32_t minAperture = expiratoryValve.minAperture();
     int32_t maxAperture = expiratoryValve.maxAperture();
     int32_t expiratoryValveAperture;
@@ -293,20 +346,24 @@ PC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressu
 
     // Windowing (it overrides the parameter.h coefficients)
     if (error < 0) {
-        coefficientI = 50;
-        coefficientP = 2500;
+        coefficientI = m_tuning.expiratoryKiAbove;
+        coefficientP = m_tuning.expiratoryKp;
         coefficientD = 0;
     } else {
         // For a high PEEP, a lower KI is required
-        // For PEEP = 100 mmH2O, KI = 120
-        // For PEEP = 50 mmH2O, KI = 250
+        // For PEEP = 100 mmH2O, KI = 120 by default
+        // For PEEP = 50 mmH2O, KI = 250 by default
         if (mainController.peepCommand() > 100) {
-            coefficientI = 120;
+            coefficientI = m_tuning.expiratoryKiHighPeep;
         } else {
-            coefficientI = ((-130 * ((int32_t)mainController.peepCommand())) / 50) + 380;
+            coefficientI =
+                (((m_tuning.expiratoryKiHighPeep - m_tuning.expiratoryKiLowPeep)
+                  * ((int32_t)mainController.peepCommand()))
+                 / 50)
+                + ((2 * m_tuning.expiratoryKiLowPeep) - m_tuning.expiratoryKiHighPeep);
         }
 
-        coefficientP = 2500;
+        coefficientP = m_tuning.expiratoryKp;
         coefficientD = 0;
     }
 
@@ -316,9 +373,11 @@ PC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressu
         if (m_expiratoryPidFastMode) {
             proportionnalWeight = (coefficientP * error) / 1000;
             derivativeWeight = (coefficientD * derivative / 1000);
-            m_expiratoryPidIntegral = 1000 * ((int32_t)m_expiratoryValveLastAperture - maxAperture)
-                                          / (maxAperture - minAperture)
-                                      - (proportionnalWeight + derivativeWeight);
+            m_expiratoryPidIntegral =
+                PC_PID_INTEGRAL_RESOLUTION
+                * (1000 * ((int32_t)m_expiratoryValveLastAperture - maxAperture)
+                       / (maxAperture - minAperture)
+                   - (proportionnalWeight + derivativeWeight));
         }
         m_expiratoryPidFastMode = false;
     }
@@ -326,23 +385,20 @@ PC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressu
     // Fast mode: open loop with ramp
     if (m_expiratoryPidFastMode) {
         // Ramp from 125 to 0 angle during 250 ms
-        int32_t increment =
-            (5 * static_cast<int32_t>(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS)) / 10000;
-        if (m_expiratoryValveLastAperture >= abs(increment)) {
-            expiratoryValveAperture =
-                max(minAperture, min(maxAperture, m_expiratoryValveLastAperture - increment));
-        } else {
-            expiratoryValveAperture = 0;
-        }
+        m_expiratoryPidFastModeDuration += dt;
+        int32_t rampAperture = maxAperture - ((5 * m_expiratoryPidFastModeDuration) / 10000);
+        expiratoryValveAperture = max(minAperture, min(maxAperture, rampAperture));
     } else {  // If not in fast mode, the PID is used
         temporarym_expiratoryPidIntegral =
-            m_expiratoryPidIntegral + ((coefficientI * error * dt) / 1000000);
+            m_expiratoryPidIntegral
+            + ((coefficientI * error * dt) / (1000000 / PC_PID_INTEGRAL_RESOLUTION));
         temporarym_expiratoryPidIntegral =
-            max(PID_PATIENT_INTEGRAL_MIN,
-                min(PID_PATIENT_INTEGRAL_MAX, temporarym_expiratoryPidIntegral));
+            max(PID_PATIENT_INTEGRAL_MIN * PC_PID_INTEGRAL_RESOLUTION,
+                min(PID_PATIENT_INTEGRAL_MAX * PC_PID_INTEGRAL_RESOLUTION,
+                    temporarym_expiratoryPidIntegral));
 
         proportionnalWeight = ((coefficientP * error) / 1000);
-        int32_t integralWeight = temporarym_expiratoryPidIntegral;
+        int32_t integralWeight = temporarym_expiratoryPidIntegral / PC_PID_INTEGRAL_RESOLUTION;
         derivativeWeight = coefficientD * derivative / 1000;
 
         int32_t patientCommand = proportionnalWeight + integralWeight + derivativeWeight;
@@ -362,3 +418,24 @@ PC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressu
 
     return expiratoryValveAperture;
 }
+
+void PC_CMV_Controller::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(m_plateauStartTime);
+    p_archive->field(m_plateauPressureReached);
+    p_archive->field(m_blowerSpeed);
+    p_archive->field(m_blowerIncrement);
+    p_archive->field(m_inspiratoryPidIntegral);
+    p_archive->field(m_expiratoryPidFastMode);
+    p_archive->field(m_inspiratoryPidFastMode);
+    p_archive->field(m_inspiratoryPidFastModeDuration);
+    p_archive->field(m_expiratoryPidFastModeDuration);
+    p_archive->field(m_expiratoryPidIntegral);
+    p_archive->field(m_inspiratoryValveLastAperture);
+    p_archive->field(m_expiratoryValveLastAperture);
+    p_archive->field(m_expiratoryPidLastError);
+    p_archive->field(m_expiratoryPidLastErrors);
+    p_archive->field(m_expiratoryPidLastErrorsIndex);
+    p_archive->field(m_inspiratoryPidLastError);
+    p_archive->field(m_inspiratoryPidLastErrors);
+    p_archive->field(m_inspiratoryPidLastErrorsIndex);
+}
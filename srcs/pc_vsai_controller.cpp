@@ -11,21 +11,23 @@
 #include "../includes/pc_vsai_controller.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/pressure_valve.h"
-
-// INITIALISATION =============================================================
-
-PC_VSAI_Controller pcVsaiController;
+#include "../includes/ventilator_context.h"
 
 // FUNCTIONS ==================================================================
 
 // cppcheck-suppress misra-c2012-5.2 ; false positive
-PC_VSAI_Controller::PC_VSAI_Controller() {
+PC_VSAI_Controller::PC_VSAI_Controller(VentilatorContext* p_context)
+    : VentilationController(p_context) {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     m_inspiratoryValveLastAperture = inspiratoryValve.maxAperture();
     m_expiratoryValveLastAperture = expiratoryValve.maxAperture();
     m_plateauPressureReached = false;
@@ -57,6 +59,10 @@ PC_VSAI_Controller::PC_VSAI_Controller() {
 void PC_VSAI_Controller::setup() { m_blowerSpeed = DEFAULT_BLOWER_SPEED; }
 
 void PC_VSAI_Controller::initCycle() {
+    MainController& mainController = context().mainController;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     m_plateauPressureReached = false;
     m_triggerWindow =
         mainController.ticksPerInhalation()
@@ -100,6 +106,10 @@ void PC_VSAI_Controller::initCycle() {
 }
 
 void PC_VSAI_Controller::inhale() {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     m_expiratoryPidFastMode = false;
 
     // Keep the inspiratory valve open using a PID
@@ -137,6 +147,10 @@ void PC_VSAI_Controller::inhale() {
 }
 
 void PC_VSAI_Controller::exhale() {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     // Open the expiration valve so the patient can exhale outside
     int32_t expiratoryValveOpenningValue = PCexpiratoryPID(
         mainController.pressureCommand(), mainController.pressure(), mainController.dt());
@@ -170,6 +184,8 @@ void PC_VSAI_Controller::exhale() {
 void PC_VSAI_Controller::endCycle() { calculateBlowerIncrement(); }
 
 void PC_VSAI_Controller::calculateBlowerIncrement() {
+    MainController& mainController = context().mainController;
+
     int16_t peakDelta =
         mainController.peakPressureMeasure() - mainController.plateauPressureCommand();
     int16_t rebouncePeakDelta =
@@ -225,6 +241,8 @@ void PC_VSAI_Controller::calculateBlowerIncrement() {
 
 int32_t
 PC_VSAI_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPressure, int32_t dt) {
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+
     int32_t minAperture = inspiratoryValve.minAperture();
     int32_t maxAperture = inspiratoryValve.maxAperture();
     int32_t inspiratoryValveAperture;
@@ -326,6 +344,9 @@ PC_VSAI_Controller::PCinspiratoryPID(int32_t targetPressure, int32_t currentPres
 
 int32_t
 PC_VSAI_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressure, int32_t dt) {
+    MainController& mainController = context().mainController;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     int32_t minAperture = expiratoryValve.minAperture();
     int32_t maxAperture = expiratoryValve.maxAperture();
     int32_t expiratoryValveAperture;
@@ -419,3 +440,25 @@ PC_VSAI_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPress
 
     return expiratoryValveAperture;
 }
+
+void PC_VSAI_Controller::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(m_triggerWindow);
+    p_archive->field(m_plateauPressureReached);
+    p_archive->field(m_blowerSpeed);
+    p_archive->field(m_reOpenInspiratoryValve);
+    p_archive->field(m_inspiratorySlope);
+    p_archive->field(m_blowerIncrement);
+    p_archive->field(m_inspiratoryPidIntegral);
+    p_archive->field(m_inspiratoryPidLastError);
+    p_archive->field(m_expiratoryPidFastMode);
+    p_archive->field(m_inspiratoryPidFastMode);
+    p_archive->field(m_expiratoryPidIntegral);
+    p_archive->field(m_inspiratoryValveLastAperture);
+    p_archive->field(m_expiratoryValveLastAperture);
+    p_archive->field(m_expiratoryPidLastError);
+    p_archive->field(m_inspiratoryPidLastErrors);
+    p_archive->field(m_inspiratoryPidLastErrorsIndex);
+    p_archive->field(m_expiratoryPidLastErrors);
+    p_archive->field(m_expiratoryPidLastErrorsIndex);
+    p_archive->field(m_maxInspiratoryFlow);
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file periodic_task.cpp
+ * @brief Table of periodic tasks run from a millisecond timer
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/periodic_task.h"
+
+// Internals
+#include "../includes/deferred_work.h"
+#include "../includes/timebase.h"
+
+// FUNCTIONS ==================================================================
+
+PeriodicTask::PeriodicTask(void (*p_callback)(void),
+                           uint32_t p_periodMs,
+                           uint32_t p_phaseMs,
+                           uint8_t p_priority)
+    : callback(p_callback),
+      periodMs(p_periodMs),
+      phaseMs(p_phaseMs),
+      priority(p_priority),
+      worstExecutionTimeUs(0u),
+      totalExecutionTimeUs(0u),
+      executionCount(0u),
+      pending(false) {}
+
+void executePeriodicTask(PeriodicTask* p_task) {
+    uint64_t start = monotonicMicros();
+    p_task->callback();
+    uint32_t duration = static_cast<uint32_t>(monotonicMicros() - start);
+
+    if (duration > p_task->worstExecutionTimeUs) {
+        p_task->worstExecutionTimeUs = duration;
+    }
+    p_task->totalExecutionTimeUs += duration;
+    p_task->executionCount++;
+}
+
+PeriodicTaskTable::PeriodicTaskTable(PeriodicTask* p_tasks, uint8_t p_size) {
+    m_tasks = p_tasks;
+    m_size = p_size;
+
+    // Insertion sort by priority: the table is small and this runs once at boot
+    for (uint8_t i = 1u; i < m_size; i++) {
+        PeriodicTask current = m_tasks[i];
+        uint8_t j = i;
+        while ((j > 0u) && (m_tasks[j - 1u].priority > current.priority)) {
+            m_tasks[j] = m_tasks[j - 1u];
+            j--;
+        }
+        m_tasks[j] = current;
+    }
+
+    resetStatistics();
+}
+
+void PeriodicTaskTable::run(uint32_t p_clockMs) {
+    for (uint8_t i = 0u; i < m_size; i++) {
+        PeriodicTask& task = m_tasks[i];
+
+        if ((p_clockMs % task.periodMs) == task.phaseMs) {
+            (void)postDeferredWork(&task);
+        }
+    }
+}
+
+uint32_t PeriodicTaskTable::meanExecutionTimeUs(uint8_t p_index) const {
+    const PeriodicTask& task = m_tasks[p_index];
+    uint32_t mean = 0u;
+
+    if (task.executionCount != 0u) {
+        mean = static_cast<uint32_t>(task.totalExecutionTimeUs / task.executionCount);
+    }
+
+    return mean;
+}
+
+void PeriodicTaskTable::resetStatistics() {
+    for (uint8_t i = 0u; i < m_size; i++) {
+        m_tasks[i].worstExecutionTimeUs = 0u;
+        m_tasks[i].totalExecutionTimeUs = 0u;
+        m_tasks[i].executionCount = 0u;
+        m_tasks[i].pending = false;
+    }
+}
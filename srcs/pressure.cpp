@@ -12,22 +12,23 @@
 #include "../includes/pressure_utl.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
+#include "../includes/hal.h"
 #include "../includes/parameters.h"
 
 // INITIALISATION =============================================================
 
-PressureSensor inspiratoryPressureSensor;
+BOARD_STATE PressureSensor inspiratoryPressureSensor;
 
 // FUNCTIONS ==================================================================
 
 PressureSensor::PressureSensor() { m_PressureSensorOffset = 0; }
 
-int32_t PressureSensor::read() {
-    int32_t withOffset =
-        convertSensor2Pressure(analogRead(PIN_PRESSURE_SENSOR)) - m_PressureSensorOffset;
+int32_t PressureSensor::read() { return convert(halReadPressureAdc()); }
+
+int32_t PressureSensor::convert(uint16_t p_rawValue) {
+    int32_t withOffset = convertSensor2Pressure(p_rawValue) - m_PressureSensorOffset;
     return withOffset;
 }
@@ -9,11 +9,12 @@
 
 #include <algorithm>
 
+#include "../includes/board_state.h"
 #include "../includes/pressure_utl.h"
 
 // INITIALISATION =============================================================
 
-static int32_t filteredRawPressure = 0;
+static BOARD_STATE int32_t filteredRawPressure = 0;
 
 static const int32_t RAW_PRESSURE_FILTER_DIVIDER = 5;
 
@@ -64,5 +65,23 @@ int16_t convertSensor2Pressure(uint32_t sensorValue) {
     return scaledRawPressure - RAW_PRESSURE_TO_MMH20_CONSTANT;
 }
 
+// cppcheck-suppress unusedFunction
+uint32_t convertPressure2Sensor(int32_t p_pressure) {
+    // Smallest raw value that convertSensor2Pressure() brings back to the pressure, within the
+    // 12 bits of the ADC
+    int32_t scaledPressure =
+        (p_pressure + RAW_PRESSURE_TO_MMH20_CONSTANT) * RAW_PRESSURE_TO_MMH20_DEN;
+    int32_t rawPressure =
+        (scaledPressure + (RAW_PRESSURE_TO_MMH20_NUM - 1)) / RAW_PRESSURE_TO_MMH20_NUM;
+    return static_cast<uint32_t>(std::min(std::max(rawPressure, int32_t(0)), int32_t(4095)));
+}
+
 // cppcheck-suppress unusedFunction
 void resetFilteredRawPressure() { filteredRawPressure = 0; }
+
+int32_t getFilteredRawPressure() { return filteredRawPressure; }
+
+// cppcheck-suppress unusedFunction
+void restoreFilteredRawPressure(int32_t p_filteredRawPressure) {
+    filteredRawPressure = p_filteredRawPressure;
+}
@@ -18,23 +18,14 @@
 // Internal libraries
 #include "../includes/parameters.h"
 
-// INITIALISATION =============================================================
-
-PressureValve expiratoryValve;
-PressureValve inspiratoryValve;
-
 // FUNCTIONS ==================================================================
 
 PressureValve::PressureValve() {}
 
-PressureValve::PressureValve(HardwareTimer* p_hardwareTimer,
-                             uint16_t p_timerChannel,
-                             uint16_t p_valvePin,
+PressureValve::PressureValve(HalPwmOutput p_output,
                              uint16_t p_openApertureAngle,
                              uint16_t p_closeApertureAngle) {
-    actuator = p_hardwareTimer;
-    timerChannel = p_timerChannel;
-    valvePin = p_valvePin;
+    output = p_output;
     openApertureAngle = p_openApertureAngle;
     closeApertureAngle = p_closeApertureAngle;
     minApertureAngle = min(p_closeApertureAngle, p_openApertureAngle);
@@ -45,8 +36,7 @@ PressureValve::PressureValve(HardwareTimer* p_hardwareTimer,
 }
 
 void PressureValve::setup() {
-    actuator->setMode(timerChannel, TIMER_OUTPUT_COMPARE_PWM1, valvePin);
-    actuator->setCaptureCompare(timerChannel, 0, MICROSEC_COMPARE_FORMAT);
+    halSetupPwmOutput(output, 0);
 }
 
 void PressureValve::open() { command = openApertureAngle; }
@@ -153,3 +143,12 @@ uint16_t valveAngle2MicroSeconds(uint16_t value) {
     // Faulhaber motors works with PWM
     return map(value, 0, 125, FAULHABER_OPENED, FAULHABER_CLOSED);
 }
+
+void PressureValve::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(command);
+    p_archive->field(position);
+    p_archive->field(positionLinear);
+    if (p_archive->isRestoring()) {
+        halWritePwmOutput(output, valveAngle2MicroSeconds(position));
+    }
+}
@@ -26,6 +26,7 @@
 #include "../includes/calibration.h"
 #include "../includes/cpu_load.h"
 #include "../includes/debug.h"
+#include "../includes/deferred_work.h"
 #include "../includes/end_of_line_test.h"
 #include "../includes/keyboard.h"
 #include "../includes/main_controller.h"
@@ -35,16 +36,29 @@
 #include "../includes/pressure.h"
 #include "../includes/pressure_valve.h"
 #include "../includes/rpi_watchdog.h"
+#include "../includes/rtos_tasks.h"
 #include "../includes/screen.h"
 #include "../includes/serial_control.h"
 #include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
 
 // PROGRAM =====================================================================
 
-HardwareTimer* hardwareTimer1;  // ESC command
-HardwareTimer* hardwareTimer3;  // valves command
+/// Calibrate the sensors, then start the main state machine or the end of line test
+void startVentilation(void) {
+    Calibration_Init();
 
-HardwareSerial Serial6(PIN_TELEMETRY_SERIAL_RX, PIN_TELEMETRY_SERIAL_TX);
+    if (!eolTest.isRunning()) {
+        mainStateMachine.setupAndStart();
+
+        // Init the watchdog timer. It must be reloaded frequently otherwise MCU resests
+        IWatchdog.begin(WATCHDOG_TIMEOUT);
+        IWatchdog.reload();
+    } else {
+        eolTest.setupAndStart();
+    }
+}
 
 void setup(void) {
     // Nothing should be sent to Serial in production, but this will avoid crashing the program if
@@ -52,6 +66,9 @@ void setup(void) {
     Serial.begin(115200);
     DBG_DO(Serial.println("Booting the system...");)
 
+    initTimebase();
+    initCpuLoad();
+
     startScreen();
 
     initBattery();
@@ -68,29 +85,24 @@ void setup(void) {
     initTelemetry();
     sendBootMessage();
 
-    // Timer for valves
-    hardwareTimer3 = new HardwareTimer(TIM3);
-    hardwareTimer3->setOverflow(VALVE_PERIOD, MICROSEC_FORMAT);
+    // Timers for valves and blower
+    initHalPwmOutputs();
 
     // Valves setup
-    inspiratoryValve = PressureValve(hardwareTimer3, TIM_CHANNEL_INSPIRATORY_VALVE,
-                                     PIN_INSPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
-    inspiratoryValve.setup();
-    hardwareTimer3->resume();
-    expiratoryValve = PressureValve(hardwareTimer3, TIM_CHANNEL_EXPIRATORY_VALVE,
-                                    PIN_EXPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
-    expiratoryValve.setup();
-    hardwareTimer3->resume();
+    ventilator.inspiratoryValve =
+        PressureValve(HAL_PWM_INSPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
+    ventilator.inspiratoryValve.setup();
+    ventilator.expiratoryValve =
+        PressureValve(HAL_PWM_EXPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
+    ventilator.expiratoryValve.setup();
 
     // Blower setup
-    hardwareTimer1 = new HardwareTimer(TIM1);
-    hardwareTimer1->setOverflow(ESC_PPM_PERIOD, MICROSEC_FORMAT);
-    blower = Blower(hardwareTimer1, TIM_CHANNEL_ESC_BLOWER, PIN_ESC_BLOWER);
-    blower.setup();
+    ventilator.blower = Blower(HAL_PWM_BLOWER);
+    ventilator.blower.setup();
 
     // Init controllers
-    mainController = MainController();
-    alarmController = AlarmController();
+    ventilator.mainController = MainController();
+    ventilator.alarmController = AlarmController();
 
     // Init sensors
     inspiratoryPressureSensor = PressureSensor();
@@ -144,20 +156,24 @@ void setup(void) {
     initKeyboard();
     BuzzerControl_Init();
     Buzzer_Init();
-    Calibration_Init();
 
-    if (!eolTest.isRunning()) {
-        mainStateMachine.setupAndStart();
-
-        // Init the watchdog timer. It must be reloaded frequently otherwise MCU resests
-        IWatchdog.begin(WATCHDOG_TIMEOUT);
-        IWatchdog.reload();
-    } else {
-        eolTest.setupAndStart();
-    }
+#ifdef RTOS_TASKS
+    // Calibration needs the flow meter acquisition, so it runs once the tasks are started
+    startRtosTasks(&startVentilation);
+#else
+    startVentilation();
+#endif
 }
 
 // cppcheck-suppress unusedFunction
-void loop(void) { COUNT_IDLE_CYCLE; }
+void loop(void) {
+    // Run the work posted by the main state machine interrupt
+    runDeferredWork();
+
+    // Nothing else runs in the background: sleep until the next interrupt
+    if (!hasDeferredWork()) {
+        __WFI();
+    }
+}
 
 #endif
@@ -10,10 +10,11 @@
 // INCLUDES ===================================================================
 
 #include "../includes/rpi_watchdog.h"
+#include "../includes/hal.h"
 
 // INITIALISATION =============================================================
 
-RpiWatchdog rpiWatchdog = RpiWatchdog();
+BOARD_STATE RpiWatchdog rpiWatchdog = RpiWatchdog();
 
 // FUNCTIONS ==================================================================
 
@@ -30,11 +31,11 @@ void RpiWatchdog::update() {
         }
     } else if (m_rpiWatchdogStep == SWITCH_OFF_RASPBERRY) {
         // Turn off the Raspberry Pi power
-        digitalWrite(PIN_ENABLE_PWR_RASP, PWR_RASP_INACTIVE);
+        halWriteRaspberryPower(false);
         m_rpiWatchdogStep = SWITCH_ON_RASPBERRY;
     } else if (m_rpiWatchdogStep == SWITCH_ON_RASPBERRY) {
         // Turn on the Raspberry Pi power
-        digitalWrite(PIN_ENABLE_PWR_RASP, PWR_RASP_ACTIVE);
+        halWriteRaspberryPower(true);
         m_countDown = COUNTDOWN_IN_S;
         m_rpiWatchdogStep = WAIT_FOR_FIRST_HEARTBEAT;
     } else if (m_rpiWatchdogStep == WAIT_FOR_FIRST_HEARTBEAT) {
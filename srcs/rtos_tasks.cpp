@@ -0,0 +1,159 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file rtos_tasks.cpp
+ * @brief Optional FreeRTOS task model of the firmware
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/rtos_tasks.h"
+
+#ifdef RTOS_TASKS
+
+// Externals
+#ifdef RTOS_POSIX_PORT
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#else
+#include <STM32FreeRTOS.h>
+#endif
+
+// Internals
+#include "../includes/deferred_work.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/mass_flow_meter.h"
+#include "../includes/serial_control.h"
+
+// The CPU load is computed by vApplicationTickHook(), see cpu_load.cpp
+#if configUSE_TICK_HOOK != 1
+#error "RTOS_TASKS needs configUSE_TICK_HOOK set to 1 in the FreeRTOS configuration"
+#endif
+
+// INITIALISATION =============================================================
+
+static SemaphoreHandle_t controlMutex = NULL;
+static TaskHandle_t controlTaskHandle = NULL;
+static void (*rtosStartup)(void) = NULL;
+
+// FUNCTIONS ==================================================================
+
+/// Acquire the flow meters
+void flowMeterStep(void) {
+#ifdef MASS_FLOW_METER_ENABLED
+    MFM_acquire();
+#endif
+}
+
+/// Run one period of the main state machine
+void controlStep(void) {
+    lockRtosControl();
+    runMainStateMachine();
+    unlockRtosControl();
+}
+
+/// Check serial input, each setting is applied under the control lock
+void serialStep(void) { serialControlLoop(); }
+
+/// Run the work posted by the main state machine
+void uiStep(void) { runDeferredWork(); }
+
+/**
+ * RTOS tasks, by decreasing priority
+ *
+ * The phase is not used: each task is released by the scheduler at its own period.
+ */
+PeriodicTask rtosTasks[RTOS_TASK_COUNT] = {
+    // callback, period (ms), phase (ms), priority
+    {&flowMeterStep, 10u, 0u, 0u},
+    {&controlStep, 1u, 0u, 1u},
+    {&serialStep, 10u, 0u, 2u},
+    {&uiStep, 1u, 0u, 3u},
+};
+
+/**
+ * Run a task at its period, forever
+ *
+ * @param p_task Task to run
+ */
+void runRtosTaskPeriodically(PeriodicTask* p_task) {
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    while (true) {
+        executePeriodicTask(p_task);
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(p_task->periodMs));
+    }
+}
+
+/// Entry point of the periodic tasks
+void rtosTaskEntry(void* p_parameters) {
+    runRtosTaskPeriodically(static_cast<PeriodicTask*>(p_parameters));
+}
+
+/// Entry point of the control task: it waits for the main state machine to be started
+void rtosControlTaskEntry(void* p_parameters) {
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    runRtosTaskPeriodically(static_cast<PeriodicTask*>(p_parameters));
+}
+
+/// Entry point of the UI task: it runs the startup function first
+void rtosUiTaskEntry(void* p_parameters) {
+    if (rtosStartup != NULL) {
+        rtosStartup();
+    }
+    runRtosTaskPeriodically(static_cast<PeriodicTask*>(p_parameters));
+}
+
+void startRtosTasks(void (*p_startup)(void)) {
+    rtosStartup = p_startup;
+    controlMutex = xSemaphoreCreateMutex();
+
+    const char* names[RTOS_TASK_COUNT] = {"flowMeter", "control", "serial", "ui"};
+
+    for (uint8_t i = 0u; i < RTOS_TASK_COUNT; i++) {
+        TaskFunction_t entry = &rtosTaskEntry;
+        if (rtosTasks[i].callback == &controlStep) {
+            entry = &rtosControlTaskEntry;
+        } else if (rtosTasks[i].callback == &uiStep) {
+            entry = &rtosUiTaskEntry;
+        } else {
+            // Plain periodic task
+        }
+
+        TaskHandle_t handle = NULL;
+        (void)xTaskCreate(entry, names[i], RTOS_TASK_STACK_SIZE, &rtosTasks[i],
+                          tskIDLE_PRIORITY + RTOS_TASK_COUNT - rtosTasks[i].priority, &handle);
+
+        if (rtosTasks[i].callback == &controlStep) {
+            controlTaskHandle = handle;
+        }
+    }
+
+    vTaskStartScheduler();
+
+    // Only reached if there is not enough heap to start the scheduler
+    while (true) {
+        continue;
+    }
+}
+
+void startRtosControlTask(void) { (void)xTaskNotifyGive(controlTaskHandle); }
+
+void lockRtosControl(void) { (void)xSemaphoreTake(controlMutex, portMAX_DELAY); }
+
+void unlockRtosControl(void) { (void)xSemaphoreGive(controlMutex); }
+
+void setRtosControlPeriod(uint32_t p_periodMs) {
+    for (uint8_t i = 0u; i < RTOS_TASK_COUNT; i++) {
+        if (rtosTasks[i].callback == &controlStep) {
+            // Read by the control task when it computes its next wake up time
+            rtosTasks[i].periodMs = p_periodMs;
+        }
+    }
+}
+
+const PeriodicTask& rtosTask(uint8_t p_index) { return rtosTasks[p_index]; }
+
+#endif
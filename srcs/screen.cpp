@@ -247,6 +247,44 @@ void displayEndOfLineTestMode() {
     screen.print("EOL Test Mode");
 }
 
+void displayEndOfLineTestMessage(const char* p_message, uint32_t p_testNumber, bool p_isFailed) {
+    screen.clear();
+    // cppcheck-suppress misra-c2012-12.3
+    if (p_testNumber == (uint32_t)0 && !p_isFailed) {
+        screen.setCursor(0, 0);
+        screen.print("EOL TEST");
+    } else {
+        screen.setCursor(0, 0);
+        screen.print("EOL TEST  #");
+        screen.print(p_testNumber);
+        if (p_isFailed) {
+            screen.setCursor(15, 0);
+            screen.print("FAIL");
+        } else {
+            screen.setCursor(18, 0);
+            screen.print("OK");
+        }
+    }
+
+    // Print line by line, respect newlines
+    int line = 1;
+    // cppcheck-suppress misra-c2012-12.3 ; call to unknown external: screen.setCursor
+    screen.setCursor(0, line);
+    int i = 0;
+    while (i < 62) {
+        if (p_message[i] == '\n') {
+            line++;
+            screen.setCursor(0, line);
+            i++;
+        }
+        if ((p_message[i] == 0) || (line > 3)) {
+            break;
+        }
+        screen.print(p_message[i]);
+        i++;
+    }
+}
+
 void displayWatchdogError() {
     screen.clear();
     screen.setCursor(0, 0);
@@ -0,0 +1,258 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_capture.cpp
+ * @brief Capture of the raw sensor samples, to replay them on a host
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/sensor_capture.h"
+
+// Internal
+#include "../includes/activation.h"
+#include "../includes/mass_flow_meter.h"
+#include "../includes/pressure.h"
+#include "../includes/pressure_utl.h"
+
+// INITIALISATION =============================================================
+
+BOARD_STATE SensorCapture sensorCapture = SensorCapture();
+
+/// Size of an end record, room is always kept for it
+#define SENSOR_CAPTURE_END_SIZE 2u
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Write a number in big endian
+ *
+ * @param p_bytes Buffer of p_size bytes
+ * @param p_value Number
+ * @param p_size Number of bytes to write
+ */
+static void writeBigEndian(uint8_t* p_bytes, uint64_t p_value, uint8_t p_size) {
+    for (uint8_t i = 0u; i < p_size; i++) {
+        p_bytes[i] = static_cast<uint8_t>(p_value >> (8u * (p_size - 1u - i)));
+    }
+}
+
+/**
+ * Check if a setting changes the ventilation, and must be replayed
+ *
+ * @param p_setting Setting of the control protocol
+ * @return False for the settings that only act on the UI, the alarms or the capture itself
+ */
+static bool isReplayedSetting(uint8_t p_setting) {
+    return (p_setting < CONTROL_SETTINGS) && (p_setting != Heartbeat)
+           && (p_setting != RespirationEnabled) && (p_setting != AlarmSnooze)
+           && (p_setting != Locale) && (p_setting != EolConfirm)
+           && (p_setting != TimingHistograms) && (p_setting != SensorCaptureEnabled);
+}
+
+SensorCapture::SensorCapture() {
+    m_tail = 0u;
+    m_size = 0u;
+    m_flowSamplesHead = 0u;
+    m_flowSamplesTail = 0u;
+    m_flowSamplesLost = false;
+    for (uint8_t i = 0u; i < CONTROL_SETTINGS; i++) {
+        m_settingValues[i] = 0u;
+        m_settingOrders[i] = 0u;
+    }
+    m_lastSettingOrder = 0u;
+    m_armed = false;
+    m_running = false;
+    m_lastTickMicros = 0u;
+    m_lastActivation = false;
+    m_overflows = 0u;
+}
+
+void SensorCapture::arm() {
+    if (!m_running) {
+        m_armed = true;
+    }
+}
+
+void SensorCapture::stop() {
+    m_armed = false;
+    if (m_running) {
+        end(SENSOR_CAPTURE_STOPPED);
+    }
+}
+
+void SensorCapture::onControlTick(uint64_t p_entryMicros,
+                                  uint64_t p_lastTimerMicros,
+                                  uint16_t p_rawPressure,
+                                  bool p_stopped) {
+    if (m_armed && p_stopped) {
+        m_armed = false;
+        start(p_entryMicros, p_lastTimerMicros);
+    }
+
+    if (m_running && appendFlowSamples()) {
+        bool activation = activationController.isRunning();
+        bool recorded = true;
+        if (activation != m_lastActivation) {
+            uint8_t record[2] = {SENSOR_CAPTURE_ACTIVATION, static_cast<uint8_t>(activation)};
+            recorded = append(record, sizeof(record));
+            m_lastActivation = activation;
+        }
+
+        uint64_t delta = p_entryMicros - m_lastTickMicros;
+        m_lastTickMicros = p_entryMicros;
+        if (!recorded) {
+            // The capture ended on an overflow
+        } else if (delta <= SENSOR_CAPTURE_SHORT_DELTA_MAX) {
+            uint8_t record[4];
+            record[0] = SENSOR_CAPTURE_TICK;
+            writeBigEndian(&record[1], (delta << 12u) | (p_rawPressure & 0xFFFu), 3u);
+            (void)append(record, sizeof(record));
+        } else {
+            uint8_t record[7];
+            record[0] = SENSOR_CAPTURE_LONG_TICK;
+            writeBigEndian(&record[1], (delta > 0xFFFFFFFFu) ? 0xFFFFFFFFu : delta, 4u);
+            writeBigEndian(&record[5], p_rawPressure, 2u);
+            (void)append(record, sizeof(record));
+        }
+    } else {
+        // Flow meter acquisitions are only kept while a capture runs
+        m_flowSamplesTail = m_flowSamplesHead;
+    }
+}
+
+void SensorCapture::onFlowSample(uint16_t p_inspiratoryWord,
+                                 uint16_t p_expiratoryWord,
+                                 bool p_fault) {
+    if (m_running) {
+        uint8_t head = m_flowSamplesHead;
+        if (static_cast<uint8_t>(head - m_flowSamplesTail) >= SENSOR_CAPTURE_FLOW_SAMPLES) {
+            m_flowSamplesLost = true;
+        } else {
+            uint16_t* sample = m_flowSamples[head % SENSOR_CAPTURE_FLOW_SAMPLES];
+            sample[0] = p_inspiratoryWord;
+            sample[1] = p_expiratoryWord;
+            sample[2] = p_fault ? 1u : 0u;
+            // Publish the acquisition once it is written
+            m_flowSamplesHead = head + 1u;
+        }
+    }
+}
+
+void SensorCapture::onControlSetting(uint8_t p_setting, uint16_t p_value) {
+    if (isReplayedSetting(p_setting)) {
+        m_lastSettingOrder++;
+        m_settingValues[p_setting] = p_value;
+        m_settingOrders[p_setting] = m_lastSettingOrder;
+
+        if (m_running) {
+            uint8_t record[4];
+            record[0] = SENSOR_CAPTURE_SETTING;
+            record[1] = p_setting;
+            writeBigEndian(&record[2], p_value, 2u);
+            (void)append(record, sizeof(record));
+        }
+    }
+}
+
+size_t SensorCapture::take(uint8_t* p_data, size_t p_size) {
+    size_t taken = 0u;
+    while ((taken < p_size) && (m_size > 0u)) {
+        p_data[taken] = m_buffer[m_tail];
+        taken++;
+        m_tail = (m_tail + 1u) % SENSOR_CAPTURE_BUFFER_SIZE;
+        m_size--;
+    }
+    return taken;
+}
+
+void SensorCapture::start(uint64_t p_entryMicros, uint64_t p_lastTimerMicros) {
+    m_running = true;
+    m_lastTickMicros = p_entryMicros;
+    m_lastActivation = false;
+    m_flowSamplesTail = m_flowSamplesHead;
+    m_flowSamplesLost = false;
+
+    uint8_t record[SENSOR_CAPTURE_START_SIZE];
+    record[0] = SENSOR_CAPTURE_START;
+    record[1] = SENSOR_CAPTURE_VERSION;
+    writeBigEndian(&record[2], p_lastTimerMicros, 8u);
+    writeBigEndian(&record[10], p_entryMicros, 8u);
+    writeBigEndian(&record[18],
+                   static_cast<uint32_t>(inspiratoryPressureSensor.pressureSensorOffset()), 4u);
+    writeBigEndian(&record[22], static_cast<uint32_t>(getFilteredRawPressure()), 4u);
+    writeBigEndian(&record[26], static_cast<uint32_t>(MFM_getOffset()), 4u);
+    bool recorded = append(record, SENSOR_CAPTURE_START_SIZE);
+
+    // The settings received since boot, in the order they were last changed
+    uint32_t previousOrder = 0u;
+    while (recorded) {
+        uint8_t next = CONTROL_SETTINGS;
+        for (uint8_t i = 0u; i < CONTROL_SETTINGS; i++) {
+            if ((m_settingOrders[i] > previousOrder)
+                && ((next == CONTROL_SETTINGS) || (m_settingOrders[i] < m_settingOrders[next]))) {
+                next = i;
+            }
+        }
+        if (next == CONTROL_SETTINGS) {
+            break;
+        }
+        previousOrder = m_settingOrders[next];
+
+        record[0] = SENSOR_CAPTURE_SETTING;
+        record[1] = next;
+        writeBigEndian(&record[2], m_settingValues[next], 2u);
+        recorded = append(record, 4u);
+    }
+}
+
+void SensorCapture::end(SensorCaptureEnd p_reason) {
+    // Room is always kept for this record
+    uint16_t head = (m_tail + m_size) % SENSOR_CAPTURE_BUFFER_SIZE;
+    m_buffer[head] = SENSOR_CAPTURE_END;
+    m_buffer[(head + 1u) % SENSOR_CAPTURE_BUFFER_SIZE] = static_cast<uint8_t>(p_reason);
+    m_size += SENSOR_CAPTURE_END_SIZE;
+
+    m_running = false;
+    if (p_reason == SENSOR_CAPTURE_OVERFLOW) {
+        m_overflows++;
+    }
+}
+
+bool SensorCapture::append(const uint8_t* p_record, uint16_t p_size) {
+    bool appended = false;
+    if (!m_running) {
+        // The capture already ended
+    } else if ((m_size + p_size + SENSOR_CAPTURE_END_SIZE) > SENSOR_CAPTURE_BUFFER_SIZE) {
+        end(SENSOR_CAPTURE_OVERFLOW);
+    } else {
+        uint16_t head = (m_tail + m_size) % SENSOR_CAPTURE_BUFFER_SIZE;
+        for (uint16_t i = 0u; i < p_size; i++) {
+            m_buffer[head] = p_record[i];
+            head = (head + 1u) % SENSOR_CAPTURE_BUFFER_SIZE;
+        }
+        m_size += p_size;
+        appended = true;
+    }
+    return appended;
+}
+
+bool SensorCapture::appendFlowSamples() {
+    bool appended = true;
+    if (m_flowSamplesLost) {
+        end(SENSOR_CAPTURE_OVERFLOW);
+        appended = false;
+    }
+    while (appended && (m_flowSamplesTail != m_flowSamplesHead)) {
+        const uint16_t* sample = m_flowSamples[m_flowSamplesTail % SENSOR_CAPTURE_FLOW_SAMPLES];
+        uint8_t record[6];
+        record[0] = SENSOR_CAPTURE_FLOW;
+        writeBigEndian(&record[1], sample[0], 2u);
+        writeBigEndian(&record[3], sample[1], 2u);
+        record[5] = static_cast<uint8_t>(sample[2]);
+        appended = append(record, sizeof(record));
+        m_flowSamplesTail = m_flowSamplesTail + 1u;
+    }
+    return appended;
+}
@@ -15,14 +15,21 @@
 #include "../includes/serial_control.h"
 
 // Externals
-#include "Arduino.h"
 #include "CRC32.h"
 
 /// Internals
 #include "../includes/activation.h"
 #include "../includes/alarm_controller.h"
+#include "../includes/control_lock.h"
+#include "../includes/cpu_load.h"
+#include "../includes/hal.h"
+#include "../includes/interrupt_timing.h"
+#include "../includes/load_shedding.h"
 #include "../includes/main_controller.h"
 #include "../includes/rpi_watchdog.h"
+#include "../includes/sensor_capture.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
 
 // INITIALISATION =============================================================
 
@@ -57,40 +64,204 @@ uint32_t toU32(byte bytes[]) {
     return num;
 }
 
+void applyControlSetting(uint8_t p_setting, uint16_t p_value) {
+    switch (p_setting) {
+    case Heartbeat:
+        if (p_value == DISABLE_RPI_WATCHDOG) {
+            rpiWatchdog.disable();
+        } else {
+            rpiWatchdog.resetCountDown();
+        }
+        break;
+
+    case VentilationMode:
+        ventilator.mainController.onVentilationModeSet(p_value);
+        break;
+
+    case PlateauPressure:
+        ventilator.mainController.onPlateauPressureSet(p_value);
+        break;
+
+    case PEEP:
+        ventilator.mainController.onPeepSet(p_value);
+        break;
+
+    case CyclesPerMinute:
+        ventilator.mainController.onCycleSet(p_value);
+        break;
+
+    case ExpiratoryTerm:
+        ventilator.mainController.onExpiratoryTermSet(p_value);
+        break;
+
+    case TriggerEnabled:
+        ventilator.mainController.onTriggerModeEnabledSet(p_value);
+        break;
+
+    case TriggerOffset:
+        ventilator.mainController.onTriggerOffsetSet(p_value);
+        break;
+
+    case RespirationEnabled:
+        activationController.changeState(p_value);
+        break;
+
+    case AlarmSnooze:
+        ventilator.alarmController.snooze();
+        break;
+
+    case InspiratoryTriggerFlow:
+        ventilator.mainController.onInspiratoryTriggerFlowSet(p_value);
+        break;
+
+    case ExpiratoryTriggerFlow:
+        ventilator.mainController.onExpiratoryTriggerFlowSet(p_value);
+        break;
+
+    case TiMin:
+        ventilator.mainController.onTiMinSet(p_value);
+        break;
+
+    case TiMax:
+        ventilator.mainController.onTiMaxSet(p_value);
+        break;
+
+    case LowInspiratoryMinuteVolumeAlarmThreshold:
+        ventilator.mainController.onLowInspiratoryMinuteVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case HighInspiratoryMinuteVolumeAlarmThreshold:
+        ventilator.mainController.onHighInspiratoryMinuteVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case LowExpiratoryMinuteVolumeAlarmThreshold:
+        ventilator.mainController.onLowExpiratoryMinuteVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case HighExpiratoryMinuteVolumeAlarmThreshold:
+        ventilator.mainController.onHighExpiratoryMinuteVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case LowRespiratoryRateAlarmThreshold:
+        ventilator.mainController.onlowRespiratoryRateAlarmThresholdSet(p_value);
+        break;
+
+    case HighRespiratoryRateAlarmThreshold:
+        ventilator.mainController.onhighRespiratoryRateAlarmThresholdSet(p_value);
+        break;
+
+    case TargetTidalVolume:
+        ventilator.mainController.onTargetTidalVolumeSet(p_value);
+        break;
+
+    case LowTidalVolumeAlarmThreshold:
+        ventilator.mainController.onLowTidalVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case HighTidalVolumeAlarmThreshold:
+        ventilator.mainController.onHighTidalVolumeAlarmThresholdSet(p_value);
+        break;
+
+    case PlateauDuration:
+        ventilator.mainController.onPlateauDurationSet(p_value);
+        break;
+
+    case LeakAlarmThreshold:
+        ventilator.mainController.onLeakAlarmThresholdSet(p_value);
+        break;
+
+    case TargetInspiratoryFlow:
+        ventilator.mainController.onTargetInspiratoryFlow(p_value);
+        break;
+
+    case InspiratoryDuration:
+        ventilator.mainController.onInspiratoryDuration(p_value);
+        break;
+
+    case Locale:
+        // TODO
+        break;
+
+    case PatientHeight:
+        ventilator.mainController.onPatientHeight(p_value);
+        break;
+
+    case PatientGender:
+        ventilator.mainController.onPatientGender(p_value);
+        break;
+
+    case PeakPressureAlarmThreshold:
+        ventilator.mainController.onPeakPressureAlarmThreshold(p_value);
+        break;
+
+    case EolConfirm:
+        eolTest.onConfirm();
+        break;
+
+    case TimingHistograms:
+        sendTimingHistograms();
+        if (p_value == 1u) {
+            for (uint8_t i = 0u; i < INTERRUPT_TIMING_SOURCES; i++) {
+                interruptTimings[i].requestReset();
+            }
+        }
+        break;
+
+    case SensorCaptureEnabled:
+        if (p_value == 1u) {
+            sensorCapture.arm();
+        } else {
+            sensorCapture.stop();
+        }
+        break;
+
+    default:
+        DBG_DO({
+            Serial.print("Unknown control setting: ");
+            Serial.print(p_setting);
+            Serial.println();
+        });
+        break;
+    }
+}
+
 // cppcheck-suppress unusedFunction
 void serialControlLoop() {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_SERIAL_RX);
+
     // Let's note this current time to avoid blocking too long here
-    int time = millis();
+    uint32_t time = monotonicMillis();
+    uint32_t budget = loadShedder.serialControlBudgetMs();
 
     // We need to ensure we received the whole message
-    while (((time + 2) >= millis()) && (Serial6.available() >= 11)) {
+    while (((monotonicMillis() - time) <= budget) && (halTelemetryAvailable() >= 11)) {
         // Let's check the first header byte
-        if (Serial6.peek() == header[0]) {
+        if (halTelemetryPeek() == header[0]) {
             // If it is correct, we discard it and continue
-            (void)Serial6.read();
+            (void)halTelemetryRead();
 
             // Let's check the second header byte
-            if (Serial6.peek() == header[1]) {
+            if (halTelemetryPeek() == header[1]) {
                 // If it is correct, we discard it and continue
-                (void)Serial6.read();
+                (void)halTelemetryRead();
 
                 // Let's prepare to compute a CRC
                 CRC32 computedCRC;
 
-                byte setting = Serial6.read();
+                byte setting = halTelemetryRead();
                 computedCRC.update(setting);
 
                 byte rawValue[2];
-                Serial6.readBytes(rawValue, 2);
+                (void)halTelemetryReadBytes(rawValue, 2);
                 computedCRC.update(rawValue, 2);
                 uint16_t value = toU16(rawValue);
 
                 byte rawExpectedCRC[4];
-                Serial6.readBytes(rawExpectedCRC, 4);
+                (void)halTelemetryReadBytes(rawExpectedCRC, 4);
                 uint32_t expectedCRC = toU32(rawExpectedCRC);
 
                 // Let's check that the 2 bytes footer is correct
-                if ((Serial6.read() != footer[0]) || (Serial6.read() != footer[1])) {
+                if ((halTelemetryRead() != footer[0]) || (halTelemetryRead() != footer[1])) {
                     DBG_DO(Serial.println(
                         "Invalid footer for control message; discarding whole message"));
                     continue;
@@ -111,155 +282,18 @@ void serialControlLoop() {
                     Serial.println();
                 });
 
-                switch (setting) {
-                case Heartbeat:
-                    if (value == DISABLE_RPI_WATCHDOG) {
-                        rpiWatchdog.disable();
-                    } else {
-                        rpiWatchdog.resetCountDown();
-                    }
-                    break;
-
-                case VentilationMode:
-                    mainController.onVentilationModeSet(value);
-                    break;
-
-                case PlateauPressure:
-                    mainController.onPlateauPressureSet(value);
-                    break;
-
-                case PEEP:
-                    mainController.onPeepSet(value);
-                    break;
-
-                case CyclesPerMinute:
-                    mainController.onCycleSet(value);
-                    break;
-
-                case ExpiratoryTerm:
-                    mainController.onExpiratoryTermSet(value);
-                    break;
-
-                case TriggerEnabled:
-                    mainController.onTriggerModeEnabledSet(value);
-                    break;
-
-                case TriggerOffset:
-                    mainController.onTriggerOffsetSet(value);
-                    break;
-
-                case RespirationEnabled:
-                    activationController.changeState(value);
-                    break;
-
-                case AlarmSnooze:
-                    alarmController.snooze();
-                    break;
-
-                case InspiratoryTriggerFlow:
-                    mainController.onInspiratoryTriggerFlowSet(value);
-                    break;
-
-                case ExpiratoryTriggerFlow:
-                    mainController.onExpiratoryTriggerFlowSet(value);
-                    break;
-
-                case TiMin:
-                    mainController.onTiMinSet(value);
-                    break;
-
-                case TiMax:
-                    mainController.onTiMaxSet(value);
-                    break;
-
-                case LowInspiratoryMinuteVolumeAlarmThreshold:
-                    mainController.onLowInspiratoryMinuteVolumeAlarmThresholdSet(value);
-                    break;
-
-                case HighInspiratoryMinuteVolumeAlarmThreshold:
-                    mainController.onHighInspiratoryMinuteVolumeAlarmThresholdSet(value);
-                    break;
-
-                case LowExpiratoryMinuteVolumeAlarmThreshold:
-                    mainController.onLowExpiratoryMinuteVolumeAlarmThresholdSet(value);
-                    break;
-
-                case HighExpiratoryMinuteVolumeAlarmThreshold:
-                    mainController.onHighExpiratoryMinuteVolumeAlarmThresholdSet(value);
-                    break;
-
-                case LowRespiratoryRateAlarmThreshold:
-                    mainController.onlowRespiratoryRateAlarmThresholdSet(value);
-                    break;
-
-                case HighRespiratoryRateAlarmThreshold:
-                    mainController.onhighRespiratoryRateAlarmThresholdSet(value);
-                    break;
-
-                case TargetTidalVolume:
-                    mainController.onTargetTidalVolumeSet(value);
-                    break;
-
-                case LowTidalVolumeAlarmThreshold:
-                    mainController.onLowTidalVolumeAlarmThresholdSet(value);
-                    break;
-
-                case HighTidalVolumeAlarmThreshold:
-                    mainController.onHighTidalVolumeAlarmThresholdSet(value);
-                    break;
-
-                case PlateauDuration:
-                    mainController.onPlateauDurationSet(value);
-                    break;
-
-                case LeakAlarmThreshold:
-                    mainController.onLeakAlarmThresholdSet(value);
-                    break;
-
-                case TargetInspiratoryFlow:
-                    mainController.onTargetInspiratoryFlow(value);
-                    break;
-
-                case InspiratoryDuration:
-                    mainController.onInspiratoryDuration(value);
-                    break;
-
-                case Locale:
-                    // TODO
-                    break;
-
-                case PatientHeight:
-                    mainController.onPatientHeight(value);
-                    break;
-
-                case PatientGender:
-                    mainController.onPatientGender(value);
-                    break;
-
-                case PeakPressureAlarmThreshold:
-                    mainController.onPeakPressureAlarmThreshold(value);
-                    break;
-
-                case EolConfirm:
-                    eolTest.onConfirm();
-                    break;
-
-                default:
-                    DBG_DO({
-                        Serial.print("Unknown control setting: ");
-                        Serial.print(setting);
-                        Serial.println();
-                    });
-                    break;
-                }
+                // The setting is applied and acknowledged between two control steps
+                ControlCriticalSection criticalSection;
+                sensorCapture.onControlSetting(setting, value);
+                applyControlSetting(setting, value);
             } else {
                 // This is not the begining of a message, let's discard it
-                (void)Serial6.read();
+                (void)halTelemetryRead();
                 DBG_DO(Serial.println("Invalid header for control message; discarding a byte"));
             }
         } else {
             // This is not the begining of a message, let's discard it
-            (void)Serial6.read();
+            (void)halTelemetryRead();
             DBG_DO(Serial.println("Invalid header for control message; discarding a byte"));
         }
     }
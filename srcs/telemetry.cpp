@@ -13,17 +13,20 @@
 #include "../includes/telemetry.h"
 
 // Externals
-#include "Arduino.h"
 #include "CRC32.h"
-#include "LL/stm32yyxx_ll_utils.h"
 
 /// Internals
+#include "../includes/board_state.h"
+#include "../includes/cpu_load.h"
+#include "../includes/hal.h"
+#include "../includes/interrupt_timing.h"
 #include "../includes/main_controller.h"
+#include "../includes/timebase.h"
 
 // INITIALISATION =============================================================
 
 /// The device ID to be joined with telemetry messages
-static byte deviceId[12];  // 3 * 32 bits = 96 bits
+static BOARD_STATE byte deviceId[12];  // 3 * 32 bits = 96 bits
 
 #define FIRST_BYTE (uint8_t)0xFF
 
@@ -83,18 +86,18 @@ void toBytes64(byte bytes[], uint64_t data) {
  * elements)
  */
 void computeDeviceId(void) {
-    deviceId[0] = (LL_GetUID_Word0() >> 24) & FIRST_BYTE;
-    deviceId[1] = (LL_GetUID_Word0() >> 16) & FIRST_BYTE;
-    deviceId[2] = (LL_GetUID_Word0() >> 8) & FIRST_BYTE;
-    deviceId[3] = LL_GetUID_Word0() & FIRST_BYTE;
-    deviceId[4] = (LL_GetUID_Word1() >> 24) & FIRST_BYTE;
-    deviceId[5] = (LL_GetUID_Word1() >> 16) & FIRST_BYTE;
-    deviceId[6] = (LL_GetUID_Word1() >> 8) & FIRST_BYTE;
-    deviceId[7] = LL_GetUID_Word1() & FIRST_BYTE;
-    deviceId[8] = (LL_GetUID_Word2() >> 24) & FIRST_BYTE;
-    deviceId[9] = (LL_GetUID_Word2() >> 16) & FIRST_BYTE;
-    deviceId[10] = (LL_GetUID_Word2() >> 8) & FIRST_BYTE;
-    deviceId[11] = LL_GetUID_Word2() & FIRST_BYTE;
+    deviceId[0] = (halReadUniqueIdWord(0u) >> 24) & FIRST_BYTE;
+    deviceId[1] = (halReadUniqueIdWord(0u) >> 16) & FIRST_BYTE;
+    deviceId[2] = (halReadUniqueIdWord(0u) >> 8) & FIRST_BYTE;
+    deviceId[3] = halReadUniqueIdWord(0u) & FIRST_BYTE;
+    deviceId[4] = (halReadUniqueIdWord(1u) >> 24) & FIRST_BYTE;
+    deviceId[5] = (halReadUniqueIdWord(1u) >> 16) & FIRST_BYTE;
+    deviceId[6] = (halReadUniqueIdWord(1u) >> 8) & FIRST_BYTE;
+    deviceId[7] = halReadUniqueIdWord(1u) & FIRST_BYTE;
+    deviceId[8] = (halReadUniqueIdWord(2u) >> 24) & FIRST_BYTE;
+    deviceId[9] = (halReadUniqueIdWord(2u) >> 16) & FIRST_BYTE;
+    deviceId[10] = (halReadUniqueIdWord(2u) >> 8) & FIRST_BYTE;
+    deviceId[11] = halReadUniqueIdWord(2u) & FIRST_BYTE;
 }
 
 /**
@@ -102,63 +105,63 @@ void computeDeviceId(void) {
  *
  * @return Systick in microseconds
  */
-uint64_t computeSystick(void) {
-    return (static_cast<uint64_t>(millis()) * 1000u) + (micros() % 1000u);
-}
+uint64_t computeSystick(void) { return monotonicMicros(); }
 
 void initTelemetry(void) {
-    Serial6.begin(115200);
+    halTelemetryBegin(115200);
     computeDeviceId();
 }
 
 void sendBootMessage() {
     uint8_t value128 = 128u;
 
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("B:", 2);
+    halTelemetryWrite("B:", 2);
     crc32.update("B:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     // cppcheck-suppress misra-c2012-12.3 ; false positive
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     // cppcheck-suppress misra-c2012-12.3 ; false positive
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     // cppcheck-suppress misra-c2012-12.3 ; false positive
     crc32.update("\t", 1);
 
-    Serial6.write(MODE);
+    halTelemetryWrite(MODE);
     crc32.update(static_cast<uint8_t>(MODE));
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     // cppcheck-suppress misra-c2012-12.3 ; false positive
     crc32.update("\t", 1);
 
-    Serial6.write(value128);
+    halTelemetryWrite(value128);
     crc32.update(value128);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendStoppedMessage(uint8_t peakCommand,
@@ -225,257 +228,259 @@ void sendStoppedMessage(uint8_t peakCommand,
         break;
     }
 
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("O:", 2);
+    halTelemetryWrite("O:", 2);
     crc32.update("O:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(peakCommand);
+    halTelemetryWrite(peakCommand);
     crc32.update(peakCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(plateauCommand);
+    halTelemetryWrite(plateauCommand);
     crc32.update(plateauCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(peepCommand);
+    halTelemetryWrite(peepCommand);
     crc32.update(peepCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(cpmCommand);
+    halTelemetryWrite(cpmCommand);
     crc32.update(cpmCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(expiratoryTerm);
+    halTelemetryWrite(expiratoryTerm);
     crc32.update(expiratoryTerm);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(triggerEnabled);
+    halTelemetryWrite(triggerEnabled);
     crc32.update(triggerEnabled);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(triggerOffset);
+    halTelemetryWrite(triggerOffset);
     crc32.update(triggerOffset);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(alarmSnoozed);
+    halTelemetryWrite(alarmSnoozed);
     crc32.update(alarmSnoozed);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(cpuLoad);
+    halTelemetryWrite(cpuLoad);
     crc32.update(cpuLoad);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(ventilationModeValue);
+    halTelemetryWrite(ventilationModeValue);
     crc32.update(ventilationModeValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(inspiratoryTriggerFlow);
+    halTelemetryWrite(inspiratoryTriggerFlow);
     crc32.update(inspiratoryTriggerFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(expiratoryTriggerFlow);
+    halTelemetryWrite(expiratoryTriggerFlow);
     crc32.update(expiratoryTriggerFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte tiMin[2];  // 16 bits
     toBytes16(tiMin, tiMinValue);
-    Serial6.write(tiMin, 2);
+    halTelemetryWrite(tiMin, 2);
     crc32.update(tiMin, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte tiMax[2];  // 16 bits
     toBytes16(tiMax, tiMaxValue);
-    Serial6.write(tiMax, 2);
+    halTelemetryWrite(tiMax, 2);
     crc32.update(tiMax, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowInspiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(lowInspiratoryMinuteVolumeAlarmThreshold);
     crc32.update(lowInspiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highInspiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(highInspiratoryMinuteVolumeAlarmThreshold);
     crc32.update(highInspiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowExpiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(lowExpiratoryMinuteVolumeAlarmThreshold);
     crc32.update(lowExpiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highExpiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(highExpiratoryMinuteVolumeAlarmThreshold);
     crc32.update(highExpiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowRespiratoryRateAlarmThreshold);
+    halTelemetryWrite(lowRespiratoryRateAlarmThreshold);
     crc32.update(lowRespiratoryRateAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highRespiratoryRateAlarmThreshold);
+    halTelemetryWrite(highRespiratoryRateAlarmThreshold);
     crc32.update(highRespiratoryRateAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte targetTidalVolume[2];  // 16 bits
     toBytes16(targetTidalVolume, targetTidalVolumeValue);
-    Serial6.write(targetTidalVolume, 2);
+    halTelemetryWrite(targetTidalVolume, 2);
     crc32.update(targetTidalVolume, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte lowTidalVolumeAlarmThreshold[2];  // 16 bits
     toBytes16(lowTidalVolumeAlarmThreshold, lowTidalVolumeAlarmThresholdValue);
-    Serial6.write(lowTidalVolumeAlarmThreshold, 2);
+    halTelemetryWrite(lowTidalVolumeAlarmThreshold, 2);
     crc32.update(lowTidalVolumeAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte highTidalVolumeAlarmThreshold[2];  // 16 bits
     toBytes16(highTidalVolumeAlarmThreshold, highTidalVolumeAlarmThresholdValue);
-    Serial6.write(highTidalVolumeAlarmThreshold, 2);
+    halTelemetryWrite(highTidalVolumeAlarmThreshold, 2);
     crc32.update(highTidalVolumeAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte plateauDuration[2];  // 16 bits
     toBytes16(plateauDuration, plateauDurationValue);
-    Serial6.write(plateauDuration, 2);
+    halTelemetryWrite(plateauDuration, 2);
     crc32.update(plateauDuration, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte leakAlarmThreshold[2];  // 16 bits
     toBytes16(leakAlarmThreshold, leakAlarmThresholdValue);
-    Serial6.write(leakAlarmThreshold, 2);
+    halTelemetryWrite(leakAlarmThreshold, 2);
     crc32.update(leakAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(targetInspiratoryFlow);
+    halTelemetryWrite(targetInspiratoryFlow);
     crc32.update(targetInspiratoryFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte inspiratoryDurationCommand[2];  // 16 bits
     toBytes16(inspiratoryDurationCommand, inspiratoryDurationCommandValue);
-    Serial6.write(inspiratoryDurationCommand, 2);
+    halTelemetryWrite(inspiratoryDurationCommand, 2);
     crc32.update(inspiratoryDurationCommand, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte batteryLevel[2];  // 16 bits
     toBytes16(batteryLevel, batteryLevelValue);
-    Serial6.write(batteryLevel, 2);
+    halTelemetryWrite(batteryLevel, 2);
     crc32.update(batteryLevel, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(currentAlarmSize);
+    halTelemetryWrite(currentAlarmSize);
     crc32.update(currentAlarmSize);
-    Serial6.write(currentAlarmCodes, currentAlarmSize);
+    halTelemetryWrite(currentAlarmCodes, currentAlarmSize);
     crc32.update(currentAlarmCodes, currentAlarmSize);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte locale[2];  // 16 bits
     toBytes16(locale, localeValue);
-    Serial6.write(locale, 2);
+    halTelemetryWrite(locale, 2);
     crc32.update(locale, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(patientHeight);
+    halTelemetryWrite(patientHeight);
     crc32.update(patientHeight);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(patientGender);
+    halTelemetryWrite(patientGender);
     crc32.update(patientGender);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte peakPressureAlarmThreshold[2];  // 16 bits
     toBytes16(peakPressureAlarmThreshold, peakPressureAlarmThresholdValue);
-    Serial6.write(peakPressureAlarmThreshold, 2);
+    halTelemetryWrite(peakPressureAlarmThreshold, 2);
     crc32.update(peakPressureAlarmThreshold, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendDataSnapshot(uint16_t centileValue,
@@ -496,97 +501,99 @@ void sendDataSnapshot(uint16_t centileValue,
         phaseValue = 0u;
     }
 
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("D:", 2);
+    halTelemetryWrite("D:", 2);
     crc32.update("D:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte centile[2];  // 16 bits
     toBytes16(centile, centileValue);
-    Serial6.write(centile, 2);
+    halTelemetryWrite(centile, 2);
     crc32.update(centile, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte pressure[2];  // 16 bits
     toBytes16(pressure, pressureValue);
-    Serial6.write(pressure, 2);
+    halTelemetryWrite(pressure, 2);
     crc32.update(pressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(phaseValue);
+    halTelemetryWrite(phaseValue);
     crc32.update(phaseValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(blowerValvePosition);
+    halTelemetryWrite(blowerValvePosition);
     crc32.update(blowerValvePosition);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(patientValvePosition);
+    halTelemetryWrite(patientValvePosition);
     crc32.update(patientValvePosition);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(blowerRpm);
+    halTelemetryWrite(blowerRpm);
     crc32.update(blowerRpm);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(batteryLevel);
+    halTelemetryWrite(batteryLevel);
     crc32.update(batteryLevel);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte inspiratoryFlow[2];  // 16 bits
     toBytes16(inspiratoryFlow, inspiratoryFlowValue);
-    Serial6.write(inspiratoryFlow, 2);
+    halTelemetryWrite(inspiratoryFlow, 2);
     crc32.update(inspiratoryFlow, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte expiratoryFlow[2];  // 16 bits
     toBytes16(expiratoryFlow, expiratoryFlowValue);
-    Serial6.write(expiratoryFlow, 2);
+    halTelemetryWrite(expiratoryFlow, 2);
     crc32.update(expiratoryFlow, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendMachineStateSnapshot(uint32_t cycleValue,
@@ -628,7 +635,8 @@ void sendMachineStateSnapshot(uint32_t cycleValue,
                               uint16_t localeValue,
                               uint8_t patientHeight,
                               uint8_t patientGender,
-                              uint16_t peakPressureAlarmThresholdValue) {
+                              uint16_t peakPressureAlarmThresholdValue,
+                              const uint16_t subsystemLoadValues[CPU_LOAD_SUBSYSTEMS]) {
     uint8_t currentAlarmSize = 0;
     for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
         if (currentAlarmCodes[i] != 0u) {
@@ -659,311 +667,324 @@ void sendMachineStateSnapshot(uint32_t cycleValue,
         ventilationModeValue = 0u;
         break;
     }
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("S:", 2);
+    halTelemetryWrite("S:", 2);
     crc32.update("S:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte cycle[4];  // 32 bits
     toBytes32(cycle, cycleValue);
-    Serial6.write(cycle, 4);
+    halTelemetryWrite(cycle, 4);
     crc32.update(cycle, 4);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(peakCommand);
+    halTelemetryWrite(peakCommand);
     crc32.update(peakCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(plateauCommand);
+    halTelemetryWrite(plateauCommand);
     crc32.update(plateauCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(peepCommand);
+    halTelemetryWrite(peepCommand);
     crc32.update(peepCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(cpmCommand);
+    halTelemetryWrite(cpmCommand);
     crc32.update(cpmCommand);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte previousPeakPressure[2];  // 16 bits
     toBytes16(previousPeakPressure, previousPeakPressureValue);
-    Serial6.write(previousPeakPressure, 2);
+    halTelemetryWrite(previousPeakPressure, 2);
     crc32.update(previousPeakPressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte previousPlateauPressure[2];  // 16 bits
     toBytes16(previousPlateauPressure, previousPlateauPressureValue);
-    Serial6.write(previousPlateauPressure, 2);
+    halTelemetryWrite(previousPlateauPressure, 2);
     crc32.update(previousPlateauPressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte previousPeepPressure[2];  // 16 bits
     toBytes16(previousPeepPressure, previousPeepPressureValue);
-    Serial6.write(previousPeepPressure, 2);
+    halTelemetryWrite(previousPeepPressure, 2);
     crc32.update(previousPeepPressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(currentAlarmSize);
+    halTelemetryWrite(currentAlarmSize);
     crc32.update(currentAlarmSize);
-    Serial6.write(currentAlarmCodes, currentAlarmSize);
+    halTelemetryWrite(currentAlarmCodes, currentAlarmSize);
     crc32.update(currentAlarmCodes, currentAlarmSize);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte volume[2];  // 16 bits
     toBytes16(volume, volumeValue);
-    Serial6.write(volume, 2);
+    halTelemetryWrite(volume, 2);
     crc32.update(volume, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(expiratoryTerm);
+    halTelemetryWrite(expiratoryTerm);
     crc32.update(expiratoryTerm);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(triggerEnabled);
+    halTelemetryWrite(triggerEnabled);
     crc32.update(triggerEnabled);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(triggerOffset);
+    halTelemetryWrite(triggerOffset);
     crc32.update(triggerOffset);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(previouscpmValue);
+    halTelemetryWrite(previouscpmValue);
     crc32.update(previouscpmValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(alarmSnoozed);
+    halTelemetryWrite(alarmSnoozed);
     crc32.update(alarmSnoozed);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(cpuLoad);
+    halTelemetryWrite(cpuLoad);
     crc32.update(cpuLoad);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(ventilationModeValue);
+    halTelemetryWrite(ventilationModeValue);
     crc32.update(ventilationModeValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(inspiratoryTriggerFlow);
+    halTelemetryWrite(inspiratoryTriggerFlow);
     crc32.update(inspiratoryTriggerFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(expiratoryTriggerFlow);
+    halTelemetryWrite(expiratoryTriggerFlow);
     crc32.update(expiratoryTriggerFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte tiMin[2];  // 16 bits
     toBytes16(tiMin, tiMinValue);
-    Serial6.write(tiMin, 2);
+    halTelemetryWrite(tiMin, 2);
     crc32.update(tiMin, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte tiMax[2];  // 16 bits
     toBytes16(tiMax, tiMaxValue);
-    Serial6.write(tiMax, 2);
+    halTelemetryWrite(tiMax, 2);
     crc32.update(tiMax, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowInspiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(lowInspiratoryMinuteVolumeAlarmThreshold);
     crc32.update(lowInspiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highInspiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(highInspiratoryMinuteVolumeAlarmThreshold);
     crc32.update(highInspiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowExpiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(lowExpiratoryMinuteVolumeAlarmThreshold);
     crc32.update(lowExpiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highExpiratoryMinuteVolumeAlarmThreshold);
+    halTelemetryWrite(highExpiratoryMinuteVolumeAlarmThreshold);
     crc32.update(highExpiratoryMinuteVolumeAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(lowRespiratoryRateAlarmThreshold);
+    halTelemetryWrite(lowRespiratoryRateAlarmThreshold);
     crc32.update(lowRespiratoryRateAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(highRespiratoryRateAlarmThreshold);
+    halTelemetryWrite(highRespiratoryRateAlarmThreshold);
     crc32.update(highRespiratoryRateAlarmThreshold);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte targetTidalVolume[2];  // 16 bits
     toBytes16(targetTidalVolume, targetTidalVolumeValue);
-    Serial6.write(targetTidalVolume, 2);
+    halTelemetryWrite(targetTidalVolume, 2);
     crc32.update(targetTidalVolume, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte lowTidalVolumeAlarmThreshold[2];  // 16 bits
     toBytes16(lowTidalVolumeAlarmThreshold, lowTidalVolumeAlarmThresholdValue);
-    Serial6.write(lowTidalVolumeAlarmThreshold, 2);
+    halTelemetryWrite(lowTidalVolumeAlarmThreshold, 2);
     crc32.update(lowTidalVolumeAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte highTidalVolumeAlarmThreshold[2];  // 16 bits
     toBytes16(highTidalVolumeAlarmThreshold, highTidalVolumeAlarmThresholdValue);
-    Serial6.write(highTidalVolumeAlarmThreshold, 2);
+    halTelemetryWrite(highTidalVolumeAlarmThreshold, 2);
     crc32.update(highTidalVolumeAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte plateauDuration[2];  // 16 bits
     toBytes16(plateauDuration, plateauDurationValue);
-    Serial6.write(plateauDuration, 2);
+    halTelemetryWrite(plateauDuration, 2);
     crc32.update(plateauDuration, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte leakAlarmThreshold[2];  // 16 bits
     toBytes16(leakAlarmThreshold, leakAlarmThresholdValue);
-    Serial6.write(leakAlarmThreshold, 2);
+    halTelemetryWrite(leakAlarmThreshold, 2);
     crc32.update(leakAlarmThreshold, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(targetInspiratoryFlow);
+    halTelemetryWrite(targetInspiratoryFlow);
     crc32.update(targetInspiratoryFlow);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte inspiratoryDurationCommand[2];  // 16 bits
     toBytes16(inspiratoryDurationCommand, inspiratoryDurationCommandValue);
-    Serial6.write(inspiratoryDurationCommand, 2);
+    halTelemetryWrite(inspiratoryDurationCommand, 2);
     crc32.update(inspiratoryDurationCommand, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte previousInspiratoryDuration[2];  // 16 bits
     toBytes16(previousInspiratoryDuration, previousInspiratoryDurationValue);
-    Serial6.write(previousInspiratoryDuration, 2);
+    halTelemetryWrite(previousInspiratoryDuration, 2);
     crc32.update(previousInspiratoryDuration, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte batteryLevel[2];  // 16 bits
     toBytes16(batteryLevel, batteryLevelValue);
-    Serial6.write(batteryLevel, 2);
+    halTelemetryWrite(batteryLevel, 2);
     crc32.update(batteryLevel, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte locale[2];  // 16 bits
     toBytes16(locale, localeValue);
-    Serial6.write(locale, 2);
+    halTelemetryWrite(locale, 2);
     crc32.update(locale, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(patientHeight);
+    halTelemetryWrite(patientHeight);
     crc32.update(patientHeight);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(patientGender);
+    halTelemetryWrite(patientGender);
     crc32.update(patientGender);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte peakPressureAlarmThreshold[2];  // 16 bits
     toBytes16(peakPressureAlarmThreshold, peakPressureAlarmThresholdValue);
-    Serial6.write(peakPressureAlarmThreshold, 2);
+    halTelemetryWrite(peakPressureAlarmThreshold, 2);
     crc32.update(peakPressureAlarmThreshold, 2);
 
-    Serial6.print("\n");
+    // CPU load of each subsystem in per mille, in the order of CpuLoadSubsystem
+    for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+        halTelemetryWrite("\t", 1);
+        crc32.update("\t", 1);
+
+        byte subsystemLoad[2];  // 16 bits
+        toBytes16(subsystemLoad, subsystemLoadValues[i]);
+        halTelemetryWrite(subsystemLoad, 2);
+        crc32.update(subsystemLoad, 2);
+    }
+
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendAlarmTrap(uint16_t centileValue,
@@ -1003,191 +1024,412 @@ void sendAlarmTrap(uint16_t centileValue,
         alarmPriorityValue = 0u;  // 00000000
     }
 
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("T:", 2);
+    halTelemetryWrite("T:", 2);
     crc32.update("T:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte centile[2];  // 16 bits
     toBytes16(centile, centileValue);
-    Serial6.write(centile, 2);
+    halTelemetryWrite(centile, 2);
     crc32.update(centile, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte pressure[2];  // 16 bits
     toBytes16(pressure, pressureValue);
-    Serial6.write(pressure, 2);
+    halTelemetryWrite(pressure, 2);
     crc32.update(pressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(phaseValue);
+    halTelemetryWrite(phaseValue);
     crc32.update(phaseValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte cycle[4];  // 32 bits
     toBytes32(cycle, cycleValue);
-    Serial6.write(cycle, 4);
+    halTelemetryWrite(cycle, 4);
     crc32.update(cycle, 4);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(alarmCode);
+    halTelemetryWrite(alarmCode);
     crc32.update(alarmCode);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(alarmPriorityValue);
+    halTelemetryWrite(alarmPriorityValue);
     crc32.update(alarmPriorityValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(triggeredValue);
+    halTelemetryWrite(triggeredValue);
     crc32.update(triggeredValue);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte expected[4];  // 32 bits
     toBytes32(expected, expectedValue);
-    Serial6.write(expected, 4);
+    halTelemetryWrite(expected, 4);
     crc32.update(expected, 4);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte measured[4];  // 32 bits
     toBytes32(measured, measuredValue);
-    Serial6.write(measured, 4);
+    halTelemetryWrite(measured, 4);
     crc32.update(measured, 4);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte cyclesSinceTrigger[4];  // 32 bits
     toBytes32(cyclesSinceTrigger, cyclesSinceTriggerValue);
-    Serial6.write(cyclesSinceTrigger, 4);
+    halTelemetryWrite(cyclesSinceTrigger, 4);
     crc32.update(cyclesSinceTrigger, 4);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendControlAck(uint8_t setting, uint16_t valueValue) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("A:", 2);
+    halTelemetryWrite("A:", 2);
     crc32.update("A:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(setting);
+    halTelemetryWrite(setting);
     crc32.update(setting);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte value[2];  // 16 bits
     toBytes16(value, valueValue);
-    Serial6.write(value, 2);
+    halTelemetryWrite(value, 2);
     crc32.update(value, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
+}
+
+void sendLoadReport(uint8_t tierValue,
+                    uint32_t overrunCountValue,
+                    uint32_t droppedSnapshotsValue,
+                    uint32_t postponedScreenUpdatesValue,
+                    uint32_t shortenedSerialLoopsValue) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
+    CRC32 crc32;
+    halTelemetryWrite("P:", 2);
+    crc32.update("P:", 2);
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    crc32.update((uint8_t)PROTOCOL_VERSION);
+
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
+    crc32.update(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(VERSION, strlen(VERSION));
+    crc32.update(VERSION, strlen(VERSION));
+    halTelemetryWrite(deviceId, 12);
+    crc32.update(deviceId, 12);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte systick[8];  // 64 bits
+    toBytes64(systick, computeSystick());
+    halTelemetryWrite(systick, 8);
+    crc32.update(systick, 8);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    halTelemetryWrite(tierValue);
+    crc32.update(tierValue);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte overrunCount[4];  // 32 bits
+    toBytes32(overrunCount, overrunCountValue);
+    halTelemetryWrite(overrunCount, 4);
+    crc32.update(overrunCount, 4);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte droppedSnapshots[4];  // 32 bits
+    toBytes32(droppedSnapshots, droppedSnapshotsValue);
+    halTelemetryWrite(droppedSnapshots, 4);
+    crc32.update(droppedSnapshots, 4);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte postponedScreenUpdates[4];  // 32 bits
+    toBytes32(postponedScreenUpdates, postponedScreenUpdatesValue);
+    halTelemetryWrite(postponedScreenUpdates, 4);
+    crc32.update(postponedScreenUpdates, 4);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte shortenedSerialLoops[4];  // 32 bits
+    toBytes32(shortenedSerialLoops, shortenedSerialLoopsValue);
+    halTelemetryWrite(shortenedSerialLoops, 4);
+    crc32.update(shortenedSerialLoops, 4);
+
+
+    halTelemetryWrite("\n", 1);
+    crc32.update("\n", 1);
+
+    byte crc[4];  // 32 bits
+    toBytes32(crc, crc32.finalize());
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
+}
+
+/**
+ * Write a timing histogram in a telemetry message
+ *
+ * @param p_histogram Histogram to write
+ * @param p_crc32 CRC of the message
+ */
+void writeTimingHistogram(const TimingHistogram& p_histogram, CRC32* p_crc32) {
+    byte value[4];  // 32 bits
+
+    toBytes32(value, p_histogram.count());
+    halTelemetryWrite(value, 4);
+    p_crc32->update(value, 4);
+
+    toBytes32(value, p_histogram.maxUs());
+    halTelemetryWrite(value, 4);
+    p_crc32->update(value, 4);
+
+    for (uint8_t i = 0u; i < TIMING_HISTOGRAM_BUCKETS; i++) {
+        toBytes32(value, p_histogram.bucket(i));
+        halTelemetryWrite(value, 4);
+        p_crc32->update(value, 4);
+    }
+}
+
+void sendTimingHistograms(void) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
+    CRC32 crc32;
+    halTelemetryWrite("H:", 2);
+    crc32.update("H:", 2);
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    crc32.update((uint8_t)PROTOCOL_VERSION);
+
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
+    crc32.update(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(VERSION, strlen(VERSION));
+    crc32.update(VERSION, strlen(VERSION));
+    halTelemetryWrite(deviceId, 12);
+    crc32.update(deviceId, 12);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte systick[8];  // 64 bits
+    toBytes64(systick, computeSystick());
+    halTelemetryWrite(systick, 8);
+    crc32.update(systick, 8);
+
+    // Bucket bounds first, so that the receiver does not need to know them
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    halTelemetryWrite(static_cast<uint8_t>(TIMING_HISTOGRAM_BUCKETS));
+    crc32.update(static_cast<uint8_t>(TIMING_HISTOGRAM_BUCKETS));
+
+    for (uint8_t i = 0u; i < (TIMING_HISTOGRAM_BUCKETS - 1u); i++) {
+        byte bound[4];  // 32 bits
+        toBytes32(bound, TIMING_HISTOGRAM_BOUNDS_US[i]);
+        halTelemetryWrite(bound, 4);
+        crc32.update(bound, 4);
+    }
+
+    // Then, for each source: latency histogram and jitter histogram
+    for (uint8_t i = 0u; i < INTERRUPT_TIMING_SOURCES; i++) {
+        halTelemetryWrite("\t", 1);
+        crc32.update("\t", 1);
+
+        writeTimingHistogram(interruptTimings[i].latency(), &crc32);
+
+        halTelemetryWrite("\t", 1);
+        crc32.update("\t", 1);
+
+        writeTimingHistogram(interruptTimings[i].jitter(), &crc32);
+    }
+
+    halTelemetryWrite("\n", 1);
+    crc32.update("\n", 1);
+
+    byte crc[4];  // 32 bits
+    toBytes32(crc, crc32.finalize());
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
+}
+
+void sendSensorCapture(const uint8_t* p_records, uint16_t p_size) {
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
+    CRC32 crc32;
+    halTelemetryWrite("R:", 2);
+    crc32.update("R:", 2);
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    crc32.update((uint8_t)PROTOCOL_VERSION);
+
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
+    crc32.update(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(VERSION, strlen(VERSION));
+    crc32.update(VERSION, strlen(VERSION));
+    halTelemetryWrite(deviceId, 12);
+    crc32.update(deviceId, 12);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte systick[8];  // 64 bits
+    toBytes64(systick, computeSystick());
+    halTelemetryWrite(systick, 8);
+    crc32.update(systick, 8);
+
+    halTelemetryWrite("\t", 1);
+    crc32.update("\t", 1);
+
+    byte size[2];  // 16 bits
+    toBytes16(size, p_size);
+    halTelemetryWrite(size, 2);
+    crc32.update(size, 2);
+
+    halTelemetryWrite(p_records, p_size);
+    crc32.update(p_records, p_size);
+
+    halTelemetryWrite("\n", 1);
+    crc32.update("\n", 1);
+
+    byte crc[4];  // 32 bits
+    toBytes32(crc, crc32.finalize());
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
+}
+
+uint16_t sensorCaptureRoom(uint16_t p_maxSize) {
+    // Header, type, version, firmware version, device ID, systick, size, CRC and footer
+    int32_t overhead = static_cast<int32_t>(HEADER_SIZE + 2u + 1u + 1u + strlen(VERSION) + 12u
+                                            + 1u + 8u + 1u + 2u + 1u + 4u + FOOTER_SIZE);
+    int32_t room = halTelemetryAvailableForWrite() - overhead;
+    return static_cast<uint16_t>(max(int32_t(0), min(room, static_cast<int32_t>(p_maxSize))));
 }
 
 void sendWatchdogRestartFatalError(void) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("E:", 2);
+    halTelemetryWrite("E:", 2);
     crc32.update("E:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write((uint8_t)1);
+    halTelemetryWrite((uint8_t)1);
     crc32.update((uint8_t)1);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendCalibrationFatalError(int16_t pressureOffsetValue,
@@ -1195,264 +1437,274 @@ void sendCalibrationFatalError(int16_t pressureOffsetValue,
                                int16_t maxPressureValue,
                                int16_t flowAtStartingValue,
                                int16_t flowWithBlowerOnValue) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("E:", 2);
+    halTelemetryWrite("E:", 2);
     crc32.update("E:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write((uint8_t)2);
+    halTelemetryWrite((uint8_t)2);
     crc32.update((uint8_t)2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte pressureOffset[2];  // 16 bits
     toBytes16(pressureOffset, pressureOffsetValue);
-    Serial6.write(pressureOffset, 2);
+    halTelemetryWrite(pressureOffset, 2);
     crc32.update(pressureOffset, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte minPressure[2];  // 16 bits
     toBytes16(minPressure, minPressureValue);
-    Serial6.write(minPressure, 2);
+    halTelemetryWrite(minPressure, 2);
     crc32.update(minPressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte maxPressure[2];  // 16 bits
     toBytes16(maxPressure, maxPressureValue);
-    Serial6.write(maxPressure, 2);
+    halTelemetryWrite(maxPressure, 2);
     crc32.update(maxPressure, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte flowAtStarting[2];  // 16 bits
     toBytes16(flowAtStarting, flowAtStartingValue);
-    Serial6.write(flowAtStarting, 2);
+    halTelemetryWrite(flowAtStarting, 2);
     crc32.update(flowAtStarting, 2);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte flowWithBlowerOn[2];  // 16 bits
     toBytes16(flowWithBlowerOn, flowWithBlowerOnValue);
-    Serial6.write(flowWithBlowerOn, 2);
+    halTelemetryWrite(flowWithBlowerOn, 2);
     crc32.update(flowWithBlowerOn, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendBatteryDeeplyDischargedFatalError(uint16_t batteryLevelValue) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("E:", 2);
+    halTelemetryWrite("E:", 2);
     crc32.update("E:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write((uint8_t)3);
+    halTelemetryWrite((uint8_t)3);
     crc32.update((uint8_t)3);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte batteryLevel[2];  // 16 bits
     toBytes16(batteryLevel, batteryLevelValue);
-    Serial6.write(batteryLevel, 2);
+    halTelemetryWrite(batteryLevel, 2);
     crc32.update(batteryLevel, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendMassFlowMeterFatalError(void) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("E:", 2);
+    halTelemetryWrite("E:", 2);
     crc32.update("E:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write((uint8_t)4);
+    halTelemetryWrite((uint8_t)4);
     crc32.update((uint8_t)4);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 void sendInconsistentPressureFatalError(uint16_t pressureValue) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("E:", 2);
+    halTelemetryWrite("E:", 2);
     crc32.update("E:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write((uint8_t)5);
+    halTelemetryWrite((uint8_t)5);
     crc32.update((uint8_t)5);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte pressure[2];  // 16 bits
     toBytes16(pressure, pressureValue);
-    Serial6.write(pressure, 2);
+    halTelemetryWrite(pressure, 2);
     crc32.update(pressure, 2);
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 
 #ifndef SIMULATOR
 void sendEolTestSnapshot(TestStep step, TestState state, char message[]) {
-    Serial6.write(header, HEADER_SIZE);
+    CpuLoadSection cpuLoadSection(CPU_LOAD_TELEMETRY);
+
+    halTelemetryWrite(header, HEADER_SIZE);
     CRC32 crc32;
-    Serial6.write("L:", 2);
+    halTelemetryWrite("L:", 2);
     crc32.update("L:", 2);
-    Serial6.write((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
+    halTelemetryWrite((uint8_t)PROTOCOL_VERSION);  // Communication protocol version
     crc32.update((uint8_t)PROTOCOL_VERSION);
 
-    Serial6.write(static_cast<uint8_t>(strlen(VERSION)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(VERSION)));
     crc32.update(static_cast<uint8_t>(strlen(VERSION)));
-    Serial6.print(VERSION);
+    halTelemetryWrite(VERSION, strlen(VERSION));
     crc32.update(VERSION, strlen(VERSION));
-    Serial6.write(deviceId, 12);
+    halTelemetryWrite(deviceId, 12);
     crc32.update(deviceId, 12);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
     byte systick[8];  // 64 bits
     toBytes64(systick, computeSystick());
-    Serial6.write(systick, 8);
+    halTelemetryWrite(systick, 8);
     crc32.update(systick, 8);
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(step);
-    crc32.update(step);
+    halTelemetryWrite(static_cast<uint8_t>(step));
+    crc32.update(static_cast<uint8_t>(step));
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(state);
-    crc32.update(state);
+    halTelemetryWrite(static_cast<uint8_t>(state));
+    crc32.update(static_cast<uint8_t>(state));
 
-    Serial6.print("\t");
+    halTelemetryWrite("\t", 1);
     crc32.update("\t", 1);
 
-    Serial6.write(static_cast<uint8_t>(strlen(message)));
+    halTelemetryWrite(static_cast<uint8_t>(strlen(message)));
     crc32.update(static_cast<uint8_t>(strlen(message)));
-    Serial6.print(message);
+    halTelemetryWrite(message, strlen(message));
     crc32.update(message, strlen(message));
 
-    Serial6.print("\n");
+    halTelemetryWrite("\n", 1);
     crc32.update("\n", 1);
 
     byte crc[4];  // 32 bits
     toBytes32(crc, crc32.finalize());
-    Serial6.write(crc, 4);
-    Serial6.write(footer, FOOTER_SIZE);
+    halTelemetryWrite(crc, 4);
+    halTelemetryWrite(footer, FOOTER_SIZE);
 }
 #endif
 
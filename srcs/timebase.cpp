@@ -0,0 +1,102 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file timebase.cpp
+ * @brief Monotonic 64-bit microsecond clock
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/timebase.h"
+
+// Internal
+#include "../includes/board_state.h"
+
+#ifndef UNIT_TEST
+// Externals
+#include "Arduino.h"
+#endif
+
+// INITIALISATION =============================================================
+
+#ifdef UNIT_TEST
+// On the host, the clock only moves when the test says so
+static BOARD_STATE uint64_t hostMicros = 0;
+#else
+// TIM2 is a 32-bit timer: at 1 MHz it overflows every 71 minutes
+#define TIMEBASE_TIMER TIM2
+#define TIMEBASE_FREQUENCY 1000000u
+
+HardwareTimer* timebaseTimer = NULL;
+static volatile uint32_t timebaseOverflows = 0;
+#endif
+
+// FUNCTIONS ==================================================================
+
+uint64_t extendTimebaseCount(uint32_t p_overflows, uint32_t p_count, bool p_overflowPending) {
+    uint64_t overflows = p_overflows;
+
+    // The overflow flag may have been raised after the counter was read: only count it when the
+    // value read is already past the wrap
+    if (p_overflowPending && (p_count < TIMEBASE_HALF_PERIOD_COUNTS)) {
+        overflows++;
+    }
+
+    return (overflows * TIMEBASE_PERIOD_COUNTS) + p_count;
+}
+
+uint32_t monotonicMillis(void) { return static_cast<uint32_t>(monotonicMicros() / 1000u); }
+
+#ifdef UNIT_TEST
+
+void initTimebase(void) { hostMicros = 0; }
+
+uint64_t monotonicMicros(void) { return hostMicros; }
+
+void setMonotonicMicros(uint64_t p_micros) {
+    if (p_micros > hostMicros) {
+        hostMicros = p_micros;
+    }
+}
+
+void advanceMonotonicMicros(uint64_t p_micros) { hostMicros += p_micros; }
+
+#else
+
+/// Count the overflows of the hardware counter
+// API update since version 1.9.0 of Arduino_Core_STM32
+#if (STM32_CORE_VERSION < 0x01090000)
+// cppcheck-suppress misra-c2012-2.7 ; valid unused parameter
+void timebaseOverflowCallback(HardwareTimer*)  // NOLINT(readability/casting)
+#else
+void timebaseOverflowCallback(void)
+#endif
+{
+    timebaseOverflows++;
+}
+
+void initTimebase(void) {
+    timebaseTimer = new HardwareTimer(TIMEBASE_TIMER);
+    timebaseTimer->setPrescaleFactor(timebaseTimer->getTimerClkFreq() / TIMEBASE_FREQUENCY);
+    timebaseTimer->setOverflow(static_cast<uint32_t>(TIMEBASE_PERIOD_COUNTS), TICK_FORMAT);
+    timebaseTimer->attachInterrupt(timebaseOverflowCallback);
+
+    // Highest priority: no reader can preempt the overflow interrupt between the moment the HAL
+    // clears the flag and the moment the overflow is counted
+    timebaseTimer->setInterruptPriority(0, 0);
+    timebaseTimer->resume();
+}
+
+uint64_t monotonicMicros(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t overflows = timebaseOverflows;
+    uint32_t count = TIMEBASE_TIMER->CNT;
+    bool overflowPending = ((TIMEBASE_TIMER->SR & TIM_SR_UIF) != 0u);
+    __set_PRIMASK(primask);
+
+    return extendTimebaseCount(overflows, count, overflowPending);
+}
+
+#endif
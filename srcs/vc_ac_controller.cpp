@@ -11,21 +11,20 @@
 #include "../includes/vc_ac_controller.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
 
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/pressure_valve.h"
-
-// INITIALISATION =============================================================
-
-VC_AC_Controller vcAcController;
+#include "../includes/ventilator_context.h"
 
 // FUNCTIONS ==================================================================
 
 void VC_AC_Controller::exhale() {
+    MainController& mainController = context().mainController;
+
     VC_CMV_Controller::exhale();
 
     // Calculate max pressure for the last samples
@@ -11,21 +11,22 @@
 #include "../includes/vc_cmv_controller.h"
 
 // External
-#include "Arduino.h"
 #include <algorithm>
 
 // Internal
+#include "../includes/hal.h"
 #include "../includes/main_controller.h"
 #include "../includes/pressure_valve.h"
-
-// INITIALISATION =============================================================
-
-VC_CMV_Controller vcCmvController;
+#include "../includes/ventilator_context.h"
 
 // FUNCTIONS ==================================================================
 
 // cppcheck-suppress misra-c2012-5.2 ; false positive
-VC_CMV_Controller::VC_CMV_Controller() {
+VC_CMV_Controller::VC_CMV_Controller(VentilatorContext* p_context)
+    : VentilationController(p_context) {
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     m_inspiratoryValveLastAperture = inspiratoryValve.maxAperture();
     m_expiratoryValveLastAperture = expiratoryValve.maxAperture();
 
@@ -53,6 +54,10 @@ void VC_CMV_Controller::setup() {
 }
 
 void VC_CMV_Controller::initCycle() {
+    MainController& mainController = context().mainController;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     m_maxInspiratoryFlow = 0;
     m_expiratoryValveLastAperture = expiratoryValve.maxAperture();
     // Reset PID values
@@ -79,6 +84,11 @@ void VC_CMV_Controller::initCycle() {
 }
 
 void VC_CMV_Controller::inhale() {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+    Blower& blower = context().blower;
+
     m_inspiratoryValveLastAperture = inspiratoryValve.maxAperture();
 
     expiratoryValve.close();
@@ -149,6 +159,10 @@ void VC_CMV_Controller::inhale() {
 }
 
 void VC_CMV_Controller::exhale() {
+    MainController& mainController = context().mainController;
+    PressureValve& inspiratoryValve = context().inspiratoryValve;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     // Open the expiration valve using PID so the patient can exhale outside
     int32_t expiratoryValveOpenningValue = PCexpiratoryPID(
         mainController.pressureCommand(), mainController.pressure(), mainController.dt());
@@ -162,6 +176,8 @@ void VC_CMV_Controller::exhale() {
 void VC_CMV_Controller::endCycle() {}
 
 void VC_CMV_Controller::calculateBlower() {
+    MainController& mainController = context().mainController;
+
     // Compute target flow for inspiration
     int32_t inspirationDurationMs =
         ((mainController.ticksPerInhalation() * MAIN_CONTROLLER_COMPUTE_PERIOD_MS)
@@ -177,6 +193,9 @@ void VC_CMV_Controller::calculateBlower() {
 
 int32_t
 VC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressure, int32_t dt) {
+    MainController& mainController = context().mainController;
+    PressureValve& expiratoryValve = context().expiratoryValve;
+
     int32_t minAperture = expiratoryValve.minAperture();
     int32_t maxAperture = expiratoryValve.maxAperture();
     int32_t expiratoryValveAperture;
@@ -270,3 +289,21 @@ VC_CMV_Controller::PCexpiratoryPID(int32_t targetPressure, int32_t currentPressu
 
     return expiratoryValveAperture;
 }
+
+void VC_CMV_Controller::checkpoint(CheckpointArchive* p_archive) {
+    p_archive->field(m_duringPlateau);
+    p_archive->field(m_blowerSpeed);
+    p_archive->field(m_targetFlowMultiplyBy1000);
+    p_archive->field(m_expiratoryPidFastMode);
+    p_archive->field(m_expiratoryPidIntegral);
+    p_archive->field(m_inspiratoryPidIntegral);
+    p_archive->field(m_inspiratoryValveLastAperture);
+    p_archive->field(m_expiratoryValveLastAperture);
+    p_archive->field(m_expiratoryPidLastError);
+    p_archive->field(m_expiratoryPidLastErrors);
+    p_archive->field(m_expiratoryPidLastErrorsIndex);
+    p_archive->field(m_inspiratoryFlowLastValues);
+    p_archive->field(m_inspiratoryFlowLastValuesIndex);
+    p_archive->field(m_maxInspiratoryFlow);
+    p_archive->field(m_blowerTicks);
+}
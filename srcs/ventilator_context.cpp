@@ -0,0 +1,38 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file ventilator_context.cpp
+ * @brief Actuators and controllers of one ventilator
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "../includes/ventilator_context.h"
+
+// INITIALISATION =============================================================
+
+BOARD_STATE VentilatorContext ventilator;
+
+// FUNCTIONS ==================================================================
+
+VentilatorContext::VentilatorContext()
+    : mainController(this),
+      pcCmvController(this),
+      pcAcController(this),
+      vcCmvController(this),
+      vcAcController(this),
+      pcVsaiController(this) {}
+
+void VentilatorContext::checkpoint(CheckpointArchive* p_archive) {
+    inspiratoryValve.checkpoint(p_archive);
+    expiratoryValve.checkpoint(p_archive);
+    blower.checkpoint(p_archive);
+    alarmController.checkpoint(p_archive);
+    mainController.checkpoint(p_archive);
+    pcCmvController.checkpoint(p_archive);
+    pcAcController.checkpoint(p_archive);
+    vcCmvController.checkpoint(p_archive);
+    vcAcController.checkpoint(p_archive);
+    pcVsaiController.checkpoint(p_archive);
+}
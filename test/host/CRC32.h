@@ -0,0 +1,71 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file CRC32.h
+ * @brief Host stand-in of the CRC32 Arduino library (bakercp/CRC32 2.0.0)
+ *
+ * Same API and same checksum (CRC-32, polynomial 0xEDB88320) as the library the firmware is
+ * built with, so that frames sent on the host can be checked like frames sent by the board.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CLASS ======================================================================
+
+/// Incremental CRC-32 checksum
+class CRC32 {
+ public:
+    /// Default constructor
+    CRC32() { reset(); }
+
+    /// Start a new checksum
+    void reset() { m_state = 0xFFFFFFFFu; }
+
+    /**
+     * Add a byte to the checksum
+     *
+     * @param p_data Byte
+     */
+    void update(const uint8_t& p_data) {
+        m_state ^= p_data;
+        for (uint8_t bit = 0; bit < 8u; bit++) {
+            m_state = (m_state >> 1) ^ ((m_state & 1u) ? 0xEDB88320u : 0u);
+        }
+    }
+
+    /**
+     * Add the bytes of a value to the checksum
+     *
+     * @param p_data Value, its sizeof(Type) bytes are added in memory order
+     */
+    template <typename Type>
+    void update(const Type& p_data) {
+        update(&p_data, 1);
+    }
+
+    /**
+     * Add the bytes of an array to the checksum
+     *
+     * @param p_data Array
+     * @param p_size Number of elements
+     */
+    template <typename Type>
+    void update(const Type* p_data, size_t p_size) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(p_data);
+        for (size_t i = 0; i < (p_size * sizeof(Type)); i++) {
+            update(bytes[i]);
+        }
+    }
+
+    /// Value of the checksum
+    uint32_t finalize() const { return ~m_state; }
+
+ private:
+    /// Current state of the checksum
+    uint32_t m_state;
+};
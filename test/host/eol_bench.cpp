@@ -0,0 +1,320 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file eol_bench.cpp
+ * @brief End of line test of a simulated machine, with a scripted operator
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "eol_bench.h"
+
+// Internal
+#include "../../includes/battery.h"
+#include "../../includes/board_state.h"
+#include "../../includes/hal.h"
+#include "../../includes/parameters.h"
+#include "../../includes/serial_control.h"
+#include "../../includes/telemetry.h"
+#include "../../includes/timebase.h"
+#include "../../includes/ventilator_context.h"
+#include "sensor_model.h"
+#include "simulator.h"
+#include "ui_link.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the simulation steps and of the actions of the operator
+#define EOL_BENCH_SAMPLE_PERIOD_US 1000u
+
+/// Time the run goes on after its last step, so that the screen and the UI show it, in ms
+#define EOL_BENCH_FINAL_DISPLAY_MS 1000u
+
+/// Offsets of the step and of the state in the fields of an end of line snapshot
+#define EOL_SNAPSHOT_STEP_INDEX 0u
+#define EOL_SNAPSHOT_STATE_INDEX 2u
+
+/// Names of the steps, in the order of TestStep
+static const char* const EOL_STEP_NAMES[] = {"START",
+                                             "SUPPLY_TO_EXPANDER_NOT_CONNECTED",
+                                             "CHECK_FAN",
+                                             "TEST_BAT_DEAD",
+                                             "BATTERY_DEEP_DISCHARGE",
+                                             "DISCONNECT_MAINS",
+                                             "CONNECT_MAINS",
+                                             "CHECK_BUZZER",
+                                             "CHECK_ALL_BUTTONS",
+                                             "CHECK_UI_SCREEN",
+                                             "PLUG_AIR_TEST_SYTEM",
+                                             "REACH_MAX_PRESSURE",
+                                             "MAX_PRESSURE_REACHED_OK",
+                                             "MAX_PRESSURE_NOT_REACHED",
+                                             "START_LEAK_MESURE",
+                                             "LEAK_IS_TOO_HIGH",
+                                             "REACH_NULL_PRESSURE",
+                                             "MIN_PRESSURE_NOT_REACHED",
+                                             "USER_CONFIRMATION_BEFORE_O2_TEST",
+                                             "START_O2_TEST",
+                                             "O2_PRESSURE_NOT_REACH",
+                                             "WAIT_USER_BEFORE_LONG_RUN",
+                                             "START_LONG_RUN_BLOWER",
+                                             "PRESSURE_NOT_STABLE",
+                                             "FLOW_NOT_STABLE",
+                                             "END_SUCCESS",
+                                             "DISPLAY_PRESSURE",
+                                             "DISPLAY_FLOW"};
+
+/// Plant of the machine under test, stepped by the simulation until the next run
+static BOARD_STATE PneumaticPlant eolPlant;
+
+/// Sensors of the plant, when the pressure sensor is noisy
+static BOARD_STATE PlantSensors eolSensors;
+
+// FUNCTIONS ==================================================================
+
+EolBenchSetup healthyEolBench() {
+    EolBenchSetup setup = {true,
+                           true,
+                           26.0,
+                           {5.0, 10.0},
+                           0,
+                           1.0,
+                           false,
+                           10000.0,
+                           0.0,
+                           false,
+                           HOST_FLOW_METER_ANSWERS,
+                           EOL_CONFIRM_WITH_BUTTONS,
+                           EOL_BENCH_REACTION_MS};
+    return setup;
+}
+
+/**
+ * Plug or unplug the mains, the battery ADC reading the charger or the battery
+ *
+ * @param p_setup Machine under test
+ * @param p_plugged True to plug the mains
+ */
+static void plugMains(const EolBenchSetup& p_setup, bool p_plugged) {
+    setHostMainsInputs(p_plugged, p_setup.supplyCablePlugged);
+    uint16_t batteryAdc = static_cast<uint16_t>(p_setup.batteryVoltage / RAW_BATTERY_MULTIPLIER);
+    setHostBatteryAdc(p_plugged ? static_cast<uint16_t>(RAW_VOLTAGE_MAINS) : batteryAdc);
+}
+
+/**
+ * Boot the host board like respirator.cpp does with the service button held: the end of line
+ * test starts instead of the main state machine
+ *
+ * @param p_setup Machine under test
+ */
+static void bootEolBoard(const EolBenchSetup& p_setup) {
+    resetSimulation(0u);
+    plugMains(p_setup, p_setup.mainsPlugged);
+    setHostFlowMeterFault(p_setup.flowMeterMissing);
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, p_setup.flowMeterBus);
+
+    bootHostBoard();
+    sendBootMessage();
+
+    eolPlant = PneumaticPlant();
+    eolPlant.setBlowerEfficiency(p_setup.blowerEfficiency);
+    if (p_setup.pressureNoise > 0.0) {
+        SensorModelSettings pressure = idealSensor(SENSOR_PRESSURE_ADC);
+        pressure.noise = p_setup.pressureNoise;
+        eolSensors.pressure = SensorModel(pressure, 1u);
+        eolSensors.inspiratoryFlow = SensorModel(idealSensor(BOARD_INSPIRATORY_SENSOR), 2u);
+        eolSensors.expiratoryFlow = SensorModel(idealSensor(BOARD_EXPIRATORY_SENSOR), 3u);
+        eolPlant.setSensors(&eolSensors);
+    }
+    setSimulatedPlant(&eolPlant, EOL_BENCH_SAMPLE_PERIOD_US);
+
+    eolTest.activate();
+    eolTest.setupAndStart();
+}
+
+/**
+ * Confirm a step, as the operator does
+ *
+ * @param p_setup Operator
+ * @param p_button Button that confirms the step on the front panel
+ */
+static void confirmStep(const EolBenchSetup& p_setup, HalButton p_button) {
+    if (p_setup.confirmation == EOL_CONFIRM_ON_UI) {
+        uint8_t frame[CONTROL_FRAME_SIZE];
+        encodeControlFrame(EolConfirm, 0u, frame);
+        pushHostTelemetryInput(frame, CONTROL_FRAME_SIZE);
+    } else {
+        pressHostButton(p_button);
+    }
+}
+
+/**
+ * Do what the screen asks for a step
+ *
+ * @param p_setup Machine under test and operator
+ * @param p_step Step
+ * @param p_report Run, told whether the buzzer sounded
+ */
+static void operateStep(const EolBenchSetup& p_setup, TestStep p_step, EolBenchReport* p_report) {
+    if ((p_step == START) || (p_step == CHECK_FAN) || (p_step == END_SUCCESS)
+        || (p_step == DISPLAY_PRESSURE)) {
+        confirmStep(p_setup, HAL_BUTTON_START);
+    } else if (p_step == DISCONNECT_MAINS) {
+        plugMains(p_setup, false);
+    } else if (p_step == CONNECT_MAINS) {
+        plugMains(p_setup, true);
+    } else if (p_step == CHECK_BUZZER) {
+        p_report->buzzerChecked = hostBuzzerOn();
+        if (p_report->buzzerChecked) {
+            confirmStep(p_setup, HAL_BUTTON_STOP);
+        }
+    } else if (p_step == CHECK_ALL_BUTTONS) {
+        for (uint8_t i = 0; i < HAL_BUTTONS; i++) {
+            pressHostButton(static_cast<HalButton>(i));
+        }
+        // There is no key on the last column of the last row
+        for (uint8_t column = 0; column < HAL_KEYBOARD_COLUMNS; column++) {
+            for (uint8_t row = 0; row < HAL_KEYBOARD_ROWS; row++) {
+                if ((column < (HAL_KEYBOARD_COLUMNS - 1u)) || (row < (HAL_KEYBOARD_ROWS - 1u))) {
+                    pressHostKeyboardKey(column, row);
+                }
+            }
+        }
+    } else if (p_step == CHECK_UI_SCREEN) {
+        // Only the touchscreen confirms this one
+        EolBenchSetup ui = p_setup;
+        ui.confirmation = EOL_CONFIRM_ON_UI;
+        confirmStep(ui, HAL_BUTTON_START);
+    } else if (p_step == PLUG_AIR_TEST_SYTEM) {
+        eolPlant.setLung(p_setup.testLung);
+        eolPlant.setLeak(p_setup.leakSectionX100);
+        confirmStep(p_setup, HAL_BUTTON_START);
+    } else if (p_step == USER_CONFIRMATION_BEFORE_O2_TEST) {
+        eolPlant.setOxygenFlow(p_setup.oxygenFlow);
+        confirmStep(p_setup, HAL_BUTTON_START);
+    } else if (p_step == WAIT_USER_BEFORE_LONG_RUN) {
+        eolPlant.setOxygenFlow(0.0);
+        confirmStep(p_setup, HAL_BUTTON_START);
+    } else {
+        // The other steps run on their own
+    }
+}
+
+/**
+ * Read the end of line snapshots the board sent to the UI
+ *
+ * @param p_received Bytes received and not decoded yet
+ * @param p_report Run, told the snapshots
+ */
+static void receiveSnapshots(std::vector<uint8_t>* p_received, EolBenchReport* p_report) {
+    uint8_t buffer[TELEMETRY_FRAME_MAX_SIZE];
+    size_t size = popHostTelemetryOutput(buffer, sizeof(buffer));
+    p_received->insert(p_received->end(), buffer, buffer + size);
+
+    bool complete = true;
+    while (complete && !p_received->empty()) {
+        TelemetryFrame frame;
+        TelemetryDecoding decoding =
+            decodeTelemetryFrame(p_received->data(), p_received->size(), &frame);
+        if (decoding == TELEMETRY_FRAME_DECODED) {
+            if ((frame.type == 'L') && (frame.fields.size() > EOL_SNAPSHOT_STATE_INDEX)) {
+                p_report->snapshots++;
+                p_report->snapshotStep =
+                    static_cast<TestStep>(frame.fields[EOL_SNAPSHOT_STEP_INDEX]);
+            }
+            p_received->erase(p_received->begin(), p_received->begin() + frame.size);
+        } else if (decoding == TELEMETRY_FRAME_INVALID) {
+            p_received->erase(p_received->begin());
+        } else {
+            complete = false;
+        }
+    }
+}
+
+EolBenchReport runEolBench(const EolBenchSetup& p_setup, uint32_t p_timeoutMs) {
+    EolBenchReport report;
+    report.step = START;
+    report.state = STATE_IN_PROGRESS;
+    report.steps.push_back(START);
+    report.durationS = 0.0;
+    report.snapshots = 0u;
+    report.snapshotStep = START;
+    report.buzzerChecked = false;
+
+    bootEolBoard(p_setup);
+
+    std::vector<uint8_t> received;
+    uint64_t timeoutUs = static_cast<uint64_t>(p_timeoutMs) * 1000u;
+    uint64_t stepStartUs = monotonicMicros();
+    uint64_t endUs = timeoutUs;
+    bool operated = false;
+    while (monotonicMicros() < endUs) {
+        runSimulation(EOL_BENCH_SAMPLE_PERIOD_US);
+        receiveSnapshots(&received, &report);
+
+        TestStep step = eolTest.currentStep();
+        if (step != report.steps.back()) {
+            report.steps.push_back(step);
+            stepStartUs = monotonicMicros();
+            operated = false;
+
+            // The expiratory valve seizes where the measure of the leak holds it, closed
+            if (step == START_LEAK_MESURE) {
+                eolPlant.setValveJammed(HAL_PWM_EXPIRATORY_VALVE, p_setup.expiratoryValveJammed);
+            }
+
+            // A failed step or the display of the flows ends the run
+            if ((eolTest.currentState() == STATE_ERROR) || (step == DISPLAY_FLOW)) {
+                endUs = min(endUs, monotonicMicros() + (EOL_BENCH_FINAL_DISPLAY_MS * 1000u));
+            }
+        }
+
+        if (!operated && (step != DISPLAY_FLOW)
+            && ((monotonicMicros() - stepStartUs) >= (p_setup.reactionMs * 1000u))) {
+            operateStep(p_setup, step, &report);
+            operated = true;
+        }
+    }
+
+    report.step = eolTest.currentStep();
+    report.state = eolTest.currentState();
+    report.durationS = static_cast<double>(monotonicMicros()) / 1000000.0;
+    report.screen = hostEndOfLineTestMessage();
+    return report;
+}
+
+const char* eolStepName(TestStep p_step) {
+    size_t count = sizeof(EOL_STEP_NAMES) / sizeof(EOL_STEP_NAMES[0]);
+    return (static_cast<size_t>(p_step) < count) ? EOL_STEP_NAMES[p_step] : "?";
+}
+
+void printEolBenchReport(const EolBenchReport& p_report, FILE* p_output) {
+    const char* outcome = "in progress";
+    if (p_report.state == STATE_SUCCESS) {
+        outcome = "success";
+    } else if (p_report.state == STATE_ERROR) {
+        outcome = "failure";
+    }
+    fprintf(p_output, "End of line test: %s at %s after %.1f s\n", outcome,
+            eolStepName(p_report.step), p_report.durationS);
+    fprintf(p_output, "Steps:");
+    for (size_t i = 0; i < p_report.steps.size(); i++) {
+        fprintf(p_output, " %s", eolStepName(p_report.steps[i]));
+    }
+    fprintf(p_output, "\n");
+    fprintf(p_output, "Buzzer %s, %u snapshots received by the UI, the last one at %s\n",
+            p_report.buzzerChecked ? "heard" : "not heard", p_report.snapshots,
+            eolStepName(p_report.snapshotStep));
+
+    // The screen, one line per line of the LCD
+    fprintf(p_output, "Screen:\n  ");
+    for (size_t i = 0; i < p_report.screen.size(); i++) {
+        if (p_report.screen[i] == '\n') {
+            fprintf(p_output, "\n  ");
+        } else {
+            fputc(p_report.screen[i], p_output);
+        }
+    }
+    fprintf(p_output, "\n");
+}
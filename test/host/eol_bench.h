@@ -0,0 +1,132 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file eol_bench.h
+ * @brief End of line test of a simulated machine, with a scripted operator
+ *
+ * The host board boots in end of line test mode, as when the service button is held at power on,
+ * and EolTest runs its steps on the control timer against the pneumatic plant. A scripted operator
+ * does what the screen asks, a moment after each new step: it presses START, PAUSE and every key,
+ * or confirms on the touchscreen of the UI through the EolConfirm control frame, unplugs and plugs
+ * the mains, plugs the testing pipes, and opens and closes the oxygen inlet.
+ *
+ * The machine under test can have the faults the test is meant to catch: the power supply cable
+ * of the motherboard unplugged, a flat battery, a blower that builds too little pressure, leaky
+ * testing pipes, a jammed expiratory valve, a blocked oxygen pipe, a noisy pressure sensor, and a
+ * missing flow meter. Every step waits on the simulated clock, so that the whole test runs in a few
+ * seconds.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../../includes/end_of_line_test.h"
+#include "host_board.h"
+#include "pneumatic_plant.h"
+
+// INITIALISATION =============================================================
+
+/// Default time the operator takes to act on a new step, in ms
+#define EOL_BENCH_REACTION_MS 500u
+
+/// How the operator confirms the steps that wait for a confirmation
+enum EolConfirmation {
+    /// With the buttons of the front panel: START, or PAUSE while the buzzer sounds
+    EOL_CONFIRM_WITH_BUTTONS,
+    /// On the touchscreen of the UI, through the EolConfirm control frame
+    EOL_CONFIRM_ON_UI
+};
+
+/// Machine under test and operator
+struct EolBenchSetup {
+    /// Mains plugged when the test starts
+    bool mainsPlugged;
+    /// Power supply cable of the motherboard plugged: the mains are not sensed otherwise
+    bool supplyCablePlugged;
+    /// Battery voltage in V, read while the mains are unplugged
+    double batteryVoltage;
+    /// Testing pipes and test lung the operator plugs
+    LungCompartment testLung;
+    /// Leak of the testing pipes, in mm² x 100
+    int32_t leakSectionX100;
+    /// Ratio of the pressure the blower builds to its characteristic
+    double blowerEfficiency;
+    /// Expiratory valve jammed closed once the measure of the leak starts
+    bool expiratoryValveJammed;
+    /// Flow of the oxygen inlet once opened, in mL/min, 0 for a blocked pipe
+    double oxygenFlow;
+    /// Standard deviation of the noise of the pressure sensor, in mmH2O
+    double pressureNoise;
+    /// Flow meters missing: they never answer
+    bool flowMeterMissing;
+    /// Answers of the inspiratory flow meter on the I2C bus
+    HostFlowMeterBus flowMeterBus;
+    /// Confirmations of the operator
+    EolConfirmation confirmation;
+    /// Time the operator takes to act on a new step, in ms
+    uint32_t reactionMs;
+};
+
+/// Run of the end of line test
+struct EolBenchReport {
+    /// Step the test ended at
+    TestStep step;
+    /// Outcome of the test
+    TestState state;
+    /// Steps the test went through, from START
+    std::vector<TestStep> steps;
+    /// Simulated duration of the run, in s
+    double durationS;
+    /// End of line snapshots received by the UI
+    uint32_t snapshots;
+    /// Step of the last snapshot received by the UI
+    TestStep snapshotStep;
+    /// True if the buzzer sounded when it was checked
+    bool buzzerChecked;
+    /// Last message of the test on the screen
+    std::string screen;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Machine without a fault, with a 1 L test lung, mains plugged and a charged battery, and an
+ * operator who confirms with the buttons
+ *
+ * @return Setup
+ */
+EolBenchSetup healthyEolBench();
+
+/**
+ * Run the end of line test of a machine
+ *
+ * @param p_setup Machine under test and operator
+ * @param p_timeoutMs Longest simulated duration, in ms
+ * @return Run, it ends on a failed step, on the display of the flows after a success, or at the
+ *         timeout
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+EolBenchReport runEolBench(const EolBenchSetup& p_setup, uint32_t p_timeoutMs);
+
+/**
+ * Name of a step of the end of line test
+ *
+ * @param p_step Step
+ * @return Name, as in end_of_line_test.h
+ */
+const char* eolStepName(TestStep p_step);
+
+/**
+ * Write a run as text
+ *
+ * @param p_report Run
+ * @param p_output Output
+ */
+void printEolBenchReport(const EolBenchReport& p_report, FILE* p_output);
@@ -0,0 +1,517 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file fault_injection.cpp
+ * @brief Sensor, bus and link faults injected on a schedule into a simulated session
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "fault_injection.h"
+
+// Externals
+#include <algorithm>
+#include <cmath>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/alarm_controller.h"
+#include "../../includes/battery.h"
+#include "../../includes/cycle.h"
+#include "../../includes/hal.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/main_state_machine.h"
+#include "../../includes/parameters.h"
+#include "../../includes/serial_control.h"
+#include "../../includes/ventilator_context.h"
+#include "simulator.h"
+#include "ui_link.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the simulation steps, of the fault updates and of the pressure samples
+#define FAULT_SAMPLE_PERIOD_US 1000u
+
+/// Duration of the PEEP measure at the end of a cycle, in samples
+#define FAULT_PEEP_SAMPLES 100u
+
+/// Period of the control frames sent during a frame fault and after it, in ms
+#define FAULT_FRAME_PERIOD_MS 100u
+
+/// Bytes of a truncated control frame: header, setting, value and the first CRC byte
+#define FAULT_TRUNCATED_FRAME_SIZE 6u
+
+/// Pressure error, in mmH2O, within which the control has recovered from the faults
+#define FAULT_RECOVERED_PRESSURE_ERROR 20.0
+
+/// State of the control frames of a fault
+struct FaultFrames {
+    /// Value of the last valid frame sent, or FAULT_NOT_SEEN
+    int32_t pendingValue;
+    /// Date of the last valid frame sent, in ms after the start of the breathing
+    uint32_t pendingMs;
+};
+
+/// Airway pressure and phase during one respiratory cycle
+struct FaultCycle {
+    std::vector<double> pressures;
+    uint32_t inhalationSamples;
+    uint32_t startMs;
+};
+
+// FUNCTIONS ==================================================================
+
+std::vector<ScheduledFault> defaultFaultSchedule() {
+    std::vector<ScheduledFault> schedule;
+    const ScheduledFault faults[] = {
+        {FAULT_FLOW_METER_NACK, 0u, 3000u, HOST_INSPIRATORY_FLOW_METER, 0u},
+        {FAULT_FLOW_METER_SHORT_READ, 0u, 3000u, HOST_EXPIRATORY_FLOW_METER, 0u},
+        {FAULT_SPURIOUS_FLOW, 0u, 3000u, HOST_INSPIRATORY_FLOW_METER, 0u},
+        // A dropout of the ADC, short enough for the mean voltage to stay above the stop
+        // threshold, and a droop to between the very low and the stop thresholds
+        {FAULT_BATTERY_SPIKE, 0u, 30u, HOST_INSPIRATORY_FLOW_METER, 0u},
+        {FAULT_BATTERY_DROOP, 0u, 3000u, HOST_INSPIRATORY_FLOW_METER, 2900u},
+        {FAULT_TRUNCATED_FRAME, 0u, 3000u, HOST_INSPIRATORY_FLOW_METER, 0u},
+        {FAULT_CORRUPTED_FRAME, 0u, 3000u, HOST_INSPIRATORY_FLOW_METER, 0u},
+    };
+    uint32_t startMs = 10000u;
+    for (const ScheduledFault& fault : faults) {
+        ScheduledFault scheduled = fault;
+        scheduled.startMs = startMs;
+        schedule.push_back(scheduled);
+        startMs += 8000u;
+    }
+    return schedule;
+}
+
+const char* faultKindName(FaultKind p_kind) {
+    const char* name = "unknown";
+    switch (p_kind) {
+    case FAULT_FLOW_METER_NACK:
+        name = "flow meter NACK";
+        break;
+    case FAULT_FLOW_METER_SHORT_READ:
+        name = "flow meter short read";
+        break;
+    case FAULT_SPURIOUS_FLOW:
+        name = "spurious 500 SLM flow";
+        break;
+    case FAULT_BATTERY_SPIKE:
+        name = "battery ADC spike";
+        break;
+    case FAULT_BATTERY_DROOP:
+        name = "battery droop";
+        break;
+    case FAULT_TRUNCATED_FRAME:
+        name = "truncated control frame";
+        break;
+    case FAULT_CORRUPTED_FRAME:
+        name = "corrupted control frame";
+        break;
+    default:
+        break;
+    }
+    return name;
+}
+
+/**
+ * Check if a fault is running at a date
+ *
+ * @param p_fault Fault
+ * @param p_dateMs Date in ms after the start of the breathing
+ * @return True from its start, included, to its end, excluded
+ */
+static bool isFaultActive(const ScheduledFault& p_fault, uint32_t p_dateMs) {
+    return (p_dateMs >= p_fault.startMs) && ((p_dateMs - p_fault.startMs) < p_fault.durationMs);
+}
+
+void applyInputFaults(const std::vector<ScheduledFault>& p_schedule, uint32_t p_dateMs) {
+    HostFlowMeterBus buses[HOST_FLOW_METERS] = {HOST_FLOW_METER_ANSWERS, HOST_FLOW_METER_ANSWERS};
+    uint16_t batteryAdc = RAW_VOLTAGE_MAINS;
+    bool mainsConnected = true;
+
+    for (const ScheduledFault& fault : p_schedule) {
+        if (!isFaultActive(fault, p_dateMs)) {
+            continue;
+        }
+        uint32_t elapsedMs = p_dateMs - fault.startMs;
+        switch (fault.kind) {
+        case FAULT_FLOW_METER_NACK:
+            buses[fault.flowMeter] = HOST_FLOW_METER_NACK;
+            break;
+        case FAULT_FLOW_METER_SHORT_READ:
+            buses[fault.flowMeter] = HOST_FLOW_METER_SHORT_READ;
+            break;
+        case FAULT_SPURIOUS_FLOW:
+            buses[HOST_INSPIRATORY_FLOW_METER] = HOST_FLOW_METER_SPURIOUS_VALUE;
+            break;
+        case FAULT_BATTERY_SPIKE:
+            batteryAdc = fault.batteryAdc;
+            break;
+        case FAULT_BATTERY_DROOP:
+            mainsConnected = false;
+            batteryAdc = static_cast<uint16_t>(
+                RAW_VOLTAGE_MAINS
+                - (((static_cast<int32_t>(RAW_VOLTAGE_MAINS) - fault.batteryAdc) * elapsedMs)
+                   / static_cast<int32_t>(fault.durationMs)));
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (uint8_t i = 0; i < HOST_FLOW_METERS; i++) {
+        setHostFlowMeterBus(static_cast<HostFlowMeter>(i), buses[i]);
+    }
+    setHostBatteryAdc(batteryAdc);
+    setHostMainsInputs(mainsConnected, true);
+}
+
+/**
+ * Send a valid control frame that changes a setting without effect on the pressure controlled
+ * modes, so that its application can be told
+ *
+ * @return Value of the expiratory trigger flow sent
+ */
+static int32_t sendValidControlFrame() {
+    uint16_t value = (ventilator.mainController.expiratoryTriggerFlowNextCommand()
+                      == static_cast<int16_t>(DEFAULT_EXPIRATORY_TRIGGER_FLOW_COMMAND))
+                         ? (DEFAULT_EXPIRATORY_TRIGGER_FLOW_COMMAND + 1u)
+                         : DEFAULT_EXPIRATORY_TRIGGER_FLOW_COMMAND;
+    uint8_t frame[CONTROL_FRAME_SIZE];
+    encodeControlFrame(ExpiratoryTriggerFlow, value, frame);
+    pushHostTelemetryInput(frame, sizeof(frame));
+    return value;
+}
+
+/**
+ * Send a damaged control frame that would move the PEEP command, then a valid frame
+ *
+ * @param p_kind FAULT_TRUNCATED_FRAME or FAULT_CORRUPTED_FRAME
+ * @param p_peep PEEP command of the session
+ * @return Value of the expiratory trigger flow sent by the valid frame
+ */
+static int32_t sendDamagedControlFrame(FaultKind p_kind, int16_t p_peep) {
+    uint16_t damagedPeep = static_cast<uint16_t>((p_peep >= 100) ? (p_peep - 50) : (p_peep + 50));
+    uint8_t frame[CONTROL_FRAME_SIZE];
+    encodeControlFrame(PEEP, damagedPeep, frame);
+    if (p_kind == FAULT_TRUNCATED_FRAME) {
+        pushHostTelemetryInput(frame, FAULT_TRUNCATED_FRAME_SIZE);
+    } else {
+        frame[4] ^= 0x01u;
+        pushHostTelemetryInput(frame, sizeof(frame));
+    }
+    return sendValidControlFrame();
+}
+
+/**
+ * Send the control frames of a fault at a date, and check what the previous ones did
+ *
+ * @param p_session Settings of the session
+ * @param p_dateMs Date in ms after the start of the breathing
+ * @param p_frames State of the frames of the fault
+ * @param p_report Report of the fault, updated
+ */
+static void runFaultFrames(const SweepSession& p_session,
+                           uint32_t p_dateMs,
+                           FaultFrames* p_frames,
+                           FaultReport* p_report) {
+    const ScheduledFault& fault = p_report->fault;
+    bool isFrameFault =
+        (fault.kind == FAULT_TRUNCATED_FRAME) || (fault.kind == FAULT_CORRUPTED_FRAME);
+    if (!isFrameFault || (p_dateMs < fault.startMs) || (p_report->linkRecoveryMs != FAULT_NOT_SEEN)
+        || (((p_dateMs - fault.startMs) % FAULT_FRAME_PERIOD_MS) != 0u)) {
+        return;
+    }
+    uint32_t endMs = fault.startMs + fault.durationMs;
+
+    if (ventilator.mainController.peepNextCommand() != p_session.peep) {
+        p_report->damagedFramesApplied++;
+        ventilator.mainController.onPeepSet(p_session.peep);
+    }
+    if (p_frames->pendingValue != FAULT_NOT_SEEN) {
+        bool applied = (ventilator.mainController.expiratoryTriggerFlowNextCommand()
+                        == p_frames->pendingValue);
+        if (p_frames->pendingMs < endMs) {
+            p_report->framesLost += applied ? 0u : 1u;
+        } else if (applied) {
+            p_report->linkRecoveryMs = static_cast<int32_t>(p_frames->pendingMs - endMs);
+            return;
+        } else {
+            // The link has not recovered yet
+        }
+    }
+
+    if (p_dateMs < endMs) {
+        p_frames->pendingValue = sendDamagedControlFrame(fault.kind, p_session.peep);
+        p_report->framesSent++;
+    } else {
+        p_frames->pendingValue = sendValidControlFrame();
+    }
+    p_frames->pendingMs = p_dateMs;
+}
+
+/**
+ * Measure the pressure errors of a cycle
+ *
+ * @param p_session Settings of the session
+ * @param p_cycle Samples of the cycle
+ * @param p_plateauError Airway pressure error at the end of the inspiration, 0 for the volume
+ *                       controlled modes
+ * @param p_peepError Error of the mean airway pressure over the end of the cycle
+ */
+static void measureFaultCycle(const SweepSession& p_session,
+                              const FaultCycle& p_cycle,
+                              double* p_plateauError,
+                              double* p_peepError) {
+    const std::vector<double>& pressures = p_cycle.pressures;
+    double peep = 0.0;
+    size_t peepStart = pressures.size() - std::min<size_t>(pressures.size(), FAULT_PEEP_SAMPLES);
+    for (size_t i = peepStart; i < pressures.size(); i++) {
+        peep += pressures[i] / static_cast<double>(pressures.size() - peepStart);
+    }
+    *p_peepError = std::abs(peep - p_session.peep);
+
+    *p_plateauError = 0.0;
+    if (isPressureControlled(p_session.mode) && (p_cycle.inhalationSamples > 0u)) {
+        *p_plateauError =
+            std::abs(pressures[p_cycle.inhalationSamples - 1u] - p_session.plateauPressure);
+    }
+}
+
+/// Alarms triggered now
+static std::vector<uint8_t> triggeredAlarms() {
+    const uint8_t* alarms = ventilator.alarmController.triggeredAlarms();
+    std::vector<uint8_t> triggered;
+    for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
+        if (alarms[i] != 0u) {
+            triggered.push_back(alarms[i]);
+        }
+    }
+    return triggered;
+}
+
+/**
+ * Check if an alarm is in a list
+ *
+ * @param p_alarms Alarm codes
+ * @param p_code Alarm code
+ * @return True if it is
+ */
+static bool hasAlarm(const std::vector<uint8_t>& p_alarms, uint8_t p_code) {
+    return std::find(p_alarms.begin(), p_alarms.end(), p_code) != p_alarms.end();
+}
+
+/**
+ * Attribute the alarms triggered since the previous call to the last fault started
+ *
+ * @param p_dateMs Date in ms after the start of the breathing
+ * @param p_baseline Alarms triggered at this date without the faults, they are not attributed
+ * @param p_triggered Alarms triggered at the previous call, updated
+ * @param p_atStart Alarms triggered at the start of every fault
+ * @param p_reports Reports of the faults
+ */
+static void attributeFaultAlarms(uint32_t p_dateMs,
+                                 const std::vector<uint8_t>& p_baseline,
+                                 std::vector<uint8_t>* p_triggered,
+                                 const std::vector<std::vector<uint8_t>>& p_atStart,
+                                 std::vector<FaultReport>* p_reports) {
+    std::vector<uint8_t> triggered = triggeredAlarms();
+
+    size_t last = p_reports->size();
+    for (size_t i = 0; i < p_reports->size(); i++) {
+        if ((*p_reports)[i].fault.startMs <= p_dateMs) {
+            last = i;
+        }
+    }
+    if (last < p_reports->size()) {
+        FaultReport& report = (*p_reports)[last];
+        for (uint8_t code : triggered) {
+            bool isReported = false;
+            for (const FaultAlarm& alarm : report.alarms) {
+                isReported = isReported || (alarm.code == code);
+            }
+            if (!hasAlarm(*p_triggered, code) && !hasAlarm(p_atStart[last], code)
+                && !hasAlarm(p_baseline, code) && !isReported) {
+                FaultAlarm alarm = {code, p_dateMs - report.fault.startMs};
+                report.alarms.push_back(alarm);
+            }
+        }
+    }
+    *p_triggered = triggered;
+}
+
+/**
+ * Follow the fault condition of the flow meters during and after a fault
+ *
+ * @param p_dateMs Date in ms after the start of the breathing
+ * @param p_report Report of the fault, updated
+ */
+static void followFlowMeterFault(uint32_t p_dateMs, FaultReport* p_report) {
+    const ScheduledFault& fault = p_report->fault;
+    bool faultCondition = hostFlowMeterFaultCondition();
+    if (isFaultActive(fault, p_dateMs)) {
+        if (faultCondition && (p_report->flowMeterFaultMs == FAULT_NOT_SEEN)) {
+            p_report->flowMeterFaultMs = static_cast<int32_t>(p_dateMs - fault.startMs);
+        }
+    } else if ((p_dateMs >= fault.startMs) && (p_report->flowMeterFaultMs != FAULT_NOT_SEEN)
+               && (p_report->flowMeterRecoveryMs == FAULT_NOT_SEEN) && !faultCondition) {
+        p_report->flowMeterRecoveryMs =
+            static_cast<int32_t>(p_dateMs - (fault.startMs + fault.durationMs));
+    } else {
+        // Before the fault, or its recovery is known
+    }
+}
+
+/**
+ * Run a session with faults injected on a schedule
+ *
+ * @param p_session Patient, mode and settings
+ * @param p_schedule Faults, sorted by start
+ * @param p_durationMs Duration of the breathing, in ms
+ * @param p_baseline Alarms triggered every ms of the session without the faults, or nullptr
+ * @param p_alarms Alarms triggered every ms, or nullptr
+ * @return What the faults did
+ */
+static FaultRunReport simulateFaults(const SweepSession& p_session,
+                                     const std::vector<ScheduledFault>& p_schedule,
+                                     uint32_t p_durationMs,
+                                     const std::vector<std::vector<uint8_t>>* p_baseline,
+                                     std::vector<std::vector<uint8_t>>* p_alarms) {
+    FaultRunReport run;
+    run.maxPlateauError = 0.0;
+    run.maxPeepError = 0.0;
+    run.recoveryCycles = FAULT_NOT_SEEN;
+    for (const ScheduledFault& fault : p_schedule) {
+        FaultReport report;
+        report.fault = fault;
+        report.flowMeterFaultMs = FAULT_NOT_SEEN;
+        report.flowMeterRecoveryMs = FAULT_NOT_SEEN;
+        report.framesSent = 0u;
+        report.framesLost = 0u;
+        report.damagedFramesApplied = 0u;
+        report.linkRecoveryMs = FAULT_NOT_SEEN;
+        run.faults.push_back(report);
+    }
+    // Without faults, the whole session is measured
+    uint32_t firstFaultMs = p_schedule.empty() ? 0u : p_schedule.front().startMs;
+    uint32_t lastFaultEndMs = 0u;
+    for (const ScheduledFault& fault : p_schedule) {
+        lastFaultEndMs = std::max(lastFaultEndMs, fault.startMs + fault.durationMs);
+    }
+
+    PneumaticPlant& plant = bootSweepBoard(p_session);
+    runSimulation(1000000u);
+    activationController.onStartButton();
+
+    std::vector<FaultFrames> frames(p_schedule.size(), FaultFrames{FAULT_NOT_SEEN, 0u});
+    std::vector<std::vector<uint8_t>> atStart(p_schedule.size());
+    std::vector<uint8_t> triggered;
+    FaultCycle cycle = {std::vector<double>(), 0u, 0u};
+    uint32_t cycleNumber = 0u;
+    uint32_t outOfBoundsCycles = 0u;
+
+    for (uint32_t dateMs = 0u; dateMs < p_durationMs; dateMs++) {
+        applyInputFaults(p_schedule, dateMs);
+        for (size_t i = 0; i < p_schedule.size(); i++) {
+            if (p_schedule[i].startMs == dateMs) {
+                atStart[i] = triggered;
+            }
+            runFaultFrames(p_session, dateMs, &frames[i], &run.faults[i]);
+        }
+
+        runSimulation(FAULT_SAMPLE_PERIOD_US);
+
+        if (p_alarms != nullptr) {
+            p_alarms->push_back(triggeredAlarms());
+        }
+        const std::vector<uint8_t> none;
+        attributeFaultAlarms(dateMs + 1u, (p_baseline != nullptr) ? (*p_baseline)[dateMs] : none,
+                             &triggered, atStart, &run.faults);
+        for (FaultReport& report : run.faults) {
+            followFlowMeterFault(dateMs + 1u, &report);
+        }
+
+        if (ventilator.mainController.cycleNumber() != cycleNumber) {
+            // Cycles that end after the start of the first fault are measured
+            if ((cycleNumber > 0u) && !cycle.pressures.empty() && (dateMs >= firstFaultMs)) {
+                double plateauError = 0.0;
+                double peepError = 0.0;
+                measureFaultCycle(p_session, cycle, &plateauError, &peepError);
+                run.maxPlateauError = std::max(run.maxPlateauError, plateauError);
+                run.maxPeepError = std::max(run.maxPeepError, peepError);
+
+                bool withinBounds = (plateauError <= FAULT_RECOVERED_PRESSURE_ERROR)
+                                    && (peepError <= FAULT_RECOVERED_PRESSURE_ERROR);
+                if ((cycle.startMs >= lastFaultEndMs) && (run.recoveryCycles == FAULT_NOT_SEEN)) {
+                    if (withinBounds) {
+                        run.recoveryCycles = static_cast<int32_t>(outOfBoundsCycles);
+                    } else {
+                        outOfBoundsCycles++;
+                    }
+                }
+            }
+            cycleNumber = ventilator.mainController.cycleNumber();
+            cycle.pressures.clear();
+            cycle.inhalationSamples = 0u;
+            cycle.startMs = dateMs + 1u;
+        }
+        cycle.pressures.push_back(plant.airwayPressure());
+        if (ventilator.mainController.phase() == INHALATION) {
+            cycle.inhalationSamples = cycle.pressures.size();
+        }
+    }
+
+    run.missedControlDeadlines = mainStateMachine.missedControlDeadlines();
+    run.watchdogResets = simulatedWatchdogResets();
+    run.stable = (run.recoveryCycles != FAULT_NOT_SEEN) && (run.watchdogResets == 0u)
+                 && (run.missedControlDeadlines == 0u);
+    return run;
+}
+
+FaultRunReport runFaultSchedule(const SweepSession& p_session,
+                                const std::vector<ScheduledFault>& p_schedule,
+                                uint32_t p_durationMs) {
+    // The alarms the session triggers without the faults are not theirs
+    std::vector<std::vector<uint8_t>> baseline;
+    (void)simulateFaults(p_session, std::vector<ScheduledFault>(), p_durationMs, nullptr,
+                         &baseline);
+    return simulateFaults(p_session, p_schedule, p_durationMs, &baseline, nullptr);
+}
+
+void printFaultRunReport(const FaultRunReport& p_report, FILE* p_output) {
+    for (const FaultReport& report : p_report.faults) {
+        fprintf(p_output, "%s at %u ms for %u ms\n", faultKindName(report.fault.kind),
+                report.fault.startMs, report.fault.durationMs);
+        for (const FaultAlarm& alarm : report.alarms) {
+            fprintf(p_output, "  alarm %u after %u ms\n", alarm.code, alarm.latencyMs);
+        }
+        if (report.flowMeterFaultMs != FAULT_NOT_SEEN) {
+            fprintf(p_output, "  flow meters in fault after %d ms, ", report.flowMeterFaultMs);
+            if (report.flowMeterRecoveryMs != FAULT_NOT_SEEN) {
+                fprintf(p_output, "recovered %d ms after the fault\n",
+                        report.flowMeterRecoveryMs);
+            } else {
+                fprintf(p_output, "never recovered\n");
+            }
+        }
+        if (report.framesSent > 0u) {
+            fprintf(p_output, "  %u valid frames lost out of %u, %u damaged frames applied, ",
+                    report.framesLost, report.framesSent, report.damagedFramesApplied);
+            if (report.linkRecoveryMs != FAULT_NOT_SEEN) {
+                fprintf(p_output, "link recovered %d ms after the fault\n",
+                        report.linkRecoveryMs);
+            } else {
+                fprintf(p_output, "link never recovered\n");
+            }
+        }
+    }
+    fprintf(p_output,
+            "Largest plateau error %.1f mmH2O, largest PEEP error %.1f mmH2O, recovered after %d "
+            "cycles\n",
+            p_report.maxPlateauError, p_report.maxPeepError, p_report.recoveryCycles);
+    fprintf(p_output, "%u missed control deadlines, %u watchdog resets: control %s\n",
+            p_report.missedControlDeadlines, p_report.watchdogResets,
+            p_report.stable ? "stable" : "unstable");
+}
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file fault_injection.h
+ * @brief Sensor, bus and link faults injected on a schedule into a simulated session
+ *
+ * A session (see session_sweep.h) ventilates the simulated lungs while the faults of a schedule
+ * start and end: the flow meters stop acknowledging their address, cut their reads short or
+ * answer the spurious 500 SLM values the board filters, the battery ADC spikes or droops with the
+ * mains unplugged, and the control frames of the UI arrive truncated or corrupted. The report
+ * tells how long each alarm took to fire after a fault, how long the flow meters took to leave
+ * their reset sequence once the bus answered again, what the damaged frames did to the link, and
+ * whether the airway pressure stayed under control.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "host_board.h"
+#include "session_sweep.h"
+
+// INITIALISATION =============================================================
+
+/// Duration or date of a report that was never reached
+#define FAULT_NOT_SEEN -1
+
+/// Faults that can be injected
+enum FaultKind {
+    /// A flow meter does not acknowledge its address
+    FAULT_FLOW_METER_NACK,
+    /// A flow meter stops its reads after the first byte
+    FAULT_FLOW_METER_SHORT_READ,
+    /// The inspiratory flow meter answers spurious values of about 500 SLM
+    FAULT_SPURIOUS_FLOW,
+    /// The battery ADC reads a fixed value, mains plugged
+    FAULT_BATTERY_SPIKE,
+    /// The mains are unplugged and the battery ADC falls linearly to a value
+    FAULT_BATTERY_DROOP,
+    /// Every control frame is cut after its first CRC byte, a valid frame follows
+    FAULT_TRUNCATED_FRAME,
+    /// Every control frame has a bit of its value flipped, a valid frame follows
+    FAULT_CORRUPTED_FRAME
+};
+
+/// Fault of a schedule
+struct ScheduledFault {
+    /// Kind of fault
+    FaultKind kind;
+    /// Start, in ms after the start of the breathing
+    uint32_t startMs;
+    /// Duration, in ms
+    uint32_t durationMs;
+    /// Flow meter of the NACK and short read faults
+    HostFlowMeter flowMeter;
+    /// Raw battery ADC value of a spike, or reached at the end of a droop
+    uint16_t batteryAdc;
+};
+
+/// Alarm fired after a fault
+struct FaultAlarm {
+    /// Alarm code, see alarm_controller.h
+    uint8_t code;
+    /// Time from the start of the fault to the alarm, in ms
+    uint32_t latencyMs;
+};
+
+/// What a fault did
+struct FaultReport {
+    /// Injected fault
+    ScheduledFault fault;
+    /// Alarms fired between the start of the fault and the start of the next one, that were not
+    /// triggered when it started nor at the same date of the session without faults, in the order
+    /// they fired
+    std::vector<FaultAlarm> alarms;
+    /// Time from the start of the fault to the fault condition of the flow meters, in ms, or
+    /// FAULT_NOT_SEEN
+    int32_t flowMeterFaultMs;
+    /// Time from the end of the fault to the end of the fault condition of the flow meters, in ms,
+    /// or FAULT_NOT_SEEN if they were not in fault or did not recover
+    int32_t flowMeterRecoveryMs;
+    /// Valid control frames sent after a damaged one
+    uint32_t framesSent;
+    /// Valid control frames that were not applied
+    uint32_t framesLost;
+    /// Damaged control frames that changed the PEEP command
+    uint32_t damagedFramesApplied;
+    /// Time from the end of the fault to the sending of the first valid control frame applied, in
+    /// ms, or FAULT_NOT_SEEN
+    int32_t linkRecoveryMs;
+};
+
+/// What a schedule did to a session
+struct FaultRunReport {
+    /// Report of every fault, in the order of the schedule
+    std::vector<FaultReport> faults;
+    /// Largest airway pressure error at the end of the inspiration, in mmH2O, from the start of
+    /// the first fault on, for the pressure controlled modes
+    double maxPlateauError;
+    /// Largest PEEP error, in mmH2O, from the start of the first fault on
+    double maxPeepError;
+    /// Cycles started after the end of the last fault with the plateau pressure or the PEEP more
+    /// than 2 cmH2O away from their commands, before the first one within, or FAULT_NOT_SEEN
+    int32_t recoveryCycles;
+    /// Control ticks that missed their deadline during the session
+    uint32_t missedControlDeadlines;
+    /// Number of times the watchdog would have reset the board
+    uint32_t watchdogResets;
+    /// True if the pressures recovered, without any watchdog reset or missed control deadline
+    bool stable;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Schedule with a fault of every kind, one every 8 s from 10 s on, each lasting 3 s but the 30 ms
+ * ADC dropout
+ *
+ * @return Schedule, sorted by start
+ */
+std::vector<ScheduledFault> defaultFaultSchedule();
+
+/**
+ * Run a session with faults injected on a schedule
+ *
+ * @param p_session Patient, mode and settings
+ * @param p_schedule Faults, sorted by start
+ * @param p_durationMs Duration of the breathing, in ms, it must let the last fault recover
+ * @return What the faults did
+ * @note The session is run a first time without the faults, to tell the alarms they trigger
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+FaultRunReport runFaultSchedule(const SweepSession& p_session,
+                                const std::vector<ScheduledFault>& p_schedule,
+                                uint32_t p_durationMs);
+
+/**
+ * Set the flow meter buses and the battery inputs of the faults running at a date
+ *
+ * @param p_schedule Faults
+ * @param p_dateMs Date in ms, on the clock of the start dates of the faults
+ * @note When faults overlap on an input, the last one of the schedule wins. The control frame
+ *       faults have no input to set
+ */
+void applyInputFaults(const std::vector<ScheduledFault>& p_schedule, uint32_t p_dateMs);
+
+/**
+ * Name of a fault kind
+ *
+ * @param p_kind Kind of fault
+ * @return Name, as written in the reports
+ */
+const char* faultKindName(FaultKind p_kind);
+
+/**
+ * Write a report as text
+ *
+ * @param p_report What a schedule did
+ * @param p_output Output
+ */
+void printFaultRunReport(const FaultRunReport& p_report, FILE* p_output);
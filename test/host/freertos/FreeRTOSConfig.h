@@ -0,0 +1,62 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file FreeRTOSConfig.h
+ * @brief FreeRTOS configuration of the RTOS task model built on the host
+ *
+ * The POSIX port of FreeRTOS runs each task on a thread, one at a time, and the tick on a 1 ms
+ * interval timer of the process. The tasks of rtos_tasks.h need the mutexes, the task
+ * notifications and vTaskDelayUntil(), and the CPU load needs the tick hook.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <assert.h>
+
+// INITIALISATION =============================================================
+
+#define configUSE_PREEMPTION 1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 1
+#define configUSE_MALLOC_FAILED_HOOK 0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK 0
+#define configCHECK_FOR_STACK_OVERFLOW 0
+
+/// Same tick as the systick of the board
+#define configTICK_RATE_HZ 1000
+#define configCPU_CLOCK_HZ 1000000
+#define configUSE_16_BIT_TICKS 0
+
+/// The 4 tasks of rtos_tasks.h, above the idle task
+#define configMAX_PRIORITIES 6
+
+/// Stack of the idle task, in words, above PTHREAD_STACK_MIN
+#define configMINIMAL_STACK_SIZE 4096
+#define configMAX_TASK_NAME_LEN 16
+#define configIDLE_SHOULD_YIELD 1
+
+#define configUSE_MUTEXES 1
+#define configUSE_RECURSIVE_MUTEXES 0
+#define configUSE_COUNTING_SEMAPHORES 0
+#define configUSE_TASK_NOTIFICATIONS 1
+#define configUSE_TIMERS 0
+#define configUSE_CO_ROUTINES 0
+#define configQUEUE_REGISTRY_SIZE 0
+
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define configSUPPORT_STATIC_ALLOCATION 0
+#define configUSE_TRACE_FACILITY 0
+#define configGENERATE_RUN_TIME_STATS 0
+
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_vTaskDelayUntil 1
+#define INCLUDE_xTaskDelayUntil 1
+#define INCLUDE_vTaskDelete 1
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+
+#define configASSERT(x) assert(x)
@@ -0,0 +1,208 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file golden_trace.cpp
+ * @brief Traces of the controller outputs, compared with stored golden traces
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "golden_trace.h"
+
+// Externals
+#include <fstream>
+#include <sstream>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/alarm_controller.h"
+#include "../../includes/board_state.h"
+#include "../../includes/cycle.h"
+#include "../../includes/hal.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/main_state_machine.h"
+#include "../../includes/parameters.h"
+#include "../../includes/ventilator_context.h"
+#include "host_board.h"
+#include "pneumatic_plant.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the plant, and of the checks for a new main controller computation
+#define GOLDEN_TRACE_SAMPLE_PERIOD_US 1000u
+
+/// Number of lines shown before the first divergent one
+#define GOLDEN_TRACE_DIFF_CONTEXT 3u
+
+/// Lungs of the scenarios, they must outlive the simulation
+static BOARD_STATE PneumaticPlant goldenPlant;
+
+/// Number of values of each setting in the grid
+#define GOLDEN_GRID_LEVELS 3u
+
+/// Number of scenarios of a mode: the rows of the L9 orthogonal array
+#define GOLDEN_GRID_ROWS 9u
+
+/// L9 orthogonal array: value index of PEEP, plateau pressure, rate and tidal volume per row
+static const uint8_t GOLDEN_GRID[GOLDEN_GRID_ROWS][4] = {
+    {0, 0, 0, 0}, {0, 1, 1, 1}, {0, 2, 2, 2}, {1, 0, 1, 2}, {1, 1, 2, 0},
+    {1, 2, 0, 1}, {2, 0, 2, 1}, {2, 1, 0, 2}, {2, 2, 1, 0},
+};
+
+/// Values of the settings in the grid, within the ranges of parameters.h
+static const int16_t GOLDEN_GRID_PEEPS[GOLDEN_GRID_LEVELS] = {50, 80, 120};
+static const int16_t GOLDEN_GRID_PLATEAU_PRESSURES[GOLDEN_GRID_LEVELS] = {150, 300, 400};
+static const uint16_t GOLDEN_GRID_CYCLES_PER_MINUTE[GOLDEN_GRID_LEVELS] = {12u, 20u, 30u};
+static const uint16_t GOLDEN_GRID_TIDAL_VOLUMES[GOLDEN_GRID_LEVELS] = {300u, 400u, 600u};
+
+/// Modes of the grid, with the names of their traces
+static const uint16_t GOLDEN_GRID_MODES[] = {PC_CMV, PC_AC, PC_VSAI, VC_CMV, VC_AC};
+static const char* GOLDEN_GRID_MODE_NAMES[] = {"pc_cmv", "pc_ac", "pc_vsai", "vc_cmv", "vc_ac"};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Boot the host board on the simulated lungs, with the settings of a scenario
+ *
+ * @param p_scenario Mode and settings
+ */
+static void bootGoldenBoard(const GoldenScenario& p_scenario) {
+    resetSimulation(0u);
+
+    bootHostBoard();
+
+    goldenPlant = PneumaticPlant();
+    setSimulatedPlant(&goldenPlant, GOLDEN_TRACE_SAMPLE_PERIOD_US);
+
+    // The settings apply from the first respiratory cycle. The patient height is set first: on
+    // the first start without it, the preset of the default height would replace them
+    ventilator.mainController.onPatientHeight(DEFAULT_PATIENT_HEIGHT);
+    ventilator.mainController.onVentilationModeSet(p_scenario.mode);
+    ventilator.mainController.onPeepSet(p_scenario.peep);
+    ventilator.mainController.onPlateauPressureSet(p_scenario.plateauPressure);
+    ventilator.mainController.onCycleSet(p_scenario.cyclesPerMinute);
+    if (p_scenario.tidalVolume > 0u) {
+        ventilator.mainController.onTargetTidalVolumeSet(p_scenario.tidalVolume);
+    }
+
+    mainStateMachine.setupAndStart();
+    halReloadWatchdog();
+}
+
+/// Trace line of the current controller outputs
+static std::string goldenTraceLine() {
+    std::ostringstream line;
+    line << ventilator.mainController.cycleNumber() << ' ' << ventilator.mainController.tick()
+         << ' ' << ((ventilator.mainController.phase() == INHALATION) ? 'I' : 'E') << ' '
+         << ventilator.inspiratoryValve.command << ' ' << ventilator.expiratoryValve.command << ' '
+         << ventilator.blower.getSpeed() << ' ';
+
+    // Alarm codes, in the order the alarm controller keeps them
+    const uint8_t* alarms = ventilator.alarmController.triggeredAlarms();
+    bool hasAlarm = false;
+    for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
+        if (alarms[i] != 0u) {
+            line << (hasAlarm ? "," : "") << static_cast<uint32_t>(alarms[i]);
+            hasAlarm = true;
+        }
+    }
+    if (!hasAlarm) {
+        line << '-';
+    }
+    return line.str();
+}
+
+std::vector<GoldenScenario> goldenScenarioGrid() {
+    std::vector<GoldenScenario> scenarios;
+    for (size_t mode = 0; mode < (sizeof(GOLDEN_GRID_MODES) / sizeof(GOLDEN_GRID_MODES[0]));
+         mode++) {
+        bool volumeControlled =
+            (GOLDEN_GRID_MODES[mode] == VC_CMV) || (GOLDEN_GRID_MODES[mode] == VC_AC);
+        for (uint8_t row = 0; row < GOLDEN_GRID_ROWS; row++) {
+            GoldenScenario scenario;
+            scenario.mode = GOLDEN_GRID_MODES[mode];
+            scenario.peep = GOLDEN_GRID_PEEPS[GOLDEN_GRID[row][0]];
+            scenario.plateauPressure = GOLDEN_GRID_PLATEAU_PRESSURES[GOLDEN_GRID[row][1]];
+            scenario.cyclesPerMinute = GOLDEN_GRID_CYCLES_PER_MINUTE[GOLDEN_GRID[row][2]];
+            scenario.tidalVolume = 0u;
+            if (volumeControlled) {
+                scenario.tidalVolume = GOLDEN_GRID_TIDAL_VOLUMES[GOLDEN_GRID[row][3]];
+            }
+
+            std::ostringstream name;
+            name << GOLDEN_GRID_MODE_NAMES[mode] << "_peep" << scenario.peep << "_plateau"
+                 << scenario.plateauPressure << "_cpm" << scenario.cyclesPerMinute;
+            if (scenario.tidalVolume > 0u) {
+                name << "_vt" << scenario.tidalVolume;
+            }
+            scenario.name = name.str();
+            scenarios.push_back(scenario);
+        }
+    }
+    return scenarios;
+}
+
+std::vector<std::string> runGoldenScenario(const GoldenScenario& p_scenario, uint32_t p_cycles) {
+    bootGoldenBoard(p_scenario);
+    runSimulation(1000000u);
+    activationController.onStartButton();
+
+    std::vector<std::string> lines;
+    lines.push_back(GOLDEN_TRACE_HEADER);
+    uint32_t lastCycle = 0u;
+    uint32_t lastTick = 0u;
+    // The first respiratory cycle is the number 1
+    while (ventilator.mainController.cycleNumber() <= p_cycles) {
+        runSimulation(GOLDEN_TRACE_SAMPLE_PERIOD_US);
+        uint32_t cycle = ventilator.mainController.cycleNumber();
+        uint32_t tick = ventilator.mainController.tick();
+        if ((cycle > 0u) && (cycle <= p_cycles)
+            && ((cycle != lastCycle) || (tick != lastTick))) {
+            lines.push_back(goldenTraceLine());
+            lastCycle = cycle;
+            lastTick = tick;
+        }
+    }
+    return lines;
+}
+
+bool readGoldenTrace(const std::string& p_path, std::vector<std::string>* p_lines) {
+    std::ifstream file(p_path.c_str());
+    std::string line;
+    while (std::getline(file, line)) {
+        p_lines->push_back(line);
+    }
+    return file.eof() && !p_lines->empty();
+}
+
+bool writeGoldenTrace(const std::string& p_path, const std::vector<std::string>& p_lines) {
+    std::ofstream file(p_path.c_str());
+    for (const std::string& line : p_lines) {
+        file << line << '\n';
+    }
+    return file.good();
+}
+
+std::string diffGoldenTraces(const std::vector<std::string>& p_expected,
+                             const std::vector<std::string>& p_actual) {
+    size_t index = 0u;
+    while ((index < p_expected.size()) && (index < p_actual.size())
+           && (p_expected[index] == p_actual[index])) {
+        index++;
+    }
+    if ((index == p_expected.size()) && (index == p_actual.size())) {
+        return std::string();
+    }
+
+    std::ostringstream diff;
+    diff << "First divergent line " << (index + 1u) << " (" << GOLDEN_TRACE_HEADER << ")\n";
+    size_t first = (index > GOLDEN_TRACE_DIFF_CONTEXT) ? (index - GOLDEN_TRACE_DIFF_CONTEXT) : 0u;
+    for (size_t i = first; i < index; i++) {
+        diff << "  " << p_expected[i] << '\n';
+    }
+    diff << "- " << ((index < p_expected.size()) ? p_expected[index] : "<end of trace>") << '\n';
+    diff << "+ " << ((index < p_actual.size()) ? p_actual[index] : "<end of trace>") << '\n';
+    return diff.str();
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file golden_trace.h
+ * @brief Traces of the controller outputs, compared with stored golden traces
+ *
+ * A scenario boots the board on the simulated lungs with a ventilation mode and its settings,
+ * starts the breathing and records one line per main controller computation (every
+ * MAIN_CONTROLLER_COMPUTE_PERIOD_MS): the cycle, the tick, the phase, the valve commands, the
+ * blower speed and the triggered alarms. The simulation is deterministic, so any change of the
+ * control behaviour changes the trace, and the first line that differs from the golden trace
+ * tells where it started.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// INITIALISATION =============================================================
+
+/// Ventilation mode and settings of a scenario
+struct GoldenScenario {
+    /// Name of the scenario, also the name of its golden trace file
+    std::string name;
+    /// Ventilation mode, see VentilationModes
+    uint16_t mode;
+    /// PEEP command, in mmH2O
+    int16_t peep;
+    /// Plateau pressure command, in mmH2O
+    int16_t plateauPressure;
+    /// Respiratory rate command, in cycles per minute
+    uint16_t cyclesPerMinute;
+    /// Tidal volume command of the volume controlled modes, in mL
+    uint16_t tidalVolume;
+};
+
+/// Header line of the traces, naming the columns
+#define GOLDEN_TRACE_HEADER "# cycle tick phase inspiratoryValve expiratoryValve blower alarms"
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Scenarios of every ventilation mode over the grid of its settings, pairwise
+ *
+ * PEEP, plateau pressure, rate and, in the volume controlled modes, tidal volume each take a low,
+ * a middle and a high value. The 9 rows of an L9 orthogonal array give every value of a setting
+ * with every value of another one, where the full grid of the volume controlled modes takes 81
+ * scenarios.
+ *
+ * @return Scenarios, named after their mode and settings
+ */
+std::vector<GoldenScenario> goldenScenarioGrid();
+
+/**
+ * Run a scenario on the simulated lungs and trace the controller outputs
+ *
+ * @param p_scenario Mode and settings
+ * @param p_cycles Number of respiratory cycles to trace from the start of the breathing
+ * @return One line per main controller computation, the header first
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+std::vector<std::string> runGoldenScenario(const GoldenScenario& p_scenario, uint32_t p_cycles);
+
+/**
+ * Read a trace file
+ *
+ * @param p_path Path of the file
+ * @param p_lines Lines of the file, without their end of line
+ * @return False if the file cannot be read
+ */
+bool readGoldenTrace(const std::string& p_path, std::vector<std::string>* p_lines);
+
+/**
+ * Write a trace file, replacing it
+ *
+ * @param p_path Path of the file
+ * @param p_lines Lines to write
+ * @return False if the file cannot be written
+ */
+bool writeGoldenTrace(const std::string& p_path, const std::vector<std::string>& p_lines);
+
+/**
+ * Describe the first difference between two traces
+ *
+ * @param p_expected Golden trace
+ * @param p_actual Trace of the current code
+ * @return Empty if the traces are the same, else the first divergent line of both traces with
+ *         the lines before it
+ */
+std::string diffGoldenTraces(const std::vector<std::string>& p_expected,
+                             const std::vector<std::string>& p_actual);
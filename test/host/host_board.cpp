@@ -0,0 +1,251 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file host_board.cpp
+ * @brief Host stand-ins of the board drivers the ventilation code calls
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "host_board.h"
+
+// Externals
+#include <stdio.h>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/battery.h"
+#include "../../includes/board_state.h"
+#include "../../includes/buzzer.h"
+#include "../../includes/buzzer_control.h"
+#include "../../includes/hal.h"
+#include "../../includes/keyboard.h"
+#include "../../includes/mass_flow_meter.h"
+#include "../../includes/mass_flow_meter_utl.h"
+#include "../../includes/parameters.h"
+#include "../../includes/pressure.h"
+#include "../../includes/pressure_valve.h"
+#include "../../includes/screen.h"
+#include "../../includes/sensor_capture.h"
+#include "../../includes/telemetry.h"
+#include "../../includes/ventilator_context.h"
+
+// INITIALISATION =============================================================
+
+// Words on the sensor lines of the flow meters
+static BOARD_STATE uint16_t hostInspiratoryWord = 0;
+static BOARD_STATE uint16_t hostExpiratoryWord = 0;
+static BOARD_STATE bool hostFlowMeterFault = false;
+static BOARD_STATE HostFlowMeterBus hostFlowMeterBuses[HOST_FLOW_METERS];
+
+// Word of the inspiratory flow meter that converts to about 500 SLM: a status bit is set
+#define HOST_MFM_SPURIOUS_WORD 0x8663u
+
+static BOARD_STATE bool hostBuzzer = false;
+static BOARD_STATE uint32_t hostBuzzerSwitchOnCount = 0;
+
+// Last message of the end of line test on the screen
+static BOARD_STATE char hostEndOfLineTestText[HOST_SCREEN_MESSAGE_SIZE];
+
+// FUNCTIONS ==================================================================
+
+/// Plug the flow meters on the I2C bus of the HAL, with the words and the answers set by the test
+static void publishHostFlowMeters(void) {
+    static const uint8_t addresses[HOST_FLOW_METERS] = {MFM_HONEYWELL_HAF_I2C_ADDRESS,
+                                                         MFM_SFM_3300D_I2C_ADDRESS};
+    for (uint8_t i = 0; i < HOST_FLOW_METERS; i++) {
+        uint16_t word = (i == HOST_INSPIRATORY_FLOW_METER) ? hostInspiratoryWord
+                                                           : hostExpiratoryWord;
+        HostI2cAnswer answer = HOST_I2C_ANSWERS;
+        switch (hostFlowMeterBuses[i]) {
+        case HOST_FLOW_METER_NACK:
+            answer = HOST_I2C_NACK;
+            break;
+        case HOST_FLOW_METER_SHORT_READ:
+            answer = HOST_I2C_SHORT_READ;
+            break;
+        case HOST_FLOW_METER_SPURIOUS_VALUE:
+            if (i == HOST_INSPIRATORY_FLOW_METER) {
+                word = HOST_MFM_SPURIOUS_WORD;
+            }
+            break;
+        default:
+            break;
+        }
+        // Failing flow meters must not end the reset sequence of the board
+        setHostI2cDevice(addresses[i], word, hostFlowMeterFault ? HOST_I2C_NACK : answer);
+    }
+}
+
+void resetHostBoard(void) {
+    hostInspiratoryWord = convertInspiratoryFlow2Sensor(0);
+    hostExpiratoryWord = convertExpiratoryFlow2Sensor(0);
+    hostFlowMeterFault = false;
+    for (uint8_t i = 0; i < HOST_FLOW_METERS; i++) {
+        hostFlowMeterBuses[i] = HOST_FLOW_METER_ANSWERS;
+    }
+    publishHostFlowMeters();
+    MFM_resetState();
+    hostBuzzer = false;
+    hostBuzzerSwitchOnCount = 0;
+    hostEndOfLineTestText[0] = 0;
+}
+
+void bootHostBoard(void) {
+    initTelemetry();
+    initHalPwmOutputs();
+    ventilator.inspiratoryValve =
+        PressureValve(HAL_PWM_INSPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
+    ventilator.inspiratoryValve.setup();
+    ventilator.expiratoryValve =
+        PressureValve(HAL_PWM_EXPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE);
+    ventilator.expiratoryValve.setup();
+    ventilator.blower = Blower(HAL_PWM_BLOWER);
+    ventilator.blower.setup();
+
+    ventilator.mainController = MainController();
+    ventilator.alarmController = AlarmController();
+    inspiratoryPressureSensor = PressureSensor();
+    initBattery();
+    (void)MFM_init();
+    activationController = ActivationController();
+    sensorCapture = SensorCapture();
+
+    BuzzerControl_Init();
+    Buzzer_Init();
+}
+
+void setHostFlows(int32_t p_inspiratoryFlow, int32_t p_expiratoryFlow) {
+    setHostFlowSensorWords(convertInspiratoryFlow2Sensor(p_inspiratoryFlow),
+                           convertExpiratoryFlow2Sensor(p_expiratoryFlow));
+}
+
+void setHostFlowSensorWords(uint16_t p_inspiratoryWord, uint16_t p_expiratoryWord) {
+    hostInspiratoryWord = p_inspiratoryWord;
+    hostExpiratoryWord = p_expiratoryWord;
+    publishHostFlowMeters();
+}
+
+void setHostFlowMeterOffset(int32_t p_inspiratoryOffset) { MFM_setOffset(p_inspiratoryOffset); }
+
+void setHostFlowMeterFault(bool p_fault) {
+    hostFlowMeterFault = p_fault;
+    publishHostFlowMeters();
+    MFM_setFaultCondition(p_fault);
+}
+
+void setHostFlowMeterBus(HostFlowMeter p_flowMeter, HostFlowMeterBus p_bus) {
+    hostFlowMeterBuses[p_flowMeter] = p_bus;
+    publishHostFlowMeters();
+}
+
+bool hostFlowMeterFaultCondition(void) { return MFM_read_airflow() == MASS_FLOW_ERROR_VALUE; }
+
+void hostBoardCheckpoint(CheckpointArchive* p_archive) {
+    p_archive->field(hostInspiratoryWord);
+    p_archive->field(hostExpiratoryWord);
+    if (p_archive->isRestoring()) {
+        publishHostFlowMeters();
+    }
+}
+
+bool hostBuzzerOn(void) { return hostBuzzer; }
+
+uint32_t hostBuzzerSwitchOns(void) { return hostBuzzerSwitchOnCount; }
+
+// Buzzer ---------------------------------------------------------------------
+
+void BuzzerControl_Init(void) { hostBuzzer = false; }
+
+void BuzzerControl_On(void) {
+    if (!hostBuzzer) {
+        hostBuzzerSwitchOnCount++;
+    }
+    hostBuzzer = true;
+}
+
+void BuzzerControl_Off(void) { hostBuzzer = false; }
+
+// Keyboard -------------------------------------------------------------------
+
+void initKeyboard() {}
+
+void keyboardLoop() {}
+
+void calibrateButtons() {}
+
+// Screen ---------------------------------------------------------------------
+
+void startScreen() {}
+
+void resetScreen() {}
+
+void displayCurrentPressure(uint16_t pressure, uint16_t cyclesPerMinute) {
+    (void)pressure;
+    (void)cyclesPerMinute;
+}
+
+void displayCurrentVolume(int32_t volumeMassFlow, uint16_t cyclesPerMinute) {
+    (void)volumeMassFlow;
+    (void)cyclesPerMinute;
+}
+
+void displayCurrentSettings(uint16_t peakPressureMax,
+                            uint16_t plateauPressureMax,
+                            uint16_t peepMin) {
+    (void)peakPressureMax;
+    (void)plateauPressureMax;
+    (void)peepMin;
+}
+
+void displayCurrentInformation(uint16_t peakPressure, uint16_t plateauPressure, uint16_t peep) {
+    (void)peakPressure;
+    (void)plateauPressure;
+    (void)peep;
+}
+
+void displayAlarmInformation(uint8_t p_alarmCodes[], uint8_t p_nbTriggeredAlarms) {
+    (void)p_alarmCodes;
+    (void)p_nbTriggeredAlarms;
+}
+
+void displayPressureOffsetUnstable(uint32_t p_minOffsetValue, uint32_t p_maxOffsetValue) {
+    (void)p_minOffsetValue;
+    (void)p_maxOffsetValue;
+}
+
+void displayPressureOffset(int32_t p_inspiratoryPressureSensorOffset) {
+    (void)p_inspiratoryPressureSensorOffset;
+}
+
+void displayFlowMeterFail(int32_t p_flowMeterFlowAtStarting, int32_t p_flowMeterFlowWithBlowerOn) {
+    (void)p_flowMeterFlowAtStarting;
+    (void)p_flowMeterFlowWithBlowerOn;
+}
+
+void displayFlowMeterOffset(int32_t p_flowMeterFlowOffset) { (void)p_flowMeterFlowOffset; }
+
+void displayPatientMustBeUnplugged() {}
+
+void displayEndOfLineTestMode() {}
+
+void displayEndOfLineTestMessage(const char* p_message, uint32_t p_testNumber, bool p_isFailed) {
+    (void)p_testNumber;
+    (void)p_isFailed;
+    (void)snprintf(hostEndOfLineTestText, sizeof(hostEndOfLineTestText), "%s", p_message);
+}
+
+const char* hostEndOfLineTestMessage(void) { return hostEndOfLineTestText; }
+
+void displayBatteryDeepDischarge() {}
+
+void displayWatchdogError() {}
+
+void displayMachineStopped() {}
+
+void clearAlarmDisplayCache() {}
+
+uint16_t convertAndRound(uint16_t pressure) {
+    return (pressure / 10u) + (((pressure % 10u) < 5u) ? 0u : 1u);
+}
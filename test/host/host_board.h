@@ -0,0 +1,132 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file host_board.h
+ * @brief Host stand-ins of the board drivers the ventilation code calls
+ *
+ * The buzzer output, keyboard and screen drivers talk to GPIOs and to the LCD, they are not built
+ * on the host. These stand-ins implement their functions: the buzzer output keeps its state, the
+ * screen keeps the message of the end of line test, and the others do nothing.
+ *
+ * The flow meter driver of the board is built as it is: this file plugs the flow meters on the
+ * I2C bus of the host HAL, with the words of the sensors set by the test. Their bus can be made
+ * to fail, the driver then goes through its own fault condition and reset sequence.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../../includes/mass_flow_meter.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the flow meter acquisition in ms, as on the board
+#define HOST_FLOW_METER_PERIOD_MS (MASS_FLOW_PERIOD / 10u)
+
+/// Size of the message of the end of line test kept from the screen, with its final 0
+#define HOST_SCREEN_MESSAGE_SIZE 128u
+
+/// Flow meters on the I2C bus
+enum HostFlowMeter {
+    /// Honeywell HAF of the inspiratory branch
+    HOST_INSPIRATORY_FLOW_METER,
+    /// SFM3300-D of the expiratory branch
+    HOST_EXPIRATORY_FLOW_METER,
+    /// Number of flow meters
+    HOST_FLOW_METERS
+};
+
+/// How a flow meter answers on the I2C bus
+enum HostFlowMeterBus {
+    /// Every request is answered
+    HOST_FLOW_METER_ANSWERS,
+    /// The address is not acknowledged: no byte is read and no command is written
+    HOST_FLOW_METER_NACK,
+    /// Commands are acknowledged, but the reads stop after the first byte
+    HOST_FLOW_METER_SHORT_READ,
+    /// Every read gives a spurious measure of about 500 SLM
+    HOST_FLOW_METER_SPURIOUS_VALUE
+};
+
+// FUNCTIONS ==================================================================
+
+/// Reset the flow meter, the buzzer output and the screen to their power-on state
+void resetHostBoard(void);
+
+/**
+ * Set up the actuators, the controllers, the sensors and the buzzer like respirator.cpp does
+ *
+ * The main state machine is not started. Call it once the board is reset, by resetSimulation()
+ * or by resetHostHal() and resetHostBoard(): the flow meter faults and the mains set before are
+ * kept.
+ */
+void bootHostBoard(void);
+
+/**
+ * Set the flows measured by the flow meters
+ *
+ * @param p_inspiratoryFlow Inspiratory flow in mL/min
+ * @param p_expiratoryFlow Expiratory flow in mL/min
+ * @note The sensors give the closest flows their words can tell. They are only read when
+ *       MFM_acquire() is called, by the flow meter timer every HOST_FLOW_METER_PERIOD_MS once
+ *       MFM_init() started it
+ */
+void setHostFlows(int32_t p_inspiratoryFlow, int32_t p_expiratoryFlow);
+
+/**
+ * Set the words the flow meters answer
+ *
+ * @param p_inspiratoryWord Word of the inspiratory flow meter
+ * @param p_expiratoryWord Word of the expiratory flow meter
+ */
+void setHostFlowSensorWords(uint16_t p_inspiratoryWord, uint16_t p_expiratoryWord);
+
+/**
+ * Set the calibration offset of the inspiratory flow meter
+ *
+ * @param p_inspiratoryOffset Offset in mL/min, removed from the flows and the volumes
+ */
+void setHostFlowMeterOffset(int32_t p_inspiratoryOffset);
+
+/**
+ * Make the flow meters fail or recover
+ *
+ * @param p_fault True if the flow meters do not answer
+ * @note The fault condition of the driver follows it immediately, without waiting for a failed
+ *       read or for the end of the reset sequence, as the sensor capture replay needs it
+ */
+void setHostFlowMeterFault(bool p_fault);
+
+/**
+ * Set how a flow meter answers on the I2C bus
+ *
+ * @param p_flowMeter Flow meter
+ * @param p_bus Answers, HOST_FLOW_METER_ANSWERS after a reset
+ * @note A failed read of the inspiratory flow meter raises the fault condition at once, the
+ *       expiratory one after 13 failed reads as on the board. The flow meters are then reset
+ *       until they both answer again
+ */
+void setHostFlowMeterBus(HostFlowMeter p_flowMeter, HostFlowMeterBus p_bus);
+
+/**
+ * Save or restore the words on the sensor lines of the flow meters
+ *
+ * @param p_archive Checkpoint archive
+ * @note The bus failures and the faults set by the test are not part of it, they are kept
+ */
+void hostBoardCheckpoint(CheckpointArchive* p_archive);
+
+/// True if the flow meters are in fault condition, their measures are then MASS_FLOW_ERROR_VALUE
+bool hostFlowMeterFaultCondition(void);
+
+/// True if the buzzer sounds
+bool hostBuzzerOn(void);
+
+/// Number of times the buzzer started to sound
+uint32_t hostBuzzerSwitchOns(void);
+
+/// Last message of the end of line test on the screen, its lines separated by '\n'
+const char* hostEndOfLineTestMessage(void);
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file patient_effort.cpp
+ * @brief Spontaneous breathing of the simulated patient
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "patient_effort.h"
+
+// Externals
+#include <math.h>
+
+// FUNCTIONS ==================================================================
+
+PatientEffort::PatientEffort()
+    : m_rate(0u),
+      m_amplitude(0.0),
+      m_contractionMs(400u),
+      m_relaxationMs(400u),
+      m_firstOnsetUs(0u) {}
+
+void PatientEffort::setRate(uint16_t p_breathsPerMinute) { m_rate = p_breathsPerMinute; }
+
+void PatientEffort::setAmplitude(double p_amplitude) { m_amplitude = p_amplitude; }
+
+void PatientEffort::setTiming(uint32_t p_contractionMs, uint32_t p_relaxationMs) {
+    m_contractionMs = p_contractionMs;
+    m_relaxationMs = p_relaxationMs;
+}
+
+void PatientEffort::setFirstOnset(uint64_t p_onsetUs) { m_firstOnsetUs = p_onsetUs; }
+
+bool PatientEffort::effortAt(uint64_t p_dateUs, uint64_t* p_onsetUs) const {
+    bool inProgress = false;
+
+    if ((m_rate > 0u) && (m_amplitude > 0.0) && (p_dateUs >= m_firstOnsetUs)) {
+        uint64_t periodUs = 60000000u / m_rate;
+        uint64_t onset = p_dateUs - ((p_dateUs - m_firstOnsetUs) % periodUs);
+        if ((p_dateUs - onset) < effortDurationUs()) {
+            *p_onsetUs = onset;
+            inProgress = true;
+        }
+    }
+    return inProgress;
+}
+
+double PatientEffort::pressure(uint64_t p_dateUs) const {
+    double musclePressure = 0.0;
+    uint64_t onset = 0u;
+
+    if (effortAt(p_dateUs, &onset)) {
+        double elapsedMs = (p_dateUs - onset) / 1000.0;
+        double depth;
+        if (elapsedMs < m_contractionMs) {
+            depth = (1.0 - cos(M_PI * elapsedMs / m_contractionMs)) / 2.0;
+        } else {
+            depth = (1.0 + cos(M_PI * (elapsedMs - m_contractionMs) / m_relaxationMs)) / 2.0;
+        }
+        musclePressure = -m_amplitude * depth;
+    }
+    return musclePressure;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file patient_effort.h
+ * @brief Spontaneous breathing of the simulated patient
+ *
+ * The respiratory muscles pull on the lungs of the pneumatic plant with a negative pressure. An
+ * effort contracts the muscles along a half cosine down to the amplitude, then relaxes them along
+ * another half cosine, and efforts come back at the breathing rate of the patient, whatever the
+ * ventilator does.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+// CLASS ======================================================================
+
+/// Muscle pressure waveform of a spontaneously breathing patient
+class PatientEffort {
+ public:
+    /// Default constructor: a patient making no effort, until a rate and an amplitude are set
+    PatientEffort();
+
+    /**
+     * Set the breathing rate of the patient
+     *
+     * @param p_breathsPerMinute Number of efforts per minute, 0 for no effort
+     */
+    void setRate(uint16_t p_breathsPerMinute);
+
+    /**
+     * Set the strength of the efforts
+     *
+     * @param p_amplitude Depth of the muscle pressure at the end of the contraction, in mmH2O
+     */
+    void setAmplitude(double p_amplitude);
+
+    /**
+     * Set the shape of an effort
+     *
+     * @param p_contractionMs Duration of the contraction of the muscles, in ms
+     * @param p_relaxationMs Duration of their relaxation, in ms
+     */
+    void setTiming(uint32_t p_contractionMs, uint32_t p_relaxationMs);
+
+    /**
+     * Set the date of the first effort, the next ones follow at the breathing rate
+     *
+     * @param p_onsetUs Date of the start of the first contraction, in µs
+     */
+    void setFirstOnset(uint64_t p_onsetUs);
+
+    /**
+     * Muscle pressure at a date
+     *
+     * @param p_dateUs Date in µs
+     * @return Pressure applied on the lungs in mmH2O, 0 or negative
+     */
+    double pressure(uint64_t p_dateUs) const;
+
+    /**
+     * Find the effort in progress at a date
+     *
+     * @param p_dateUs Date in µs
+     * @param p_onsetUs Set to the date the effort started, in µs, when there is one
+     * @return True if the muscles are contracting or relaxing at that date
+     */
+    bool effortAt(uint64_t p_dateUs, uint64_t* p_onsetUs) const;
+
+    /// Duration of an effort, contraction and relaxation, in µs
+    uint64_t effortDurationUs() const {
+        return (static_cast<uint64_t>(m_contractionMs) + m_relaxationMs) * 1000u;
+    }
+
+ private:
+    uint16_t m_rate;
+    double m_amplitude;
+    uint32_t m_contractionMs;
+    uint32_t m_relaxationMs;
+    uint64_t m_firstOnsetUs;
+};
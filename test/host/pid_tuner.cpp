@@ -0,0 +1,273 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file pid_tuner.cpp
+ * @brief Search of the PID and blower regulation coefficients of the PC modes
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "pid_tuner.h"
+
+// Externals
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Internal
+#include "../../includes/cycle.h"
+
+// INITIALISATION =============================================================
+
+/// Relative change of a coefficient at the first pass of the search
+#define TUNING_FIRST_STEP 0.5
+
+/// Relative change under which the search stops
+#define TUNING_LAST_STEP 0.02
+
+/// Respiratory rate of the tuning sessions, in cycles per minute
+#define TUNING_CYCLES_PER_MINUTE 20u
+
+// FUNCTIONS ==================================================================
+
+const std::vector<TuningCoefficient>& tuningCoefficients() {
+    static const std::vector<TuningCoefficient> coefficients = {
+        {"PC_CMV_INSPIRATORY_PID_KP", "Proportional gain of the inspiratory valve PID",
+         &PcCmvTuning::inspiratoryKp, 100, 20000},
+        {"PC_CMV_INSPIRATORY_PID_KI_ABOVE",
+         "Integral gain of the inspiratory valve PID, above the pressure command",
+         &PcCmvTuning::inspiratoryKiAbove, 1, 2000},
+        {"PC_CMV_INSPIRATORY_PID_KI_BELOW",
+         "Integral gain of the inspiratory valve PID, below the pressure command",
+         &PcCmvTuning::inspiratoryKiBelow, 1, 2000},
+        {"PC_CMV_EXPIRATORY_PID_KP", "Proportional gain of the expiratory valve PID",
+         &PcCmvTuning::expiratoryKp, 100, 20000},
+        {"PC_CMV_EXPIRATORY_PID_KI_ABOVE",
+         "Integral gain of the expiratory valve PID, above the PEEP command",
+         &PcCmvTuning::expiratoryKiAbove, 1, 2000},
+        {"PC_CMV_EXPIRATORY_PID_KI_LOW_PEEP",
+         "Integral gain of the expiratory valve PID, below a PEEP command of 50 mmH2O",
+         &PcCmvTuning::expiratoryKiLowPeep, 1, 2000},
+        {"PC_CMV_EXPIRATORY_PID_KI_HIGH_PEEP",
+         "Integral gain of the expiratory valve PID, below a PEEP command of 100 mmH2O or more",
+         &PcCmvTuning::expiratoryKiHighPeep, 1, 2000},
+        {"PC_CMV_BLOWER_HALF_RAMP_MS",
+         "Duration of the half pressure ramp, in ms, a faster plateau decreases the blower speed",
+         &PcCmvTuning::blowerHalfRampMs, 10, 1000},
+        {"PC_CMV_BLOWER_EARLY_PLATEAU_PERCENT",
+         "Part of the inspiration, in %, before which a plateau may decrease the blower speed",
+         &PcCmvTuning::blowerEarlyPlateauPercent, 1, 100},
+        {"PC_CMV_BLOWER_OVERSHOOT_PERCENT",
+         "Part of the inspiration, in %, before which a small overshoot decreases the blower speed",
+         &PcCmvTuning::blowerOvershootPercent, 1, 100},
+        {"PC_CMV_BLOWER_SMALL_OVERSHOOT",
+         "Peak pressure above the plateau command, in mmH2O, that is a small overshoot",
+         &PcCmvTuning::blowerSmallOvershoot, 1, 200},
+        {"PC_CMV_BLOWER_LARGE_OVERSHOOT",
+         "Peak pressure above the plateau command, in mmH2O, that is a large overshoot",
+         &PcCmvTuning::blowerLargeOvershoot, 1, 200},
+        {"PC_CMV_BLOWER_DECREMENT", "Blower speed decrease after a fast ramp or an overshoot",
+         &PcCmvTuning::blowerDecrement, 1, 500},
+        {"PC_CMV_BLOWER_HOLD_PERCENT",
+         "Part of the inspiration, in %, before which a plateau keeps the blower speed",
+         &PcCmvTuning::blowerHoldPercent, 1, 100},
+        {"PC_CMV_BLOWER_SMALL_STEP_PERCENT",
+         "Part of the inspiration, in %, before which a plateau slightly increases the "
+         "blower speed",
+         &PcCmvTuning::blowerSmallStepPercent, 1, 100},
+        {"PC_CMV_BLOWER_SMALL_INCREMENT", "Blower speed increase after a slightly late plateau",
+         &PcCmvTuning::blowerSmallIncrement, 1, 500},
+        {"PC_CMV_BLOWER_MEDIUM_STEP_PERCENT",
+         "Part of the inspiration, in %, before which a plateau increases the blower speed",
+         &PcCmvTuning::blowerMediumStepPercent, 1, 100},
+        {"PC_CMV_BLOWER_MEDIUM_INCREMENT", "Blower speed increase after a late plateau",
+         &PcCmvTuning::blowerMediumIncrement, 1, 500},
+        {"PC_CMV_BLOWER_LARGE_INCREMENT",
+         "Blower speed increase after a very late plateau, or no plateau",
+         &PcCmvTuning::blowerLargeIncrement, 1, 500},
+    };
+    return coefficients;
+}
+
+bool isValidTuning(const PcCmvTuning& p_tuning) {
+    for (const TuningCoefficient& coefficient : tuningCoefficients()) {
+        int32_t value = p_tuning.*coefficient.value;
+        if ((value < coefficient.minimum) || (value > coefficient.maximum)) {
+            return false;
+        }
+    }
+    return (p_tuning.blowerOvershootPercent <= p_tuning.blowerEarlyPlateauPercent)
+           && (p_tuning.blowerEarlyPlateauPercent <= p_tuning.blowerHoldPercent)
+           && (p_tuning.blowerHoldPercent <= p_tuning.blowerSmallStepPercent)
+           && (p_tuning.blowerSmallStepPercent <= p_tuning.blowerMediumStepPercent)
+           && (p_tuning.blowerSmallOvershoot <= p_tuning.blowerLargeOvershoot)
+           && (p_tuning.blowerSmallIncrement <= p_tuning.blowerMediumIncrement)
+           && (p_tuning.blowerMediumIncrement <= p_tuning.blowerLargeIncrement);
+}
+
+std::vector<SweepSession> tuningSessions() {
+    const int16_t peeps[] = {50, 100};
+    const int16_t plateauPressures[] = {200, 300};
+
+    std::vector<SweepSession> sessions;
+    for (const LungCompartment& lung : defaultSweepRanges(1u).lungs) {
+        for (int16_t peep : peeps) {
+            for (int16_t plateauPressure : plateauPressures) {
+                SweepSession session = {PC_CMV,
+                                        peep,
+                                        plateauPressure,
+                                        TUNING_CYCLES_PER_MINUTE,
+                                        DEFAULT_TIDAL_VOLUME_COMMAND,
+                                        lung};
+                sessions.push_back(session);
+            }
+        }
+    }
+    return sessions;
+}
+
+bool evaluateTuning(const PcCmvTuning& p_tuning,
+                    const std::vector<SweepSession>& p_sessions,
+                    uint32_t p_settlingCycles,
+                    uint32_t p_measuredCycles,
+                    uint32_t p_workers,
+                    TuningCost* p_cost) {
+    *p_cost = {0.0, 0.0, 0.0, 0.0, 0.0};
+
+    setSweepTuning(p_tuning);
+    std::vector<SessionMetrics> metrics;
+    bool success =
+        runSessionSweep(p_sessions, p_settlingCycles, p_measuredCycles, p_workers, &metrics);
+    setSweepTuning(PC_CMV_DEFAULT_TUNING);
+    if (!success || metrics.empty()) {
+        return false;
+    }
+
+    for (const SessionMetrics& session : metrics) {
+        p_cost->riseTimeMs += session.riseTimeMs;
+        p_cost->overshoot += session.overshoot;
+        p_cost->peepError += std::abs(session.peepError);
+        p_cost->convergenceCycles += session.convergenceCycles;
+    }
+    double sessions = metrics.size();
+    p_cost->riseTimeMs /= sessions;
+    p_cost->overshoot /= sessions;
+    p_cost->peepError /= sessions;
+    p_cost->convergenceCycles /= sessions;
+    p_cost->total = (p_cost->riseTimeMs / 100.0) + (p_cost->overshoot / 10.0)
+                    + (p_cost->peepError / 10.0) + p_cost->convergenceCycles;
+    return true;
+}
+
+/**
+ * Value of a coefficient changed by a relative step, by one unit at least
+ *
+ * @param p_value Current value
+ * @param p_step Relative change, negative to decrease the value
+ * @return Changed value
+ */
+static int32_t stepCoefficient(int32_t p_value, double p_step) {
+    int32_t changed = static_cast<int32_t>(std::lround(p_value * (1.0 + p_step)));
+    if (changed == p_value) {
+        changed = p_value + ((p_step > 0.0) ? 1 : -1);
+    }
+    return changed;
+}
+
+PcCmvTuning tunePcCmv(const PcCmvTuning& p_initial,
+                      const std::vector<TuningCoefficient>& p_coefficients,
+                      const std::vector<SweepSession>& p_sessions,
+                      uint32_t p_settlingCycles,
+                      uint32_t p_measuredCycles,
+                      uint32_t p_passes,
+                      uint32_t p_workers,
+                      TuningCost* p_cost,
+                      FILE* p_log) {
+    PcCmvTuning best = p_initial;
+    TuningCost bestCost;
+    if (!evaluateTuning(best, p_sessions, p_settlingCycles, p_measuredCycles, p_workers,
+                        &bestCost)) {
+        bestCost.total = HUGE_VAL;
+    }
+    if (p_log != nullptr) {
+        fprintf(p_log, "Initial cost %.3f\n", bestCost.total);
+    }
+
+    double step = TUNING_FIRST_STEP;
+    for (uint32_t pass = 0; (pass < p_passes) && (step >= TUNING_LAST_STEP); pass++) {
+        bool improved = false;
+        for (const TuningCoefficient& coefficient : p_coefficients) {
+            for (double direction : {1.0, -1.0}) {
+                PcCmvTuning candidate = best;
+                candidate.*coefficient.value =
+                    stepCoefficient(best.*coefficient.value, direction * step);
+                if (!isValidTuning(candidate)) {
+                    continue;
+                }
+                TuningCost cost;
+                if (evaluateTuning(candidate, p_sessions, p_settlingCycles, p_measuredCycles,
+                                   p_workers, &cost)
+                    && (cost.total < bestCost.total)) {
+                    best = candidate;
+                    bestCost = cost;
+                    improved = true;
+                    if (p_log != nullptr) {
+                        fprintf(p_log, "Pass %u: %s = %d, cost %.3f\n", pass + 1u,
+                                coefficient.name, best.*coefficient.value, bestCost.total);
+                    }
+                    break;
+                }
+            }
+        }
+        // Narrow the steps once the coefficients are at a local minimum
+        if (!improved) {
+            step /= 2.0;
+        }
+    }
+
+    *p_cost = bestCost;
+    return best;
+}
+
+std::string tuningHeader(const PcCmvTuning& p_tuning, const std::string& p_origin) {
+    // Description of the file, wrapped at 100 columns like the sources
+    std::istringstream words("Generated by tune_pc_cmv (see test/README.md): " + p_origin + ".");
+    std::string description;
+    std::string line = " *";
+    std::string word;
+    while (words >> word) {
+        if ((line.size() + 1u + word.size()) > 100u) {
+            description += line + "\n";
+            line = " *";
+        }
+        line += " " + word;
+    }
+    description += line + "\n";
+
+    std::ostringstream header;
+    header << "/******************************************************************************\n"
+           << " * @author Makers For Life\n"
+           << " * @copyright Copyright (c) 2020 Makers For Life\n"
+           << " * @file pc_cmv_tuning.h\n"
+           << " * @brief Coefficients of the valve PIDs and of the blower regulation of the PC "
+              "modes\n"
+           << " *\n"
+           << description
+           << " *****************************************************************************/\n"
+           << "\n"
+           << "#pragma once\n"
+           << "\n"
+           << "// INCLUDES ===================================================================\n"
+           << "\n"
+           << "#include <stdint.h>\n"
+           << "\n"
+           << "// INITIALISATION =============================================================\n"
+           << "\n";
+    for (const TuningCoefficient& coefficient : tuningCoefficients()) {
+        header << "/// " << coefficient.description << "\n"
+               << "static const int32_t " << coefficient.name << " = "
+               << p_tuning.*coefficient.value << ";\n";
+    }
+    return header.str();
+}
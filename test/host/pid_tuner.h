@@ -0,0 +1,133 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file pid_tuner.h
+ * @brief Search of the PID and blower regulation coefficients of the PC modes
+ *
+ * A tuning (PcCmvTuning) is scored by running simulated PC_CMV sessions on a library of patients
+ * in worker processes (see session_sweep.h), and weighting their rise time, overshoot, PEEP error
+ * and the number of cycles the plateau pressure took to converge. The search changes one
+ * coefficient at a time, keeps the changes that lower the cost and narrows its steps when none
+ * does. The result is written as includes/pc_cmv_tuning.h, the header the firmware compiles in.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../../includes/pc_cmv_controller.h"
+#include "session_sweep.h"
+
+// INITIALISATION =============================================================
+
+/// Coefficient of a tuning that the search changes
+struct TuningCoefficient {
+    /// Name of the constant in pc_cmv_tuning.h
+    const char* name;
+    /// Documentation of the constant
+    const char* description;
+    /// Coefficient in the tuning
+    int32_t PcCmvTuning::*value;
+    /// Lowest value
+    int32_t minimum;
+    /// Highest value
+    int32_t maximum;
+};
+
+/// Measures of a tuning, averaged over its sessions
+struct TuningCost {
+    /// Rise time, in ms
+    double riseTimeMs;
+    /// Overshoot, in mmH2O
+    double overshoot;
+    /// Absolute PEEP error, in mmH2O
+    double peepError;
+    /// Cycles before the plateau pressure converges
+    double convergenceCycles;
+    /// Weighted sum: one per 100 ms of rise time, per cmH2O of overshoot and of PEEP error, and
+    /// per cycle to converge
+    double total;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Every coefficient of a tuning, in the order of pc_cmv_tuning.h
+ *
+ * @return Coefficients
+ */
+const std::vector<TuningCoefficient>& tuningCoefficients();
+
+/**
+ * Check that the blower regulation rules of a tuning stay ordered
+ *
+ * @param p_tuning Coefficients
+ * @return True if the coefficients are within their bounds, the parts of the inspiration,
+ *         overshoots and increments increasing
+ */
+bool isValidTuning(const PcCmvTuning& p_tuning);
+
+/**
+ * Sessions scoring a tuning: PC_CMV at a low and a high PEEP and plateau pressure, on every
+ * patient of the sweep library
+ *
+ * @return Sessions
+ */
+std::vector<SweepSession> tuningSessions();
+
+/**
+ * Score a tuning
+ *
+ * @param p_tuning Coefficients
+ * @param p_sessions Sessions to run
+ * @param p_settlingCycles Number of cycles run before the measure
+ * @param p_measuredCycles Number of cycles measured
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @param p_cost Measures and cost of the tuning
+ * @return False if a worker failed
+ */
+bool evaluateTuning(const PcCmvTuning& p_tuning,
+                    const std::vector<SweepSession>& p_sessions,
+                    uint32_t p_settlingCycles,
+                    uint32_t p_measuredCycles,
+                    uint32_t p_workers,
+                    TuningCost* p_cost);
+
+/**
+ * Search the coefficients of lowest cost
+ *
+ * @param p_initial Coefficients the search starts from
+ * @param p_coefficients Coefficients to change, the others keep their initial value
+ * @param p_sessions Sessions scoring a tuning
+ * @param p_settlingCycles Number of cycles run before the measure
+ * @param p_measuredCycles Number of cycles measured
+ * @param p_passes Number of passes over the coefficients
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @param p_cost Cost of the returned tuning
+ * @param p_log Progress output, nullptr for none
+ * @return Tuning of lowest cost, the initial one if no change lowered it
+ */
+PcCmvTuning tunePcCmv(const PcCmvTuning& p_initial,
+                      const std::vector<TuningCoefficient>& p_coefficients,
+                      const std::vector<SweepSession>& p_sessions,
+                      uint32_t p_settlingCycles,
+                      uint32_t p_measuredCycles,
+                      uint32_t p_passes,
+                      uint32_t p_workers,
+                      TuningCost* p_cost,
+                      FILE* p_log);
+
+/**
+ * Content of pc_cmv_tuning.h for a tuning
+ *
+ * @param p_tuning Coefficients
+ * @param p_origin Where the coefficients come from, ending the file description
+ * @return Header source
+ */
+std::string tuningHeader(const PcCmvTuning& p_tuning, const std::string& p_origin);
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file pneumatic_plant.cpp
+ * @brief Pneumatic circuit and patient lungs around the simulated board
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "pneumatic_plant.h"
+
+// Externals
+#include <math.h>
+
+// Internal
+#include "../../includes/blower.h"
+#include "../../includes/hal.h"
+#include "../../includes/parameters.h"
+#include "../../includes/pressure_utl.h"
+#include "../../includes/timebase.h"
+#include "host_board.h"
+
+// INITIALISATION =============================================================
+
+/// Density of the air in kg/m³
+#define AIR_DENSITY 1.2
+
+/// Pressure of 1 mmH2O in Pa
+#define MMH2O_TO_PA 9.80665
+
+/// Highest pressure in mmH2O the circuit can reach, above the blower maximum
+#define MAX_CIRCUIT_PRESSURE 2000.0
+
+/// Number of bisection steps of the flow balances
+#define BALANCE_ITERATIONS 20u
+
+// FUNCTIONS ==================================================================
+
+PneumaticPlant::PneumaticPlant()
+    : m_inspiratoryValve(HAL_PWM_INSPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE),
+      m_expiratoryValve(HAL_PWM_EXPIRATORY_VALVE, VALVE_OPEN_STATE, VALVE_CLOSED_STATE),
+      m_inspiratoryValveAngle(VALVE_OPEN_STATE),
+      m_expiratoryValveAngle(VALVE_OPEN_STATE),
+      m_inspiratorySection(0),
+      m_expiratorySection(0),
+      m_blowerSpeed(0),
+      m_blowerEfficiency(1.0),
+      m_inspiratoryValveJammed(false),
+      m_expiratoryValveJammed(false),
+      m_leakSection(0),
+      m_oxygenFlow(0.0),
+      m_dischargeCoefficient(0.6),
+      m_compartments(0),
+      m_patientEffort(nullptr),
+      m_musclePressure(0.0),
+      m_sensors(nullptr),
+      m_airwayPressure(0.0),
+      m_inspiratoryFlow(0.0),
+      m_expiratoryFlow(0.0) {
+    LungCompartment lung = {10.0, 50.0};
+    setLung(lung);
+}
+
+void PneumaticPlant::setLung(const LungCompartment& p_lung) {
+    m_compartments = 1u;
+    m_lungs[0] = p_lung;
+    m_volumes[0] = 0.0;
+    m_volumes[1] = 0.0;
+}
+
+void PneumaticPlant::changeLung(const LungCompartment& p_lung) {
+    m_volumes[0] = lungVolume();
+    m_volumes[1] = 0.0;
+    m_compartments = 1u;
+    m_lungs[0] = p_lung;
+}
+
+void PneumaticPlant::setLungs(const LungCompartment& p_first, const LungCompartment& p_second) {
+    m_compartments = 2u;
+    m_lungs[0] = p_first;
+    m_lungs[1] = p_second;
+    m_volumes[0] = 0.0;
+    m_volumes[1] = 0.0;
+}
+
+void PneumaticPlant::setDischargeCoefficient(double p_coefficient) {
+    m_dischargeCoefficient = p_coefficient;
+}
+
+void PneumaticPlant::setValveJammed(HalPwmOutput p_valve, bool p_jammed) {
+    if (p_valve == HAL_PWM_INSPIRATORY_VALVE) {
+        m_inspiratoryValveJammed = p_jammed;
+    } else if (p_valve == HAL_PWM_EXPIRATORY_VALVE) {
+        m_expiratoryValveJammed = p_jammed;
+    }
+}
+
+double PneumaticPlant::lungVolume() const {
+    double volume = 0.0;
+    for (uint8_t i = 0; i < m_compartments; i++) {
+        volume += m_volumes[i];
+    }
+    return volume;
+}
+
+double PneumaticPlant::orificeFlow(int32_t p_sectionX100, double p_pressureDrop) const {
+    // Bernoulli: Q = Cd.A.sqrt(2.dP/rho), with A in mm² and Q in mL/s
+    double speed = sqrt(2.0 * fabs(p_pressureDrop) * MMH2O_TO_PA / AIR_DENSITY);
+    double flow = m_dischargeCoefficient * (p_sectionX100 / 100.0) * speed;
+    return (p_pressureDrop < 0.0) ? -flow : flow;
+}
+
+double PneumaticPlant::blowerFlow(double p_circuitPressure) const {
+    // The pressure of the blower drops with its flow: find the flow that goes through the valve
+    // under the pressure the blower builds at that flow
+    double low = orificeFlow(m_inspiratorySection, -p_circuitPressure);
+    double high = orificeFlow(m_inspiratorySection,
+                              (m_blowerEfficiency * Blower::getBlowerPressure(m_blowerSpeed, 0))
+                                  - p_circuitPressure);
+    for (uint8_t i = 0; i < BALANCE_ITERATIONS; i++) {
+        double flow = (low + high) / 2.0;
+        int32_t flowMlPerMin = static_cast<int32_t>(max(flow, 0.0) * 60.0);
+        double blowerPressure =
+            m_blowerEfficiency * Blower::getBlowerPressure(m_blowerSpeed, flowMlPerMin);
+        if (orificeFlow(m_inspiratorySection, blowerPressure - p_circuitPressure) > flow) {
+            low = flow;
+        } else {
+            high = flow;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+double PneumaticPlant::circuitFlowBalance(double p_circuitPressure) const {
+    double balance = blowerFlow(p_circuitPressure) + m_oxygenFlow
+                     - orificeFlow(m_expiratorySection, p_circuitPressure)
+                     - orificeFlow(m_leakSection, p_circuitPressure);
+
+    for (uint8_t i = 0; i < m_compartments; i++) {
+        // cmH2O/(L/s) to mmH2O/(mL/s), and mL/cmH2O to mL/mmH2O
+        double resistance = m_lungs[i].resistance / 100.0;
+        double compliance = m_lungs[i].compliance / 10.0;
+        double alveolarPressure = (m_volumes[i] / compliance) + m_musclePressure;
+        balance -= (p_circuitPressure - alveolarPressure) / resistance;
+    }
+    return balance;
+}
+
+void PneumaticPlant::moveValve(uint16_t p_pulseUs, double* p_angle, uint32_t p_dtUs) {
+    // Inverse of valveAngle2MicroSeconds()
+    double target = (static_cast<double>(p_pulseUs) - FAULHABER_OPENED) * VALVE_CLOSED_STATE
+                    / (FAULHABER_CLOSED - FAULHABER_OPENED);
+    target = min(max(target, 0.0), static_cast<double>(VALVE_CLOSED_STATE));
+
+    // The motor goes from open to closed in VALVE_RESPONSE_TIME_MS
+    double maxMove =
+        (static_cast<double>(VALVE_CLOSED_STATE) * p_dtUs) / (VALVE_RESPONSE_TIME_MS * 1000.0);
+    *p_angle += min(max(target - *p_angle, -maxMove), maxMove);
+}
+
+void PneumaticPlant::step(uint32_t p_dtUs) {
+    // Actuators
+    if (!m_inspiratoryValveJammed) {
+        moveValve(hostPwmOutputPulse(HAL_PWM_INSPIRATORY_VALVE), &m_inspiratoryValveAngle,
+                  p_dtUs);
+    }
+    if (!m_expiratoryValveJammed) {
+        moveValve(hostPwmOutputPulse(HAL_PWM_EXPIRATORY_VALVE), &m_expiratoryValveAngle, p_dtUs);
+    }
+    m_inspiratoryValve.open(static_cast<uint16_t>(lround(m_inspiratoryValveAngle)));
+    m_expiratoryValve.open(static_cast<uint16_t>(lround(m_expiratoryValveAngle)));
+    m_inspiratorySection = m_inspiratoryValve.getSectionBigHoseX100();
+    m_expiratorySection = m_expiratoryValve.getSectionBigHoseX100();
+
+    // Inverse of BlowerSpeed2MicroSeconds()
+    int32_t blowerPulse = hostPwmOutputPulse(HAL_PWM_BLOWER);
+    m_blowerSpeed = static_cast<uint16_t>(
+        min(max((blowerPulse - 1000) * 1800 / 950, int32_t(0)), int32_t(MAX_BLOWER_SPEED)));
+
+    // Patient
+    m_musclePressure =
+        (m_patientEffort == nullptr) ? 0.0 : m_patientEffort->pressure(monotonicMicros());
+
+    // Circuit pressure that balances the flows, the balance decreases with the pressure
+    double low = -MAX_CIRCUIT_PRESSURE;
+    double high = MAX_CIRCUIT_PRESSURE;
+    for (uint8_t i = 0; i < BALANCE_ITERATIONS; i++) {
+        double pressure = (low + high) / 2.0;
+        if (circuitFlowBalance(pressure) > 0.0) {
+            low = pressure;
+        } else {
+            high = pressure;
+        }
+    }
+    m_airwayPressure = (low + high) / 2.0;
+    m_inspiratoryFlow = blowerFlow(m_airwayPressure);
+    m_expiratoryFlow = orificeFlow(m_expiratorySection, m_airwayPressure);
+
+    // Lungs
+    double dt = p_dtUs / 1000000.0;
+    for (uint8_t i = 0; i < m_compartments; i++) {
+        double resistance = m_lungs[i].resistance / 100.0;
+        double compliance = m_lungs[i].compliance / 10.0;
+        double alveolarPressure = (m_volumes[i] / compliance) + m_musclePressure;
+        m_volumes[i] += dt * (m_airwayPressure - alveolarPressure) / resistance;
+    }
+
+    // Sensors
+    if (m_sensors == nullptr) {
+        setHostPressureAdc(
+            static_cast<uint16_t>(convertPressure2Sensor(lround(m_airwayPressure))));
+        setHostFlows(static_cast<int32_t>(inspiratoryFlow()),
+                     static_cast<int32_t>(expiratoryFlow()));
+    } else {
+        setHostPressureAdc(
+            m_sensors->pressure.boardWord(m_airwayPressure, p_dtUs, SENSOR_PRESSURE_ADC));
+        setHostFlowSensorWords(m_sensors->inspiratoryFlow.boardWord(inspiratoryFlow(), p_dtUs,
+                                                                    BOARD_INSPIRATORY_SENSOR),
+                               m_sensors->expiratoryFlow.boardWord(expiratoryFlow(), p_dtUs,
+                                                                   BOARD_EXPIRATORY_SENSOR));
+    }
+}
@@ -0,0 +1,215 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file pneumatic_plant.h
+ * @brief Pneumatic circuit and patient lungs around the simulated board
+ *
+ * The plant reads the valve and blower commands on the HAL outputs and turns them into the
+ * pressure and the flows the sensors measure. The blower builds the pressure of its
+ * characteristic (Blower::getBlowerPressure), the valves are orifices of the section given by
+ * their geometry (PressureValve::getSectionBigHoseX100, which PressureValve::openSection inverts),
+ * and the lungs are one or two resistance-compliance compartments, on which the muscles of a
+ * breathing patient can pull (PatientEffort). The circuit is considered stiff compared to the
+ * lungs: on every step, its pressure is the one that balances the flows.
+ *
+ * The faults of a machine on the production line can be modelled as well: a leak of the circuit,
+ * a blower that builds less pressure than its characteristic, a jammed valve, and the oxygen
+ * inlet that the operator opens during the end of line test.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "../../includes/pressure_valve.h"
+#include "patient_effort.h"
+#include "sensor_model.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Maximum number of lung compartments
+#define PNEUMATIC_PLANT_MAX_COMPARTMENTS 2u
+
+/// Sensors of the pressure and of the flows
+struct PlantSensors {
+    /// Pressure sensor, read at the patient
+    SensorModel pressure;
+    /// Flow meter of the inspiratory branch
+    SensorModel inspiratoryFlow;
+    /// Flow meter of the expiratory branch
+    SensorModel expiratoryFlow;
+};
+
+/// Resistance-compliance lung compartment
+struct LungCompartment {
+    /// Airway resistance in cmH2O/(L/s)
+    double resistance;
+    /// Compliance in mL/cmH2O
+    double compliance;
+};
+
+// CLASS ======================================================================
+
+/// Closed loop plant of the ventilator: blower, valves, circuit and lungs
+class PneumaticPlant : public SimulatedPlant {
+ public:
+    /// Default constructor: one compartment of 10 cmH2O/(L/s) and 50 mL/cmH2O
+    PneumaticPlant();
+
+    /**
+     * Use a single compartment lung, emptied to its relaxation volume
+     *
+     * @param p_lung Compartment
+     */
+    void setLung(const LungCompartment& p_lung);
+
+    /**
+     * Change the lung of a breathing patient for a single compartment, keeping its volume: the
+     * elastic pressure follows the new compliance from the next step
+     *
+     * @param p_lung Compartment
+     */
+    void changeLung(const LungCompartment& p_lung);
+
+    /**
+     * Use a two compartment lung, emptied to its relaxation volume
+     *
+     * @param p_first First compartment
+     * @param p_second Second compartment, in parallel with the first one
+     */
+    void setLungs(const LungCompartment& p_first, const LungCompartment& p_second);
+
+    /**
+     * Set the discharge coefficient of the valve orifices
+     *
+     * @param p_coefficient Ratio of the actual flow to the ideal orifice flow, 0.6 by default
+     */
+    void setDischargeCoefficient(double p_coefficient);
+
+    /**
+     * Open a leak of the circuit to the room, at the patient
+     *
+     * @param p_sectionX100 Section of the leak in mm² x 100, 0 for a tight circuit
+     */
+    void setLeak(int32_t p_sectionX100) { m_leakSection = p_sectionX100; }
+
+    /**
+     * Scale the pressure the blower builds
+     *
+     * @param p_efficiency Ratio to the pressure of its characteristic, 1 by default
+     */
+    void setBlowerEfficiency(double p_efficiency) { m_blowerEfficiency = p_efficiency; }
+
+    /**
+     * Jam a valve, or free it
+     *
+     * @param p_valve HAL_PWM_INSPIRATORY_VALVE or HAL_PWM_EXPIRATORY_VALVE
+     * @param p_jammed True to keep the valve at its current angle whatever its command
+     */
+    void setValveJammed(HalPwmOutput p_valve, bool p_jammed);
+
+    /**
+     * Set the flow of the oxygen inlet into the circuit
+     *
+     * @param p_flow Flow in mL/min, held by the regulator of the supply whatever the pressure of
+     *        the circuit, 0 while the inlet is closed
+     */
+    void setOxygenFlow(double p_flow) { m_oxygenFlow = p_flow / 60.0; }
+
+    /**
+     * Let the patient breathe on the ventilator
+     *
+     * @param p_effort Muscle pressure waveform, or nullptr for a passive patient
+     */
+    void setPatientEffort(const PatientEffort* p_effort) { m_patientEffort = p_effort; }
+
+    /**
+     * Measure the pressure and the flows with imperfect sensors
+     *
+     * @param p_sensors Sensors, sampled on every step, or nullptr for ideal sensors that only
+     *        round the values to the resolution of the board conversions
+     */
+    void setSensors(PlantSensors* p_sensors) { m_sensors = p_sensors; }
+
+    void step(uint32_t p_dtUs) override;
+
+    /// Pressure at the patient in mmH2O
+    double airwayPressure() const { return m_airwayPressure; }
+
+    /// Pressure the respiratory muscles apply on the lungs in mmH2O
+    double musclePressure() const { return m_musclePressure; }
+
+    /// Flow through the inspiratory valve in mL/min
+    double inspiratoryFlow() const { return m_inspiratoryFlow * 60.0; }
+
+    /// Flow through the expiratory valve in mL/min
+    double expiratoryFlow() const { return m_expiratoryFlow * 60.0; }
+
+    /// Volume in the lungs above their relaxation volume, in mL
+    double lungVolume() const;
+
+    /**
+     * Get the volume of a compartment
+     *
+     * @param p_index Index of the compartment
+     * @return Volume above its relaxation volume, in mL
+     */
+    double compartmentVolume(uint8_t p_index) const { return m_volumes[p_index]; }
+
+ private:
+    /// Flow in mL/s through an orifice of a section in mm² x 100 under a pressure difference
+    double orificeFlow(int32_t p_sectionX100, double p_pressureDrop) const;
+
+    /// Flow in mL/s the blower pushes through the inspiratory valve into the circuit
+    double blowerFlow(double p_circuitPressure) const;
+
+    /// Sum of the flows in mL/s entering the circuit at a pressure, decreasing with the pressure
+    double circuitFlowBalance(double p_circuitPressure) const;
+
+    /// Move a valve towards its command at the speed of its motor
+    void moveValve(uint16_t p_pulseUs, double* p_angle, uint32_t p_dtUs);
+
+    /// Copies of the valves, used for their geometry only
+    PressureValve m_inspiratoryValve;
+    PressureValve m_expiratoryValve;
+
+    /// Current valve angles in degrees
+    double m_inspiratoryValveAngle;
+    double m_expiratoryValveAngle;
+
+    /// Valve sections in mm² x 100
+    int32_t m_inspiratorySection;
+    int32_t m_expiratorySection;
+
+    /// Blower speed read on its output
+    uint16_t m_blowerSpeed;
+
+    double m_blowerEfficiency;
+
+    bool m_inspiratoryValveJammed;
+    bool m_expiratoryValveJammed;
+
+    /// Section of the leak in mm² x 100
+    int32_t m_leakSection;
+
+    /// Flow of the oxygen inlet in mL/s
+    double m_oxygenFlow;
+
+    double m_dischargeCoefficient;
+
+    uint8_t m_compartments;
+    LungCompartment m_lungs[PNEUMATIC_PLANT_MAX_COMPARTMENTS];
+    double m_volumes[PNEUMATIC_PLANT_MAX_COMPARTMENTS];
+
+    const PatientEffort* m_patientEffort;
+    double m_musclePressure;
+
+    PlantSensors* m_sensors;
+
+    double m_airwayPressure;
+    double m_inspiratoryFlow;
+    double m_expiratoryFlow;
+};
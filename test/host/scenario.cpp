@@ -0,0 +1,1009 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file scenario.cpp
+ * @brief Scripted ventilation sessions, read from scenario files
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "scenario.h"
+
+// Externals
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/alarm_controller.h"
+#include "../../includes/board_state.h"
+#include "../../includes/cycle.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/serial_control.h"
+#include "../../includes/timebase.h"
+#include "../../includes/ventilator_context.h"
+#include "patient_effort.h"
+#include "session_sweep.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the simulation steps, of the dates and of the pressure samples
+#define SCENARIO_SAMPLE_PERIOD_US 1000u
+
+/// Duration of the PEEP measure at the end of a cycle, in samples
+#define SCENARIO_PEEP_SAMPLES 100u
+
+/// Longest session, a scenario whose end is not reached by then is in error
+#define SCENARIO_MAX_DURATION_MS (30u * 60u * 1000u)
+
+/// Size of the texts of a scenario outcome sent by a worker
+#define SCENARIO_NAME_SIZE 64u
+#define SCENARIO_ERROR_SIZE 160u
+#define SCENARIO_TEXT_SIZE 96u
+#define SCENARIO_MESSAGE_SIZE 128u
+
+/// Name of a control setting in the scenario files
+struct ScenarioSettingName {
+    const char* name;
+    uint8_t setting;
+};
+
+/// Control settings, named as in ControlSetting
+static const ScenarioSettingName SCENARIO_SETTINGS[] = {
+    {"Heartbeat", Heartbeat},
+    {"VentilationMode", VentilationMode},
+    {"PlateauPressure", PlateauPressure},
+    {"PEEP", PEEP},
+    {"CyclesPerMinute", CyclesPerMinute},
+    {"ExpiratoryTerm", ExpiratoryTerm},
+    {"TriggerEnabled", TriggerEnabled},
+    {"TriggerOffset", TriggerOffset},
+    {"RespirationEnabled", RespirationEnabled},
+    {"AlarmSnooze", AlarmSnooze},
+    {"InspiratoryTriggerFlow", InspiratoryTriggerFlow},
+    {"ExpiratoryTriggerFlow", ExpiratoryTriggerFlow},
+    {"TiMin", TiMin},
+    {"TiMax", TiMax},
+    {"LowInspiratoryMinuteVolumeAlarmThreshold", LowInspiratoryMinuteVolumeAlarmThreshold},
+    {"HighInspiratoryMinuteVolumeAlarmThreshold", HighInspiratoryMinuteVolumeAlarmThreshold},
+    {"LowExpiratoryMinuteVolumeAlarmThreshold", LowExpiratoryMinuteVolumeAlarmThreshold},
+    {"HighExpiratoryMinuteVolumeAlarmThreshold", HighExpiratoryMinuteVolumeAlarmThreshold},
+    {"LowRespiratoryRateAlarmThreshold", LowRespiratoryRateAlarmThreshold},
+    {"HighRespiratoryRateAlarmThreshold", HighRespiratoryRateAlarmThreshold},
+    {"TargetTidalVolume", TargetTidalVolume},
+    {"LowTidalVolumeAlarmThreshold", LowTidalVolumeAlarmThreshold},
+    {"HighTidalVolumeAlarmThreshold", HighTidalVolumeAlarmThreshold},
+    {"PlateauDuration", PlateauDuration},
+    {"LeakAlarmThreshold", LeakAlarmThreshold},
+    {"TargetInspiratoryFlow", TargetInspiratoryFlow},
+    {"InspiratoryDuration", InspiratoryDuration},
+    {"Locale", Locale},
+    {"PatientHeight", PatientHeight},
+    {"PatientGender", PatientGender},
+    {"PeakPressureAlarmThreshold", PeakPressureAlarmThreshold},
+    {"EolConfirm", EolConfirm},
+    {"TimingHistograms", TimingHistograms},
+    {"SensorCaptureEnabled", SensorCaptureEnabled}};
+
+/// Ventilation modes, named as in VentilationModes
+static const char* const SCENARIO_MODES[] = {"PC_CMV", "PC_AC", "VC_CMV", "PC_VSAI", "VC_AC"};
+
+/// Input faults, in the order of FaultKind
+static const char* const SCENARIO_FAULTS[] = {"flow_meter_nack", "flow_meter_short_read",
+                                              "spurious_flow", "battery_spike", "battery_droop"};
+
+/// Lungs of the scenario running in this process, they must outlive the simulation
+static BOARD_STATE PatientEffort scenarioEffort;
+
+/// Measures of a respiratory cycle of a scenario
+struct ScenarioCycle {
+    uint32_t number;
+    /// Date of the end of the cycle, in ms after the boot
+    uint32_t endMs;
+    bool pressureControlled;
+    int16_t peepCommand;
+    int16_t plateauPressureCommand;
+    uint16_t tidalVolumeCommand;
+    std::vector<double> pressures;
+    uint32_t inhalationSamples;
+    double minVolume;
+    double maxVolume;
+};
+
+/// Change of the state of an alarm
+struct ScenarioAlarmChange {
+    uint8_t code;
+    /// Date in ms after the boot
+    uint32_t dateMs;
+    bool triggered;
+};
+
+/// What the session of a scenario did
+struct ScenarioRun {
+    /// Date of the end of the session, in ms after the boot
+    uint32_t endMs;
+    /// Date of the start of every respiratory cycle, in ms after the boot, 0 for the cycle 0
+    std::vector<uint32_t> cycleStartsMs;
+    /// Dates of the commands run after the boot, in ms
+    std::vector<uint32_t> actionDatesMs;
+    std::vector<ScenarioCycle> cycles;
+    std::vector<ScenarioAlarmChange> alarmChanges;
+};
+
+/// Outcome of an expectation, as a worker sends it
+struct ScenarioCheckRecord {
+    uint32_t line;
+    uint8_t passed;
+    char text[SCENARIO_TEXT_SIZE];
+    char message[SCENARIO_MESSAGE_SIZE];
+};
+
+/// Outcome of a scenario, as a worker sends it
+struct ScenarioRecord {
+    char name[SCENARIO_NAME_SIZE];
+    char error[SCENARIO_ERROR_SIZE];
+    double durationS;
+    uint32_t checks;
+    ScenarioCheckRecord records[SCENARIO_MAX_CHECKS];
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Parse an unsigned integer
+ *
+ * @param p_token Text
+ * @param p_max Largest value accepted
+ * @param p_value Value
+ * @return False if the text is not an integer up to the largest value
+ */
+static bool parseUnsigned(const std::string& p_token, uint32_t p_max, uint32_t* p_value) {
+    char* end = nullptr;
+    unsigned long value = strtoul(p_token.c_str(), &end, 10);
+    if (p_token.empty() || (p_token[0] == '-') || (*end != '\0') || (value > p_max)) {
+        return false;
+    }
+    *p_value = static_cast<uint32_t>(value);
+    return true;
+}
+
+/**
+ * Parse a real number
+ *
+ * @param p_token Text
+ * @param p_value Value
+ * @return False if the text is not a number
+ */
+static bool parseReal(const std::string& p_token, double* p_value) {
+    char* end = nullptr;
+    double value = strtod(p_token.c_str(), &end);
+    if (p_token.empty() || (*end != '\0') || !std::isfinite(value)) {
+        return false;
+    }
+    *p_value = value;
+    return true;
+}
+
+/**
+ * Parse a duration: a number followed by its unit, ms or s
+ *
+ * @param p_value Number
+ * @param p_unit Unit
+ * @param p_ms Duration in ms
+ * @return False if the duration is not valid
+ */
+static bool parseDuration(const std::string& p_value, const std::string& p_unit, uint32_t* p_ms) {
+    double value = 0.0;
+    if (!parseReal(p_value, &value) || (value < 0.0)) {
+        return false;
+    }
+    if (p_unit == "s") {
+        value *= 1000.0;
+    } else if (p_unit != "ms") {
+        return false;
+    }
+    if (value > SCENARIO_MAX_DURATION_MS) {
+        return false;
+    }
+    *p_ms = static_cast<uint32_t>(lround(value));
+    return true;
+}
+
+/**
+ * Find a name in a list
+ *
+ * @param p_names Names
+ * @param p_count Number of names
+ * @param p_name Name to find
+ * @return Index of the name, or p_count if it is not in the list
+ */
+static size_t findName(const char* const* p_names, size_t p_count, const std::string& p_name) {
+    size_t index = 0u;
+    while ((index < p_count) && (p_name != p_names[index])) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * Parse an expectation
+ *
+ * @param p_tokens Words of the expectation, after "expect"
+ * @param p_check Expectation, its line, text and date already set
+ * @return Empty, or the reason of the error
+ */
+static std::string parseCheck(const std::vector<std::string>& p_tokens, ScenarioCheck* p_check) {
+    std::vector<std::string> tokens = p_tokens;
+    uint32_t value = 0u;
+    if ((tokens.size() >= 2u) && (tokens[0] == "no") && (tokens[1] == "alarm")) {
+        p_check->kind = SCENARIO_EXPECT_NO_ALARM;
+        tokens.erase(tokens.begin());
+    } else if (!tokens.empty() && (tokens[0] == "alarm")) {
+        p_check->kind = SCENARIO_EXPECT_ALARM;
+    } else {
+        if ((tokens.size() != 6u) || (tokens[1] != "within") || (tokens[3] != "after")
+            || (tokens[5] != "cycles")) {
+            return "expected '<measure> within <tolerance> after <n> cycles'";
+        }
+        if (tokens[0] == "peep") {
+            p_check->kind = SCENARIO_EXPECT_PEEP;
+        } else if (tokens[0] == "plateau") {
+            p_check->kind = SCENARIO_EXPECT_PLATEAU;
+        } else if (tokens[0] == "tidal_volume") {
+            p_check->kind = SCENARIO_EXPECT_TIDAL_VOLUME;
+        } else {
+            return "unknown measure '" + tokens[0] + "'";
+        }
+        if (!parseReal(tokens[2], &p_check->tolerance) || (p_check->tolerance < 0.0)) {
+            return "invalid tolerance '" + tokens[2] + "'";
+        }
+        if (!parseUnsigned(tokens[4], UINT16_MAX, &p_check->cycles)) {
+            return "invalid number of cycles '" + tokens[4] + "'";
+        }
+        return "";
+    }
+
+    if ((tokens.size() != 5u) || (tokens[2] != "within") || (tokens[4] != "cycles")) {
+        return "expected 'alarm <code> within <n> cycles'";
+    }
+    if (!parseUnsigned(tokens[1], UINT8_MAX, &value) || (value == 0u)) {
+        return "invalid alarm code '" + tokens[1] + "'";
+    }
+    p_check->alarm = static_cast<uint8_t>(value);
+    if (!parseUnsigned(tokens[3], UINT16_MAX, &p_check->cycles)) {
+        return "invalid number of cycles '" + tokens[3] + "'";
+    }
+    return "";
+}
+
+/**
+ * Parse a command acting on the session
+ *
+ * @param p_tokens Words of the command
+ * @param p_action Command, its line and date already set
+ * @return Empty, or the reason of the error
+ */
+static std::string parseAction(const std::vector<std::string>& p_tokens,
+                               ScenarioAction* p_action) {
+    const std::string& command = p_tokens[0];
+    uint32_t value = 0u;
+    if ((command == "start") || (command == "stop") || (command == "end")) {
+        if (p_tokens.size() != 1u) {
+            return "'" + command + "' takes no argument";
+        }
+        p_action->kind = (command == "start")
+                             ? SCENARIO_START
+                             : ((command == "stop") ? SCENARIO_STOP : SCENARIO_END);
+    } else if (command == "set") {
+        if (p_tokens.size() != 3u) {
+            return "expected 'set <setting> <value>'";
+        }
+        size_t count = sizeof(SCENARIO_SETTINGS) / sizeof(SCENARIO_SETTINGS[0]);
+        size_t index = 0u;
+        while ((index < count) && (p_tokens[1] != SCENARIO_SETTINGS[index].name)) {
+            index++;
+        }
+        if (index == count) {
+            return "unknown setting '" + p_tokens[1] + "'";
+        }
+        if (!parseUnsigned(p_tokens[2], UINT16_MAX, &value)) {
+            return "invalid value '" + p_tokens[2] + "'";
+        }
+        p_action->kind = SCENARIO_SET;
+        p_action->setting = SCENARIO_SETTINGS[index].setting;
+        p_action->value = static_cast<uint16_t>(value);
+    } else if (command == "mode") {
+        size_t count = sizeof(SCENARIO_MODES) / sizeof(SCENARIO_MODES[0]);
+        size_t index = (p_tokens.size() == 2u) ? findName(SCENARIO_MODES, count, p_tokens[1])
+                                               : count;
+        if (index == count) {
+            return "expected 'mode <PC_CMV|PC_AC|VC_CMV|PC_VSAI|VC_AC>'";
+        }
+        p_action->kind = SCENARIO_SET;
+        p_action->setting = VentilationMode;
+        // Modes are numbered from 1, in the order of the names
+        p_action->value = static_cast<uint16_t>(index + 1u);
+    } else if (command == "patient") {
+        if ((p_tokens.size() != 3u) && (p_tokens.size() != 5u)) {
+            return "expected 'patient <resistance> <compliance> [<resistance> <compliance>]'";
+        }
+        p_action->kind = SCENARIO_PATIENT;
+        p_action->compartments = static_cast<uint8_t>((p_tokens.size() - 1u) / 2u);
+        if ((p_action->compartments > 1u) && (p_action->date.kind != SCENARIO_AT_BOOT)) {
+            return "two compartments can only be set at the boot";
+        }
+        for (uint8_t i = 0; i < p_action->compartments; i++) {
+            LungCompartment& lung = p_action->lungs[i];
+            if (!parseReal(p_tokens[1u + (2u * i)], &lung.resistance)
+                || !parseReal(p_tokens[2u + (2u * i)], &lung.compliance)
+                || (lung.resistance <= 0.0) || (lung.compliance <= 0.0)) {
+                return "invalid resistance or compliance";
+            }
+        }
+    } else if (command == "effort") {
+        if ((p_tokens.size() != 3u) || !parseUnsigned(p_tokens[1], UINT16_MAX, &value)
+            || !parseReal(p_tokens[2], &p_action->effortAmplitude)) {
+            return "expected 'effort <breaths per minute> <amplitude>'";
+        }
+        p_action->kind = SCENARIO_EFFORT;
+        p_action->effortRate = static_cast<uint16_t>(value);
+    } else if (command == "fault") {
+        size_t count = sizeof(SCENARIO_FAULTS) / sizeof(SCENARIO_FAULTS[0]);
+        size_t index = (p_tokens.size() >= 4u) ? findName(SCENARIO_FAULTS, count, p_tokens[1])
+                                                : count;
+        ScheduledFault& fault = p_action->fault;
+        if ((index == count) || (p_tokens.size() > 5u)
+            || !parseDuration(p_tokens[2], p_tokens[3], &fault.durationMs)) {
+            return "expected 'fault <kind> <duration> <ms|s> [inspiratory|expiratory|<ADC>]'";
+        }
+        p_action->kind = SCENARIO_FAULT;
+        fault.kind = static_cast<FaultKind>(index);
+        fault.startMs = 0u;
+        fault.flowMeter = HOST_INSPIRATORY_FLOW_METER;
+        fault.batteryAdc = 0u;
+        if (p_tokens.size() == 5u) {
+            if (p_tokens[4] == "expiratory") {
+                fault.flowMeter = HOST_EXPIRATORY_FLOW_METER;
+            } else if (p_tokens[4] != "inspiratory") {
+                if (!parseUnsigned(p_tokens[4], 4095u, &value)) {
+                    return "invalid flow meter or ADC value '" + p_tokens[4] + "'";
+                }
+                fault.batteryAdc = static_cast<uint16_t>(value);
+            }
+        }
+    } else {
+        return "unknown command '" + command + "'";
+    }
+    return "";
+}
+
+bool parseScenario(const std::string& p_name,
+                   const std::string& p_text,
+                   Scenario* p_scenario,
+                   std::string* p_error) {
+    p_scenario->name = p_name;
+    p_scenario->actions.clear();
+    p_scenario->checks.clear();
+
+    std::istringstream lines(p_text);
+    std::string line;
+    uint32_t lineNumber = 0u;
+    bool ended = false;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        std::string reason;
+        std::istringstream words(line.substr(0u, line.find('#')));
+        std::vector<std::string> tokens;
+        std::string word;
+        while (words >> word) {
+            tokens.push_back(word);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        ScenarioDate date = {SCENARIO_AT_BOOT, 0u};
+        size_t first = 0u;
+        if (tokens[0] == "at") {
+            first = 3u;
+            if ((tokens.size() >= 3u) && (tokens[1] == "cycle")) {
+                date.kind = SCENARIO_AT_CYCLE;
+                if (!parseUnsigned(tokens[2], UINT16_MAX, &date.value) || (date.value == 0u)) {
+                    reason = "invalid cycle '" + tokens[2] + "'";
+                }
+            } else {
+                date.kind = SCENARIO_AT_MS;
+                if ((tokens.size() < 3u) || !parseDuration(tokens[1], tokens[2], &date.value)) {
+                    reason = "expected 'at <n> ms', 'at <n> s' or 'at cycle <n>'";
+                }
+            }
+            if (reason.empty() && (tokens.size() <= first)) {
+                reason = "missing command after the date";
+            }
+        }
+
+        if (reason.empty()) {
+            std::vector<std::string> command(tokens.begin() + first, tokens.end());
+            if (command[0] == "expect") {
+                ScenarioCheck check;
+                check.line = lineNumber;
+                check.date = date;
+                check.alarm = 0u;
+                check.cycles = 0u;
+                check.tolerance = 0.0;
+                for (size_t i = 0; i < command.size(); i++) {
+                    check.text += ((i > 0u) ? " " : "") + command[i];
+                }
+                reason = parseCheck(std::vector<std::string>(command.begin() + 1, command.end()),
+                                    &check);
+                if (reason.empty() && (p_scenario->checks.size() >= SCENARIO_MAX_CHECKS)) {
+                    reason = "too many expectations";
+                }
+                p_scenario->checks.push_back(check);
+            } else {
+                ScenarioAction action = ScenarioAction();
+                action.line = lineNumber;
+                action.date = date;
+                reason = parseAction(command, &action);
+                if (reason.empty() && (action.kind == SCENARIO_END)) {
+                    if (ended) {
+                        reason = "the session has already an end";
+                    } else if (date.kind == SCENARIO_AT_BOOT) {
+                        reason = "the end needs a date";
+                    }
+                    ended = true;
+                }
+                p_scenario->actions.push_back(action);
+            }
+        }
+
+        if (!reason.empty()) {
+            *p_error = "line " + std::to_string(lineNumber) + ": " + reason;
+            return false;
+        }
+    }
+
+    if (!ended) {
+        *p_error = "missing 'at <date> end'";
+        return false;
+    }
+    return true;
+}
+
+bool readScenarioFile(const std::string& p_path, Scenario* p_scenario, std::string* p_error) {
+    size_t slash = p_path.find_last_of('/');
+    std::string name = (slash == std::string::npos) ? p_path : p_path.substr(slash + 1u);
+    name = name.substr(0u, name.find_last_of('.'));
+
+    std::ifstream file(p_path.c_str());
+    if (!file) {
+        *p_error = "cannot read " + p_path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parseScenario(name, text.str(), p_scenario, p_error);
+}
+
+/**
+ * Check if the date of a command is reached
+ *
+ * @param p_date Date of the command
+ * @param p_nowMs Date in ms after the boot
+ * @return True if the command must run
+ */
+static bool isDateReached(const ScenarioDate& p_date, uint32_t p_nowMs) {
+    bool reached = true;
+    if (p_date.kind == SCENARIO_AT_MS) {
+        reached = p_nowMs >= p_date.value;
+    } else if (p_date.kind == SCENARIO_AT_CYCLE) {
+        reached = ventilator.mainController.cycleNumber() >= p_date.value;
+    }
+    return reached;
+}
+
+/**
+ * Run a command acting on the session
+ *
+ * @param p_action Command
+ * @param p_plant Lungs of the session
+ * @param p_nowMs Date in ms after the boot
+ * @param p_schedule Faults started so far, the fault of the command is added to it
+ */
+static void runAction(const ScenarioAction& p_action,
+                      PneumaticPlant* p_plant,
+                      uint32_t p_nowMs,
+                      std::vector<ScheduledFault>* p_schedule) {
+    switch (p_action.kind) {
+    case SCENARIO_SET:
+        applyControlSetting(p_action.setting, p_action.value);
+        break;
+    case SCENARIO_PATIENT:
+        if (p_action.compartments > 1u) {
+            p_plant->setLungs(p_action.lungs[0], p_action.lungs[1]);
+        } else if (p_action.date.kind == SCENARIO_AT_BOOT) {
+            p_plant->setLung(p_action.lungs[0]);
+        } else {
+            p_plant->changeLung(p_action.lungs[0]);
+        }
+        break;
+    case SCENARIO_EFFORT:
+        scenarioEffort.setRate(p_action.effortRate);
+        scenarioEffort.setAmplitude(p_action.effortAmplitude);
+        scenarioEffort.setFirstOnset(monotonicMicros());
+        p_plant->setPatientEffort(&scenarioEffort);
+        break;
+    case SCENARIO_FAULT: {
+        ScheduledFault fault = p_action.fault;
+        fault.startMs = p_nowMs;
+        p_schedule->push_back(fault);
+        break;
+    }
+    case SCENARIO_START:
+        activationController.onStartButton();
+        break;
+    case SCENARIO_STOP:
+        activationController.onStopButton();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Record the alarms that were triggered or cleared since the previous call
+ *
+ * @param p_nowMs Date in ms after the boot
+ * @param p_triggered Alarms triggered at the previous call, updated
+ * @param p_changes Changes, appended to
+ */
+static void recordAlarmChanges(uint32_t p_nowMs,
+                               std::vector<uint8_t>* p_triggered,
+                               std::vector<ScenarioAlarmChange>* p_changes) {
+    const uint8_t* alarms = ventilator.alarmController.triggeredAlarms();
+    std::vector<uint8_t> triggered;
+    for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
+        if (alarms[i] != 0u) {
+            triggered.push_back(alarms[i]);
+        }
+    }
+    for (uint8_t code : triggered) {
+        if (std::find(p_triggered->begin(), p_triggered->end(), code) == p_triggered->end()) {
+            ScenarioAlarmChange change = {code, p_nowMs, true};
+            p_changes->push_back(change);
+        }
+    }
+    for (uint8_t code : *p_triggered) {
+        if (std::find(triggered.begin(), triggered.end(), code) == triggered.end()) {
+            ScenarioAlarmChange change = {code, p_nowMs, false};
+            p_changes->push_back(change);
+        }
+    }
+    *p_triggered = triggered;
+}
+
+/**
+ * Start the record of a respiratory cycle, with the commands it runs with
+ *
+ * @param p_plant Lungs of the session
+ * @param p_cycle Record
+ */
+static void startScenarioCycle(const PneumaticPlant& p_plant, ScenarioCycle* p_cycle) {
+    const MainController& controller = ventilator.mainController;
+    const VentilationController* mode = controller.ventilationControllerNextCommand();
+    p_cycle->number = controller.cycleNumber();
+    p_cycle->endMs = 0u;
+    p_cycle->pressureControlled =
+        (mode != &ventilator.vcCmvController) && (mode != &ventilator.vcAcController);
+    p_cycle->peepCommand = controller.peepCommand();
+    p_cycle->plateauPressureCommand = controller.plateauPressureCommand();
+    p_cycle->tidalVolumeCommand = static_cast<uint16_t>(controller.tidalVolumeCommand());
+    p_cycle->pressures.clear();
+    p_cycle->inhalationSamples = 0u;
+    p_cycle->minVolume = p_plant.lungVolume();
+    p_cycle->maxVolume = p_cycle->minVolume;
+}
+
+/**
+ * Run the session of a scenario
+ *
+ * @param p_scenario Script of the session
+ * @param p_run What the session did
+ * @return Empty, or the reason the session could not be run to its end
+ */
+static std::string runScenarioSession(const Scenario& p_scenario, ScenarioRun* p_run) {
+    PneumaticPlant& plant = bootSweepBoard(defaultSweepSession());
+    scenarioEffort = PatientEffort();
+
+    std::vector<bool> done(p_scenario.actions.size(), false);
+    std::vector<ScheduledFault> schedule;
+    std::vector<uint8_t> triggered;
+    ScenarioCycle cycle;
+    startScenarioCycle(plant, &cycle);
+    p_run->cycleStartsMs.assign(1u, 0u);
+
+    uint32_t nowMs = 0u;
+    bool ended = false;
+    while (!ended) {
+        for (size_t i = 0; i < p_scenario.actions.size(); i++) {
+            const ScenarioAction& action = p_scenario.actions[i];
+            if (done[i] || !isDateReached(action.date, nowMs)) {
+                continue;
+            }
+            done[i] = true;
+            ended = ended || (action.kind == SCENARIO_END);
+            runAction(action, &plant, nowMs, &schedule);
+            if (action.date.kind != SCENARIO_AT_BOOT) {
+                p_run->actionDatesMs.push_back(nowMs);
+            }
+        }
+        if (ended) {
+            break;
+        }
+        if (nowMs >= SCENARIO_MAX_DURATION_MS) {
+            return "the end was not reached after " + std::to_string(nowMs / 1000u) + " s";
+        }
+
+        if (!schedule.empty()) {
+            applyInputFaults(schedule, nowMs);
+        }
+        runSimulation(SCENARIO_SAMPLE_PERIOD_US);
+        nowMs++;
+        recordAlarmChanges(nowMs, &triggered, &p_run->alarmChanges);
+
+        // Cycle numbers only grow by one
+        const MainController& controller = ventilator.mainController;
+        if (controller.cycleNumber() != cycle.number) {
+            if ((cycle.number > 0u) && !cycle.pressures.empty()) {
+                cycle.endMs = nowMs;
+                p_run->cycles.push_back(cycle);
+            }
+            while (p_run->cycleStartsMs.size() <= controller.cycleNumber()) {
+                p_run->cycleStartsMs.push_back(nowMs);
+            }
+            startScenarioCycle(plant, &cycle);
+        }
+        cycle.pressures.push_back(plant.airwayPressure());
+        if (controller.phase() == INHALATION) {
+            cycle.inhalationSamples = static_cast<uint32_t>(cycle.pressures.size());
+        }
+        cycle.minVolume = std::min(cycle.minVolume, plant.lungVolume());
+        cycle.maxVolume = std::max(cycle.maxVolume, plant.lungVolume());
+    }
+    p_run->endMs = nowMs;
+    return "";
+}
+
+/**
+ * Find the respiratory cycle in progress at a date
+ *
+ * @param p_run What the session did
+ * @param p_dateMs Date in ms after the boot
+ * @return Cycle number, 0 before the first cycle
+ */
+static uint32_t cycleAt(const ScenarioRun& p_run, uint32_t p_dateMs) {
+    uint32_t number = 0u;
+    while (((number + 1u) < p_run.cycleStartsMs.size())
+           && (p_run.cycleStartsMs[number + 1u] <= p_dateMs)) {
+        number++;
+    }
+    return number;
+}
+
+/**
+ * Evaluate an alarm expectation
+ *
+ * @param p_check Expectation
+ * @param p_run What the session did
+ * @param p_dateMs Date of the expectation, in ms after the boot
+ * @param p_result Outcome, its message set
+ * @return True if the alarm was triggered in the window
+ */
+static bool checkAlarm(const ScenarioCheck& p_check,
+                       const ScenarioRun& p_run,
+                       uint32_t p_dateMs,
+                       ScenarioCheckResult* p_result) {
+    uint32_t lastCycle = cycleAt(p_run, p_dateMs) + p_check.cycles;
+    uint32_t windowEndMs =
+        ((lastCycle + 1u) < p_run.cycleStartsMs.size()) ? p_run.cycleStartsMs[lastCycle + 1u]
+                                                        : p_run.endMs;
+    int64_t latencyMs = -1;
+    bool active = false;
+    for (const ScenarioAlarmChange& change : p_run.alarmChanges) {
+        if ((change.code != p_check.alarm) || (change.dateMs >= windowEndMs)) {
+            continue;
+        }
+        if (change.dateMs <= p_dateMs) {
+            active = change.triggered;
+        } else if (change.triggered && (latencyMs < 0)) {
+            latencyMs = change.dateMs - p_dateMs;
+        }
+    }
+    if (active) {
+        latencyMs = 0;
+    }
+
+    char message[SCENARIO_MESSAGE_SIZE];
+    if (latencyMs >= 0) {
+        (void)snprintf(message, sizeof(message), "alarm %u triggered after %lld ms",
+                       p_check.alarm, static_cast<long long>(latencyMs));
+    } else {
+        (void)snprintf(message, sizeof(message), "alarm %u not triggered from %u ms to %u ms",
+                       p_check.alarm, p_dateMs, windowEndMs);
+    }
+    p_result->message = message;
+    return latencyMs >= 0;
+}
+
+/**
+ * Evaluate a measure expectation
+ *
+ * @param p_check Expectation
+ * @param p_run What the session did
+ * @param p_dateMs Date of the expectation, in ms after the boot
+ * @param p_result Outcome, its message set
+ * @return True if every cycle checked is within the tolerance, and there is one
+ */
+static bool checkMeasure(const ScenarioCheck& p_check,
+                         const ScenarioRun& p_run,
+                         uint32_t p_dateMs,
+                         ScenarioCheckResult* p_result) {
+    uint32_t firstCycle = cycleAt(p_run, p_dateMs) + p_check.cycles + 1u;
+    uint32_t limitMs = p_run.endMs;
+    for (uint32_t dateMs : p_run.actionDatesMs) {
+        if (dateMs > p_dateMs) {
+            limitMs = std::min(limitMs, dateMs);
+        }
+    }
+
+    uint32_t checked = 0u;
+    double worstError = 0.0;
+    uint32_t worstCycle = 0u;
+    for (const ScenarioCycle& cycle : p_run.cycles) {
+        if ((cycle.number < firstCycle) || (cycle.endMs > limitMs)) {
+            continue;
+        }
+        double error = 0.0;
+        if (p_check.kind == SCENARIO_EXPECT_PEEP) {
+            size_t count = std::min<size_t>(cycle.pressures.size(), SCENARIO_PEEP_SAMPLES);
+            double peep = 0.0;
+            for (size_t i = cycle.pressures.size() - count; i < cycle.pressures.size(); i++) {
+                peep += cycle.pressures[i] / static_cast<double>(count);
+            }
+            error = peep - cycle.peepCommand;
+        } else if (p_check.kind == SCENARIO_EXPECT_PLATEAU) {
+            if (!cycle.pressureControlled || (cycle.inhalationSamples == 0u)) {
+                continue;
+            }
+            error = cycle.pressures[cycle.inhalationSamples - 1u] - cycle.plateauPressureCommand;
+        } else {
+            error = (cycle.maxVolume - cycle.minVolume) - cycle.tidalVolumeCommand;
+        }
+        checked++;
+        if ((checked == 1u) || (std::abs(error) > std::abs(worstError))) {
+            worstError = error;
+            worstCycle = cycle.number;
+        }
+    }
+
+    char message[SCENARIO_MESSAGE_SIZE];
+    if (checked == 0u) {
+        (void)snprintf(message, sizeof(message), "no cycle to check from cycle %u to %u ms",
+                       firstCycle, limitMs);
+    } else {
+        (void)snprintf(message, sizeof(message), "%u cycles from cycle %u, worst error %.1f at "
+                       "cycle %u", checked, firstCycle, worstError, worstCycle);
+    }
+    p_result->message = message;
+    return (checked > 0u) && (std::abs(worstError) <= p_check.tolerance);
+}
+
+ScenarioResult runScenario(const Scenario& p_scenario) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ScenarioResult result;
+    result.name = p_scenario.name;
+
+    ScenarioRun run;
+    result.error = runScenarioSession(p_scenario, &run);
+    if (result.error.empty()) {
+        for (const ScenarioCheck& check : p_scenario.checks) {
+            ScenarioCheckResult outcome = {check.line, check.text, false, ""};
+            uint32_t dateMs = 0u;
+            bool dated = true;
+            if (check.date.kind == SCENARIO_AT_MS) {
+                dateMs = check.date.value;
+                dated = dateMs <= run.endMs;
+            } else if (check.date.kind == SCENARIO_AT_CYCLE) {
+                dated = check.date.value < run.cycleStartsMs.size();
+                dateMs = dated ? run.cycleStartsMs[check.date.value] : 0u;
+            }
+
+            if (!dated) {
+                outcome.message = "the date of the expectation was not reached";
+            } else if ((check.kind == SCENARIO_EXPECT_ALARM)
+                       || (check.kind == SCENARIO_EXPECT_NO_ALARM)) {
+                bool triggered = checkAlarm(check, run, dateMs, &outcome);
+                outcome.passed = triggered == (check.kind == SCENARIO_EXPECT_ALARM);
+            } else {
+                outcome.passed = checkMeasure(check, run, dateMs, &outcome);
+            }
+            result.checks.push_back(outcome);
+        }
+    }
+
+    result.durationS =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/**
+ * Copy a text into a buffer of a record, cut to its size
+ *
+ * @param p_text Text
+ * @param p_buffer Buffer
+ * @param p_size Size of the buffer
+ */
+static void copyText(const std::string& p_text, char* p_buffer, size_t p_size) {
+    (void)snprintf(p_buffer, p_size, "%s", p_text.c_str());
+}
+
+std::vector<ScenarioResult> runScenarioFiles(const std::vector<std::string>& p_paths,
+                                             uint32_t p_workers) {
+    std::vector<uint8_t> records;
+    bool complete = runWorkerJobs(
+        p_paths.size(), p_workers, sizeof(ScenarioRecord),
+        [&](size_t p_index, uint8_t* p_result) {
+            Scenario scenario;
+            ScenarioResult result;
+            std::string error;
+            if (readScenarioFile(p_paths[p_index], &scenario, &error)) {
+                result = runScenario(scenario);
+            } else {
+                result.name = scenario.name.empty() ? p_paths[p_index] : scenario.name;
+                result.error = error;
+                result.durationS = 0.0;
+            }
+
+            ScenarioRecord record = ScenarioRecord();
+            copyText(result.name, record.name, sizeof(record.name));
+            copyText(result.error, record.error, sizeof(record.error));
+            record.durationS = result.durationS;
+            record.checks = static_cast<uint32_t>(result.checks.size());
+            for (size_t i = 0; i < result.checks.size(); i++) {
+                ScenarioCheckRecord& check = record.records[i];
+                check.line = result.checks[i].line;
+                check.passed = result.checks[i].passed ? 1u : 0u;
+                copyText(result.checks[i].text, check.text, sizeof(check.text));
+                copyText(result.checks[i].message, check.message, sizeof(check.message));
+            }
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+            std::copy(bytes, bytes + sizeof(record), p_result);
+        },
+        &records);
+
+    std::vector<ScenarioResult> results;
+    for (size_t i = 0; i < p_paths.size(); i++) {
+        ScenarioRecord record;
+        const uint8_t* bytes = &records[i * sizeof(record)];
+        std::copy(bytes, bytes + sizeof(record), reinterpret_cast<uint8_t*>(&record));
+
+        ScenarioResult result;
+        result.name = record.name;
+        result.error = record.error;
+        result.durationS = record.durationS;
+        // A scenario of a failed worker was never sent
+        if (!complete && result.name.empty()) {
+            result.name = p_paths[i];
+            result.error = "the worker running the scenario failed";
+        }
+        for (uint32_t j = 0; j < std::min(record.checks, SCENARIO_MAX_CHECKS); j++) {
+            const ScenarioCheckRecord& check = record.records[j];
+            ScenarioCheckResult outcome = {check.line, check.text, check.passed != 0u,
+                                           check.message};
+            result.checks.push_back(outcome);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+bool scenarioPassed(const ScenarioResult& p_result) {
+    bool passed = p_result.error.empty();
+    for (const ScenarioCheckResult& check : p_result.checks) {
+        passed = passed && check.passed;
+    }
+    return passed;
+}
+
+/**
+ * Escape a text for an XML attribute
+ *
+ * @param p_text Text
+ * @return Escaped text
+ */
+static std::string escapeXml(const std::string& p_text) {
+    std::string escaped;
+    for (char character : p_text) {
+        switch (character) {
+        case '&':
+            escaped += "&amp;";
+            break;
+        case '<':
+            escaped += "&lt;";
+            break;
+        case '>':
+            escaped += "&gt;";
+            break;
+        case '"':
+            escaped += "&quot;";
+            break;
+        default:
+            escaped += character;
+            break;
+        }
+    }
+    return escaped;
+}
+
+void writeJUnitReport(const std::vector<ScenarioResult>& p_results, FILE* p_output) {
+    uint32_t tests = 0u;
+    uint32_t failures = 0u;
+    uint32_t errors = 0u;
+    double durationS = 0.0;
+    for (const ScenarioResult& result : p_results) {
+        errors += result.error.empty() ? 0u : 1u;
+        tests += result.error.empty() ? static_cast<uint32_t>(result.checks.size()) : 1u;
+        for (const ScenarioCheckResult& check : result.checks) {
+            failures += check.passed ? 0u : 1u;
+        }
+        durationS += result.durationS;
+    }
+
+    fprintf(p_output, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(p_output,
+            "<testsuites name=\"scenarios\" tests=\"%u\" failures=\"%u\" errors=\"%u\" "
+            "time=\"%.3f\">\n",
+            tests, failures, errors, durationS);
+    for (const ScenarioResult& result : p_results) {
+        std::string name = escapeXml(result.name);
+        uint32_t suiteFailures = 0u;
+        for (const ScenarioCheckResult& check : result.checks) {
+            suiteFailures += check.passed ? 0u : 1u;
+        }
+        fprintf(p_output,
+                "  <testsuite name=\"%s\" tests=\"%zu\" failures=\"%u\" errors=\"%u\" "
+                "time=\"%.3f\">\n",
+                name.c_str(), result.error.empty() ? result.checks.size() : 1u, suiteFailures,
+                result.error.empty() ? 0u : 1u, result.durationS);
+        if (!result.error.empty()) {
+            fprintf(p_output,
+                    "    <testcase classname=\"%s\" name=\"scenario\">\n"
+                    "      <error message=\"%s\"/>\n"
+                    "    </testcase>\n",
+                    name.c_str(), escapeXml(result.error).c_str());
+        }
+        for (const ScenarioCheckResult& check : result.checks) {
+            std::string testName =
+                escapeXml("line " + std::to_string(check.line) + ": " + check.text);
+            if (check.passed) {
+                fprintf(p_output, "    <testcase classname=\"%s\" name=\"%s\"/>\n", name.c_str(),
+                        testName.c_str());
+            } else {
+                fprintf(p_output,
+                        "    <testcase classname=\"%s\" name=\"%s\">\n"
+                        "      <failure message=\"%s\"/>\n"
+                        "    </testcase>\n",
+                        name.c_str(), testName.c_str(), escapeXml(check.message).c_str());
+            }
+        }
+        fprintf(p_output, "  </testsuite>\n");
+    }
+    fprintf(p_output, "</testsuites>\n");
+}
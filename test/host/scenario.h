@@ -0,0 +1,218 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file scenario.h
+ * @brief Scripted ventilation sessions, read from scenario files
+ *
+ * A scenario file scripts a session on the simulated lungs, one command per line, with an
+ * optional date. '#' starts a comment:
+ *
+ *     [at <n> ms | at <n> s | at cycle <n>] <command>
+ *
+ * A command without a date runs at the boot, before the breathing starts. A date in ms or s counts
+ * from the boot, a cycle date is the start of that respiratory cycle, the first one is 1. The
+ * commands of the same date run in the order of the file:
+ *
+ * - `set <setting> <value>`: apply a control setting as the UI does, the setting being named as in
+ *   ControlSetting (serial_control.h), for example `set PEEP 80` or `set CyclesPerMinute 25`
+ * - `mode <PC_CMV|PC_AC|VC_CMV|PC_VSAI|VC_AC>`: switch the ventilation mode
+ * - `patient <resistance> <compliance> [<resistance> <compliance>]`: lungs of the patient, in
+ *   cmH2O/(L/s) and mL/cmH2O. A single compartment keeps the volume of the lungs when it changes
+ *   during the session, two compartments can only be set at the boot
+ * - `effort <breaths per minute> <amplitude>`: spontaneous breathing, muscle pressure in mmH2O
+ * - `fault <kind> <duration> <ms|s> [inspiratory|expiratory|<battery ADC value>]`: inject an input
+ *   fault of fault_injection.h, kind flow_meter_nack, flow_meter_short_read, spurious_flow,
+ *   battery_spike or battery_droop
+ * - `start`, `stop`: press the start or the stop button
+ * - `end`: end of the session, required
+ * - `expect alarm <code> within <n> cycles`: the alarm is triggered at the date, or later before
+ *   the end of the n-th cycle after the one in progress
+ * - `expect no alarm <code> within <n> cycles`: the alarm is not triggered in that window
+ * - `expect <peep|plateau|tidal_volume> within <tolerance> after <n> cycles`: the n cycles after
+ *   the one in progress at the date are let settle, then every cycle ending before the next dated
+ *   command or the end has its PEEP (mean airway pressure over the last 100 ms), plateau pressure
+ *   (airway pressure at the end of the inspiration, pressure controlled modes only) or tidal
+ *   volume (lung volume swing) within the tolerance of its command, in mmH2O or mL
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "fault_injection.h"
+#include "pneumatic_plant.h"
+
+// INITIALISATION =============================================================
+
+/// Maximum number of expectations of a scenario
+#define SCENARIO_MAX_CHECKS 32u
+
+/// Kinds of scenario dates
+enum ScenarioDateKind {
+    /// At the boot, before the breathing starts
+    SCENARIO_AT_BOOT,
+    /// In ms after the boot
+    SCENARIO_AT_MS,
+    /// At the start of a respiratory cycle
+    SCENARIO_AT_CYCLE
+};
+
+/// Date of a command
+struct ScenarioDate {
+    ScenarioDateKind kind;
+    /// Date in ms, or cycle number
+    uint32_t value;
+};
+
+/// Commands of a scenario that act on the session
+enum ScenarioActionKind {
+    SCENARIO_SET,
+    SCENARIO_PATIENT,
+    SCENARIO_EFFORT,
+    SCENARIO_FAULT,
+    SCENARIO_START,
+    SCENARIO_STOP,
+    SCENARIO_END
+};
+
+/// Command acting on the session
+struct ScenarioAction {
+    /// Line in the file
+    uint32_t line;
+    ScenarioDate date;
+    ScenarioActionKind kind;
+    /// Control setting and its value, for SCENARIO_SET
+    uint8_t setting;
+    uint16_t value;
+    /// Number of compartments and lungs, for SCENARIO_PATIENT
+    uint8_t compartments;
+    LungCompartment lungs[PNEUMATIC_PLANT_MAX_COMPARTMENTS];
+    /// Breathing rate and muscle pressure amplitude, for SCENARIO_EFFORT
+    uint16_t effortRate;
+    double effortAmplitude;
+    /// Fault, started at the date of the command, for SCENARIO_FAULT
+    ScheduledFault fault;
+};
+
+/// Expectations of a scenario
+enum ScenarioCheckKind {
+    SCENARIO_EXPECT_ALARM,
+    SCENARIO_EXPECT_NO_ALARM,
+    SCENARIO_EXPECT_PEEP,
+    SCENARIO_EXPECT_PLATEAU,
+    SCENARIO_EXPECT_TIDAL_VOLUME
+};
+
+/// Expectation on the session
+struct ScenarioCheck {
+    /// Line in the file
+    uint32_t line;
+    /// Expectation as written, without its date
+    std::string text;
+    ScenarioDate date;
+    ScenarioCheckKind kind;
+    /// Alarm code, see alarm_controller.h
+    uint8_t alarm;
+    /// Cycles of the window of an alarm, or to let settle before a measure
+    uint32_t cycles;
+    /// Tolerance of a measure, in mmH2O or mL
+    double tolerance;
+};
+
+/// Script of a session
+struct Scenario {
+    /// Name, the name of the file without its directory and extension
+    std::string name;
+    std::vector<ScenarioAction> actions;
+    std::vector<ScenarioCheck> checks;
+};
+
+/// Outcome of an expectation
+struct ScenarioCheckResult {
+    /// Line in the file
+    uint32_t line;
+    /// Expectation as written
+    std::string text;
+    bool passed;
+    /// What was seen
+    std::string message;
+};
+
+/// Outcome of a scenario
+struct ScenarioResult {
+    /// Name of the scenario
+    std::string name;
+    /// Empty, or why the scenario could not be read or run
+    std::string error;
+    std::vector<ScenarioCheckResult> checks;
+    /// Wall clock duration of the run, in s
+    double durationS;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Parse a scenario
+ *
+ * @param p_name Name of the scenario
+ * @param p_text Content of the scenario file
+ * @param p_scenario Parsed scenario
+ * @param p_error Set to the line and the reason of the first error
+ * @return False on an error
+ */
+bool parseScenario(const std::string& p_name,
+                   const std::string& p_text,
+                   Scenario* p_scenario,
+                   std::string* p_error);
+
+/**
+ * Read and parse a scenario file
+ *
+ * @param p_path Path of the file
+ * @param p_scenario Parsed scenario, named after the file
+ * @param p_error Set to the reason of the first error
+ * @return False if the file cannot be read or parsed
+ */
+bool readScenarioFile(const std::string& p_path, Scenario* p_scenario, std::string* p_error);
+
+/**
+ * Run a scenario in this process
+ *
+ * @param p_scenario Script of the session
+ * @return Outcome of every expectation
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+ScenarioResult runScenario(const Scenario& p_scenario);
+
+/**
+ * Read and run scenario files in worker processes
+ *
+ * @param p_paths Paths of the files
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @return Outcome of every scenario, in the order of the files
+ */
+std::vector<ScenarioResult> runScenarioFiles(const std::vector<std::string>& p_paths,
+                                             uint32_t p_workers);
+
+/**
+ * Check if a scenario passed
+ *
+ * @param p_result Outcome of the scenario
+ * @return True if it ran and every expectation passed
+ */
+bool scenarioPassed(const ScenarioResult& p_result);
+
+/**
+ * Write the outcomes of scenarios as a JUnit XML report: a test suite per scenario, a test case
+ * per expectation, and an error test case for a scenario that could not be read or run
+ *
+ * @param p_results Outcomes of the scenarios
+ * @param p_output Output
+ */
+void writeJUnitReport(const std::vector<ScenarioResult>& p_results, FILE* p_output);
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_model.cpp
+ * @brief Noise, offset drift and quantisation of the simulated sensors
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "sensor_model.h"
+
+// Externals
+#include <math.h>
+
+// Internal
+#include "../../includes/mass_flow_meter_utl.h"
+#include "../../includes/pressure_utl.h"
+
+// INITIALISATION =============================================================
+
+/// Linear transfer function of a sensor, from its code to its measure
+struct SensorTransfer {
+    /// Measure of one code, in mmH2O or mL/min
+    double unitsPerCode;
+    /// Code of a null measure
+    double zeroCode;
+    /// Range of the code
+    int32_t minCode;
+    int32_t maxCode;
+    /// Bits of the output
+    uint8_t bits;
+};
+
+/// Transfer functions, in the order of SensorKind, as the conversions of the board
+static const SensorTransfer SENSOR_TRANSFERS[] = {
+    // P(mmH2O) = 0.2238 x raw - 45, see pressure_utl.cpp
+    {0.2238, 45.0 / 0.2238, 0, 4095, 12u},
+    // Flow(mL/min) = 1.526 x (10 x raw - 16384), the 2 status bits above the 14 bits at 0
+    {15.26, 1638.4, 0, 0x3FFF, 14u},
+    // Flow(mL/min) = (raw - 32768) x 1000 / 120
+    {1000.0 / 120.0, 32768.0, 0, 0xFFFF, 16u},
+    // Flow(mL/min) = (raw + 24576) x 1000 / 170, raw signed
+    {1000.0 / 170.0, -24576.0, -32768, 32767, 16u}};
+
+// FUNCTIONS ==================================================================
+
+SensorModelSettings idealSensor(SensorKind p_kind) {
+    SensorModelSettings settings = {p_kind, 0.0, 0.0, 0.0, sensorBits(p_kind)};
+    return settings;
+}
+
+uint8_t sensorBits(SensorKind p_kind) { return SENSOR_TRANSFERS[p_kind].bits; }
+
+const char* sensorKindName(SensorKind p_kind) {
+    const char* name = "pressure ADC";
+    if (p_kind == SENSOR_HONEYWELL_HAF) {
+        name = "Honeywell HAF";
+    } else if (p_kind == SENSOR_SFM3300) {
+        name = "SFM3300-D";
+    } else if (p_kind == SENSOR_SFM3019) {
+        name = "SFM3019";
+    }
+    return name;
+}
+
+SensorModel::SensorModel()
+    : m_settings(idealSensor(SENSOR_PRESSURE_ADC)), m_offset(0.0), m_generator(0u), m_noise() {}
+
+SensorModel::SensorModel(const SensorModelSettings& p_settings, uint32_t p_seed)
+    : m_settings(p_settings), m_offset(p_settings.offset), m_generator(p_seed), m_noise() {}
+
+uint16_t SensorModel::sample(double p_value, uint32_t p_dtUs) {
+    const SensorTransfer& transfer = SENSOR_TRANSFERS[m_settings.kind];
+    m_offset += (m_settings.offsetDrift * p_dtUs) / 1000000.0;
+    double value = p_value + m_offset;
+    if (m_settings.noise > 0.0) {
+        value += m_settings.noise * m_noise(m_generator);
+    }
+
+    // Round the code to the effective resolution: the low bits the sensor does not resolve are 0
+    uint8_t bits = (m_settings.bits < transfer.bits) ? m_settings.bits : transfer.bits;
+    double step = static_cast<double>(1u << (transfer.bits - bits));
+    double code = transfer.zeroCode + (value / transfer.unitsPerCode);
+    int32_t word = static_cast<int32_t>(lround(code / step) * static_cast<int32_t>(step));
+    if (word < transfer.minCode) {
+        word = transfer.minCode;
+    } else if (word > transfer.maxCode) {
+        word = transfer.maxCode;
+    }
+    return static_cast<uint16_t>(word);
+}
+
+int32_t SensorModel::measure(uint16_t p_word) const {
+    int32_t raw = p_word;
+    int32_t result = 0;
+    switch (m_settings.kind) {
+    case SENSOR_HONEYWELL_HAF:
+        result = (((10 * raw) - 16384) * 1526) / 1000;
+        break;
+    case SENSOR_SFM3300:
+        result = ((raw - 32768) * 8) + ((raw - 32768) / 3);
+        break;
+    case SENSOR_SFM3019:
+        result = (1000 * (static_cast<int16_t>(p_word) + 24576)) / 170;
+        break;
+    default:
+        result = ((raw * 2238) / 10000) - 45;
+        break;
+    }
+    return result;
+}
+
+uint16_t SensorModel::boardWord(double p_value, uint32_t p_dtUs, SensorKind p_boardSensor) {
+    uint16_t word = sample(p_value, p_dtUs);
+    if (m_settings.kind != p_boardSensor) {
+        if (p_boardSensor == SENSOR_PRESSURE_ADC) {
+            word = static_cast<uint16_t>(convertPressure2Sensor(measure(word)));
+        } else if (p_boardSensor == BOARD_EXPIRATORY_SENSOR) {
+            word = convertExpiratoryFlow2Sensor(measure(word));
+        } else {
+            word = convertInspiratoryFlow2Sensor(measure(word));
+        }
+    }
+    return word;
+}
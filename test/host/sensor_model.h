@@ -0,0 +1,143 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_model.h
+ * @brief Noise, offset drift and quantisation of the simulated sensors
+ *
+ * A sensor model turns the true pressure or flow of the pneumatic plant into the output word of
+ * the sensor: an offset drifting at a constant rate and a gaussian noise are added to the true
+ * value, the transfer function of the datasheet maps it to a code, and the code is rounded to the
+ * effective resolution of the sensor and clamped to its range. The pressure sensor is read on the
+ * 12 bits ADC of the board, the Honeywell HAF gives 14 bits, the SFM3300-D and SFM3019 16 bits.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include <random>
+
+#include "../../includes/config.h"
+
+// INITIALISATION =============================================================
+
+/// Sensors that can be modelled
+enum SensorKind {
+    /// Pressure sensor on the 12 bits ADC, in mmH2O
+    SENSOR_PRESSURE_ADC,
+    /// Honeywell HAF flow meter, 14 bits, in mL/min
+    SENSOR_HONEYWELL_HAF,
+    /// Sensirion SFM3300-D flow meter, 16 bits offset binary, in mL/min
+    SENSOR_SFM3300,
+    /// Sensirion SFM3019 flow meter, 16 bits signed, in mL/min
+    SENSOR_SFM3019
+};
+
+/// Inspiratory flow meter the firmware is built for
+#if MASS_FLOW_METER_SENSOR == MFM_SFM3019
+#define BOARD_INSPIRATORY_SENSOR SENSOR_SFM3019
+#else
+#define BOARD_INSPIRATORY_SENSOR SENSOR_HONEYWELL_HAF
+#endif
+
+/// Expiratory flow meter the firmware is built for
+#define BOARD_EXPIRATORY_SENSOR SENSOR_SFM3300
+
+/// Imperfections of a sensor, in the unit of its measure: mmH2O or mL/min
+struct SensorModelSettings {
+    /// Modelled sensor
+    SensorKind kind;
+    /// Standard deviation of the gaussian noise added to every sample
+    double noise;
+    /// Offset at the start
+    double offset;
+    /// Change of the offset, per second
+    double offsetDrift;
+    /// Effective resolution in bits, at most the bits of the output of the sensor
+    uint8_t bits;
+};
+
+// CLASS ======================================================================
+
+/// Output word of a sensor measuring a true value
+class SensorModel {
+ public:
+    /// Default constructor: an ideal pressure sensor
+    SensorModel();
+
+    /**
+     * Parameterized constructor
+     *
+     * @param p_settings Imperfections of the sensor
+     * @param p_seed Seed of the noise
+     */
+    SensorModel(const SensorModelSettings& p_settings, uint32_t p_seed);
+
+    /**
+     * Sample the sensor
+     *
+     * @param p_value True value, in mmH2O or mL/min
+     * @param p_dtUs Time since the previous sample, in µs, by which the offset drifts
+     * @return Output word of the sensor, the bits of a signed code as is
+     */
+    uint16_t sample(double p_value, uint32_t p_dtUs);
+
+    /**
+     * Convert an output word as the board does, without its filters
+     *
+     * @param p_word Output word of the sensor
+     * @return Measure, in mmH2O or mL/min
+     */
+    int32_t measure(uint16_t p_word) const;
+
+    /**
+     * Sample the sensor and give the word a board reads, built for a sensor of a kind
+     *
+     * @param p_value True value, in mmH2O or mL/min
+     * @param p_dtUs Time since the previous sample, in µs
+     * @param p_boardSensor Sensor the firmware converts the words of
+     * @return Output word of the sensor, or the word of the board sensor closest to its measure
+     *         when the kinds differ: the resolution of both then applies
+     */
+    uint16_t boardWord(double p_value, uint32_t p_dtUs, SensorKind p_boardSensor);
+
+    /// Modelled sensor
+    SensorKind kind() const { return m_settings.kind; }
+
+    /// Current offset, in mmH2O or mL/min
+    double offset() const { return m_offset; }
+
+ private:
+    SensorModelSettings m_settings;
+    double m_offset;
+    std::mt19937 m_generator;
+    std::normal_distribution<double> m_noise;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Settings of a sensor without noise nor offset, at the resolution of its output
+ *
+ * @param p_kind Sensor
+ * @return Settings
+ */
+SensorModelSettings idealSensor(SensorKind p_kind);
+
+/**
+ * Number of bits of the output of a sensor
+ *
+ * @param p_kind Sensor
+ * @return Bits, 12 for the ADC of the pressure sensor
+ */
+uint8_t sensorBits(SensorKind p_kind);
+
+/**
+ * Name of a sensor
+ *
+ * @param p_kind Sensor
+ * @return Name, as written in the reports
+ */
+const char* sensorKindName(SensorKind p_kind);
@@ -0,0 +1,247 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_replay.cpp
+ * @brief Replay of a raw sensor capture through the ventilation core
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "sensor_replay.h"
+
+// Externals
+#include "CRC32.h"
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/alarm_controller.h"
+#include "../../includes/deferred_work.h"
+#include "../../includes/hal.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/main_state_machine.h"
+#include "../../includes/mass_flow_meter.h"
+#include "../../includes/pressure.h"
+#include "../../includes/pressure_utl.h"
+#include "../../includes/sensor_capture.h"
+#include "../../includes/serial_control.h"
+#include "../../includes/timebase.h"
+#include "../../includes/ventilator_context.h"
+#include "host_board.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Size of the fields of a sensor capture message around its records, header and footer excluded
+#define MESSAGE_TYPE_SIZE 2u
+#define MESSAGE_DEVICE_ID_SIZE 12u
+#define MESSAGE_SYSTICK_SIZE 8u
+#define MESSAGE_CRC_SIZE 4u
+
+static const uint8_t MESSAGE_HEADER[2] = {0x03, 0x0C};
+static const uint8_t MESSAGE_FOOTER[2] = {0x30, 0xC0};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Read a big endian number
+ *
+ * @param p_bytes Bytes of the number
+ * @param p_size Number of bytes
+ * @return The number
+ */
+static uint64_t readBigEndian(const uint8_t* p_bytes, size_t p_size) {
+    uint64_t value = 0u;
+    for (size_t i = 0u; i < p_size; i++) {
+        value = (value << 8u) | p_bytes[i];
+    }
+    return value;
+}
+
+/**
+ * Parse a sensor capture message
+ *
+ * @param p_message Bytes from the header of the message to the end of the stream
+ * @param p_size Number of bytes
+ * @param p_records Records of the message are appended to it when it is valid
+ * @return Size of the message, or 0 if it is not a valid sensor capture message
+ */
+static size_t parseSensorCaptureMessage(const uint8_t* p_message,
+                                        size_t p_size,
+                                        std::vector<uint8_t>* p_records) {
+    // Header, type, protocol version and size of the firmware version
+    size_t index = sizeof(MESSAGE_HEADER) + MESSAGE_TYPE_SIZE + 2u;
+    if ((p_size < index) || (p_message[0] != MESSAGE_HEADER[0])
+        || (p_message[1] != MESSAGE_HEADER[1]) || (p_message[2] != 'R') || (p_message[3] != ':')) {
+        return 0u;
+    }
+
+    // Firmware version, device ID, systick and size of the records
+    index += p_message[index - 1u] + MESSAGE_DEVICE_ID_SIZE + 1u + MESSAGE_SYSTICK_SIZE + 1u;
+    if (p_size < (index + 2u)) {
+        return 0u;
+    }
+    size_t recordsSize = readBigEndian(&p_message[index], 2u);
+    size_t recordsIndex = index + 2u;
+    size_t crcIndex = recordsIndex + recordsSize + 1u;
+    size_t messageSize = crcIndex + MESSAGE_CRC_SIZE + sizeof(MESSAGE_FOOTER);
+    if ((p_size < messageSize) || (p_message[crcIndex - 1u] != '\n')
+        || (p_message[messageSize - 2u] != MESSAGE_FOOTER[0])
+        || (p_message[messageSize - 1u] != MESSAGE_FOOTER[1])) {
+        return 0u;
+    }
+
+    // The checksum covers everything between the header and itself
+    CRC32 crc32;
+    crc32.update(&p_message[sizeof(MESSAGE_HEADER)], crcIndex - sizeof(MESSAGE_HEADER));
+    if (crc32.finalize() != readBigEndian(&p_message[crcIndex], MESSAGE_CRC_SIZE)) {
+        return 0u;
+    }
+
+    p_records->insert(p_records->end(), &p_message[recordsIndex],
+                      &p_message[recordsIndex + recordsSize]);
+    return messageSize;
+}
+
+size_t extractSensorCapture(const uint8_t* p_telemetry,
+                            size_t p_size,
+                            std::vector<uint8_t>* p_records) {
+    size_t messages = 0u;
+    size_t index = 0u;
+    while (index < p_size) {
+        size_t messageSize =
+            parseSensorCaptureMessage(&p_telemetry[index], p_size - index, p_records);
+        if (messageSize > 0u) {
+            messages++;
+            index += messageSize;
+        } else {
+            index++;
+        }
+    }
+    return messages;
+}
+
+/**
+ * Boot the host board like respirator.cpp does, and start the main state machine
+ *
+ * @param p_startMicros Date of the boot in µs, the first period of the main state machine ends
+ *                      1 ms later
+ */
+static void bootReplayBoard(uint64_t p_startMicros) {
+    resetSimulation(p_startMicros);
+
+    bootHostBoard();
+
+    mainStateMachine.setupAndStart();
+}
+
+bool replaySensorCapture(const std::vector<uint8_t>& p_records,
+                         std::vector<ReplayedTick>* p_ticks) {
+    if ((p_records.size() < SENSOR_CAPTURE_START_SIZE) || (p_records[0] != SENSOR_CAPTURE_START)
+        || (p_records[1] != SENSOR_CAPTURE_VERSION)) {
+        return false;
+    }
+    uint64_t lastTimerMicros = readBigEndian(&p_records[2], 8u);
+    uint64_t date = readBigEndian(&p_records[10], 8u);
+
+    // The first period runs the setup of the main state machine, and ends on the date the
+    // capture started from, in the stopped state
+    bootReplayBoard(lastTimerMicros - 1000u);
+    runMainStateMachine();
+    runDeferredWork();
+
+    inspiratoryPressureSensor.setPressureSensorOffset(
+        static_cast<int32_t>(readBigEndian(&p_records[18], 4u)));
+    restoreFilteredRawPressure(static_cast<int32_t>(readBigEndian(&p_records[22], 4u)));
+    setHostFlowMeterOffset(static_cast<int32_t>(readBigEndian(&p_records[26], 4u)));
+
+    size_t index = SENSOR_CAPTURE_START_SIZE;
+    bool complete = true;
+    bool ended = false;
+    while (complete && !ended && (index < p_records.size())) {
+        const uint8_t* record = &p_records[index];
+        size_t remaining = p_records.size() - index;
+        size_t recordSize = 0u;
+        uint16_t rawPressure = 0u;
+        bool isTick = false;
+
+        switch (record[0]) {
+        case SENSOR_CAPTURE_TICK:
+            recordSize = 4u;
+            if (remaining >= recordSize) {
+                uint32_t field = static_cast<uint32_t>(readBigEndian(&record[1], 3u));
+                date += field >> 12u;
+                rawPressure = field & 0xFFFu;
+                isTick = true;
+            }
+            break;
+
+        case SENSOR_CAPTURE_LONG_TICK:
+            recordSize = 7u;
+            if (remaining >= recordSize) {
+                date += readBigEndian(&record[1], 4u);
+                rawPressure = static_cast<uint16_t>(readBigEndian(&record[5], 2u));
+                isTick = true;
+            }
+            break;
+
+        case SENSOR_CAPTURE_FLOW:
+            recordSize = 6u;
+            if (remaining >= recordSize) {
+                setHostFlowSensorWords(static_cast<uint16_t>(readBigEndian(&record[1], 2u)),
+                                       static_cast<uint16_t>(readBigEndian(&record[3], 2u)));
+                setHostFlowMeterFault(record[5] != 0u);
+                MFM_acquire();
+            }
+            break;
+
+        case SENSOR_CAPTURE_SETTING:
+            recordSize = 4u;
+            if (remaining >= recordSize) {
+                applyControlSetting(record[1],
+                                    static_cast<uint16_t>(readBigEndian(&record[2], 2u)));
+            }
+            break;
+
+        case SENSOR_CAPTURE_ACTIVATION:
+            recordSize = 2u;
+            if (remaining >= recordSize) {
+                activationController.changeState(record[1]);
+            }
+            break;
+
+        case SENSOR_CAPTURE_END:
+            recordSize = 2u;
+            ended = true;
+            break;
+
+        default:
+            // Unknown record, its size is unknown too
+            recordSize = remaining + 1u;
+            break;
+        }
+
+        if (remaining < recordSize) {
+            complete = false;
+        } else if (isTick) {
+            // Like the control interrupt, then the background loop
+            setMonotonicMicros(date);
+            setHostPressureAdc(rawPressure);
+            runMainStateMachine();
+            runDeferredWork();
+
+            ReplayedTick replayed = {date,
+                                     rawPressure,
+                                     ventilator.mainController.pressure(),
+                                     ventilator.mainController.pressureCommand(),
+                                     ventilator.mainController.cycleNumber(),
+                                     ventilator.mainController.tick(),
+                                     hostPwmOutputPulse(HAL_PWM_BLOWER),
+                                     hostPwmOutputPulse(HAL_PWM_INSPIRATORY_VALVE),
+                                     hostPwmOutputPulse(HAL_PWM_EXPIRATORY_VALVE)};
+            p_ticks->push_back(replayed);
+        }
+        index += recordSize;
+    }
+    return complete;
+}
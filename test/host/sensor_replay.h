@@ -0,0 +1,71 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file sensor_replay.h
+ * @brief Replay of a raw sensor capture through the ventilation core
+ *
+ * The "sensor capture" telemetry messages of a board carry the records of sensor_capture.h. The
+ * replay boots the host board at the date the capture started, restores the calibrations, the
+ * pressure filter and the settings, then runs every control tick at its date with its raw pressure,
+ * with the flow meter words, control settings and activation changes received in between. The
+ * conversions, the main state machine and the controllers compute the same commands as on the
+ * board, so a problem breath can be replayed, instrumented and bisected on the host.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// INITIALISATION =============================================================
+
+/// State of the controller after a replayed control tick
+struct ReplayedTick {
+    /// Date of the control tick on the board clock, in µs
+    uint64_t dateUs;
+    /// Value of the pressure sensor ADC
+    uint16_t rawPressure;
+    /// Pressure the controller measured, in mmH2O
+    int16_t pressure;
+    /// Pressure command, in mmH2O
+    int32_t pressureCommand;
+    /// Respiratory cycle number
+    uint32_t cycle;
+    /// Tick of the main controller in the cycle
+    uint32_t tick;
+    /// Pulse of the blower PWM output, in µs
+    uint16_t blowerPulse;
+    /// Pulse of the inspiratory valve PWM output, in µs
+    uint16_t inspiratoryValvePulse;
+    /// Pulse of the expiratory valve PWM output, in µs
+    uint16_t expiratoryValvePulse;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Gather the records of the sensor capture messages found in a telemetry stream
+ *
+ * @param p_telemetry Bytes received on the telemetry link
+ * @param p_size Number of bytes
+ * @param p_records Records of the messages with a valid checksum are appended to it, in order
+ * @return Number of sensor capture messages found
+ */
+size_t extractSensorCapture(const uint8_t* p_telemetry,
+                            size_t p_size,
+                            std::vector<uint8_t>* p_records);
+
+/**
+ * Replay a capture on the host board
+ *
+ * @param p_records Records of a capture, starting with its start record
+ * @param p_ticks State of the controller after every control tick is appended to it
+ * @return False if the records do not start a capture of this version or are truncated, the ticks
+ *         before the problem are still replayed
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+bool replaySensorCapture(const std::vector<uint8_t>& p_records, std::vector<ReplayedTick>* p_ticks);
@@ -0,0 +1,475 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file session_sweep.cpp
+ * @brief Parameter sweep of simulated ventilation sessions over all CPU cores
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "session_sweep.h"
+
+// Externals
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/alarm_controller.h"
+#include "../../includes/board_state.h"
+#include "../../includes/cycle.h"
+#include "../../includes/hal.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/main_state_machine.h"
+#include "../../includes/parameters.h"
+#include "../../includes/ventilator_context.h"
+#include "host_board.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the plant and of the pressure samples
+#define SWEEP_SAMPLE_PERIOD_US 1000u
+
+/// Duration of the PEEP measure at the end of a cycle, in samples
+#define SWEEP_PEEP_SAMPLES 100u
+
+/// Plateau error, in mmH2O, within which the blower regulation has converged
+#define SWEEP_CONVERGED_PLATEAU_ERROR 20.0
+
+/// Lungs of the session running in this process, they must outlive the simulation
+static BOARD_STATE PneumaticPlant sweepPlant;
+
+/// Coefficients of the pressure controlled modes of the next sessions
+static PcCmvTuning sweepTuning = PC_CMV_DEFAULT_TUNING;
+
+/// Airway pressure, phase and lung volume during one respiratory cycle
+struct SweepCycle {
+    std::vector<double> pressures;
+    uint32_t inhalationSamples;
+    double minVolume;
+    double maxVolume;
+};
+
+// FUNCTIONS ==================================================================
+
+bool isPressureControlled(uint16_t p_mode) {
+    return (p_mode == PC_CMV) || (p_mode == PC_AC) || (p_mode == PC_VSAI);
+}
+
+/**
+ * Evenly spaced values between two bounds
+ *
+ * @param p_min Lowest value
+ * @param p_max Highest value
+ * @param p_steps Number of values, the bounds are included from 2 values
+ * @return Values
+ */
+static std::vector<int32_t> sweepAxis(int32_t p_min, int32_t p_max, uint16_t p_steps) {
+    std::vector<int32_t> values;
+    if (p_steps <= 1u) {
+        values.push_back(p_min);
+    } else {
+        for (uint16_t i = 0; i < p_steps; i++) {
+            values.push_back(p_min + (((p_max - p_min) * i) / (p_steps - 1u)));
+        }
+    }
+    return values;
+}
+
+SweepSession defaultSweepSession(void) {
+    SweepSession session = {PC_CMV,
+                            DEFAULT_PEEP_COMMAND,
+                            DEFAULT_PLATEAU_COMMAND,
+                            DEFAULT_CYCLE_PER_MINUTE_COMMAND,
+                            DEFAULT_TIDAL_VOLUME_COMMAND,
+                            {10.0, 50.0}};
+    return session;
+}
+
+SweepRanges defaultSweepRanges(uint16_t p_steps) {
+    SweepRanges ranges;
+    ranges.steps = p_steps;
+    // Healthy, stiff (ARDS), obstructive (COPD) and small lungs, in cmH2O/(L/s) and mL/cmH2O
+    ranges.lungs.push_back({10.0, 50.0});
+    ranges.lungs.push_back({10.0, 20.0});
+    ranges.lungs.push_back({25.0, 60.0});
+    ranges.lungs.push_back({20.0, 10.0});
+    // The blower speed of the pressure controlled modes converges over several cycles
+    ranges.settlingCycles = 8u;
+    ranges.measuredCycles = 3u;
+    return ranges;
+}
+
+std::vector<SweepSession> sweepSessions(const SweepRanges& p_ranges) {
+    const uint16_t modes[] = {PC_CMV, PC_AC, PC_VSAI, VC_CMV, VC_AC};
+    std::vector<int32_t> peeps =
+        sweepAxis(CONST_MIN_PEEP_PRESSURE, CONST_MAX_PEEP_PRESSURE, p_ranges.steps);
+    std::vector<int32_t> plateauPressures =
+        sweepAxis(CONST_MIN_PLATEAU_PRESSURE, CONST_MAX_PLATEAU_PRESSURE, p_ranges.steps);
+    std::vector<int32_t> rates = sweepAxis(CONST_MIN_CYCLE, CONST_MAX_CYCLE, p_ranges.steps);
+    std::vector<int32_t> tidalVolumes =
+        sweepAxis(CONST_MIN_TIDAL_VOLUME, CONST_MAX_TIDAL_VOLUME, p_ranges.steps);
+
+    std::vector<SweepSession> sessions;
+    for (uint16_t mode : modes) {
+        bool pressureControlled = isPressureControlled(mode);
+        // Only one of the plateau pressure and the tidal volume is a target of the mode
+        std::vector<int32_t> plateaus =
+            pressureControlled ? plateauPressures
+                               : std::vector<int32_t>(1u, DEFAULT_PLATEAU_COMMAND);
+        std::vector<int32_t> volumes = pressureControlled
+                                           ? std::vector<int32_t>(1u, DEFAULT_TIDAL_VOLUME_COMMAND)
+                                           : tidalVolumes;
+        for (int32_t peep : peeps) {
+            for (int32_t plateau : plateaus) {
+                if (pressureControlled && (peep >= plateau)) {
+                    continue;
+                }
+                for (int32_t rate : rates) {
+                    for (int32_t volume : volumes) {
+                        for (const LungCompartment& lung : p_ranges.lungs) {
+                            SweepSession session = {mode,
+                                                    static_cast<int16_t>(peep),
+                                                    static_cast<int16_t>(plateau),
+                                                    static_cast<uint16_t>(rate),
+                                                    static_cast<uint16_t>(volume),
+                                                    lung};
+                            sessions.push_back(session);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return sessions;
+}
+
+PneumaticPlant& bootSweepBoard(const SweepSession& p_session) {
+    resetSimulation(0u);
+
+    bootHostBoard();
+    ventilator.pcCmvController.setTuning(sweepTuning);
+    ventilator.pcAcController.setTuning(sweepTuning);
+
+    sweepPlant = PneumaticPlant();
+    sweepPlant.setLung(p_session.lung);
+    setSimulatedPlant(&sweepPlant, SWEEP_SAMPLE_PERIOD_US);
+
+    // The settings apply from the first respiratory cycle. The patient height is set first: on
+    // the first start without it, the preset of the default height would replace them
+    ventilator.mainController.onPatientHeight(DEFAULT_PATIENT_HEIGHT);
+    ventilator.mainController.onVentilationModeSet(p_session.mode);
+    ventilator.mainController.onPeepSet(p_session.peep);
+    ventilator.mainController.onPlateauPressureSet(p_session.plateauPressure);
+    ventilator.mainController.onCycleSet(p_session.cyclesPerMinute);
+    ventilator.mainController.onTargetTidalVolumeSet(p_session.tidalVolume);
+
+    mainStateMachine.setupAndStart();
+    halReloadWatchdog();
+    return sweepPlant;
+}
+
+/**
+ * Count the alarms triggered since the previous call
+ *
+ * @param p_triggered Alarms triggered at the previous call, updated
+ * @return Number of alarms triggered now and not at the previous call
+ */
+static uint32_t countNewAlarms(std::vector<uint8_t>* p_triggered) {
+    const uint8_t* alarms = ventilator.alarmController.triggeredAlarms();
+    std::vector<uint8_t> triggered;
+    uint32_t count = 0u;
+    for (uint8_t i = 0; i < ALARMS_SIZE; i++) {
+        if (alarms[i] != 0u) {
+            triggered.push_back(alarms[i]);
+            if (std::find(p_triggered->begin(), p_triggered->end(), alarms[i])
+                == p_triggered->end()) {
+                count++;
+            }
+        }
+    }
+    *p_triggered = triggered;
+    return count;
+}
+
+/**
+ * Add the measures of a cycle to the metrics of a session
+ *
+ * @param p_session Settings of the session
+ * @param p_cycle Samples of the cycle
+ * @param p_metrics Sums of the measures of the cycles
+ */
+static void measureSweepCycle(const SweepSession& p_session,
+                              const SweepCycle& p_cycle,
+                              SessionMetrics* p_metrics) {
+    const std::vector<double>& pressures = p_cycle.pressures;
+    p_metrics->cycles++;
+
+    double peep = 0.0;
+    size_t peepStart = pressures.size() - std::min<size_t>(pressures.size(), SWEEP_PEEP_SAMPLES);
+    for (size_t i = peepStart; i < pressures.size(); i++) {
+        peep += pressures[i] / static_cast<double>(pressures.size() - peepStart);
+    }
+    p_metrics->peepError += peep - p_session.peep;
+    p_metrics->tidalVolume += p_cycle.maxVolume - p_cycle.minVolume;
+
+    if (isPressureControlled(p_session.mode)) {
+        double command = p_session.plateauPressure;
+        double start = pressures[0];
+        double peak = start;
+        uint32_t low = 0u;
+        uint32_t high = 0u;
+        for (uint32_t i = 0; i < p_cycle.inhalationSamples; i++) {
+            peak = std::max(peak, pressures[i]);
+            if ((low == 0u) && (pressures[i] >= (start + (0.1 * (command - start))))) {
+                low = i + 1u;
+            }
+            if ((high == 0u) && (pressures[i] >= (start + (0.9 * (command - start))))) {
+                high = i + 1u;
+            }
+        }
+        p_metrics->riseTimeMs += ((high > 0u) ? high : p_cycle.inhalationSamples) - low;
+        p_metrics->overshoot += std::max(0.0, peak - command);
+        if (p_cycle.inhalationSamples > 0u) {
+            p_metrics->plateauError += pressures[p_cycle.inhalationSamples - 1u] - command;
+        }
+    } else {
+        p_metrics->tidalVolumeError +=
+            (p_cycle.maxVolume - p_cycle.minVolume) - p_session.tidalVolume;
+    }
+}
+
+void setSweepTuning(const PcCmvTuning& p_tuning) { sweepTuning = p_tuning; }
+
+/**
+ * Check if the airway pressure at the end of the inspiration of a cycle is close to its command
+ *
+ * @param p_session Settings of the session
+ * @param p_cycle Samples of the cycle
+ * @return True if the plateau pressure has converged, always for the volume controlled modes
+ */
+static bool isPlateauConverged(const SweepSession& p_session, const SweepCycle& p_cycle) {
+    if (!isPressureControlled(p_session.mode) || (p_cycle.inhalationSamples == 0u)) {
+        return true;
+    }
+    double error = p_cycle.pressures[p_cycle.inhalationSamples - 1u] - p_session.plateauPressure;
+    return std::abs(error) <= SWEEP_CONVERGED_PLATEAU_ERROR;
+}
+
+SessionMetrics runSweepSession(const SweepSession& p_session,
+                               uint32_t p_settlingCycles,
+                               uint32_t p_measuredCycles) {
+    SessionMetrics metrics = {0u, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0u, 0u};
+    bootSweepBoard(p_session);
+    runSimulation(1000000u);
+    activationController.onStartButton();
+
+    std::vector<uint8_t> triggered;
+    SweepCycle cycle = {std::vector<double>(), 0u, 0.0, 0.0};
+    uint32_t cycleNumber = 0u;
+    uint32_t lastCycle = p_settlingCycles + p_measuredCycles;
+    while (ventilator.mainController.cycleNumber() <= lastCycle) {
+        runSimulation(SWEEP_SAMPLE_PERIOD_US);
+        metrics.alarms += countNewAlarms(&triggered);
+
+        if (ventilator.mainController.cycleNumber() != cycleNumber) {
+            // The first respiratory cycle is the number 1
+            if ((cycleNumber > 0u) && !cycle.pressures.empty()) {
+                if (cycleNumber > p_settlingCycles) {
+                    measureSweepCycle(p_session, cycle, &metrics);
+                }
+                if (!isPlateauConverged(p_session, cycle)) {
+                    metrics.convergenceCycles = cycleNumber;
+                }
+            }
+            cycleNumber = ventilator.mainController.cycleNumber();
+            cycle.pressures.clear();
+            cycle.inhalationSamples = 0u;
+            cycle.minVolume = sweepPlant.lungVolume();
+            cycle.maxVolume = cycle.minVolume;
+        }
+
+        cycle.pressures.push_back(sweepPlant.airwayPressure());
+        if (ventilator.mainController.phase() == INHALATION) {
+            cycle.inhalationSamples = cycle.pressures.size();
+        }
+        cycle.minVolume = std::min(cycle.minVolume, sweepPlant.lungVolume());
+        cycle.maxVolume = std::max(cycle.maxVolume, sweepPlant.lungVolume());
+    }
+
+    if (metrics.cycles > 0u) {
+        double cycles = metrics.cycles;
+        metrics.riseTimeMs /= cycles;
+        metrics.overshoot /= cycles;
+        metrics.plateauError /= cycles;
+        metrics.peepError /= cycles;
+        metrics.tidalVolume /= cycles;
+        metrics.tidalVolumeError /= cycles;
+    }
+    return metrics;
+}
+
+/**
+ * Run the share of the jobs of a worker, and send their results
+ *
+ * @param p_jobs Number of jobs
+ * @param p_resultSize Size of the result of a job, in bytes
+ * @param p_job Job, writing its result
+ * @param p_worker Index of the worker, it runs every p_workers job from this one
+ * @param p_workers Number of workers
+ * @param p_output Pipe to the parent process
+ * @return True if every result was sent
+ */
+static bool runWorker(size_t p_jobs,
+                      size_t p_resultSize,
+                      const std::function<void(size_t, uint8_t*)>& p_job,
+                      uint32_t p_worker,
+                      uint32_t p_workers,
+                      int p_output) {
+    // Every result is sent after the index of its job
+    std::vector<uint8_t> message(sizeof(uint32_t) + p_resultSize);
+    for (size_t i = p_worker; i < p_jobs; i += p_workers) {
+        uint32_t index = static_cast<uint32_t>(i);
+        std::copy(reinterpret_cast<const uint8_t*>(&index),
+                  reinterpret_cast<const uint8_t*>(&index) + sizeof(index), message.begin());
+        p_job(i, &message[sizeof(index)]);
+        size_t written = 0u;
+        while (written < message.size()) {
+            ssize_t count = write(p_output, &message[written], message.size() - written);
+            if ((count < 0) && (errno != EINTR)) {
+                return false;
+            }
+            written += (count > 0) ? static_cast<size_t>(count) : 0u;
+        }
+    }
+    return true;
+}
+
+bool runWorkerJobs(size_t p_jobs,
+                   uint32_t p_workers,
+                   size_t p_resultSize,
+                   const std::function<void(size_t, uint8_t*)>& p_job,
+                   std::vector<uint8_t>* p_results) {
+    p_results->assign(p_jobs * p_resultSize, 0u);
+    std::vector<bool> received(p_jobs, false);
+    size_t messageSize = sizeof(uint32_t) + p_resultSize;
+
+    uint32_t workers = p_workers;
+    if (workers == 0u) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cores > 0) ? static_cast<uint32_t>(cores) : 1u;
+    }
+    workers = std::max(1u, std::min(workers, static_cast<uint32_t>(p_jobs)));
+
+    // Output buffered before the fork would be written by every worker
+    (void)fflush(stdout);
+    (void)fflush(stderr);
+
+    bool success = true;
+    std::vector<pid_t> pids;
+    std::vector<struct pollfd> pipes;
+    std::vector<std::vector<uint8_t>> pending;
+    for (uint32_t worker = 0; worker < workers; worker++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            success = false;
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            (void)close(fds[0]);
+            bool sent = runWorker(p_jobs, p_resultSize, p_job, worker, workers, fds[1]);
+            // Leave without running the exit handlers of the parent
+            _exit(sent ? 0 : 1);
+        }
+        (void)close(fds[1]);
+        if (pid < 0) {
+            (void)close(fds[0]);
+            success = false;
+            break;
+        }
+        pids.push_back(pid);
+        struct pollfd output = {fds[0], POLLIN, 0};
+        pipes.push_back(output);
+        pending.push_back(std::vector<uint8_t>());
+    }
+
+    // Gather the results as the workers send them, so that no pipe fills up
+    size_t open = pipes.size();
+    while (open > 0u) {
+        if ((poll(pipes.data(), pipes.size(), -1) < 0) && (errno != EINTR)) {
+            success = false;
+            break;
+        }
+        for (size_t i = 0; i < pipes.size(); i++) {
+            if ((pipes[i].fd < 0) || (pipes[i].revents == 0)) {
+                continue;
+            }
+            uint8_t buffer[4096];
+            ssize_t count = read(pipes[i].fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                pending[i].insert(pending[i].end(), buffer, &buffer[count]);
+                while (pending[i].size() >= messageSize) {
+                    uint32_t index = 0u;
+                    std::copy(pending[i].begin(), pending[i].begin() + sizeof(index),
+                              reinterpret_cast<uint8_t*>(&index));
+                    if (index < p_jobs) {
+                        std::copy(pending[i].begin() + sizeof(index),
+                                  pending[i].begin() + messageSize,
+                                  p_results->begin() + (index * p_resultSize));
+                        received[index] = true;
+                    }
+                    pending[i].erase(pending[i].begin(), pending[i].begin() + messageSize);
+                }
+            } else if ((count == 0) || (errno != EINTR)) {
+                (void)close(pipes[i].fd);
+                pipes[i].fd = -1;
+                open--;
+            }
+        }
+    }
+
+    for (pid_t pid : pids) {
+        int status = 0;
+        if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status)
+            || (WEXITSTATUS(status) != 0)) {
+            success = false;
+        }
+    }
+    return success && (std::find(received.begin(), received.end(), false) == received.end());
+}
+
+bool runSessionSweep(const std::vector<SweepSession>& p_sessions,
+                     uint32_t p_settlingCycles,
+                     uint32_t p_measuredCycles,
+                     uint32_t p_workers,
+                     std::vector<SessionMetrics>* p_metrics) {
+    std::vector<uint8_t> results;
+    bool success = runWorkerJobs(
+        p_sessions.size(), p_workers, sizeof(SessionMetrics),
+        [&](size_t p_index, uint8_t* p_result) {
+            SessionMetrics metrics =
+                runSweepSession(p_sessions[p_index], p_settlingCycles, p_measuredCycles);
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&metrics);
+            std::copy(bytes, bytes + sizeof(metrics), p_result);
+        },
+        &results);
+
+    // The results of the sessions of a failed worker stay at 0: metrics of 0 cycles
+    p_metrics->resize(p_sessions.size());
+    for (size_t i = 0; i < p_sessions.size(); i++) {
+        const uint8_t* result = &results[i * sizeof(SessionMetrics)];
+        std::copy(result, result + sizeof(SessionMetrics),
+                  reinterpret_cast<uint8_t*>(&(*p_metrics)[i]));
+    }
+    return success;
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file session_sweep.h
+ * @brief Parameter sweep of simulated ventilation sessions over all CPU cores
+ *
+ * A session boots the board on the simulated lungs of one patient, ventilates with one mode and
+ * its settings, lets it settle and measures the airway pressure and the lung volume over the
+ * following cycles. The state of the board is per thread (see board_state.h), but the jobs of a
+ * sweep may also change objects of the caller: the sweep forks worker processes, each running a
+ * share of the sessions on a copy of them and sending the metrics back through a pipe.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "../../includes/pc_cmv_controller.h"
+#include "pneumatic_plant.h"
+
+// INITIALISATION =============================================================
+
+/// Patient, ventilation mode and settings of a session
+struct SweepSession {
+    /// Ventilation mode, see VentilationModes
+    uint16_t mode;
+    /// PEEP command, in mmH2O
+    int16_t peep;
+    /// Plateau pressure command, in mmH2O
+    int16_t plateauPressure;
+    /// Respiratory rate command, in cycles per minute
+    uint16_t cyclesPerMinute;
+    /// Tidal volume command of the volume controlled modes, in mL
+    uint16_t tidalVolume;
+    /// Lungs of the patient
+    LungCompartment lung;
+};
+
+/// Measures of a session, averaged over the measured cycles
+struct SessionMetrics {
+    /// Number of cycles measured
+    uint32_t cycles;
+    /// Time to go from 10% to 90% of the way between PEEP and the plateau command, in ms, for the
+    /// pressure controlled modes
+    double riseTimeMs;
+    /// Highest airway pressure above the plateau command, in mmH2O, for the pressure controlled
+    /// modes
+    double overshoot;
+    /// Airway pressure at the end of the inspiration minus the plateau command, in mmH2O, for the
+    /// pressure controlled modes
+    double plateauError;
+    /// Airway pressure over the last 100 ms of the cycle minus the PEEP command, in mmH2O
+    double peepError;
+    /// Volume delivered to the lungs, in mL
+    double tidalVolume;
+    /// Volume delivered minus the tidal volume command, in mL, for the volume controlled modes
+    double tidalVolumeError;
+    /// Number of times an alarm was triggered, during the settling too
+    uint32_t alarms;
+    /// Number of cycles, the settling included, before the airway pressure at the end of the
+    /// inspiration stays within 2 cmH2O of the plateau command, for the pressure controlled modes
+    uint32_t convergenceCycles;
+};
+
+/// Ranges of a sweep, every axis is split in evenly spaced values, bounds included
+struct SweepRanges {
+    /// Number of values of the PEEP, plateau pressure, rate and tidal volume axes
+    uint16_t steps;
+    /// Patients of the sweep
+    std::vector<LungCompartment> lungs;
+    /// Number of cycles run before the measure
+    uint32_t settlingCycles;
+    /// Number of cycles measured
+    uint32_t measuredCycles;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Check if a mode regulates the pressure, rather than the volume
+ *
+ * @param p_mode Ventilation mode
+ * @return True for the pressure controlled modes
+ */
+bool isPressureControlled(uint16_t p_mode);
+
+/// Healthy patient ventilated in PC_CMV with the default settings of parameters.h
+SweepSession defaultSweepSession(void);
+
+/**
+ * Ranges covering the settings limits of parameters.h with a library of patients
+ *
+ * @param p_steps Number of values of every setting axis
+ * @return Ranges of the sweep
+ */
+SweepRanges defaultSweepRanges(uint16_t p_steps);
+
+/**
+ * List the sessions of a sweep: every mode, setting value and patient
+ *
+ * @param p_ranges Ranges of the sweep
+ * @return Sessions, with the PEEP below the plateau pressure, and the tidal volume only swept
+ *         for the volume controlled modes
+ */
+std::vector<SweepSession> sweepSessions(const SweepRanges& p_ranges);
+
+/**
+ * Set the coefficients of the pressure controlled modes for the next sessions
+ *
+ * @param p_tuning Coefficients, PC_CMV_DEFAULT_TUNING until it is called
+ * @note Workers of runSessionSweep() take the coefficients set when it is called
+ */
+void setSweepTuning(const PcCmvTuning& p_tuning);
+
+/**
+ * Boot the host board on the lungs of a session, with its settings, the breathing stopped
+ *
+ * @param p_session Patient, mode and settings
+ * @return Lungs of the session, stepped by the simulation until the next boot
+ */
+PneumaticPlant& bootSweepBoard(const SweepSession& p_session);
+
+/**
+ * Run a session in this process
+ *
+ * @param p_session Patient, mode and settings
+ * @param p_settlingCycles Number of cycles run before the measure
+ * @param p_measuredCycles Number of cycles measured
+ * @return Measures of the session
+ * @warning It boots the host board again: the state of a previous simulation is lost
+ */
+SessionMetrics runSweepSession(const SweepSession& p_session,
+                               uint32_t p_settlingCycles,
+                               uint32_t p_measuredCycles);
+
+/**
+ * Run jobs in worker processes, as many as CPU cores by default
+ *
+ * @param p_jobs Number of jobs
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @param p_resultSize Size of the result of a job, in bytes
+ * @param p_job Job run in a worker: it gets its index and writes its result, of plain data
+ * @param p_results Results of every job, one after the other, at 0 for the jobs of a failed worker
+ * @return False if a worker failed
+ */
+bool runWorkerJobs(size_t p_jobs,
+                   uint32_t p_workers,
+                   size_t p_resultSize,
+                   const std::function<void(size_t, uint8_t*)>& p_job,
+                   std::vector<uint8_t>* p_results);
+
+/**
+ * Run sessions in worker processes
+ *
+ * @param p_sessions Sessions to run
+ * @param p_settlingCycles Number of cycles run before the measure
+ * @param p_measuredCycles Number of cycles measured
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @param p_metrics Measures of every session, in the order of the sessions
+ * @return False if a worker failed, its sessions then have metrics of 0 cycles
+ */
+bool runSessionSweep(const std::vector<SweepSession>& p_sessions,
+                     uint32_t p_settlingCycles,
+                     uint32_t p_measuredCycles,
+                     uint32_t p_workers,
+                     std::vector<SessionMetrics>* p_metrics);
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file simulator.cpp
+ * @brief Faster than real time simulation of the firmware timers
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "simulator.h"
+
+// Internal
+#include "../../includes/board_state.h"
+#include "../../includes/buzzer.h"
+#include "../../includes/checkpoint.h"
+#include "../../includes/deferred_work.h"
+#include "../../includes/timebase.h"
+#include "host_board.h"
+
+// INITIALISATION =============================================================
+
+static BOARD_STATE bool simulatedBackgroundLoop = true;
+static BOARD_STATE SimulatedPlant* simulatedPlant = nullptr;
+static BOARD_STATE uint32_t simulatedPlantPeriod = 0;
+static BOARD_STATE uint64_t nextPlantStep = 0;
+static BOARD_STATE uint64_t simulatedEvents[HAL_TIMERS];
+static BOARD_STATE uint32_t simulatedWatchdogResetCount = 0;
+
+// Date of the watchdog reload after which the last reset happened
+static BOARD_STATE uint64_t simulatedWatchdogResetReload = 0;
+
+// FUNCTIONS ==================================================================
+
+void resetSimulation(uint64_t p_startMicros) {
+    // Work left by a previous simulation would never be run by the board
+    runDeferredWork();
+
+    initTimebase();
+    setMonotonicMicros(p_startMicros);
+    resetHostHal();
+    resetHostBoard();
+
+    simulatedBackgroundLoop = true;
+    simulatedPlant = nullptr;
+    for (uint8_t i = 0; i < HAL_TIMERS; i++) {
+        simulatedEvents[i] = 0;
+    }
+    simulatedWatchdogResetCount = 0;
+    simulatedWatchdogResetReload = 0;
+}
+
+/**
+ * Check if the watchdog expired on a date
+ *
+ * @param p_dateUs Date in µs on the host clock
+ */
+static void checkSimulatedWatchdog(uint64_t p_dateUs) {
+    uint64_t lastReload = hostWatchdogLastReload();
+    // The watchdog only runs once it has been reloaded, and resets the board once per stall
+    if ((hostWatchdogReloads() > 0u) && ((p_dateUs - lastReload) > WATCHDOG_TIMEOUT)
+        && ((simulatedWatchdogResetCount == 0u) || (lastReload != simulatedWatchdogResetReload))) {
+        simulatedWatchdogResetCount++;
+        simulatedWatchdogResetReload = lastReload;
+    }
+}
+
+void runSimulation(uint64_t p_durationUs) {
+    uint64_t end = monotonicMicros() + p_durationUs;
+    bool running = true;
+
+    while (running) {
+        HalTimer timer = HAL_TIMER_CONTROL;
+        uint64_t date = 0;
+        bool hasTimerEvent = hostNextTimerEvent(&timer, &date);
+        bool isPlantStep =
+            (simulatedPlant != nullptr) && (!hasTimerEvent || (nextPlantStep <= date));
+        if (isPlantStep) {
+            date = nextPlantStep;
+        }
+
+        if ((!hasTimerEvent && !isPlantStep) || (date > end)) {
+            running = false;
+        } else if (isPlantStep) {
+            setMonotonicMicros(date);
+            simulatedPlant->step(simulatedPlantPeriod);
+            nextPlantStep += simulatedPlantPeriod;
+        } else {
+            setMonotonicMicros(date);
+            checkSimulatedWatchdog(date);
+
+            fireHostTimer(timer);
+            simulatedEvents[timer]++;
+
+            // The background loop takes no simulated time: the work posted by an interrupt is
+            // done before the next one
+            if (simulatedBackgroundLoop) {
+                runDeferredWork();
+            }
+        }
+    }
+
+    setMonotonicMicros(end);
+    checkSimulatedWatchdog(end);
+}
+
+void setSimulatedPlant(SimulatedPlant* p_plant, uint32_t p_periodUs) {
+    simulatedPlant = p_plant;
+    simulatedPlantPeriod = p_periodUs;
+    nextPlantStep = monotonicMicros() + p_periodUs;
+}
+
+void setSimulatedBackgroundLoop(bool p_running) { simulatedBackgroundLoop = p_running; }
+
+uint64_t simulatedTimerEvents(HalTimer p_timer) { return simulatedEvents[p_timer]; }
+
+uint32_t simulatedWatchdogResets(void) { return simulatedWatchdogResetCount; }
+
+/**
+ * Archive the host clock, the host board and the state of the simulation
+ *
+ * @param p_archive Archive
+ */
+static void simulationCheckpoint(CheckpointArchive* p_archive) {
+    uint64_t date = monotonicMicros();
+    p_archive->field(date);
+    if (p_archive->isRestoring()) {
+        // The host clock only moves forward, it is started again to go back to the date
+        initTimebase();
+        setMonotonicMicros(date);
+    }
+    hostHalCheckpoint(p_archive);
+    hostBoardCheckpoint(p_archive);
+    p_archive->field(simulatedBackgroundLoop);
+    p_archive->field(simulatedPlantPeriod);
+    p_archive->field(nextPlantStep);
+    p_archive->field(simulatedEvents);
+    p_archive->field(simulatedWatchdogResetCount);
+    p_archive->field(simulatedWatchdogResetReload);
+}
+
+std::vector<uint8_t> saveSimulation(void) {
+    CheckpointArchive measure;
+    simulationCheckpoint(&measure);
+    std::vector<uint8_t> checkpoint(checkpointSize() + measure.size());
+
+    size_t size = saveCheckpoint(checkpoint.data(), checkpoint.size());
+    CheckpointArchive host(&checkpoint[size], checkpoint.size() - size);
+    simulationCheckpoint(&host);
+    return checkpoint;
+}
+
+bool restoreSimulation(const std::vector<uint8_t>& p_checkpoint) {
+    size_t size = checkpointSize();
+    CheckpointArchive measure;
+    simulationCheckpoint(&measure);
+    if (p_checkpoint.size() != (size + measure.size())) {
+        return false;
+    }
+
+    // Work posted by the abandoned session belongs to it
+    runDeferredWork();
+    if (!restoreCheckpoint(p_checkpoint.data(), size)) {
+        return false;
+    }
+    // The host board comes last: the timers get back the periods they had, whatever the firmware
+    // set while it was restored
+    CheckpointArchive host(&p_checkpoint[size], measure.size());
+    simulationCheckpoint(&host);
+    return true;
+}
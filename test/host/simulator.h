@@ -0,0 +1,105 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file simulator.h
+ * @brief Faster than real time simulation of the firmware timers
+ *
+ * The host clock (timebase.h) does not move by itself. The simulation moves it from one period
+ * elapsed event of the HAL timers to the next one, runs the callback of the timer like its
+ * interrupt would, then runs the deferred work like the background loop does before sleeping.
+ * The main state machine, the flow meter acquisition and the buzzer patterns see the same dates
+ * as on the board, so hours of ventilation run through the real firmware in seconds.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "../../includes/hal.h"
+
+// INITIALISATION =============================================================
+
+/// One simulated second, in µs
+#define SECOND_US 1000000u
+
+// CLASS ======================================================================
+
+/// Physical system around the board, stepped by the simulation between the timer events
+class SimulatedPlant {
+ public:
+    virtual ~SimulatedPlant() {}
+
+    /**
+     * Move the plant forward: read the actuators on the HAL outputs, then set the sensor inputs
+     *
+     * @param p_dtUs Duration of the step in µs
+     */
+    virtual void step(uint32_t p_dtUs) = 0;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Reset the host board and set the host clock, the plant is removed
+ *
+ * @param p_startMicros Date in µs the simulation starts from, to reach the counter wraps quickly
+ */
+void resetSimulation(uint64_t p_startMicros);
+
+/**
+ * Run the timers and the background loop
+ *
+ * @param p_durationUs Simulated duration in µs, the host clock ends exactly that much later
+ */
+void runSimulation(uint64_t p_durationUs);
+
+/**
+ * Close the loop around the board with a plant
+ *
+ * @param p_plant Plant, or nullptr to remove it
+ * @param p_periodUs Period of the plant steps in µs, a step comes before a timer event on the
+ *                   same date so that the board samples the sensors of that date
+ */
+void setSimulatedPlant(SimulatedPlant* p_plant, uint32_t p_periodUs);
+
+/**
+ * Let the background loop run or not
+ *
+ * @param p_running False to simulate a background task stuck in a loop, the posted work is then
+ *                  left in the queue
+ */
+void setSimulatedBackgroundLoop(bool p_running);
+
+/**
+ * Get the number of period elapsed events a timer had since the simulation was reset
+ *
+ * @param p_timer Timer
+ * @return Number of times its callback ran
+ */
+uint64_t simulatedTimerEvents(HalTimer p_timer);
+
+/// Number of times the watchdog would have reset the board, since the simulation was reset
+uint32_t simulatedWatchdogResets(void);
+
+/**
+ * Save a simulation: the runtime state of the firmware (checkpoint.h), the host board, the timers
+ * and the host clock
+ *
+ * @return Checkpoint of the simulation
+ * @note The plant is not part of it: a plant that has a state must be copied along
+ */
+std::vector<uint8_t> saveSimulation(void);
+
+/**
+ * Restore a simulation saved in this process, or in the process it was forked from, to run it
+ * again from that date: a warm-up can be run once, then branched into many sessions
+ *
+ * @param p_checkpoint Checkpoint of the simulation
+ * @return False if it is not a checkpoint of this firmware, nothing is restored then
+ * @note The plant set stays, its state must be restored by the caller
+ */
+bool restoreSimulation(const std::vector<uint8_t>& p_checkpoint);
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file trigger_report.cpp
+ * @brief Synchronisation of the ventilator with a breathing patient
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "trigger_report.h"
+
+// Externals
+#include <stdio.h>
+
+// Internal
+#include "../../includes/main_controller.h"
+#include "../../includes/timebase.h"
+#include "../../includes/ventilator_context.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Step of the measures, in µs
+#define TRIGGER_REPORT_STEP_US 1000u
+
+// FUNCTIONS ==================================================================
+
+TriggerReport runTriggerReport(const PatientEffort& p_effort, uint64_t p_durationUs) {
+    TriggerReport report = {0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u};
+    uint64_t delaySumUs = 0u;
+    uint64_t inspiratoryTimeSumMs = 0u;
+
+    uint64_t end = monotonicMicros() + p_durationUs;
+    bool wasTriggered = ventilator.mainController.triggered();
+    uint32_t cycle = ventilator.mainController.cycleNumber();
+    uint32_t ticksPerInhalation = ventilator.mainController.ticksPerInhalation();
+
+    // Effort in progress, whether it started during the period and whether a trigger detected it
+    uint64_t onset = 0u;
+    bool inEffort = p_effort.effortAt(monotonicMicros(), &onset);
+    bool tracked = false;
+    bool detected = false;
+    uint64_t delayUs = 0u;
+
+    while (monotonicMicros() < end) {
+        runSimulation(TRIGGER_REPORT_STEP_US);
+        uint64_t now = monotonicMicros();
+
+        // Report the effort that ended, if it started during the period
+        uint64_t currentOnset = 0u;
+        bool nowInEffort = p_effort.effortAt(now, &currentOnset);
+        bool isNewEffort = nowInEffort && (!inEffort || (currentOnset != onset));
+        if (inEffort && tracked && (!nowInEffort || isNewEffort)) {
+            report.efforts++;
+            if (detected) {
+                report.detectedEfforts++;
+                delaySumUs += delayUs;
+                if ((delayUs / 1000u) > report.maxTriggerDelayMs) {
+                    report.maxTriggerDelayMs = static_cast<uint32_t>(delayUs / 1000u);
+                }
+            } else {
+                report.missedTriggers++;
+            }
+        }
+        if (isNewEffort) {
+            tracked = true;
+            detected = false;
+        }
+        inEffort = nowInEffort;
+        onset = currentOnset;
+
+        // The trigger stays raised until the next cycle starts
+        bool triggered = ventilator.mainController.triggered();
+        if (triggered && !wasTriggered) {
+            if (inEffort && !detected) {
+                detected = true;
+                delayUs = now - onset;
+            } else {
+                report.autoTriggers++;
+            }
+        }
+        wasTriggered = triggered;
+
+        // The duration of the inspiration is known when the cycle ends
+        if (ventilator.mainController.cycleNumber() != cycle) {
+            report.cycles++;
+            inspiratoryTimeSumMs += ticksPerInhalation * MAIN_CONTROLLER_COMPUTE_PERIOD_MS;
+            cycle = ventilator.mainController.cycleNumber();
+        }
+        ticksPerInhalation = ventilator.mainController.ticksPerInhalation();
+    }
+
+    if (report.detectedEfforts > 0u) {
+        report.meanTriggerDelayMs =
+            static_cast<uint32_t>(delaySumUs / (report.detectedEfforts * 1000u));
+    }
+    if (report.cycles > 0u) {
+        report.meanInspiratoryTimeMs = static_cast<uint32_t>(inspiratoryTimeSumMs / report.cycles);
+    }
+    return report;
+}
+
+void printTriggerReport(const char* p_setting, const TriggerReport& p_report) {
+    printf("%-32s efforts %3u  detected %3u  missed %3u  auto-triggers %3u  delay %4u ms (max %4u)"
+           "  cycles %3u  Ti %4u ms\n",
+           p_setting, p_report.efforts, p_report.detectedEfforts, p_report.missedTriggers,
+           p_report.autoTriggers, p_report.meanTriggerDelayMs, p_report.maxTriggerDelayMs,
+           p_report.cycles, p_report.meanInspiratoryTimeMs);
+}
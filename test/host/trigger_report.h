@@ -0,0 +1,61 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file trigger_report.h
+ * @brief Synchronisation of the ventilator with a breathing patient
+ *
+ * The simulation runs by steps of 1 ms while the efforts of the patient are compared with the
+ * inspiratory triggers the controller raises (MainController::triggered). A trigger raised during
+ * an effort detects it, after the trigger delay. An effort that ends without a trigger is a
+ * missed trigger, and a trigger raised outside an effort, or a second one during the same effort,
+ * is an auto-trigger. Only the efforts that start and end during the measure are reported.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+
+#include "patient_effort.h"
+
+// INITIALISATION =============================================================
+
+/// Synchronisation measures over a simulated period
+struct TriggerReport {
+    /// Number of efforts that started and ended during the period
+    uint32_t efforts;
+    /// Efforts the controller detected with a trigger
+    uint32_t detectedEfforts;
+    /// Efforts that ended without any trigger
+    uint32_t missedTriggers;
+    /// Triggers raised outside of an effort, or twice during the same effort
+    uint32_t autoTriggers;
+    /// Mean delay between the start of a detected effort and its trigger, in ms
+    uint32_t meanTriggerDelayMs;
+    /// Longest of these delays, in ms
+    uint32_t maxTriggerDelayMs;
+    /// Number of respiratory cycles that ended during the period
+    uint32_t cycles;
+    /// Mean duration of the inspiration of these cycles, in ms
+    uint32_t meanInspiratoryTimeMs;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Run the simulation and measure how the ventilator follows the efforts of the patient
+ *
+ * @param p_effort Efforts of the patient, already given to the pneumatic plant
+ * @param p_durationUs Duration of the measure in µs
+ * @return Measures of the period
+ */
+TriggerReport runTriggerReport(const PatientEffort& p_effort, uint64_t p_durationUs);
+
+/**
+ * Print a report on the standard output, on one line
+ *
+ * @param p_setting Description of the mode and settings the report was measured with
+ * @param p_report Report to print
+ */
+void printTriggerReport(const char* p_setting, const TriggerReport& p_report);
@@ -0,0 +1,443 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file ui_link.cpp
+ * @brief Serial link between the simulated board and a stand-in of the control UI
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "ui_link.h"
+
+// Externals
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+// Internal
+#include "../../includes/hal.h"
+#include "../../includes/rpi_watchdog.h"
+#include "../../includes/serial_control.h"
+#include "../../includes/telemetry.h"
+#include "CRC32.h"
+
+// INITIALISATION =============================================================
+
+/// Header of the telemetry frames
+static const uint8_t TELEMETRY_HEADER[2] = {0x03, 0x0C};
+
+/// Footer of the telemetry frames
+static const uint8_t TELEMETRY_FOOTER[2] = {0x30, 0xC0};
+
+/// Size of the checksum of a frame
+#define TELEMETRY_CRC_SIZE 4u
+
+/// Size of the device ID of a frame
+#define TELEMETRY_DEVICE_ID_SIZE 12u
+
+/// Size of the systick of a frame
+#define TELEMETRY_SYSTICK_SIZE 8u
+
+/// Size of the fields of a control ack: setting and value
+#define TELEMETRY_ACK_FIELDS_SIZE 4u
+
+/// Size of the fields of an alarm trap, up to the number of cycles since it was triggered
+#define TELEMETRY_TRAP_FIELDS_SIZE 33u
+
+/// Offset of the alarm code in the fields of an alarm trap
+#define TELEMETRY_TRAP_CODE_INDEX 13u
+
+/// Offset of the triggered flag in the fields of an alarm trap
+#define TELEMETRY_TRAP_TRIGGERED_INDEX 17u
+
+/// Value of the triggered flag of an alarm trap for a triggered alarm
+#define TELEMETRY_TRAP_TRIGGERED 240u
+
+/// Bytes read from a device at once
+#define UI_LINK_READ_SIZE 256u
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Read a big endian number
+ *
+ * @param p_data Bytes of the number
+ * @param p_size Number of bytes
+ * @return Number
+ */
+static uint64_t readBigEndian(const uint8_t* p_data, size_t p_size) {
+    uint64_t value = 0u;
+    for (size_t i = 0; i < p_size; i++) {
+        value = (value << 8u) | p_data[i];
+    }
+    return value;
+}
+
+/**
+ * Put a terminal in raw mode, at the telemetry bit rate
+ *
+ * @param p_fd Terminal
+ */
+static void setRawMode(int p_fd) {
+    struct termios attributes;
+    if (tcgetattr(p_fd, &attributes) == 0) {
+        cfmakeraw(&attributes);
+        (void)cfsetispeed(&attributes, B115200);
+        (void)cfsetospeed(&attributes, B115200);
+        (void)tcsetattr(p_fd, TCSANOW, &attributes);
+    }
+}
+
+void encodeControlFrame(uint8_t p_setting, uint16_t p_value, uint8_t* p_frame) {
+    p_frame[0] = 0x05;
+    p_frame[1] = 0x0A;
+    p_frame[2] = p_setting;
+    p_frame[3] = static_cast<uint8_t>(p_value >> 8u);
+    p_frame[4] = static_cast<uint8_t>(p_value & 0xFFu);
+    CRC32 crc32;
+    crc32.update(&p_frame[2], 3u);
+    uint32_t crc = crc32.finalize();
+    for (uint8_t i = 0; i < 4u; i++) {
+        p_frame[5u + i] = static_cast<uint8_t>(crc >> (24u - (8u * i)));
+    }
+    p_frame[9] = 0x50;
+    p_frame[10] = 0xA0;
+}
+
+TelemetryDecoding decodeTelemetryFrame(const uint8_t* p_data,
+                                       size_t p_size,
+                                       TelemetryFrame* p_frame) {
+    // Header, type of message and protocol version, as far as they are received
+    if (((p_size > 0u) && (p_data[0] != TELEMETRY_HEADER[0]))
+        || ((p_size > 1u) && (p_data[1] != TELEMETRY_HEADER[1]))
+        || ((p_size > 3u) && (p_data[3] != ':'))
+        || ((p_size > 4u) && (p_data[4] != PROTOCOL_VERSION))) {
+        return TELEMETRY_FRAME_INVALID;
+    }
+    if (p_size < 6u) {
+        return TELEMETRY_FRAME_INCOMPLETE;
+    }
+
+    // Firmware version, device ID and systick, each followed by a '\t'
+    size_t systickIndex = 6u + p_data[5] + TELEMETRY_DEVICE_ID_SIZE + 1u;
+    size_t fieldsIndex = systickIndex + TELEMETRY_SYSTICK_SIZE + 1u;
+    if (p_size < fieldsIndex) {
+        return TELEMETRY_FRAME_INCOMPLETE;
+    }
+    if ((p_data[systickIndex - 1u] != '\t') || (p_data[fieldsIndex - 1u] != '\t')) {
+        return TELEMETRY_FRAME_INVALID;
+    }
+
+    // The fields may hold the bytes of a footer: the end is the first footer the checksum of
+    // everything between the header and itself agrees with
+    CRC32 crc32;
+    crc32.update(&p_data[sizeof(TELEMETRY_HEADER)], fieldsIndex - sizeof(TELEMETRY_HEADER));
+    bool damaged = false;
+    for (size_t end = fieldsIndex;
+         (end + 1u + TELEMETRY_CRC_SIZE + sizeof(TELEMETRY_FOOTER)) <= p_size; end++) {
+        crc32.update(p_data[end]);
+        size_t footerIndex = end + 1u + TELEMETRY_CRC_SIZE;
+        if ((p_data[end] != '\n') || (p_data[footerIndex] != TELEMETRY_FOOTER[0])
+            || (p_data[footerIndex + 1u] != TELEMETRY_FOOTER[1])) {
+            continue;
+        }
+
+        size_t frameSize = footerIndex + sizeof(TELEMETRY_FOOTER);
+        if (crc32.finalize() == readBigEndian(&p_data[end + 1u], TELEMETRY_CRC_SIZE)) {
+            p_frame->type = static_cast<char>(p_data[2]);
+            p_frame->systick = readBigEndian(&p_data[systickIndex], TELEMETRY_SYSTICK_SIZE);
+            p_frame->fields.assign(&p_data[fieldsIndex], &p_data[end]);
+            p_frame->size = frameSize;
+            return TELEMETRY_FRAME_DECODED;
+        }
+        if (((frameSize + 1u) < p_size) && (p_data[frameSize] == TELEMETRY_HEADER[0])
+            && (p_data[frameSize + 1u] == TELEMETRY_HEADER[1])) {
+            damaged = true;
+        }
+    }
+
+    return (damaged || (p_size >= TELEMETRY_FRAME_MAX_SIZE)) ? TELEMETRY_FRAME_INVALID
+                                                              : TELEMETRY_FRAME_INCOMPLETE;
+}
+
+bool decodeControlAck(const TelemetryFrame& p_frame, uint8_t* p_setting, uint16_t* p_value) {
+    if ((p_frame.type != 'A') || (p_frame.fields.size() != TELEMETRY_ACK_FIELDS_SIZE)
+        || (p_frame.fields[1] != '\t')) {
+        return false;
+    }
+    *p_setting = p_frame.fields[0];
+    *p_value = static_cast<uint16_t>(readBigEndian(&p_frame.fields[2], 2u));
+    return true;
+}
+
+bool decodeAlarmTrap(const TelemetryFrame& p_frame, uint8_t* p_code, bool* p_triggered) {
+    if ((p_frame.type != 'T') || (p_frame.fields.size() != TELEMETRY_TRAP_FIELDS_SIZE)) {
+        return false;
+    }
+    *p_code = p_frame.fields[TELEMETRY_TRAP_CODE_INDEX];
+    *p_triggered = (p_frame.fields[TELEMETRY_TRAP_TRIGGERED_INDEX] == TELEMETRY_TRAP_TRIGGERED);
+    return true;
+}
+
+PtyLink::PtyLink()
+    : m_fd(-1), m_lineCredit(0u), m_bytesSent(0u), m_bytesReceived(0u), m_maxBacklog(0u) {}
+
+PtyLink::~PtyLink() {
+    if (m_fd >= 0) {
+        (void)close(m_fd);
+    }
+}
+
+bool PtyLink::open() {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return false;
+    }
+    const char* name = ((grantpt(fd) == 0) && (unlockpt(fd) == 0)) ? ptsname(fd) : nullptr;
+    if (name == nullptr) {
+        (void)close(fd);
+        return false;
+    }
+
+    setRawMode(fd);
+    m_fd = fd;
+    m_devicePath = name;
+    return true;
+}
+
+void PtyLink::exchange(uint64_t p_elapsedUs) {
+    if (m_fd < 0) {
+        return;
+    }
+
+    // The UI may not have opened the terminal yet, or closed it: reads then fail with EIO
+    uint8_t buffer[UI_LINK_READ_SIZE];
+    ssize_t count = read(m_fd, buffer, sizeof(buffer));
+    while (count > 0) {
+        pushHostTelemetryInput(buffer, static_cast<size_t>(count));
+        m_bytesReceived += static_cast<uint64_t>(count);
+        count = read(m_fd, buffer, sizeof(buffer));
+    }
+
+    size_t taken = popHostTelemetryOutput(buffer, sizeof(buffer));
+    while (taken > 0u) {
+        m_backlog.insert(m_backlog.end(), &buffer[0], &buffer[taken]);
+        taken = popHostTelemetryOutput(buffer, sizeof(buffer));
+    }
+    m_maxBacklog = std::max(m_maxBacklog, m_backlog.size());
+
+    m_lineCredit += p_elapsedUs * TELEMETRY_BAUD_RATE;
+    const uint64_t creditPerByte = TELEMETRY_BITS_PER_BYTE * 1000000u;
+    size_t lineBytes = static_cast<size_t>(
+        std::min(m_lineCredit / creditPerByte, static_cast<uint64_t>(m_backlog.size())));
+    std::vector<uint8_t> line(m_backlog.begin(), m_backlog.begin() + lineBytes);
+    ssize_t written = (lineBytes > 0u) ? write(m_fd, line.data(), line.size()) : 0;
+    if (written > 0) {
+        m_backlog.erase(m_backlog.begin(), m_backlog.begin() + written);
+        m_bytesSent += static_cast<uint64_t>(written);
+        m_lineCredit -= static_cast<uint64_t>(written) * creditPerByte;
+    }
+
+    // An idle line, or one the UI does not read, gains no credit for later
+    if (m_backlog.empty() || (written < static_cast<ssize_t>(lineBytes))) {
+        m_lineCredit = 0u;
+    }
+}
+
+UiStandIn::UiStandIn()
+    : m_fd(-1),
+      m_heartbeatPeriodMs(UI_HEARTBEAT_PERIOD_MS),
+      m_nextHeartbeatUs(0u),
+      m_firstPollUs(0u),
+      m_lastPollUs(0u),
+      m_polled(false),
+      m_clockOffsetUs(std::numeric_limits<int64_t>::max()),
+      m_report(),
+      m_lastFrame() {
+    m_lastFrame.type = '\0';
+    m_lastFrame.systick = 0u;
+    m_lastFrame.size = 0u;
+}
+
+UiStandIn::~UiStandIn() {
+    if (m_fd >= 0) {
+        (void)close(m_fd);
+    }
+}
+
+bool UiStandIn::open(const std::string& p_path) {
+    int fd = ::open(p_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return false;
+    }
+    setRawMode(fd);
+    m_fd = fd;
+    return true;
+}
+
+void UiStandIn::writeControl(uint8_t p_setting, uint16_t p_value) {
+    uint8_t frame[CONTROL_FRAME_SIZE];
+    encodeControlFrame(p_setting, p_value, frame);
+    ssize_t written = write(m_fd, frame, sizeof(frame));
+    if (written > 0) {
+        m_report.bytesSent += static_cast<uint64_t>(written);
+    }
+}
+
+void UiStandIn::sendSetting(uint8_t p_setting, uint16_t p_value, uint64_t p_nowUs) {
+    writeControl(p_setting, p_value);
+    m_report.settingsSent++;
+    PendingSetting pending = {p_setting, p_nowUs};
+    m_pendingSettings.push_back(pending);
+}
+
+void UiStandIn::poll(uint64_t p_nowUs) {
+    if (!m_polled) {
+        m_polled = true;
+        m_firstPollUs = p_nowUs;
+        m_nextHeartbeatUs = p_nowUs;
+    }
+    m_lastPollUs = p_nowUs;
+
+    if ((m_heartbeatPeriodMs > 0u) && (p_nowUs >= m_nextHeartbeatUs)) {
+        writeControl(Heartbeat, 0u);
+        m_report.heartbeatsSent++;
+        m_nextHeartbeatUs = p_nowUs + (static_cast<uint64_t>(m_heartbeatPeriodMs) * 1000u);
+    }
+
+    uint8_t buffer[UI_LINK_READ_SIZE];
+    ssize_t count = read(m_fd, buffer, sizeof(buffer));
+    while (count > 0) {
+        m_received.insert(m_received.end(), &buffer[0], &buffer[count]);
+        m_report.bytesReceived += static_cast<uint64_t>(count);
+        count = read(m_fd, buffer, sizeof(buffer));
+    }
+
+    size_t index = 0u;
+    bool decoding = true;
+    while (decoding && (index < m_received.size())) {
+        TelemetryFrame frame;
+        TelemetryDecoding outcome =
+            decodeTelemetryFrame(&m_received[index], m_received.size() - index, &frame);
+        if (outcome == TELEMETRY_FRAME_DECODED) {
+            onFrame(frame, p_nowUs);
+            index += frame.size;
+        } else if (outcome == TELEMETRY_FRAME_INCOMPLETE) {
+            decoding = false;
+        } else {
+            m_report.invalidBytes++;
+            index++;
+        }
+    }
+    m_received.erase(m_received.begin(), m_received.begin() + index);
+}
+
+void UiStandIn::onFrame(const TelemetryFrame& p_frame, uint64_t p_nowUs) {
+    m_report.frames[p_frame.type]++;
+    int64_t delay = static_cast<int64_t>(p_nowUs) - static_cast<int64_t>(p_frame.systick);
+    m_clockOffsetUs = std::min(m_clockOffsetUs, delay);
+
+    uint8_t setting = 0u;
+    uint16_t value = 0u;
+    if (decodeControlAck(p_frame, &setting, &value)) {
+        // The value may have been bounded by the firmware, the ack answers the oldest setting
+        // of the same kind
+        for (auto pending = m_pendingSettings.begin(); pending != m_pendingSettings.end();
+             ++pending) {
+            if (pending->setting == setting) {
+                m_report.ackLatenciesUs.push_back(p_nowUs - pending->sentUs);
+                m_report.settingsAcked++;
+                (void)m_pendingSettings.erase(pending);
+                break;
+            }
+        }
+    }
+
+    uint8_t code = 0u;
+    bool triggered = false;
+    if (decodeAlarmTrap(p_frame, &code, &triggered) && triggered) {
+        m_report.alarmsTriggered.push_back(code);
+        m_alarmDelays.push_back(delay);
+    }
+
+    m_lastFrame = p_frame;
+}
+
+UiLinkReport UiStandIn::report() const {
+    UiLinkReport report = m_report;
+    report.durationS = static_cast<double>(m_lastPollUs - m_firstPollUs) / 1000000.0;
+
+    // The clocks of the board and of the UI differ by an unknown offset: the delay of an alarm
+    // trap is counted from the fastest frame received
+    for (int64_t delay : m_alarmDelays) {
+        report.alarmLatenciesUs.push_back(static_cast<uint64_t>(delay - m_clockOffsetUs));
+    }
+    return report;
+}
+
+PneumaticPlant& bootLinkedBoard(const SweepSession& p_session) {
+    PneumaticPlant& plant = bootSweepBoard(p_session);
+    rpiWatchdog = RpiWatchdog();
+    sendBootMessage();
+    return plant;
+}
+
+/**
+ * Write the smallest, mean and largest of some latencies
+ *
+ * @param p_name Name of the latencies
+ * @param p_latenciesUs Latencies, in µs
+ * @param p_output Output
+ */
+static void printLatencies(const char* p_name,
+                           const std::vector<uint64_t>& p_latenciesUs,
+                           FILE* p_output) {
+    if (p_latenciesUs.empty()) {
+        return;
+    }
+    uint64_t sum = 0u;
+    for (uint64_t latency : p_latenciesUs) {
+        sum += latency;
+    }
+    fprintf(p_output, "%s latency: min %.1f ms, mean %.1f ms, max %.1f ms\n", p_name,
+            static_cast<double>(*std::min_element(p_latenciesUs.begin(), p_latenciesUs.end()))
+                / 1000.0,
+            (static_cast<double>(sum) / static_cast<double>(p_latenciesUs.size())) / 1000.0,
+            static_cast<double>(*std::max_element(p_latenciesUs.begin(), p_latenciesUs.end()))
+                / 1000.0);
+}
+
+void printUiLinkReport(const UiLinkReport& p_report, FILE* p_output) {
+    double durationS = std::max(p_report.durationS, 0.001);
+    double bytesPerS = static_cast<double>(p_report.bytesReceived) / durationS;
+    fprintf(p_output,
+            "Received %llu bytes in %.1f s: %.0f B/s, %.0f%% of the line, %llu bytes skipped\n",
+            static_cast<unsigned long long>(p_report.bytesReceived), p_report.durationS,
+            bytesPerS,
+            (100.0 * bytesPerS * TELEMETRY_BITS_PER_BYTE)
+                / static_cast<double>(TELEMETRY_BAUD_RATE),
+            static_cast<unsigned long long>(p_report.invalidBytes));
+    fprintf(p_output, "Frames:");
+    for (const auto& frames : p_report.frames) {
+        fprintf(p_output, " %c %u (%.1f/s)", frames.first, frames.second,
+                static_cast<double>(frames.second) / durationS);
+    }
+    fprintf(p_output, "\n");
+    fprintf(p_output, "Sent %llu bytes: %u heartbeats, %u settings, %u acked\n",
+            static_cast<unsigned long long>(p_report.bytesSent), p_report.heartbeatsSent,
+            p_report.settingsSent, p_report.settingsAcked);
+    printLatencies("Ack", p_report.ackLatenciesUs, p_output);
+    if (!p_report.alarmsTriggered.empty()) {
+        fprintf(p_output, "Alarms triggered:");
+        for (uint8_t code : p_report.alarmsTriggered) {
+            fprintf(p_output, " %u", code);
+        }
+        fprintf(p_output, "\n");
+    }
+    printLatencies("Alarm", p_report.alarmLatenciesUs, p_output);
+}
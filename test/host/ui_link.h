@@ -0,0 +1,315 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file ui_link.h
+ * @brief Serial link between the simulated board and a stand-in of the control UI
+ *
+ * The board side (PtyLink) carries the telemetry serial link of the host board over a
+ * pseudo-terminal, at the bit rate of the UART of the board: whatever opens the terminal talks to
+ * the simulated firmware like the Raspberry Pi talks to the board, the control UI included.
+ *
+ * The UI side (UiStandIn) opens a terminal, or a serial device of a real board, and speaks both
+ * protocols like the control UI: it decodes the telemetry frames (`B:` boot, `O:` stopped, `D:`
+ * data snapshot, `S:` machine state snapshot, `T:` alarm trap, `A:` control ack, ...), sends the
+ * control frames of the settings and a heartbeat every second, so that the RPi watchdog of the
+ * firmware behaves as in production. It measures the throughput of the link, the latency from a
+ * setting sent to its ack, and the latency from an alarm trap to its receipt.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pneumatic_plant.h"
+#include "session_sweep.h"
+
+// INITIALISATION =============================================================
+
+/// Size of a control frame: header, setting, value, CRC32 and footer
+#define CONTROL_FRAME_SIZE 11u
+
+/// Largest telemetry frame, a sensor capture message
+#define TELEMETRY_FRAME_MAX_SIZE 1024u
+
+/// Bit rate of the telemetry serial link, see initTelemetry()
+#define TELEMETRY_BAUD_RATE 115200u
+
+/// Bits on the line per byte: start bit, 8 data bits, stop bit
+#define TELEMETRY_BITS_PER_BYTE 10u
+
+/// Period of the heartbeats of the UI, in ms
+#define UI_HEARTBEAT_PERIOD_MS 1000u
+
+/// Outcome of the decoding of a telemetry frame
+enum TelemetryDecoding {
+    /// A frame with a valid checksum
+    TELEMETRY_FRAME_DECODED,
+    /// The start of a frame, the rest is yet to be received
+    TELEMETRY_FRAME_INCOMPLETE,
+    /// Not a frame of this protocol version, or a damaged one
+    TELEMETRY_FRAME_INVALID
+};
+
+/// Telemetry frame sent by the board
+struct TelemetryFrame {
+    /// Type of message, the letter before ':'
+    char type;
+    /// Date of the message on the clock of the board, in µs
+    uint64_t systick;
+    /// Fields after the systick, with their '\t' separators but without the final '\n'
+    std::vector<uint8_t> fields;
+    /// Size of the whole frame, header and footer included
+    size_t size;
+};
+
+/// Settings, acks, alarms and traffic seen by the UI stand-in
+struct UiLinkReport {
+    /// Duration of the session, in s of the clock given to the stand-in
+    double durationS;
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    /// Bytes skipped because they did not belong to a valid frame
+    uint64_t invalidBytes;
+    /// Number of frames received by type of message
+    std::map<char, uint32_t> frames;
+    uint32_t heartbeatsSent;
+    uint32_t settingsSent;
+    uint32_t settingsAcked;
+    /// Time from a setting sent to its ack received, in µs
+    std::vector<uint64_t> ackLatenciesUs;
+    /// Codes of the alarms triggered, in the order of their traps
+    std::vector<uint8_t> alarmsTriggered;
+    /// Time from the date of an alarm trap on the board to its receipt, in µs
+    std::vector<uint64_t> alarmLatenciesUs;
+};
+
+// CLASS ======================================================================
+
+/// Board side: the telemetry serial link of the host board over a pseudo-terminal
+class PtyLink {
+ public:
+    PtyLink();
+    ~PtyLink();
+
+    PtyLink(const PtyLink&) = delete;
+    PtyLink& operator=(const PtyLink&) = delete;
+
+    /**
+     * Create the pseudo-terminal, in raw mode
+     *
+     * @return False if it could not be created
+     */
+    bool open();
+
+    /// Path of the terminal to open on the UI side
+    const std::string& devicePath() const { return m_devicePath; }
+
+    /**
+     * Move the bytes of the serial link, after some time of simulation: everything received on
+     * the terminal is queued to the firmware, and what the firmware sent goes out at the bit rate
+     * of the UART, the rest waiting for the next call
+     *
+     * @param p_elapsedUs Time simulated since the previous call, in µs
+     */
+    void exchange(uint64_t p_elapsedUs);
+
+    /// Number of bytes sent to the UI
+    uint64_t bytesSent() const { return m_bytesSent; }
+
+    /// Number of bytes received from the UI
+    uint64_t bytesReceived() const { return m_bytesReceived; }
+
+    /// Largest number of bytes sent by the firmware and still waiting for the line, in bytes
+    size_t maxBacklog() const { return m_maxBacklog; }
+
+ private:
+    /// Master side of the terminal, -1 while closed
+    int m_fd;
+
+    std::string m_devicePath;
+
+    /// Bytes sent by the firmware that the line did not carry yet
+    std::deque<uint8_t> m_backlog;
+
+    /// Bits the line could carry since the last byte, times 1e6
+    uint64_t m_lineCredit;
+
+    uint64_t m_bytesSent;
+    uint64_t m_bytesReceived;
+    size_t m_maxBacklog;
+};
+
+/// UI side: a stand-in of the control UI on a terminal or serial device
+class UiStandIn {
+ public:
+    UiStandIn();
+    ~UiStandIn();
+
+    UiStandIn(const UiStandIn&) = delete;
+    UiStandIn& operator=(const UiStandIn&) = delete;
+
+    /**
+     * Open the terminal or serial device of the board, in raw mode at the telemetry bit rate
+     *
+     * @param p_path Path of the device
+     * @return False if it could not be opened
+     */
+    bool open(const std::string& p_path);
+
+    /**
+     * Change the period of the heartbeats
+     *
+     * @param p_periodMs Period in ms, 0 to send none
+     */
+    void setHeartbeatPeriod(uint32_t p_periodMs) { m_heartbeatPeriodMs = p_periodMs; }
+
+    /**
+     * Send a setting like the UI does, and wait for its ack
+     *
+     * @param p_setting Setting, one of ControlSetting
+     * @param p_value Value of the setting
+     * @param p_nowUs Current date, in µs
+     */
+    void sendSetting(uint8_t p_setting, uint16_t p_value, uint64_t p_nowUs);
+
+    /**
+     * Send the heartbeats that are due, then read and decode what the board sent
+     *
+     * @param p_nowUs Current date, in µs
+     */
+    void poll(uint64_t p_nowUs);
+
+    /// What the stand-in saw since it was opened
+    UiLinkReport report() const;
+
+    /// Last frame received, of type '\0' before the first one
+    const TelemetryFrame& lastFrame() const { return m_lastFrame; }
+
+ private:
+    /// Setting sent and not acked yet
+    struct PendingSetting {
+        uint8_t setting;
+        uint64_t sentUs;
+    };
+
+    /**
+     * Write a control frame
+     *
+     * @param p_setting Setting, one of ControlSetting
+     * @param p_value Value of the setting
+     */
+    void writeControl(uint8_t p_setting, uint16_t p_value);
+
+    /**
+     * Account for a frame received
+     *
+     * @param p_frame Frame
+     * @param p_nowUs Date of its receipt, in µs
+     */
+    void onFrame(const TelemetryFrame& p_frame, uint64_t p_nowUs);
+
+    /// Device, -1 while closed
+    int m_fd;
+
+    uint32_t m_heartbeatPeriodMs;
+
+    /// Date of the next heartbeat, in µs
+    uint64_t m_nextHeartbeatUs;
+
+    /// Date of the first poll, in µs
+    uint64_t m_firstPollUs;
+
+    /// Date of the last poll, in µs
+    uint64_t m_lastPollUs;
+
+    bool m_polled;
+
+    /// Bytes received and not decoded yet
+    std::vector<uint8_t> m_received;
+
+    std::deque<PendingSetting> m_pendingSettings;
+
+    /// Receipt date minus systick of every alarm trap, in µs
+    std::vector<int64_t> m_alarmDelays;
+
+    /// Smallest receipt date minus systick of all frames, the offset of the clock of the board
+    /// plus the fastest transfer, in µs
+    int64_t m_clockOffsetUs;
+
+    UiLinkReport m_report;
+
+    TelemetryFrame m_lastFrame;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Build the control frame of a setting, as the UI sends it
+ *
+ * @param p_setting Setting, one of ControlSetting
+ * @param p_value Value of the setting
+ * @param p_frame Frame to fill, of CONTROL_FRAME_SIZE bytes
+ */
+void encodeControlFrame(uint8_t p_setting, uint16_t p_value, uint8_t* p_frame);
+
+/**
+ * Decode the telemetry frame at the start of some bytes
+ *
+ * A frame with a wrong checksum is only told invalid once the bytes after its footer start
+ * another frame, or once TELEMETRY_FRAME_MAX_SIZE bytes are in: until then it may be a frame
+ * whose fields happen to hold a footer.
+ *
+ * @param p_data Bytes received
+ * @param p_size Number of bytes
+ * @param p_frame Decoded frame
+ * @return Outcome of the decoding, p_frame is only set when a frame is decoded
+ */
+TelemetryDecoding decodeTelemetryFrame(const uint8_t* p_data,
+                                       size_t p_size,
+                                       TelemetryFrame* p_frame);
+
+/**
+ * Read the setting and the value of a control ack
+ *
+ * @param p_frame Frame
+ * @param p_setting Setting acked, one of ControlSetting
+ * @param p_value Value the setting has now
+ * @return False if the frame is not a control ack
+ */
+bool decodeControlAck(const TelemetryFrame& p_frame, uint8_t* p_setting, uint16_t* p_value);
+
+/**
+ * Read the alarm of an alarm trap
+ *
+ * @param p_frame Frame
+ * @param p_code Code of the alarm, see alarm_controller.h
+ * @param p_triggered True if the alarm was triggered, false if it stopped
+ * @return False if the frame is not an alarm trap
+ */
+bool decodeAlarmTrap(const TelemetryFrame& p_frame, uint8_t* p_code, bool* p_triggered);
+
+/**
+ * Boot the host board like respirator.cpp does: the boot message is sent and the RPi watchdog
+ * counts down from its start
+ *
+ * @param p_session Patient, mode and settings
+ * @return Lungs of the session, stepped by the simulation until the next boot
+ */
+PneumaticPlant& bootLinkedBoard(const SweepSession& p_session);
+
+/**
+ * Write the report of the UI stand-in
+ *
+ * @param p_report Report
+ * @param p_output Output
+ */
+void printUiLinkReport(const UiLinkReport& p_report, FILE* p_output);
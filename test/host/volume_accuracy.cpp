@@ -0,0 +1,332 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file volume_accuracy.cpp
+ * @brief Monte Carlo study of the volume and PEEP measures with imperfect sensors
+ *****************************************************************************/
+
+// INCLUDES ===================================================================
+
+// Associated header
+#include "volume_accuracy.h"
+
+// Externals
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Internal
+#include "../../includes/activation.h"
+#include "../../includes/board_state.h"
+#include "../../includes/cycle.h"
+#include "../../includes/main_controller.h"
+#include "../../includes/mass_flow_meter.h"
+#include "../../includes/parameters.h"
+#include "../../includes/ventilator_context.h"
+#include "host_board.h"
+#include "simulator.h"
+
+// INITIALISATION =============================================================
+
+/// Period of the truth samples, the plant steps at it
+#define VOLUME_ACCURACY_SAMPLE_PERIOD_US 1000u
+
+/// Duration of the true PEEP at the end of a cycle, in samples, as the 10 pressures of the
+/// controller
+#define VOLUME_ACCURACY_PEEP_SAMPLES 100u
+
+/// Flow samples averaged by the zero calibration, MFM_MEAN_SAMPLES on the board
+#define VOLUME_ACCURACY_ZERO_SAMPLES 40
+
+/// Largest offset the zero calibration accepts, in mL/min
+#define VOLUME_ACCURACY_MAX_ZERO 10000
+
+/// Sensors of the trial running in this process, they must outlive the simulation
+static BOARD_STATE PlantSensors accuracySensors;
+
+/// Measures and truth of a cycle
+struct CycleAccuracy {
+    double tidalVolume;
+    double tidalVolumeError;
+    double peepError;
+    double minuteVolumeError;
+};
+
+/// Cycles of a trial, as a worker sends them
+struct VolumeAccuracyTrial {
+    uint32_t cycles;
+    CycleAccuracy measures[VOLUME_ACCURACY_MAX_CYCLES];
+};
+
+// FUNCTIONS ==================================================================
+
+SensorModelSettings sensorTolerances(SensorKind p_kind) {
+    SensorModelSettings settings = idealSensor(p_kind);
+    if (p_kind == SENSOR_PRESSURE_ADC) {
+        // A few LSB of noise on the ADC, the offset of the MPX5010 after the zero of the board
+        settings.noise = 1.0;
+        settings.offset = 5.0;
+        settings.offsetDrift = 0.01;
+    } else if (p_kind == SENSOR_HONEYWELL_HAF) {
+        settings.noise = 100.0;
+        settings.offset = 200.0;
+        settings.offsetDrift = 1.0;
+    } else if (p_kind == SENSOR_SFM3300) {
+        settings.noise = 50.0;
+        settings.offset = 100.0;
+        settings.offsetDrift = 0.5;
+    } else {
+        settings.noise = 30.0;
+        settings.offset = 50.0;
+        settings.offsetDrift = 0.5;
+    }
+    return settings;
+}
+
+VolumeAccuracySettings defaultVolumeAccuracySettings(uint32_t p_trials) {
+    VolumeAccuracySettings settings = {defaultSweepSession(),
+                                       sensorTolerances(SENSOR_PRESSURE_ADC),
+                                       sensorTolerances(BOARD_INSPIRATORY_SENSOR),
+                                       sensorTolerances(BOARD_EXPIRATORY_SENSOR),
+                                       p_trials,
+                                       3u,
+                                       10u,
+                                       1u,
+                                       true};
+    return settings;
+}
+
+ErrorDistribution errorDistribution(std::vector<double> p_errors) {
+    ErrorDistribution distribution = {0u, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if (p_errors.empty()) {
+        return distribution;
+    }
+    std::sort(p_errors.begin(), p_errors.end());
+    size_t count = p_errors.size();
+    distribution.samples = static_cast<uint32_t>(count);
+
+    for (double error : p_errors) {
+        distribution.mean += error / static_cast<double>(count);
+        distribution.maxAbs = std::max(distribution.maxAbs, std::abs(error));
+    }
+    double variance = 0.0;
+    for (double error : p_errors) {
+        variance += (error - distribution.mean) * (error - distribution.mean);
+    }
+    distribution.standardDeviation =
+        (count > 1u) ? std::sqrt(variance / static_cast<double>(count - 1u)) : 0.0;
+
+    // Nearest rank percentiles
+    distribution.low = p_errors[(count * 5u) / 100u];
+    distribution.median = p_errors[count / 2u];
+    distribution.high = p_errors[std::min(count - 1u, (count * 95u) / 100u)];
+    return distribution;
+}
+
+/**
+ * Draw the imperfections of a sensor within its tolerances
+ *
+ * @param p_tolerances Settings, with the bounds of the offset and of the drift
+ * @param p_generator Random generator of the trial
+ * @return Sensor of the trial
+ */
+static SensorModel drawSensor(const SensorModelSettings& p_tolerances,
+                              std::mt19937* p_generator) {
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    SensorModelSettings settings = p_tolerances;
+    settings.offset = p_tolerances.offset * uniform(*p_generator);
+    settings.offsetDrift = p_tolerances.offsetDrift * uniform(*p_generator);
+    return SensorModel(settings, static_cast<uint32_t>((*p_generator)()));
+}
+
+/// Measure the offset of the inspiratory flow meter at rest, as MFM_calibrateZero() on the board
+static void calibrateFlowMeterZero(void) {
+    int32_t zeroFlow = 0;
+    for (int32_t i = 0; i < VOLUME_ACCURACY_ZERO_SAMPLES; i++) {
+        runSimulation(HOST_FLOW_METER_PERIOD_MS * 1000u);
+        zeroFlow += MFM_read_airflow();
+    }
+    zeroFlow /= VOLUME_ACCURACY_ZERO_SAMPLES;
+    if ((zeroFlow < VOLUME_ACCURACY_MAX_ZERO) && (zeroFlow > -VOLUME_ACCURACY_MAX_ZERO)) {
+        setHostFlowMeterOffset(zeroFlow);
+    }
+}
+
+/**
+ * Run a trial in this process
+ *
+ * @param p_settings Session, sensors and trials
+ * @param p_trial Index of the trial, with the seed it gives the random draws
+ * @param p_result Cycles of the trial
+ */
+static void runVolumeAccuracyTrial(const VolumeAccuracySettings& p_settings,
+                                   uint32_t p_trial,
+                                   VolumeAccuracyTrial* p_result) {
+    std::mt19937 generator(p_settings.seed + (p_trial * 7919u));
+    PneumaticPlant& plant = bootSweepBoard(p_settings.session);
+    accuracySensors.pressure = drawSensor(p_settings.pressure, &generator);
+    accuracySensors.inspiratoryFlow = drawSensor(p_settings.inspiratoryFlow, &generator);
+    accuracySensors.expiratoryFlow = drawSensor(p_settings.expiratoryFlow, &generator);
+    plant.setSensors(&accuracySensors);
+
+    runSimulation(1000000u);
+    if (p_settings.zeroCalibration) {
+        calibrateFlowMeterZero();
+    }
+    activationController.onStartButton();
+
+    const MainController& controller = ventilator.mainController;
+    uint32_t measuredCycles = std::min(p_settings.measuredCycles, VOLUME_ACCURACY_MAX_CYCLES);
+    uint32_t lastCycle = p_settings.settlingCycles + measuredCycles;
+    uint32_t cycleNumber = 0u;
+    double volume = 0.0;
+    std::vector<double> pressures;
+    p_result->cycles = 0u;
+    while ((controller.cycleNumber() <= lastCycle) && (p_result->cycles < measuredCycles)) {
+        // The controller reads the volume 100 ms after the end of the inhalation
+        bool volumeRead =
+            controller.tick()
+            > (controller.ticksPerInhalation() + (100u / MAIN_CONTROLLER_COMPUTE_PERIOD_MS));
+        if (!volumeRead) {
+            volume += (plant.inspiratoryFlow() * VOLUME_ACCURACY_SAMPLE_PERIOD_US) / 60000000.0;
+        }
+        runSimulation(VOLUME_ACCURACY_SAMPLE_PERIOD_US);
+
+        if (controller.cycleNumber() != cycleNumber) {
+            // The first respiratory cycle is the number 1
+            if ((cycleNumber > p_settings.settlingCycles) && !pressures.empty()) {
+                double peep = 0.0;
+                size_t peepStart =
+                    pressures.size()
+                    - std::min<size_t>(pressures.size(), VOLUME_ACCURACY_PEEP_SAMPLES);
+                for (size_t i = peepStart; i < pressures.size(); i++) {
+                    peep += pressures[i] / static_cast<double>(pressures.size() - peepStart);
+                }
+                double durationMs =
+                    (pressures.size() * VOLUME_ACCURACY_SAMPLE_PERIOD_US) / 1000.0;
+                double minuteVolume =
+                    static_cast<double>(controller.tidalVolumeMeasure())
+                    * static_cast<double>(controller.cyclesPerMinuteMeasure());
+
+                CycleAccuracy& cycle = p_result->measures[p_result->cycles];
+                cycle.tidalVolume = volume;
+                cycle.tidalVolumeError = controller.tidalVolumeMeasure() - volume;
+                cycle.peepError = controller.peepMeasure() - peep;
+                cycle.minuteVolumeError = minuteVolume - ((volume * 60000.0) / durationMs);
+                p_result->cycles++;
+            }
+            cycleNumber = controller.cycleNumber();
+            volume = 0.0;
+            pressures.clear();
+        }
+        pressures.push_back(plant.airwayPressure());
+    }
+}
+
+VolumeAccuracyReport runVolumeAccuracy(const VolumeAccuracySettings& p_settings,
+                                       uint32_t p_workers) {
+    std::vector<uint8_t> results;
+    bool complete = runWorkerJobs(
+        p_settings.trials, p_workers, sizeof(VolumeAccuracyTrial),
+        [&](size_t p_index, uint8_t* p_result) {
+            VolumeAccuracyTrial trial;
+            runVolumeAccuracyTrial(p_settings, static_cast<uint32_t>(p_index), &trial);
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&trial);
+            std::copy(bytes, bytes + sizeof(trial), p_result);
+        },
+        &results);
+
+    std::vector<double> tidalVolumeErrors;
+    std::vector<double> relativeErrors;
+    std::vector<double> peepErrors;
+    std::vector<double> minuteVolumeErrors;
+    double tidalVolume = 0.0;
+    for (uint32_t i = 0; i < p_settings.trials; i++) {
+        VolumeAccuracyTrial trial;
+        std::copy(&results[i * sizeof(trial)], &results[i * sizeof(trial)] + sizeof(trial),
+                  reinterpret_cast<uint8_t*>(&trial));
+        for (uint32_t j = 0; j < std::min(trial.cycles, VOLUME_ACCURACY_MAX_CYCLES); j++) {
+            const CycleAccuracy& cycle = trial.measures[j];
+            tidalVolume += cycle.tidalVolume;
+            tidalVolumeErrors.push_back(cycle.tidalVolumeError);
+            if (cycle.tidalVolume > 0.0) {
+                relativeErrors.push_back((100.0 * cycle.tidalVolumeError) / cycle.tidalVolume);
+            }
+            peepErrors.push_back(cycle.peepError);
+            minuteVolumeErrors.push_back(cycle.minuteVolumeError);
+        }
+    }
+
+    VolumeAccuracyReport report;
+    report.trials = p_settings.trials;
+    report.complete = complete;
+    report.tidalVolume = tidalVolumeErrors.empty()
+                             ? 0.0
+                             : tidalVolume / static_cast<double>(tidalVolumeErrors.size());
+    report.tidalVolumeError = errorDistribution(tidalVolumeErrors);
+    report.relativeTidalVolumeError = errorDistribution(relativeErrors);
+    report.peepError = errorDistribution(peepErrors);
+    report.minuteVolumeError = errorDistribution(minuteVolumeErrors);
+    return report;
+}
+
+/**
+ * Write a distribution as a line of text
+ *
+ * @param p_name Name of the measure
+ * @param p_unit Unit of the errors
+ * @param p_distribution Distribution of the errors
+ * @param p_output Output
+ */
+static void printErrorDistribution(const char* p_name,
+                                   const char* p_unit,
+                                   const ErrorDistribution& p_distribution,
+                                   FILE* p_output) {
+    fprintf(p_output,
+            "%-22s %-7s %6u %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", p_name, p_unit,
+            p_distribution.samples, p_distribution.mean, p_distribution.standardDeviation,
+            p_distribution.low, p_distribution.median, p_distribution.high,
+            p_distribution.maxAbs);
+}
+
+/**
+ * Write the settings of a sensor as a line of text
+ *
+ * @param p_settings Settings, with the bounds of the offset and of the drift
+ * @param p_unit Unit of the measure
+ * @param p_output Output
+ */
+static void printSensorSettings(const SensorModelSettings& p_settings,
+                                const char* p_unit,
+                                FILE* p_output) {
+    fprintf(p_output, "  %-13s %u bits, noise %.1f %s, offset +/-%.1f %s, drift +/-%.2f %s/s\n",
+            sensorKindName(p_settings.kind), p_settings.bits, p_settings.noise, p_unit,
+            p_settings.offset, p_unit, p_settings.offsetDrift, p_unit);
+}
+
+void printVolumeAccuracyReport(const VolumeAccuracySettings& p_settings,
+                               const VolumeAccuracyReport& p_report,
+                               FILE* p_output) {
+    const SweepSession& session = p_settings.session;
+    fprintf(p_output,
+            "Mode %u, PEEP %d, plateau %d mmH2O, %u cycles/min, %u mL, R %.0f C %.0f, %u trials "
+            "of %u cycles%s\n",
+            session.mode, session.peep, session.plateauPressure, session.cyclesPerMinute,
+            session.tidalVolume, session.lung.resistance, session.lung.compliance,
+            p_report.trials, p_settings.measuredCycles,
+            p_settings.zeroCalibration ? ", flow meter zero calibrated" : "");
+    printSensorSettings(p_settings.pressure, "mmH2O", p_output);
+    printSensorSettings(p_settings.inspiratoryFlow, "mL/min", p_output);
+    printSensorSettings(p_settings.expiratoryFlow, "mL/min", p_output);
+    fprintf(p_output, "True tidal volume %.1f mL\n", p_report.tidalVolume);
+
+    fprintf(p_output, "%-22s %-7s %6s %9s %9s %9s %9s %9s %9s\n", "Measure", "Unit", "Cycles",
+            "Mean", "Std dev", "P5", "Median", "P95", "Max abs");
+    printErrorDistribution("Tidal volume", "mL", p_report.tidalVolumeError, p_output);
+    printErrorDistribution("Tidal volume", "%", p_report.relativeTidalVolumeError, p_output);
+    printErrorDistribution("PEEP", "mmH2O", p_report.peepError, p_output);
+    printErrorDistribution("Minute volume", "mL/min", p_report.minuteVolumeError, p_output);
+    if (!p_report.complete) {
+        fprintf(p_output, "Some trials failed, their cycles are missing\n");
+    }
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+ * @author Makers For Life
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @file volume_accuracy.h
+ * @brief Monte Carlo study of the volume and PEEP measures with imperfect sensors
+ *
+ * Every trial ventilates the simulated lungs of a session with sensors of random offsets and
+ * offset drifts, within the tolerances of the settings, and noisy samples (see sensor_model.h).
+ * The tidal volume, PEEP and minute volume the main controller measures at the end of every cycle
+ * are compared with the truth of the pneumatic plant: the volume that went through the
+ * inspiratory valve until the controller read the flow meter, the mean airway pressure over the
+ * last 100 ms of the cycle, and that volume over the true duration of the cycle. The errors of
+ * every measured cycle of every trial make the distributions of the report.
+ *****************************************************************************/
+
+#pragma once
+
+// INCLUDES ===================================================================
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "sensor_model.h"
+#include "session_sweep.h"
+
+// INITIALISATION =============================================================
+
+/// Maximum number of cycles measured by a trial
+#define VOLUME_ACCURACY_MAX_CYCLES 32u
+
+/// Session, sensors and trials of a study
+struct VolumeAccuracySettings {
+    /// Patient, mode and settings
+    SweepSession session;
+    /// Pressure sensor, the offset and the drift are bounds: every trial draws them uniformly
+    /// between their opposite and them
+    SensorModelSettings pressure;
+    /// Inspiratory flow meter, with bounds of the offset and the drift
+    SensorModelSettings inspiratoryFlow;
+    /// Expiratory flow meter, with bounds of the offset and the drift
+    SensorModelSettings expiratoryFlow;
+    /// Number of trials
+    uint32_t trials;
+    /// Number of cycles run before the measure
+    uint32_t settlingCycles;
+    /// Number of cycles measured, at most VOLUME_ACCURACY_MAX_CYCLES
+    uint32_t measuredCycles;
+    /// Seed of the random draws, a study is reproducible
+    uint32_t seed;
+    /// Measure the offset of the inspiratory flow meter before the start, as MFM_calibrateZero()
+    bool zeroCalibration;
+};
+
+/// Distribution of the errors of a measure
+struct ErrorDistribution {
+    /// Number of errors
+    uint32_t samples;
+    double mean;
+    double standardDeviation;
+    /// 5th percentile
+    double low;
+    double median;
+    /// 95th percentile
+    double high;
+    /// Largest error, in absolute value
+    double maxAbs;
+};
+
+/// Errors of the measures, the measure minus the truth
+struct VolumeAccuracyReport {
+    /// Number of trials run
+    uint32_t trials;
+    /// True if every trial was run
+    bool complete;
+    /// Mean true tidal volume, in mL
+    double tidalVolume;
+    /// Tidal volume errors, in mL
+    ErrorDistribution tidalVolumeError;
+    /// Tidal volume errors, in % of the true tidal volume
+    ErrorDistribution relativeTidalVolumeError;
+    /// PEEP errors, in mmH2O
+    ErrorDistribution peepError;
+    /// Inspiratory minute volume errors, in mL/min
+    ErrorDistribution minuteVolumeError;
+};
+
+// FUNCTIONS ==================================================================
+
+/**
+ * Tolerances of a sensor, from its datasheet
+ *
+ * @param p_kind Sensor
+ * @return Settings, with the bounds of the offset and of the drift
+ */
+SensorModelSettings sensorTolerances(SensorKind p_kind);
+
+/**
+ * Study of a healthy patient in PC_CMV with the default settings and the sensors of the board
+ *
+ * @param p_trials Number of trials
+ * @return Settings of the study
+ */
+VolumeAccuracySettings defaultVolumeAccuracySettings(uint32_t p_trials);
+
+/**
+ * Distribution of errors
+ *
+ * @param p_errors Errors
+ * @return Distribution, of 0 samples and values when there are no errors
+ */
+ErrorDistribution errorDistribution(std::vector<double> p_errors);
+
+/**
+ * Run the trials of a study in worker processes
+ *
+ * @param p_settings Session, sensors and trials
+ * @param p_workers Number of worker processes, 0 for one per CPU core
+ * @return Errors of the measures
+ */
+VolumeAccuracyReport runVolumeAccuracy(const VolumeAccuracySettings& p_settings,
+                                       uint32_t p_workers);
+
+/**
+ * Write a report as text
+ *
+ * @param p_settings Settings of the study
+ * @param p_report Errors of the measures
+ * @param p_output Output
+ */
+void printVolumeAccuracyReport(const VolumeAccuracySettings& p_settings,
+                               const VolumeAccuracyReport& p_report,
+                               FILE* p_output);
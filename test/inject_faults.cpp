@@ -0,0 +1,36 @@
+/******************************************************************************
+ * @file inject_faults.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Sensor, bus and link faults injected into a simulated session
+ *
+ * Usage: inject_faults [ventilation mode, see VentilationModes, PC_CMV by default]
+ *
+ * A healthy patient is ventilated for 80 s with the default settings of the mode while a fault of
+ * every kind is injected (see defaultFaultSchedule()), and the report is written on the output.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "../includes/cycle.h"
+#include "fault_injection.h"
+
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [mode]\n", argv[0]);
+        return 2;
+    }
+    uint16_t mode = PC_CMV;
+    if (argc > 1) {
+        mode = static_cast<uint16_t>(atoi(argv[1]));
+    }
+
+    SweepSession session = defaultSweepSession();
+    session.mode = mode;
+    FaultRunReport report = runFaultSchedule(session, defaultFaultSchedule(), 80000u);
+    printFaultRunReport(report, stdout);
+    return report.stable ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * @file run_eol_test.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief End of line test of a simulated machine, run headless
+ *
+ * Usage: run_eol_test [-u] [-t timeout in s, 300 by default] [-f fault]...
+ *
+ * The operator confirms with the buttons of the front panel, or on the touchscreen of the UI with
+ * -u. Each -f option gives the machine a fault: supply-cable, flat-battery, weak-blower, leak,
+ * jammed-valve, blocked-oxygen, noisy-pressure or missing-flow-meter. The steps the test went
+ * through and its last screen are written on the output, and the exit code is 0 if the machine
+ * passed.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eol_bench.h"
+
+/**
+ * Give a fault to a machine
+ *
+ * @param p_name Name of the fault
+ * @param p_setup Machine under test
+ * @return False if the fault is unknown
+ */
+static bool applyFault(const char* p_name, EolBenchSetup* p_setup) {
+    bool known = true;
+    if (strcmp(p_name, "supply-cable") == 0) {
+        p_setup->supplyCablePlugged = false;
+    } else if (strcmp(p_name, "flat-battery") == 0) {
+        p_setup->batteryVoltage = 21.0;
+    } else if (strcmp(p_name, "weak-blower") == 0) {
+        p_setup->blowerEfficiency = 0.85;
+    } else if (strcmp(p_name, "leak") == 0) {
+        p_setup->leakSectionX100 = 100;
+    } else if (strcmp(p_name, "jammed-valve") == 0) {
+        p_setup->expiratoryValveJammed = true;
+    } else if (strcmp(p_name, "blocked-oxygen") == 0) {
+        p_setup->oxygenFlow = 0.0;
+    } else if (strcmp(p_name, "noisy-pressure") == 0) {
+        p_setup->pressureNoise = 15.0;
+    } else if (strcmp(p_name, "missing-flow-meter") == 0) {
+        p_setup->flowMeterMissing = true;
+    } else {
+        known = false;
+    }
+    return known;
+}
+
+int main(int argc, char** argv) {
+    EolBenchSetup setup = healthyEolBench();
+    uint32_t timeoutS = 300u;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-u") == 0) {
+            setup.confirmation = EOL_CONFIRM_ON_UI;
+        } else if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc)) {
+            i++;
+            timeoutS = static_cast<uint32_t>(atoi(argv[i]));
+        } else if ((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc)) {
+            i++;
+            valid = valid && applyFault(argv[i], &setup);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Usage: %s [-u] [-t timeout] [-f fault]...\n", argv[0]);
+        return 2;
+    }
+
+    EolBenchReport report = runEolBench(setup, timeoutS * 1000u);
+    printEolBenchReport(report, stdout);
+    return (report.state == STATE_SUCCESS) ? 0 : 1;
+}
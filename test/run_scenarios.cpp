@@ -0,0 +1,73 @@
+/******************************************************************************
+ * @file run_scenarios.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Runner of scenario files
+ *
+ * Usage: run_scenarios [-j workers, one per CPU core by default] [-o JUnit report]
+ * <scenario files>
+ *
+ * The scenarios (see host/scenario.h for the format) run in worker processes. A line per
+ * scenario, and one per failed expectation, is written on the output, and the exit code is 1 if
+ * any scenario failed.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "scenario.h"
+
+int main(int argc, char** argv) {
+    uint32_t workers = 0u;
+    const char* reportPath = nullptr;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-j") == 0) && ((i + 1) < argc)) {
+            i++;
+            workers = static_cast<uint32_t>(atoi(argv[i]));
+        } else if ((strcmp(argv[i], "-o") == 0) && ((i + 1) < argc)) {
+            i++;
+            reportPath = argv[i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "Usage: %s [-j workers] [-o report.xml] <scenario files>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<ScenarioResult> results = runScenarioFiles(paths, workers);
+    uint32_t failed = 0u;
+    for (const ScenarioResult& result : results) {
+        bool passed = scenarioPassed(result);
+        failed += passed ? 0u : 1u;
+        printf("%s %s (%zu expectations, %.1f s)\n", passed ? "PASS" : "FAIL",
+               result.name.c_str(), result.checks.size(), result.durationS);
+        if (!result.error.empty()) {
+            printf("  %s\n", result.error.c_str());
+        }
+        for (const ScenarioCheckResult& check : result.checks) {
+            if (!check.passed) {
+                printf("  line %u: %s: %s\n", check.line, check.text.c_str(),
+                       check.message.c_str());
+            }
+        }
+    }
+    printf("%zu scenarios, %u failed\n", results.size(), failed);
+
+    if (reportPath != nullptr) {
+        FILE* report = fopen(reportPath, "w");
+        if (report == nullptr) {
+            fprintf(stderr, "Cannot write %s\n", reportPath);
+            return 1;
+        }
+        writeJUnitReport(results, report);
+        (void)fclose(report);
+    }
+    return (failed == 0u) ? 0 : 1;
+}
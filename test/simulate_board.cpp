@@ -0,0 +1,112 @@
+/******************************************************************************
+ * @file simulate_board.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Simulated board with its telemetry serial link on a pseudo-terminal
+ *
+ * Usage: simulate_board [-s speed, 1 for real time by default, 0 as fast as possible]
+ * [-d duration in s, until interrupted by default] [ventilation mode, PC_CMV by default]
+ *
+ * The firmware ventilates a healthy patient, breathing stopped, and the path of the terminal is
+ * written on the first line of the output: the control UI, or ui_stand_in, opens it to talk to the
+ * firmware as it would to the board. The changes of the power of the Raspberry Pi, switched by
+ * the RPi watchdog, are written as they happen, and the traffic of the link at the end.
+ *****************************************************************************/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/timebase.h"
+#include "simulator.h"
+#include "ui_link.h"
+
+/// Period of the simulation steps and of the link exchanges, in µs
+#define SIMULATE_BOARD_STEP_US 1000u
+
+/// Set when the process is interrupted
+static volatile sig_atomic_t interrupted = 0;
+
+/// End the simulation on an interruption
+static void onInterrupt(int p_signal) {
+    (void)p_signal;
+    interrupted = 1;
+}
+
+/// Wall clock, in µs
+static uint64_t wallMicros() {
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<uint64_t>(now.tv_sec) * 1000000u)
+           + (static_cast<uint64_t>(now.tv_nsec) / 1000u);
+}
+
+int main(int argc, char** argv) {
+    double speed = 1.0;
+    double durationS = 0.0;
+    uint16_t mode = PC_CMV;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc)) {
+            i++;
+            speed = atof(argv[i]);
+        } else if ((strcmp(argv[i], "-d") == 0) && ((i + 1) < argc)) {
+            i++;
+            durationS = atof(argv[i]);
+        } else if (argv[i][0] != '-') {
+            mode = static_cast<uint16_t>(atoi(argv[i]));
+        } else {
+            fprintf(stderr, "Usage: %s [-s speed] [-d duration] [mode]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    SweepSession session = defaultSweepSession();
+    session.mode = mode;
+    (void)bootLinkedBoard(session);
+
+    PtyLink link;
+    if (!link.open()) {
+        fprintf(stderr, "Cannot create a pseudo-terminal\n");
+        return 1;
+    }
+    printf("%s\n", link.devicePath().c_str());
+    (void)fflush(stdout);
+
+    (void)signal(SIGINT, &onInterrupt);
+    (void)signal(SIGTERM, &onInterrupt);
+
+    uint64_t endUs = static_cast<uint64_t>(durationS * 1000000.0);
+    uint64_t wallStartUs = wallMicros();
+    bool raspberryPowered = hostRaspberryPowered();
+    while ((interrupted == 0) && ((endUs == 0u) || (monotonicMicros() < endUs))) {
+        runSimulation(SIMULATE_BOARD_STEP_US);
+        link.exchange(SIMULATE_BOARD_STEP_US);
+
+        if (hostRaspberryPowered() != raspberryPowered) {
+            raspberryPowered = hostRaspberryPowered();
+            printf("Raspberry Pi switched %s at %.1f s\n", raspberryPowered ? "on" : "off",
+                   static_cast<double>(monotonicMicros()) / 1000000.0);
+            (void)fflush(stdout);
+        }
+
+        if (speed > 0.0) {
+            uint64_t dueUs =
+                wallStartUs + static_cast<uint64_t>(static_cast<double>(monotonicMicros()) / speed);
+            uint64_t nowUs = wallMicros();
+            if (dueUs > nowUs) {
+                (void)usleep(static_cast<useconds_t>(dueUs - nowUs));
+            }
+        }
+    }
+
+    printf("Sent %llu bytes, received %llu bytes, largest backlog %zu bytes in %.1f s\n",
+           static_cast<unsigned long long>(link.bytesSent()),
+           static_cast<unsigned long long>(link.bytesReceived()), link.maxBacklog(),
+           static_cast<double>(monotonicMicros()) / 1000000.0);
+    return 0;
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * @file study_volume_accuracy.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Monte Carlo study of the volume and PEEP measures with imperfect sensors
+ *
+ * Usage: study_volume_accuracy [trials, 100 by default] [inspiratory flow meter, haf or sfm3019,
+ * the one of the board by default] [workers, one per CPU core by default]
+ *
+ * A healthy patient is ventilated in PC_CMV with the default settings, and the sensors have the
+ * tolerances of their datasheets (see sensorTolerances()). The distributions of the errors of the
+ * tidal volume, PEEP and minute volume measures are written on the output.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "volume_accuracy.h"
+
+int main(int argc, char** argv) {
+    if (argc > 4) {
+        fprintf(stderr, "Usage: %s [trials] [haf|sfm3019] [workers]\n", argv[0]);
+        return 2;
+    }
+    uint32_t trials = (argc > 1) ? static_cast<uint32_t>(atoi(argv[1])) : 100u;
+    uint32_t workers = (argc > 3) ? static_cast<uint32_t>(atoi(argv[3])) : 0u;
+
+    VolumeAccuracySettings settings = defaultVolumeAccuracySettings(trials);
+    if (argc > 2) {
+        if (strcmp(argv[2], "haf") == 0) {
+            settings.inspiratoryFlow = sensorTolerances(SENSOR_HONEYWELL_HAF);
+        } else if (strcmp(argv[2], "sfm3019") == 0) {
+            settings.inspiratoryFlow = sensorTolerances(SENSOR_SFM3019);
+        } else {
+            fprintf(stderr, "Unknown flow meter %s\n", argv[2]);
+            return 2;
+        }
+    }
+
+    VolumeAccuracyReport report = runVolumeAccuracy(settings, workers);
+    printVolumeAccuracyReport(settings, report, stdout);
+    return report.complete ? 0 : 1;
+}
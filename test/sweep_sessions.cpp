@@ -0,0 +1,63 @@
+/******************************************************************************
+ * @file sweep_sessions.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Sweep of simulated ventilation sessions over the settings ranges of parameters.h
+ *
+ * Usage: sweep_sessions <results.csv> [steps per setting axis, 5 by default] [workers, one per
+ * CPU core by default]
+ *
+ * The results file has one line per session: its mode, settings and patient, then its metrics
+ * (see SessionMetrics).
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "session_sweep.h"
+
+int main(int argc, char** argv) {
+    if ((argc < 2) || (argc > 4)) {
+        fprintf(stderr, "Usage: %s <results.csv> [steps] [workers]\n", argv[0]);
+        return 2;
+    }
+    uint16_t steps = (argc > 2) ? static_cast<uint16_t>(atoi(argv[2])) : 5u;
+    uint32_t workers = (argc > 3) ? static_cast<uint32_t>(atoi(argv[3])) : 0u;
+
+    SweepRanges ranges = defaultSweepRanges(steps);
+    std::vector<SweepSession> sessions = sweepSessions(ranges);
+    fprintf(stderr, "Running %zu sessions\n", sessions.size());
+
+    time_t start = time(nullptr);
+    std::vector<SessionMetrics> metrics;
+    bool success =
+        runSessionSweep(sessions, ranges.settlingCycles, ranges.measuredCycles, workers, &metrics);
+
+    FILE* results = fopen(argv[1], "w");
+    if (results == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(results,
+            "mode,peep,plateauPressure,cyclesPerMinute,tidalVolume,resistance,compliance,cycles,"
+            "riseTimeMs,overshoot,plateauError,peepError,measuredTidalVolume,tidalVolumeError,"
+            "alarms,convergenceCycles\n");
+    for (size_t i = 0; i < sessions.size(); i++) {
+        const SweepSession& session = sessions[i];
+        const SessionMetrics& measures = metrics[i];
+        fprintf(results, "%u,%d,%d,%u,%u,%.1f,%.1f,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u\n",
+                session.mode, session.peep, session.plateauPressure, session.cyclesPerMinute,
+                session.tidalVolume, session.lung.resistance, session.lung.compliance,
+                measures.cycles, measures.riseTimeMs, measures.overshoot, measures.plateauError,
+                measures.peepError, measures.tidalVolume, measures.tidalVolumeError,
+                measures.alarms, measures.convergenceCycles);
+    }
+    (void)fclose(results);
+
+    fprintf(stderr, "%zu sessions in %ld s%s\n", sessions.size(),
+            static_cast<long>(time(nullptr) - start), success ? "" : ", some of them failed");
+    return success ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * @file test_checkpoint.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the checkpoint and restore of the runtime state
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "../includes/activation.h"
+#include "../includes/checkpoint.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/parameters.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "session_sweep.h"
+#include "simulator.h"
+
+/// What the board did during a stretch of a session, sampled every ms
+struct SessionTrace {
+    std::vector<uint16_t> blowerPulses;
+    std::vector<uint16_t> inspiratoryValvePulses;
+    std::vector<uint16_t> expiratoryValvePulses;
+    std::vector<int16_t> pressures;
+    std::vector<uint32_t> cycles;
+};
+
+/// Run a session and sample its actuators and measures
+static SessionTrace runTrace(uint32_t p_durationMs) {
+    SessionTrace trace;
+    for (uint32_t i = 0; i < p_durationMs; i++) {
+        runSimulation(1000u);
+        trace.blowerPulses.push_back(hostPwmOutputPulse(HAL_PWM_BLOWER));
+        trace.inspiratoryValvePulses.push_back(hostPwmOutputPulse(HAL_PWM_INSPIRATORY_VALVE));
+        trace.expiratoryValvePulses.push_back(hostPwmOutputPulse(HAL_PWM_EXPIRATORY_VALVE));
+        trace.pressures.push_back(ventilator.mainController.pressure());
+        trace.cycles.push_back(ventilator.mainController.cycleNumber());
+    }
+    return trace;
+}
+
+/// Boot a healthy session, start it and run it to the middle of an inhalation
+static PneumaticPlant& warmUp() {
+    PneumaticPlant& plant = bootSweepBoard(defaultSweepSession());
+    runSimulation(1000000u);
+    activationController.onStartButton();
+    runSimulation(12000000u);
+    while ((ventilator.mainController.phase() != CyclePhases::INHALATION)
+           || (ventilator.mainController.tick() < (ventilator.mainController.ticksPerInhalation()
+                                                   / 2u))) {
+        runSimulation(1000u);
+    }
+    return plant;
+}
+
+TEST(CheckpointArchiveTest, membersAreSavedInBigEndianAndRestored) {
+    bool flag = true;
+    int8_t small = -2;
+    uint16_t word = 0x1234u;
+    int32_t negative = -5;
+    uint64_t date = 0x0102030405060708u;
+    int16_t ring[3] = {1, -1, 300};
+    CyclePhases phase = CyclePhases::EXHALATION;
+
+    uint8_t data[32];
+    CheckpointArchive saving(data, sizeof(data));
+    saving.field(flag);
+    saving.field(small);
+    saving.field(word);
+    saving.field(negative);
+    saving.field(date);
+    saving.field(ring);
+    saving.enumField(phase);
+    ASSERT_FALSE(saving.overflowed());
+    EXPECT_EQ(26u, saving.size());
+    EXPECT_EQ(0x01u, data[0]);
+    EXPECT_EQ(0xFEu, data[1]);
+    EXPECT_EQ(0x12u, data[2]);
+    EXPECT_EQ(0x34u, data[3]);
+    EXPECT_EQ(0xFFu, data[4]);
+    EXPECT_EQ(0xFBu, data[7]);
+    EXPECT_EQ(0x01u, data[8]);
+    EXPECT_EQ(0x08u, data[15]);
+
+    bool restoredFlag = false;
+    int8_t restoredSmall = 0;
+    uint16_t restoredWord = 0u;
+    int32_t restoredNegative = 0;
+    uint64_t restoredDate = 0u;
+    int16_t restoredRing[3] = {0, 0, 0};
+    CyclePhases restoredPhase = CyclePhases::INHALATION;
+    CheckpointArchive restoring(static_cast<const uint8_t*>(data), saving.size());
+    restoring.field(restoredFlag);
+    restoring.field(restoredSmall);
+    restoring.field(restoredWord);
+    restoring.field(restoredNegative);
+    restoring.field(restoredDate);
+    restoring.field(restoredRing);
+    restoring.enumField(restoredPhase);
+    EXPECT_FALSE(restoring.overflowed());
+    EXPECT_TRUE(restoredFlag);
+    EXPECT_EQ(-2, restoredSmall);
+    EXPECT_EQ(0x1234u, restoredWord);
+    EXPECT_EQ(-5, restoredNegative);
+    EXPECT_EQ(date, restoredDate);
+    EXPECT_EQ(-1, restoredRing[1]);
+    EXPECT_EQ(300, restoredRing[2]);
+    EXPECT_EQ(CyclePhases::EXHALATION, restoredPhase);
+}
+
+TEST(CheckpointArchiveTest, membersPastTheEndAreNotCopied) {
+    uint8_t data[3] = {0xAAu, 0xAAu, 0xAAu};
+    uint32_t value = 7u;
+    uint16_t word = 0x0102u;
+    CheckpointArchive saving(data, sizeof(data));
+    saving.field(word);
+    saving.field(value);
+    EXPECT_TRUE(saving.overflowed());
+    EXPECT_EQ(0xAAu, data[2]);
+
+    CheckpointArchive restoring(static_cast<const uint8_t*>(data), sizeof(data));
+    restoring.field(word);
+    restoring.field(value);
+    EXPECT_TRUE(restoring.overflowed());
+    EXPECT_EQ(7u, value);
+}
+
+TEST(CheckpointTest, onlyACompleteCheckpointOfThisVersionIsRestored) {
+    bootSweepBoard(defaultSweepSession());
+    std::vector<uint8_t> checkpoint(checkpointSize());
+    EXPECT_EQ(0u, saveCheckpoint(checkpoint.data(), checkpoint.size() - 1u));
+    ASSERT_EQ(checkpoint.size(), saveCheckpoint(checkpoint.data(), checkpoint.size()));
+    EXPECT_EQ(0x4Du, checkpoint[0]);
+
+    ventilator.mainController.onPeepSet(100);
+    std::vector<uint8_t> otherVersion = checkpoint;
+    otherVersion[5]++;
+    EXPECT_FALSE(restoreCheckpoint(otherVersion.data(), otherVersion.size()));
+    EXPECT_FALSE(restoreCheckpoint(checkpoint.data(), checkpoint.size() - 1u));
+    EXPECT_EQ(100, ventilator.mainController.peepNextCommand());
+
+    EXPECT_TRUE(restoreCheckpoint(checkpoint.data(), checkpoint.size()));
+    EXPECT_EQ(DEFAULT_PEEP_COMMAND, ventilator.mainController.peepNextCommand());
+}
+
+TEST(CheckpointTest, aContextIsRestoredInAnotherOne) {
+    warmUp();
+    std::unique_ptr<VentilatorContext> other(new VentilatorContext());
+    std::vector<uint8_t> data(checkpointSize());
+    CheckpointArchive saving(data.data(), data.size());
+    ventilator.checkpoint(&saving);
+
+    CheckpointArchive restoring(static_cast<const uint8_t*>(data.data()), saving.size());
+    other->checkpoint(&restoring);
+
+    EXPECT_EQ(saving.size(), restoring.size());
+    EXPECT_EQ(ventilator.mainController.cycleNumber(), other->mainController.cycleNumber());
+    EXPECT_EQ(ventilator.mainController.tick(), other->mainController.tick());
+    EXPECT_EQ(ventilator.mainController.phase(), other->mainController.phase());
+    EXPECT_EQ(ventilator.mainController.peepMeasure(), other->mainController.peepMeasure());
+    EXPECT_EQ(ventilator.blower.getSpeed(), other->blower.getSpeed());
+    EXPECT_EQ(ventilator.inspiratoryValve.command, other->inspiratoryValve.command);
+    // The controller in use is the one of the same mode, in the context it was restored in
+    EXPECT_EQ(&other->pcCmvController, other->mainController.ventilationControllerNextCommand());
+}
+
+TEST(CheckpointTest, aRestoredSessionRunsAgainBitForBit) {
+    PneumaticPlant& plant = warmUp();
+    std::vector<uint8_t> checkpoint = saveSimulation();
+    PneumaticPlant savedPlant = plant;
+    uint64_t date = monotonicMicros();
+
+    SessionTrace first = runTrace(8000u);
+
+    plant = savedPlant;
+    ASSERT_TRUE(restoreSimulation(checkpoint));
+    EXPECT_EQ(date, monotonicMicros());
+    SessionTrace second = runTrace(8000u);
+
+    EXPECT_EQ(first.blowerPulses, second.blowerPulses);
+    EXPECT_EQ(first.inspiratoryValvePulses, second.inspiratoryValvePulses);
+    EXPECT_EQ(first.expiratoryValvePulses, second.expiratoryValvePulses);
+    EXPECT_EQ(first.pressures, second.pressures);
+    EXPECT_EQ(first.cycles, second.cycles);
+    EXPECT_GT(first.cycles.back(), first.cycles.front());
+}
+
+TEST(CheckpointTest, warmUpIsBranchedInWorkers) {
+    PneumaticPlant& plant = warmUp();
+    std::vector<uint8_t> checkpoint = saveSimulation();
+    PneumaticPlant savedPlant = plant;
+    const int16_t peeps[] = {50, 80, 120};
+
+    std::vector<uint8_t> results;
+    bool complete = runWorkerJobs(
+        3u, 2u, sizeof(int16_t),
+        [&](size_t p_index, uint8_t* p_result) {
+            plant = savedPlant;
+            (void)restoreSimulation(checkpoint);
+            ventilator.mainController.onPeepSet(peeps[p_index]);
+            uint32_t lastCycle = ventilator.mainController.cycleNumber() + 8u;
+            while (ventilator.mainController.cycleNumber() < lastCycle) {
+                runSimulation(1000u);
+            }
+            int16_t peep = ventilator.mainController.peepMeasure();
+            memcpy(p_result, &peep, sizeof(peep));
+        },
+        &results);
+
+    ASSERT_TRUE(complete);
+    for (size_t i = 0; i < 3u; i++) {
+        int16_t peep = 0;
+        memcpy(&peep, &results[i * sizeof(int16_t)], sizeof(peep));
+        EXPECT_NEAR(peeps[i], peep, 20) << "branch " << i;
+    }
+}
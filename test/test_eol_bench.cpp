@@ -0,0 +1,139 @@
+/******************************************************************************
+ * @file test_eol_bench.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the end of line test of a simulated machine
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+
+#include "eol_bench.h"
+
+/// Longest simulated duration of a run, in ms
+#define EOL_BENCH_TEST_TIMEOUT_MS 300000u
+
+/// Run the end of line test of a machine
+static EolBenchReport run(const EolBenchSetup& p_setup) {
+    return runEolBench(p_setup, EOL_BENCH_TEST_TIMEOUT_MS);
+}
+
+/// Check that a run failed at a step, and that the UI was told
+static void expectFailure(const EolBenchReport& p_report, TestStep p_step) {
+    EXPECT_EQ(STATE_ERROR, p_report.state);
+    EXPECT_STREQ(eolStepName(p_step), eolStepName(p_report.step));
+    EXPECT_EQ(p_step, p_report.snapshotStep);
+    EXPECT_LT(p_report.durationS, 80.0);
+}
+
+TEST(EolBenchTest, healthyMachinePassesWithButtons) {
+    EolBenchReport report = run(healthyEolBench());
+
+    EXPECT_EQ(STATE_SUCCESS, report.state);
+    EXPECT_EQ(DISPLAY_FLOW, report.step);
+    EXPECT_EQ(DISPLAY_FLOW, report.snapshotStep);
+    EXPECT_TRUE(report.buzzerChecked);
+    EXPECT_GT(report.snapshots, 100u);
+
+    // Every step is gone through, in order
+    const TestStep expected[] = {START,
+                                 CHECK_FAN,
+                                 TEST_BAT_DEAD,
+                                 DISCONNECT_MAINS,
+                                 TEST_BAT_DEAD,
+                                 CONNECT_MAINS,
+                                 CHECK_BUZZER,
+                                 CHECK_ALL_BUTTONS,
+                                 CHECK_UI_SCREEN,
+                                 PLUG_AIR_TEST_SYTEM,
+                                 REACH_MAX_PRESSURE,
+                                 MAX_PRESSURE_REACHED_OK,
+                                 START_LEAK_MESURE,
+                                 REACH_NULL_PRESSURE,
+                                 USER_CONFIRMATION_BEFORE_O2_TEST,
+                                 START_O2_TEST,
+                                 WAIT_USER_BEFORE_LONG_RUN,
+                                 START_LONG_RUN_BLOWER,
+                                 END_SUCCESS,
+                                 DISPLAY_PRESSURE,
+                                 DISPLAY_FLOW};
+    ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), report.steps.size());
+    EXPECT_TRUE(std::equal(report.steps.begin(), report.steps.end(), expected));
+}
+
+TEST(EolBenchTest, healthyMachinePassesOnTheUi) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.confirmation = EOL_CONFIRM_ON_UI;
+    EolBenchReport report = run(setup);
+
+    EXPECT_EQ(STATE_SUCCESS, report.state);
+    EXPECT_EQ(DISPLAY_FLOW, report.step);
+    EXPECT_TRUE(report.buzzerChecked);
+}
+
+TEST(EolBenchTest, unpluggedSupplyCableFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.supplyCablePlugged = false;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, SUPPLY_TO_EXPANDER_NOT_CONNECTED);
+}
+
+TEST(EolBenchTest, flatBatteryFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.batteryVoltage = 21.0;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, BATTERY_DEEP_DISCHARGE);
+}
+
+TEST(EolBenchTest, weakBlowerFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.blowerEfficiency = 0.85;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, MAX_PRESSURE_NOT_REACHED);
+}
+
+TEST(EolBenchTest, leakyPipesFail) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.leakSectionX100 = 100;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, LEAK_IS_TOO_HIGH);
+    EXPECT_NE(std::string::npos, report.screen.find("Leak"));
+}
+
+TEST(EolBenchTest, jammedExpiratoryValveFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.expiratoryValveJammed = true;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, MIN_PRESSURE_NOT_REACHED);
+}
+
+TEST(EolBenchTest, blockedOxygenFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.oxygenFlow = 0.0;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, O2_PRESSURE_NOT_REACH);
+}
+
+TEST(EolBenchTest, noisyPressureSensorFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.pressureNoise = 15.0;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, PRESSURE_NOT_STABLE);
+}
+
+TEST(EolBenchTest, missingFlowMeterFails) {
+    EolBenchSetup setup = healthyEolBench();
+    setup.flowMeterMissing = true;
+    EolBenchReport report = run(setup);
+
+    expectFailure(report, FLOW_NOT_STABLE);
+}
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * @file test_fault_injection.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the faults injected into simulated sessions
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../includes/alarm_controller.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/mass_flow_meter.h"
+#include "../includes/parameters.h"
+#include "fault_injection.h"
+#include "host_board.h"
+#include "simulator.h"
+
+/// Schedule of a single fault starting at 10 s
+static std::vector<ScheduledFault> singleFault(FaultKind p_kind,
+                                               uint32_t p_durationMs,
+                                               HostFlowMeter p_flowMeter,
+                                               uint16_t p_batteryAdc) {
+    ScheduledFault fault = {p_kind, 10000u, p_durationMs, p_flowMeter, p_batteryAdc};
+    return std::vector<ScheduledFault>(1u, fault);
+}
+
+/// Run the flow meter acquisition until its fault condition changes
+static uint32_t flowMeterPeriodsUntil(bool p_faultCondition) {
+    uint32_t periods = 0u;
+    while ((hostFlowMeterFaultCondition() != p_faultCondition) && (periods < 100u)) {
+        runSimulation(HOST_FLOW_METER_PERIOD_MS * 1000u);
+        periods++;
+    }
+    return periods;
+}
+
+class FlowMeterBusTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() {
+        resetSimulation(0u);
+        (void)MFM_init();
+        setHostFlows(30000, -20000);
+        runSimulation(100000u);
+    }
+};
+
+TEST_F(FlowMeterBusTest, inspiratoryNackIsAFaultAtTheFirstRead) {
+    EXPECT_FALSE(hostFlowMeterFaultCondition());
+
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_NACK);
+    EXPECT_EQ(1u, flowMeterPeriodsUntil(true));
+    EXPECT_EQ(MASS_FLOW_ERROR_VALUE, MFM_read_airflow());
+    EXPECT_EQ(MASS_FLOW_ERROR_VALUE, MFM_read_milliliters(false));
+}
+
+TEST_F(FlowMeterBusTest, resetSequenceTakesThirteenPeriods) {
+    int32_t flow = MFM_read_airflow();
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_NACK);
+    ASSERT_EQ(1u, flowMeterPeriodsUntil(true));
+
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_ANSWERS);
+    EXPECT_EQ(13u, flowMeterPeriodsUntil(false));
+    EXPECT_EQ(flow, MFM_read_airflow());
+}
+
+TEST_F(FlowMeterBusTest, resetSequencePowersTheFlowMetersOffUntilTheWarmUp) {
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_NACK);
+    ASSERT_EQ(1u, flowMeterPeriodsUntil(true));
+    EXPECT_TRUE(hostFlowMeterPowered());
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_ANSWERS);
+
+    // Powered off on the first period of the sequence, on again 8 periods before its end
+    uint32_t periodsOff = 0u;
+    for (uint32_t i = 0u; i < 13u; i++) {
+        runSimulation(HOST_FLOW_METER_PERIOD_MS * 1000u);
+        periodsOff += hostFlowMeterPowered() ? 0u : 1u;
+    }
+    EXPECT_EQ(4u, periodsOff);
+    EXPECT_TRUE(hostFlowMeterPowered());
+    EXPECT_FALSE(hostFlowMeterFaultCondition());
+}
+
+TEST_F(FlowMeterBusTest, resetSequenceStartsAgainWhileTheBusFails) {
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_SHORT_READ);
+    ASSERT_EQ(1u, flowMeterPeriodsUntil(true));
+
+    // The serial number reads fail, the sequence never ends
+    runSimulation(1000000u);
+    EXPECT_TRUE(hostFlowMeterFaultCondition());
+
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_ANSWERS);
+    uint32_t periods = flowMeterPeriodsUntil(false);
+    EXPECT_GE(periods, 1u);
+    EXPECT_LE(periods, 13u);
+}
+
+TEST_F(FlowMeterBusTest, expiratoryShortReadsAreAFaultAfterThirteenReads) {
+    setHostFlowMeterBus(HOST_EXPIRATORY_FLOW_METER, HOST_FLOW_METER_SHORT_READ);
+    EXPECT_EQ(13u, flowMeterPeriodsUntil(true));
+    EXPECT_EQ(MASS_FLOW_ERROR_VALUE, MFM_expi_read_airflow());
+}
+
+TEST_F(FlowMeterBusTest, spuriousValuesAreDropped) {
+    int32_t flow = MFM_read_airflow();
+    setHostFlowMeterBus(HOST_INSPIRATORY_FLOW_METER, HOST_FLOW_METER_SPURIOUS_VALUE);
+    runSimulation(100000u);
+
+    EXPECT_FALSE(hostFlowMeterFaultCondition());
+    EXPECT_EQ(flow, MFM_read_airflow());
+}
+
+TEST(FaultInjectionTest, flowMetersRecoverWithinTheResetSequence) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_FLOW_METER_NACK, 1000u, HOST_INSPIRATORY_FLOW_METER, 0u), 20000u);
+    ASSERT_EQ(1u, report.faults.size());
+
+    const FaultReport& fault = report.faults[0];
+    EXPECT_GE(fault.flowMeterFaultMs, 0);
+    EXPECT_LE(fault.flowMeterFaultMs, 10);
+    EXPECT_GE(fault.flowMeterRecoveryMs, 0);
+    EXPECT_LE(fault.flowMeterRecoveryMs, 130);
+    EXPECT_TRUE(report.stable);
+}
+
+TEST(FaultInjectionTest, expiratoryShortReadsNeedThirteenReads) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_FLOW_METER_SHORT_READ, 1000u, HOST_EXPIRATORY_FLOW_METER, 0u), 20000u);
+
+    const FaultReport& fault = report.faults[0];
+    EXPECT_GE(fault.flowMeterFaultMs, 120);
+    EXPECT_LE(fault.flowMeterFaultMs, 130);
+    EXPECT_NE(FAULT_NOT_SEEN, fault.flowMeterRecoveryMs);
+    EXPECT_TRUE(report.stable);
+}
+
+TEST(FaultInjectionTest, batteryDroopFiresTheBatteryAlarmsInOrder) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_BATTERY_DROOP, 3000u, HOST_INSPIRATORY_FLOW_METER, 2900u), 20000u);
+
+    const std::vector<FaultAlarm>& alarms = report.faults[0].alarms;
+    ASSERT_EQ(3u, alarms.size());
+    // Unplugged mains are seen by the next battery task, the low voltages after the mean of the
+    // samples falls below their thresholds
+    EXPECT_EQ(RCM_SW_16, alarms[0].code);
+    EXPECT_LE(alarms[0].latencyMs, 10u);
+    EXPECT_EQ(RCM_SW_11, alarms[1].code);
+    EXPECT_EQ(RCM_SW_12, alarms[2].code);
+    EXPECT_LT(alarms[1].latencyMs, alarms[2].latencyMs);
+    EXPECT_LT(alarms[2].latencyMs, 3000u);
+    EXPECT_TRUE(report.stable);
+}
+
+TEST(FaultInjectionTest, shortAdcDropoutIsFiltered) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_BATTERY_SPIKE, 30u, HOST_INSPIRATORY_FLOW_METER, 0u), 20000u);
+
+    EXPECT_TRUE(report.faults[0].alarms.empty());
+    EXPECT_TRUE(report.stable);
+}
+
+TEST(FaultInjectionTest, longAdcDropoutLetsTheWatchdogReset) {
+    // The mean voltage falls below the stop threshold, even with the mains plugged
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_BATTERY_SPIKE, 1000u, HOST_INSPIRATORY_FLOW_METER, 0u), 20000u);
+
+    EXPECT_TRUE(report.faults[0].alarms.empty());
+    EXPECT_GE(report.watchdogResets, 1u);
+    EXPECT_FALSE(report.stable);
+}
+
+TEST(FaultInjectionTest, corruptedFramesAreDiscarded) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_CORRUPTED_FRAME, 1000u, HOST_INSPIRATORY_FLOW_METER, 0u), 15000u);
+
+    const FaultReport& fault = report.faults[0];
+    EXPECT_EQ(10u, fault.framesSent);
+    EXPECT_EQ(0u, fault.framesLost);
+    EXPECT_EQ(0u, fault.damagedFramesApplied);
+    EXPECT_EQ(0, fault.linkRecoveryMs);
+}
+
+TEST(FaultInjectionTest, truncatedFramesTakeTheNextFrameWithThem) {
+    FaultRunReport report = runFaultSchedule(
+        defaultSweepSession(),
+        singleFault(FAULT_TRUNCATED_FRAME, 1000u, HOST_INSPIRATORY_FLOW_METER, 0u), 15000u);
+
+    // The rest of a truncated frame is read from the next frame, that is then lost
+    const FaultReport& fault = report.faults[0];
+    EXPECT_EQ(10u, fault.framesSent);
+    EXPECT_EQ(fault.framesSent, fault.framesLost);
+    EXPECT_EQ(0u, fault.damagedFramesApplied);
+    EXPECT_EQ(0, fault.linkRecoveryMs);
+}
+
+TEST(FaultInjectionTest, defaultScheduleKeepsTheControlStable) {
+    std::vector<ScheduledFault> schedule = defaultFaultSchedule();
+    FaultRunReport report = runFaultSchedule(defaultSweepSession(), schedule, 80000u);
+
+    ASSERT_EQ(schedule.size(), report.faults.size());
+    EXPECT_TRUE(report.stable);
+    EXPECT_EQ(0u, report.watchdogResets);
+    EXPECT_LT(report.maxPlateauError, 20.0);
+    EXPECT_LT(report.maxPeepError, 20.0);
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * @file test_golden_trace.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Regression tests of the controller outputs against golden traces
+ *
+ * Run with the GOLDEN_TRACE_UPDATE environment variable set to write the traces of the current
+ * code as the new golden traces, after checking that the change of control behaviour is wanted.
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <map>
+#include <ostream>
+#include <set>
+#include <utility>
+#include <string>
+#include <vector>
+
+#include "golden_trace.h"
+
+/// Number of respiratory cycles traced by every scenario
+#define GOLDEN_TRACE_CYCLES 3u
+
+/// Print a scenario by its name in the test reports
+void PrintTo(const GoldenScenario& p_scenario, std::ostream* p_stream) {
+    *p_stream << p_scenario.name;
+}
+
+/// Values of the settings of a scenario: PEEP, plateau pressure, rate and tidal volume
+static std::vector<int32_t> settingsOf(const GoldenScenario& p_scenario) {
+    return {p_scenario.peep, p_scenario.plateauPressure, p_scenario.cyclesPerMinute,
+            p_scenario.tidalVolume};
+}
+
+TEST(GoldenScenarioGridTest, everyPairOfSettingValuesIsTraced) {
+    std::map<uint16_t, std::vector<GoldenScenario>> modes;
+    for (const GoldenScenario& scenario : goldenScenarioGrid()) {
+        modes[scenario.mode].push_back(scenario);
+    }
+    ASSERT_EQ(5u, modes.size());
+
+    for (const auto& mode : modes) {
+        SCOPED_TRACE(mode.first);
+        EXPECT_EQ(9u, mode.second.size());
+        for (size_t first = 0; first < 4u; first++) {
+            for (size_t second = first + 1u; second < 4u; second++) {
+                std::set<int32_t> firstValues;
+                std::set<int32_t> secondValues;
+                std::set<std::pair<int32_t, int32_t>> pairs;
+                for (const GoldenScenario& scenario : mode.second) {
+                    std::vector<int32_t> settings = settingsOf(scenario);
+                    firstValues.insert(settings[first]);
+                    secondValues.insert(settings[second]);
+                    pairs.insert(std::make_pair(settings[first], settings[second]));
+                }
+                EXPECT_EQ(firstValues.size() * secondValues.size(), pairs.size());
+            }
+        }
+    }
+}
+
+/// One scenario per test, named after it
+class GoldenTraceTest : public ::testing::TestWithParam<GoldenScenario> {};
+
+TEST_P(GoldenTraceTest, controllerOutputsMatchTheGoldenTrace) {
+    const GoldenScenario& scenario = GetParam();
+    std::string path = std::string(GOLDEN_TRACE_DIR) + "/" + scenario.name + ".trace";
+    std::vector<std::string> actual = runGoldenScenario(scenario, GOLDEN_TRACE_CYCLES);
+    ASSERT_GT(actual.size(), 1u);
+
+    if (getenv("GOLDEN_TRACE_UPDATE") != nullptr) {
+        ASSERT_TRUE(writeGoldenTrace(path, actual)) << "Cannot write " << path;
+        return;
+    }
+
+    std::vector<std::string> expected;
+    ASSERT_TRUE(readGoldenTrace(path, &expected))
+        << "Cannot read " << path << ", run with GOLDEN_TRACE_UPDATE=1 to create it";
+    std::string diff = diffGoldenTraces(expected, actual);
+    EXPECT_TRUE(diff.empty()) << scenario.name << " diverges from " << path << "\n" << diff;
+}
+
+INSTANTIATE_TEST_SUITE_P(Scenarios,
+                         GoldenTraceTest,
+                         ::testing::ValuesIn(goldenScenarioGrid()),
+                         [](const ::testing::TestParamInfo<GoldenScenario>& p_info) {
+                             return p_info.param.name;
+                         });
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * @file test_interrupt_timing.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for interrupt_timing.cpp
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "../includes/interrupt_timing.h"
+#include "../includes/timebase.h"
+
+/// Test fixture resetting the host clock before each test
+class InterruptTimingTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() { initTimebase(); }
+};
+
+TEST_F(InterruptTimingTest, durationsGoToTheirBucket) {
+    TimingHistogram histogram;
+
+    histogram.record(0u);
+    histogram.record(1u);
+    histogram.record(4u);
+    histogram.record(499u);
+    histogram.record(500u);
+    histogram.record(100000u);
+
+    EXPECT_EQ(1u, histogram.bucket(0u));
+    EXPECT_EQ(1u, histogram.bucket(1u));
+    EXPECT_EQ(1u, histogram.bucket(2u));
+    EXPECT_EQ(1u, histogram.bucket(8u));
+    EXPECT_EQ(2u, histogram.bucket(9u));
+    EXPECT_EQ(6u, histogram.count());
+    EXPECT_EQ(100000u, histogram.maxUs());
+
+    histogram.reset();
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.maxUs());
+    EXPECT_EQ(0u, histogram.bucket(9u));
+}
+
+TEST_F(InterruptTimingTest, jitterIsTheDeviationFromTheNominalPeriod) {
+    InterruptTiming timing(1000u);
+
+    // First entry has no period
+    timing.onEntry(3u);
+    EXPECT_EQ(1u, timing.latency().count());
+    EXPECT_EQ(0u, timing.jitter().count());
+
+    // 7 µs late, then 7 µs early
+    advanceMonotonicMicros(1007u);
+    timing.onEntry(10u);
+    advanceMonotonicMicros(993u);
+    timing.onEntry(3u);
+
+    EXPECT_EQ(2u, timing.jitter().count());
+    EXPECT_EQ(2u, timing.jitter().bucket(3u));
+    EXPECT_EQ(7u, timing.jitter().maxUs());
+    EXPECT_EQ(10u, timing.latency().maxUs());
+}
+
+TEST_F(InterruptTimingTest, periodChangeSkipsOnePeriod) {
+    InterruptTiming timing(1000u);
+
+    timing.onEntry(0u);
+    timing.setNominalPeriod(10000u);
+
+    // This period spans both timer periods, it must not be recorded
+    advanceMonotonicMicros(4000u);
+    timing.onEntry(0u);
+    EXPECT_EQ(0u, timing.jitter().count());
+
+    advanceMonotonicMicros(10000u);
+    timing.onEntry(0u);
+    EXPECT_EQ(1u, timing.jitter().bucket(0u));
+}
+
+TEST_F(InterruptTimingTest, resetHappensOnTheNextEntry) {
+    InterruptTiming timing(1000u);
+
+    timing.onEntry(3u);
+    advanceMonotonicMicros(1000u);
+    timing.onEntry(3u);
+
+    // The histograms are only cleared by the interrupt
+    timing.requestReset();
+    EXPECT_EQ(2u, timing.latency().count());
+    EXPECT_EQ(1u, timing.jitter().count());
+
+    // The entry after the reset starts new histograms, without a period
+    advanceMonotonicMicros(1000u);
+    timing.onEntry(40u);
+    EXPECT_EQ(1u, timing.latency().count());
+    EXPECT_EQ(40u, timing.latency().maxUs());
+    EXPECT_EQ(0u, timing.jitter().count());
+
+    advanceMonotonicMicros(1000u);
+    timing.onEntry(3u);
+    EXPECT_EQ(1u, timing.jitter().count());
+}
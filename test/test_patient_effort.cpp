@@ -0,0 +1,161 @@
+/******************************************************************************
+ * @file test_patient_effort.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the inspiratory triggers on a breathing patient
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include "../includes/activation.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/ventilator_context.h"
+#include "host_board.h"
+#include "patient_effort.h"
+#include "pneumatic_plant.h"
+#include "simulator.h"
+#include "trigger_report.h"
+
+/// Period of the plant
+#define SAMPLE_PERIOD_US 1000u
+
+/// Test fixture booting the board on the lungs of a breathing patient
+class PatientEffortTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() { boot(); }
+
+    void boot() {
+        resetSimulation(0u);
+
+        bootHostBoard();
+
+        plant = PneumaticPlant();
+        effort = PatientEffort();
+        plant.setPatientEffort(&effort);
+        setSimulatedPlant(&plant, SAMPLE_PERIOD_US);
+    }
+
+    /// Start the ventilation in a mode, then let it synchronise with the patient
+    void startVentilation(uint16_t p_mode) {
+        ventilator.mainController.onVentilationModeSet(p_mode);
+        mainStateMachine.setupAndStart();
+        halReloadWatchdog();
+        runSimulation(SECOND_US);
+        activationController.onStartButton();
+        runSimulation(10u * SECOND_US);
+    }
+
+    /// Let the patient breathe at 25 per minute, faster than the default 20 cycles per minute
+    void breathe(double p_amplitude) {
+        effort.setRate(25u);
+        effort.setAmplitude(p_amplitude);
+        effort.setTiming(400u, 400u);
+        effort.setFirstOnset(12u * SECOND_US);
+    }
+
+    PneumaticPlant plant;
+    PatientEffort effort;
+};
+
+/// Assisted modes, with their names for the reports
+static const uint16_t assistedModes[] = {PC_AC, VC_AC, PC_VSAI};
+static const char* assistedModeNames[] = {"PC_AC", "VC_AC", "PC_VSAI"};
+
+TEST_F(PatientEffortTest, effortFollowsItsWaveform) {
+    breathe(60.0);
+    uint64_t onset = 0u;
+
+    EXPECT_EQ(0.0, effort.pressure(11u * SECOND_US));
+    EXPECT_NEAR(-30.0, effort.pressure((12u * SECOND_US) + 200000u), 0.01);
+    EXPECT_NEAR(-60.0, effort.pressure((12u * SECOND_US) + 400000u), 0.01);
+    EXPECT_TRUE(effort.effortAt((14u * SECOND_US) + 500000u, &onset));
+    EXPECT_EQ((14u * SECOND_US) + 400000u, onset);
+    EXPECT_FALSE(effort.effortAt((14u * SECOND_US) + 200000u, &onset));
+}
+
+TEST_F(PatientEffortTest, passivePatientRaisesNoTrigger) {
+    for (uint8_t i = 0; i < 3u; i++) {
+        SCOPED_TRACE(assistedModeNames[i]);
+        boot();
+        ventilator.mainController.onTriggerOffsetSet(10u);
+        startVentilation(assistedModes[i]);
+
+        TriggerReport report = runTriggerReport(effort, 30u * SECOND_US);
+
+        EXPECT_EQ(0u, report.autoTriggers);
+        EXPECT_EQ(10u, report.cycles);
+    }
+}
+
+TEST_F(PatientEffortTest, triggerDelayGrowsWithTheTriggerOffset) {
+    uint16_t offsets[] = {10u, 20u, 40u};
+    for (uint8_t i = 0; i < 3u; i++) {
+        uint32_t previousDelayMs = 0u;
+        for (uint16_t offset : offsets) {
+            char setting[64];
+            (void)snprintf(setting, sizeof(setting), "%s, trigger offset %u mmH2O",
+                           assistedModeNames[i], offset);
+            SCOPED_TRACE(setting);
+            boot();
+            breathe(60.0);
+            ventilator.mainController.onTriggerOffsetSet(offset);
+            startVentilation(assistedModes[i]);
+
+            TriggerReport report = runTriggerReport(effort, 30u * SECOND_US);
+            printTriggerReport(setting, report);
+
+            EXPECT_EQ(report.efforts, report.detectedEfforts + report.missedTriggers);
+            EXPECT_EQ(0u, report.autoTriggers);
+            if (offset <= 20u) {
+                // Every effort is detected, and the ventilator follows the patient
+                EXPECT_EQ(0u, report.missedTriggers);
+                EXPECT_NEAR(report.efforts, report.cycles, 1u);
+                EXPECT_GT(report.meanTriggerDelayMs, previousDelayMs);
+                EXPECT_LT(report.maxTriggerDelayMs, 300u);
+                previousDelayMs = report.meanTriggerDelayMs;
+            } else {
+                // The pressure drop of the efforts stays below the offset
+                EXPECT_EQ(0u, report.detectedEfforts);
+            }
+        }
+    }
+}
+
+TEST_F(PatientEffortTest, weakEffortsAreMissed) {
+    breathe(30.0);
+    startVentilation(PC_AC);
+
+    TriggerReport report = runTriggerReport(effort, 30u * SECOND_US);
+
+    EXPECT_EQ(0u, report.detectedEfforts);
+    EXPECT_EQ(report.efforts, report.missedTriggers);
+    EXPECT_EQ(10u, report.cycles);
+}
+
+TEST_F(PatientEffortTest, expiratoryTriggerFlowShortensTheInspiration) {
+    uint16_t flows[] = {10u, 30u, 60u};
+    uint32_t previousInspiratoryTimeMs = UINT32_MAX;
+    for (uint16_t flow : flows) {
+        char setting[64];
+        (void)snprintf(setting, sizeof(setting), "PC_VSAI, expiratory trigger flow %u%%", flow);
+        SCOPED_TRACE(setting);
+        boot();
+        breathe(60.0);
+        ventilator.mainController.onExpiratoryTriggerFlowSet(flow);
+        startVentilation(PC_VSAI);
+
+        TriggerReport report = runTriggerReport(effort, 30u * SECOND_US);
+        printTriggerReport(setting, report);
+
+        EXPECT_EQ(0u, report.missedTriggers);
+        EXPECT_EQ(0u, report.autoTriggers);
+        EXPECT_LT(report.meanInspiratoryTimeMs, previousInspiratoryTimeMs);
+        previousInspiratoryTimeMs = report.meanInspiratoryTimeMs;
+    }
+}
+
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * @file test_pid_tuner.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the search of the PID and blower regulation coefficients
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../includes/pc_cmv_controller.h"
+#include "../includes/ventilator_context.h"
+#include "pid_tuner.h"
+
+/// Sessions short enough for the tests: one patient, low and high pressures
+static std::vector<SweepSession> shortTuningSessions() {
+    std::vector<SweepSession> sessions;
+    for (const SweepSession& session : tuningSessions()) {
+        if ((session.lung.resistance == 10.0) && (session.lung.compliance == 50.0)) {
+            sessions.push_back(session);
+        }
+    }
+    return sessions;
+}
+
+TEST(PidTunerTest, compiledHeaderIsTheGeneratedOneOfTheDefaultTuning) {
+    std::ifstream file(PC_CMV_TUNING_HEADER);
+    ASSERT_TRUE(file.good());
+    std::stringstream content;
+    content << file.rdbuf();
+
+    EXPECT_EQ(tuningHeader(PC_CMV_DEFAULT_TUNING, "hand-picked values"), content.str());
+}
+
+TEST(PidTunerTest, controllersStartWithTheCompiledTuning) {
+    VentilatorContext context;
+    for (const TuningCoefficient& coefficient : tuningCoefficients()) {
+        SCOPED_TRACE(coefficient.name);
+        EXPECT_EQ(PC_CMV_DEFAULT_TUNING.*coefficient.value,
+                  context.pcCmvController.tuning().*coefficient.value);
+        EXPECT_EQ(PC_CMV_DEFAULT_TUNING.*coefficient.value,
+                  context.pcAcController.tuning().*coefficient.value);
+    }
+}
+
+TEST(PidTunerTest, tuningsKeepTheBlowerRulesOrdered) {
+    EXPECT_TRUE(isValidTuning(PC_CMV_DEFAULT_TUNING));
+
+    PcCmvTuning unordered = PC_CMV_DEFAULT_TUNING;
+    unordered.blowerHoldPercent = unordered.blowerMediumStepPercent + 1;
+    EXPECT_FALSE(isValidTuning(unordered));
+
+    PcCmvTuning outOfBounds = PC_CMV_DEFAULT_TUNING;
+    outOfBounds.inspiratoryKp = 0;
+    EXPECT_FALSE(isValidTuning(outOfBounds));
+}
+
+TEST(PidTunerTest, detunedCoefficientsCostMore) {
+    std::vector<SweepSession> sessions = shortTuningSessions();
+    ASSERT_EQ(4u, sessions.size());
+
+    TuningCost tuned;
+    ASSERT_TRUE(evaluateTuning(PC_CMV_DEFAULT_TUNING, sessions, 4u, 2u, 0u, &tuned));
+    EXPECT_GT(tuned.riseTimeMs, 0.0);
+
+    // A blower that barely adapts takes longer to reach the plateau pressure
+    PcCmvTuning detuned = PC_CMV_DEFAULT_TUNING;
+    detuned.blowerSmallIncrement = 1;
+    detuned.blowerMediumIncrement = 1;
+    detuned.blowerLargeIncrement = 1;
+    TuningCost cost;
+    ASSERT_TRUE(evaluateTuning(detuned, sessions, 4u, 2u, 0u, &cost));
+    EXPECT_GT(cost.total, tuned.total);
+}
+
+TEST(PidTunerTest, searchNeverReturnsAWorseTuning) {
+    std::vector<SweepSession> sessions = shortTuningSessions();
+    std::vector<TuningCoefficient> coefficients;
+    for (const TuningCoefficient& coefficient : tuningCoefficients()) {
+        if (coefficient.value == &PcCmvTuning::blowerLargeIncrement) {
+            coefficients.push_back(coefficient);
+        }
+    }
+    ASSERT_EQ(1u, coefficients.size());
+
+    TuningCost initial;
+    ASSERT_TRUE(evaluateTuning(PC_CMV_DEFAULT_TUNING, sessions, 4u, 2u, 0u, &initial));
+    TuningCost cost;
+    PcCmvTuning tuning = tunePcCmv(PC_CMV_DEFAULT_TUNING, coefficients, sessions, 4u, 2u, 1u, 0u,
+                                   &cost, nullptr);
+
+    EXPECT_LE(cost.total, initial.total);
+    EXPECT_TRUE(isValidTuning(tuning));
+    // Only the searched coefficient may change
+    EXPECT_EQ(PC_CMV_DEFAULT_TUNING.inspiratoryKp, tuning.inspiratoryKp);
+    EXPECT_EQ(PC_CMV_DEFAULT_TUNING.blowerDecrement, tuning.blowerDecrement);
+}
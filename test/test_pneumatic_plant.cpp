@@ -0,0 +1,205 @@
+/******************************************************************************
+ * @file test_pneumatic_plant.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the ventilation modes closed on the simulated lungs
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../includes/activation.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/ventilator_context.h"
+#include "host_board.h"
+#include "pneumatic_plant.h"
+#include "simulator.h"
+
+/// Period of the plant and of the pressure samples
+#define SAMPLE_PERIOD_US 1000u
+
+/// Airway pressure and lung volume during one respiratory cycle
+struct CycleRecord {
+    /// Airway pressure every SAMPLE_PERIOD_US, in mmH2O
+    std::vector<double> pressures;
+    /// Volume delivered to the lungs, in mL
+    double tidalVolume;
+    /// Peak pressure the controller measured at the end of the cycle, in mmH2O
+    int16_t peakPressureMeasure;
+};
+
+/// Measures of the airway pressure over one respiratory cycle
+struct CycleMeasures {
+    /// Highest pressure, in mmH2O
+    double peak;
+    /// Time to go from 10% to 90% of the way between PEEP and the command, in ms
+    uint32_t riseTimeMs;
+    /// Mean pressure over the last 100 ms of the cycle, in mmH2O
+    double peep;
+};
+
+/// Test fixture booting the board on the simulated lungs
+class PneumaticPlantTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() { boot(); }
+
+    void boot() {
+        resetSimulation(0u);
+
+        bootHostBoard();
+
+        plant = PneumaticPlant();
+        setSimulatedPlant(&plant, SAMPLE_PERIOD_US);
+    }
+
+    /// Start the ventilation in a mode, then let it settle for a few cycles
+    void startVentilation(uint16_t p_mode) {
+        ventilator.mainController.onVentilationModeSet(p_mode);
+        mainStateMachine.setupAndStart();
+        halReloadWatchdog();
+        runSimulation(SECOND_US);
+        activationController.onStartButton();
+        runSimulation(10u * SECOND_US);
+    }
+
+    /// Record the airway pressure and the lung volume during the next respiratory cycle
+    CycleRecord recordCycle() {
+        uint32_t cycle = ventilator.mainController.cycleNumber();
+        while (ventilator.mainController.cycleNumber() == cycle) {
+            runSimulation(SAMPLE_PERIOD_US);
+        }
+
+        CycleRecord record = {std::vector<double>(), 0.0, 0};
+        double minVolume = plant.lungVolume();
+        double maxVolume = minVolume;
+        cycle = ventilator.mainController.cycleNumber();
+        while (ventilator.mainController.cycleNumber() == cycle) {
+            // The measures of the controller are reset when the next cycle starts
+            record.peakPressureMeasure = ventilator.mainController.peakPressureMeasure();
+            runSimulation(SAMPLE_PERIOD_US);
+            record.pressures.push_back(plant.airwayPressure());
+            minVolume = std::min(minVolume, plant.lungVolume());
+            maxVolume = std::max(maxVolume, plant.lungVolume());
+        }
+        record.tidalVolume = maxVolume - minVolume;
+        return record;
+    }
+
+    /// Measure a recorded cycle against the plateau pressure command
+    CycleMeasures measure(const std::vector<double>& p_samples) {
+        double command = ventilator.mainController.plateauPressureCommand();
+        CycleMeasures measures = {0.0, 0u, 0.0};
+        double start = p_samples[0];
+        uint32_t low = 0u;
+        uint32_t high = 0u;
+        for (uint32_t i = 0; i < p_samples.size(); i++) {
+            measures.peak = std::max(measures.peak, p_samples[i]);
+            if ((low == 0u) && (p_samples[i] >= (start + (0.1 * (command - start))))) {
+                low = i + 1u;
+            }
+            if ((high == 0u) && (p_samples[i] >= (start + (0.9 * (command - start))))) {
+                high = i + 1u;
+            }
+        }
+        measures.riseTimeMs = ((high > 0u) ? high : p_samples.size()) - low;
+
+        for (uint32_t i = p_samples.size() - 100u; i < p_samples.size(); i++) {
+            measures.peep += p_samples[i] / 100.0;
+        }
+        return measures;
+    }
+
+    PneumaticPlant plant;
+};
+
+TEST_F(PneumaticPlantTest, pressureControlledModesReachThePlateauCommand) {
+    uint16_t modes[] = {PC_CMV, PC_AC, PC_VSAI};
+    for (uint16_t mode : modes) {
+        SCOPED_TRACE(mode);
+        boot();
+        startVentilation(mode);
+
+        CycleRecord record = recordCycle();
+        CycleMeasures measures = measure(record.pressures);
+
+        double command = ventilator.mainController.plateauPressureCommand();
+        double peep = ventilator.mainController.peepCommand();
+        EXPECT_GT(measures.peak, command);
+        EXPECT_LT(measures.peak - command, 0.15 * (command - peep));
+        EXPECT_LT(measures.riseTimeMs, 300u);
+        EXPECT_NEAR(peep, measures.peep, 5.0);
+
+        // The controller sees the plant through the pressure sensor conversion
+        EXPECT_NEAR(measures.peak, record.peakPressureMeasure, 2.0);
+        EXPECT_NEAR(measures.peep, ventilator.mainController.peepMeasure(), 2.0);
+    }
+}
+
+TEST_F(PneumaticPlantTest, volumeControlledModesDeliverTheTidalVolumeCommand) {
+    uint16_t modes[] = {VC_CMV, VC_AC};
+    for (uint16_t mode : modes) {
+        SCOPED_TRACE(mode);
+        boot();
+        startVentilation(mode);
+
+        CycleRecord record = recordCycle();
+        CycleMeasures measures = measure(record.pressures);
+
+        double command = ventilator.mainController.tidalVolumeCommand();
+        EXPECT_NEAR(command, record.tidalVolume, 0.1 * command);
+        EXPECT_NEAR(ventilator.mainController.peepCommand(), measures.peep, 5.0);
+
+        // The controller sees the plant through the flow meter
+        EXPECT_NEAR(record.tidalVolume, ventilator.mainController.tidalVolumeMeasure(),
+                    0.05 * record.tidalVolume);
+    }
+}
+
+TEST_F(PneumaticPlantTest, peepIsStableFromCycleToCycle) {
+    startVentilation(PC_CMV);
+
+    double lowest = 1000.0;
+    double highest = 0.0;
+    for (uint8_t i = 0; i < 5u; i++) {
+        CycleMeasures measures = measure(recordCycle().pressures);
+        lowest = std::min(lowest, measures.peep);
+        highest = std::max(highest, measures.peep);
+    }
+
+    EXPECT_LT(highest - lowest, 1.0);
+}
+
+TEST_F(PneumaticPlantTest, stifferLungsNeedMorePressureForTheSameVolume) {
+    startVentilation(VC_CMV);
+    CycleRecord normal = recordCycle();
+
+    boot();
+    LungCompartment stiff = {10.0, 20.0};
+    plant.setLung(stiff);
+    startVentilation(VC_CMV);
+    CycleRecord stiffer = recordCycle();
+
+    EXPECT_GT(measure(stiffer.pressures).peak, measure(normal.pressures).peak + 50.0);
+    EXPECT_NEAR(normal.tidalVolume, stiffer.tidalVolume, 0.1 * normal.tidalVolume);
+}
+
+TEST_F(PneumaticPlantTest, fastCompartmentFillsFirst) {
+    LungCompartment fast = {5.0, 25.0};
+    LungCompartment slow = {20.0, 25.0};
+    plant.setLungs(fast, slow);
+    startVentilation(PC_CMV);
+
+    CycleMeasures measures = measure(recordCycle().pressures);
+    EXPECT_LT(measures.riseTimeMs, 300u);
+
+    // Both compartments are back to the PEEP at the end of the expiration
+    EXPECT_NEAR(plant.compartmentVolume(0), plant.compartmentVolume(1), 5.0);
+
+    // The slow compartment lags behind during the rise of the pressure
+    runSimulation(200u * SAMPLE_PERIOD_US);
+    EXPECT_GT(plant.compartmentVolume(0), plant.compartmentVolume(1) + 20.0);
+}
@@ -86,3 +86,21 @@ TEST_F(PressionTest, testConvertSensor2Pressure) {
 
     ASSERT_THAT(output, testing::ElementsAreArray(outputTruth));
 }
+
+/**
+ * Test that convertPressure2Sensor gives back the pressure once the filter settled
+ *
+ */
+TEST_F(PressionTest, testConvertPressure2SensorRoundTrip) {
+    std::vector<int32_t> pressures = {0, 50, 200, 350, 700};
+
+    for (size_t i = 0; i < pressures.size(); i++) {
+        uint32_t raw = convertPressure2Sensor(pressures[i]);
+        int16_t pressure = 0;
+        for (int sample = 0; sample < 100; sample++) {
+            pressure = convertSensor2Pressure(raw);
+        }
+
+        ASSERT_EQ(pressures[i], pressure);
+    }
+}
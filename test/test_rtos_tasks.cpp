@@ -0,0 +1,117 @@
+/******************************************************************************
+ * @file test_rtos_tasks.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the FreeRTOS task model, on the POSIX port of FreeRTOS
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "../includes/activation.h"
+#include "../includes/control_lock.h"
+#include "../includes/cpu_load.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/rtos_tasks.h"
+#include "session_sweep.h"
+
+/// Index of the control task, by decreasing priority
+#define RTOS_CONTROL_TASK 1u
+
+/// Ticks during which the tasks are measured
+#define RTOS_MEASURED_TICKS 1000u
+
+/// Ticks during which the UI task holds the control lock
+#define RTOS_LOCKED_TICKS 50u
+
+/// Longest time the scheduler process may take, in ms of the host
+#define RTOS_TEST_TIMEOUT_MS 30000
+
+/// What the UI task saw of the scheduler
+struct RtosRun {
+    uint32_t ticks;
+    uint32_t tickHooks;
+    uint32_t controlPeriods;
+    uint32_t controlPeriodsWhileLocked;
+    uint32_t controlPeriodsAfterUnlock;
+};
+
+/// Pipe on which the scheduler process sends its RtosRun
+static int rtosRunPipe = -1;
+
+/// Start function of the UI task: it ventilates, measures the other tasks and ends the process
+static void measureRtosTasks(void) {
+    (void)bootSweepBoard(defaultSweepSession());
+    activationController.onStartButton();
+    vTaskDelay(pdMS_TO_TICKS(100u));
+
+    const PeriodicTask& control = rtosTask(RTOS_CONTROL_TASK);
+    RtosRun run = {};
+    TickType_t startTick = xTaskGetTickCount();
+    uint32_t startTickHooks = readCpuLoadTicks();
+    uint32_t startPeriods = control.executionCount;
+    vTaskDelay(pdMS_TO_TICKS(RTOS_MEASURED_TICKS));
+    run.ticks = xTaskGetTickCount() - startTick;
+    run.tickHooks = readCpuLoadTicks() - startTickHooks;
+    run.controlPeriods = control.executionCount - startPeriods;
+
+    // A period that started before the lock may end while it is held
+    lockControl();
+    startPeriods = control.executionCount;
+    vTaskDelay(pdMS_TO_TICKS(RTOS_LOCKED_TICKS));
+    run.controlPeriodsWhileLocked = control.executionCount - startPeriods;
+    unlockControl();
+
+    startPeriods = control.executionCount;
+    vTaskDelay(pdMS_TO_TICKS(RTOS_LOCKED_TICKS));
+    run.controlPeriodsAfterUnlock = control.executionCount - startPeriods;
+
+    ssize_t written = write(rtosRunPipe, &run, sizeof(run));
+    _exit((written == static_cast<ssize_t>(sizeof(run))) ? 0 : 1);
+}
+
+TEST(RtosTasksTest, controlRunsEveryTickUnlessLocked) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    // The scheduler never returns: it runs in its own process, that the UI task ends
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        (void)close(fds[0]);
+        rtosRunPipe = fds[1];
+        startRtosTasks(&measureRtosTasks);
+        _exit(1);
+    }
+    (void)close(fds[1]);
+
+    RtosRun run = {};
+    struct pollfd output = {fds[0], POLLIN, 0};
+    bool received = (poll(&output, 1, RTOS_TEST_TIMEOUT_MS) == 1)
+                    && (read(fds[0], &run, sizeof(run)) == static_cast<ssize_t>(sizeof(run)));
+    if (!received) {
+        (void)kill(pid, SIGKILL);
+    }
+    int status = 0;
+    (void)waitpid(pid, &status, 0);
+    (void)close(fds[0]);
+    ASSERT_TRUE(received);
+    EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    // Ticks the host timer missed are caught up without calling the hook
+    EXPECT_GE(run.ticks, RTOS_MEASURED_TICKS);
+    EXPECT_LE(run.tickHooks, run.ticks);
+    EXPECT_GT(run.tickHooks, (9u * run.ticks) / 10u);
+
+    // The control task is released on every tick while breathing
+    EXPECT_NEAR(run.ticks, run.controlPeriods, 2u);
+    EXPECT_LE(run.controlPeriodsWhileLocked, 1u);
+    EXPECT_GT(run.controlPeriodsAfterUnlock, RTOS_LOCKED_TICKS - 2u);
+}
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * @file test_scenario.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the scripted ventilation sessions
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../includes/serial_control.h"
+#include "scenario.h"
+
+/// Parse a scenario, expecting no error
+static Scenario parsed(const std::string& p_text) {
+    Scenario scenario;
+    std::string error;
+    EXPECT_TRUE(parseScenario("test", p_text, &scenario, &error)) << error;
+    return scenario;
+}
+
+/// Error of a scenario that does not parse
+static std::string parseError(const std::string& p_text) {
+    Scenario scenario;
+    std::string error;
+    EXPECT_FALSE(parseScenario("test", p_text, &scenario, &error));
+    return error;
+}
+
+TEST(ScenarioParserTest, commandsAndDates) {
+    Scenario scenario = parsed(
+        "# comment\n"
+        "mode VC_CMV\n"
+        "set PEEP 80   # trailing comment\n"
+        "patient 10 50 20 30\n"
+        "at 2 s start\n"
+        "at cycle 3 fault flow_meter_nack 500 ms expiratory\n"
+        "at 1500 ms fault battery_droop 1 s 2000\n"
+        "at cycle 3 expect peep within 20 after 2 cycles\n"
+        "at 4 s expect no alarm 14 within 3 cycles\n"
+        "at 10 s end\n");
+
+    ASSERT_EQ(scenario.actions.size(), 7u);
+    EXPECT_EQ(scenario.name, "test");
+    EXPECT_EQ(scenario.actions[0].kind, SCENARIO_SET);
+    EXPECT_EQ(scenario.actions[0].setting, VentilationMode);
+    EXPECT_EQ(scenario.actions[0].value, VC_CMV);
+    EXPECT_EQ(scenario.actions[1].setting, PEEP);
+    EXPECT_EQ(scenario.actions[1].value, 80u);
+    EXPECT_EQ(scenario.actions[1].line, 3u);
+    EXPECT_EQ(scenario.actions[2].compartments, 2u);
+    EXPECT_DOUBLE_EQ(scenario.actions[2].lungs[1].compliance, 30.0);
+    EXPECT_EQ(scenario.actions[3].date.kind, SCENARIO_AT_MS);
+    EXPECT_EQ(scenario.actions[3].date.value, 2000u);
+    EXPECT_EQ(scenario.actions[4].date.kind, SCENARIO_AT_CYCLE);
+    EXPECT_EQ(scenario.actions[4].date.value, 3u);
+    EXPECT_EQ(scenario.actions[4].fault.kind, FAULT_FLOW_METER_NACK);
+    EXPECT_EQ(scenario.actions[4].fault.durationMs, 500u);
+    EXPECT_EQ(scenario.actions[4].fault.flowMeter, HOST_EXPIRATORY_FLOW_METER);
+    EXPECT_EQ(scenario.actions[5].fault.kind, FAULT_BATTERY_DROOP);
+    EXPECT_EQ(scenario.actions[5].fault.durationMs, 1000u);
+    EXPECT_EQ(scenario.actions[5].fault.batteryAdc, 2000u);
+    EXPECT_EQ(scenario.actions[6].kind, SCENARIO_END);
+
+    ASSERT_EQ(scenario.checks.size(), 2u);
+    EXPECT_EQ(scenario.checks[0].kind, SCENARIO_EXPECT_PEEP);
+    EXPECT_DOUBLE_EQ(scenario.checks[0].tolerance, 20.0);
+    EXPECT_EQ(scenario.checks[0].cycles, 2u);
+    EXPECT_EQ(scenario.checks[0].text, "expect peep within 20 after 2 cycles");
+    EXPECT_EQ(scenario.checks[1].kind, SCENARIO_EXPECT_NO_ALARM);
+    EXPECT_EQ(scenario.checks[1].alarm, 14u);
+    EXPECT_EQ(scenario.checks[1].cycles, 3u);
+}
+
+TEST(ScenarioParserTest, errorsNameTheLine) {
+    EXPECT_EQ(parseError("start\nat 1 s jump\nat 2 s end\n"), "line 2: unknown command 'jump'");
+    EXPECT_EQ(parseError("at 1 s start\n"), "missing 'at <date> end'");
+    EXPECT_EQ(parseError("end\n"), "line 1: the end needs a date");
+    EXPECT_EQ(parseError("at 1 h start\nat 2 s end\n"),
+              "line 1: expected 'at <n> ms', 'at <n> s' or 'at cycle <n>'");
+    EXPECT_EQ(parseError("at cycle 0 start\nat 2 s end\n"), "line 1: invalid cycle '0'");
+    EXPECT_EQ(parseError("set Volume 300\nat 2 s end\n"), "line 1: unknown setting 'Volume'");
+    EXPECT_EQ(parseError("at 1 s patient 10 50 20 30\nat 2 s end\n"),
+              "line 1: two compartments can only be set at the boot");
+    EXPECT_EQ(parseError("at 1 s expect pressure within 5 after 2 cycles\nat 2 s end\n"),
+              "line 1: unknown measure 'pressure'");
+    EXPECT_EQ(parseError("at 1 s end\nat 2 s end\n"), "line 2: the session has already an end");
+}
+
+TEST(ScenarioRunTest, checksPassAndFailOnTheSession) {
+    Scenario scenario = parsed(
+        "mode PC_CMV\n"
+        "patient 10 50\n"
+        "set PEEP 50\n"
+        "set CyclesPerMinute 20\n"
+        "at 1 s start\n"
+        "at 1 s expect peep within 20 after 3 cycles\n"
+        "at 1 s expect alarm 21 within 2 cycles\n"
+        "at 30 s expect no alarm 21 within 1 cycles\n"
+        "at 20 s end\n");
+
+    ScenarioResult result = runScenario(scenario);
+
+    EXPECT_TRUE(result.error.empty()) << result.error;
+    ASSERT_EQ(result.checks.size(), 3u);
+    EXPECT_TRUE(result.checks[0].passed) << result.checks[0].message;
+    EXPECT_EQ(result.checks[0].line, 6u);
+    // The battery is healthy: no low battery alarm
+    EXPECT_FALSE(result.checks[1].passed);
+    EXPECT_NE(result.checks[1].message.find("alarm 21 not triggered"), std::string::npos);
+    EXPECT_FALSE(result.checks[2].passed);
+    EXPECT_EQ(result.checks[2].message, "the date of the expectation was not reached");
+    EXPECT_FALSE(scenarioPassed(result));
+}
+
+TEST(ScenarioReportTest, junitReportHasFailuresAndErrors) {
+    ScenarioResult failed;
+    failed.name = "failed";
+    failed.durationS = 1.5;
+    ScenarioCheckResult passed = {3u, "expect peep within 20 after 3 cycles", true, ""};
+    ScenarioCheckResult failure = {4u, "expect alarm 12 within 2 cycles", false,
+                                   "alarm 12 not triggered from 1000 ms to 7000 ms"};
+    failed.checks.push_back(passed);
+    failed.checks.push_back(failure);
+    ScenarioResult broken;
+    broken.name = "broken";
+    broken.error = "line 1: unknown command '<jump>'";
+    broken.durationS = 0.0;
+    std::vector<ScenarioResult> results;
+    results.push_back(failed);
+    results.push_back(broken);
+
+    FILE* output = tmpfile();
+    ASSERT_NE(output, nullptr);
+    writeJUnitReport(results, output);
+    std::string report;
+    rewind(output);
+    int character = 0;
+    while ((character = fgetc(output)) != EOF) {
+        report += static_cast<char>(character);
+    }
+    (void)fclose(output);
+
+    EXPECT_NE(report.find("tests=\"3\" failures=\"1\" errors=\"1\""), std::string::npos);
+    EXPECT_NE(report.find("name=\"line 3: expect peep within 20 after 3 cycles\"/>"),
+              std::string::npos);
+    EXPECT_NE(report.find("<failure message=\"alarm 12 not triggered from 1000 ms to 7000 ms\"/>"),
+              std::string::npos);
+    EXPECT_NE(report.find("<error message=\"line 1: unknown command '&lt;jump&gt;'\"/>"),
+              std::string::npos);
+    EXPECT_FALSE(scenarioPassed(failed));
+    EXPECT_FALSE(scenarioPassed(broken));
+}
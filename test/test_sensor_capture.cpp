@@ -0,0 +1,275 @@
+/******************************************************************************
+ * @file test_sensor_capture.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the raw sensor capture and its replay on the host
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "CRC32.h"
+
+#include "../includes/activation.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/mass_flow_meter_utl.h"
+#include "../includes/sensor_capture.h"
+#include "../includes/serial_control.h"
+#include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "host_board.h"
+#include "patient_effort.h"
+#include "pneumatic_plant.h"
+#include "sensor_replay.h"
+#include "simulator.h"
+#include "ui_link.h"
+
+/// Period of the plant and of the samples of the outputs
+#define SAMPLE_PERIOD_US 1000u
+
+/// Tick of the data snapshot the control interrupt sends in the middle of a capture message
+#define INTERRUPTING_SNAPSHOT_TICK 4242u
+
+/// Outputs of the board after a control tick
+struct Outputs {
+    int32_t pressureCommand;
+    uint16_t blowerPulse;
+    uint16_t inspiratoryValvePulse;
+    uint16_t expiratoryValvePulse;
+};
+
+/// Test fixture booting the board on the lungs of a breathing patient
+class SensorCaptureTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() {
+        resetSimulation(0u);
+
+        bootHostBoard();
+
+        plant = PneumaticPlant();
+        effort = PatientEffort();
+        effort.setRate(25u);
+        effort.setAmplitude(60.0);
+        effort.setFirstOnset(3u * SECOND_US);
+        plant.setPatientEffort(&effort);
+        setSimulatedPlant(&plant, SAMPLE_PERIOD_US);
+
+        telemetry.clear();
+        mainStateMachine.setupAndStart();
+        halReloadWatchdog();
+    }
+
+    /// Receive a control message on the serial link, like the UI sends it
+    void sendControl(uint8_t p_setting, uint16_t p_value) {
+        uint8_t frame[11] = {0x05, 0x0A, p_setting, static_cast<uint8_t>(p_value >> 8u),
+                             static_cast<uint8_t>(p_value & 0xFFu)};
+        CRC32 crc32;
+        crc32.update(&frame[2], 3u);
+        uint32_t crc = crc32.finalize();
+        for (uint8_t i = 0; i < 4u; i++) {
+            frame[5u + i] = static_cast<uint8_t>(crc >> (24u - (8u * i)));
+        }
+        frame[9] = 0x50;
+        frame[10] = 0xA0;
+        pushHostTelemetryInput(frame, sizeof(frame));
+    }
+
+    /// Run the simulation, keeping everything sent on the telemetry link
+    void run(uint64_t p_durationUs) {
+        uint64_t end = monotonicMicros() + p_durationUs;
+        while (monotonicMicros() < end) {
+            runSimulation(SAMPLE_PERIOD_US);
+            if ((monotonicMicros() % (100u * SAMPLE_PERIOD_US)) == 0u) {
+                receiveTelemetry();
+            }
+        }
+        receiveTelemetry();
+    }
+
+    /// Run the simulation, keeping the outputs after every control tick
+    void record(uint64_t p_durationUs) {
+        uint64_t end = monotonicMicros() + p_durationUs;
+        while (monotonicMicros() < end) {
+            run(SAMPLE_PERIOD_US);
+            Outputs outputs = {ventilator.mainController.pressureCommand(),
+                               hostPwmOutputPulse(HAL_PWM_BLOWER),
+                               hostPwmOutputPulse(HAL_PWM_INSPIRATORY_VALVE),
+                               hostPwmOutputPulse(HAL_PWM_EXPIRATORY_VALVE)};
+            recorded[monotonicMicros()] = outputs;
+        }
+    }
+
+    /// Take what the board sent on the telemetry link since the last call
+    void receiveTelemetry() {
+        std::vector<uint8_t> output(HOST_TELEMETRY_OUTPUT_SIZE);
+        output.resize(popHostTelemetryOutput(output.data(), output.size()));
+        telemetry.insert(telemetry.end(), output.begin(), output.end());
+    }
+
+    /// Records of the sensor capture messages received
+    std::vector<uint8_t> capturedRecords() {
+        std::vector<uint8_t> records;
+        (void)extractSensorCapture(telemetry.data(), telemetry.size(), &records);
+        return records;
+    }
+
+    PneumaticPlant plant;
+    PatientEffort effort;
+    std::vector<uint8_t> telemetry;
+    std::map<uint64_t, Outputs> recorded;
+};
+
+/// Control interrupt sending a data snapshot while the background loop sends on the link
+static void sendInterruptingSnapshot(void) {
+    sendDataSnapshot(INTERRUPTING_SNAPSHOT_TICK, 100, CyclePhases::INHALATION, 10u, 20u, 30u, 40u,
+                     50, 60);
+}
+
+TEST(SensorCaptureConversionTest, flowWordsGiveBackTheFlows) {
+    int32_t flows[] = {0, 501, 15000, 60000, 150000};
+    for (int32_t flow : flows) {
+        SCOPED_TRACE(flow);
+        uint16_t inspiratoryWord = convertInspiratoryFlow2Sensor(flow);
+        EXPECT_GE(convertInspiratoryFlowSensor(inspiratoryWord), flow);
+        EXPECT_LT(convertInspiratoryFlowSensor(inspiratoryWord - 1u), flow);
+
+        uint16_t expiratoryWord = convertExpiratoryFlow2Sensor(-flow);
+        EXPECT_GE(convertExpiratoryFlowSensor(expiratoryWord), -flow);
+        EXPECT_LT(convertExpiratoryFlowSensor(expiratoryWord - 1u), -flow);
+    }
+}
+
+TEST_F(SensorCaptureTest, replayGivesBackTheCommandsBitForBit) {
+    // Settings received before the capture are part of its start
+    sendControl(VentilationMode, PC_AC);
+    sendControl(TriggerOffset, 20u);
+    sendControl(PEEP, 80u);
+    run(SECOND_US);
+
+    sendControl(SensorCaptureEnabled, 1u);
+    run(100u * SAMPLE_PERIOD_US);
+    activationController.onStartButton();
+    record(5u * SECOND_US);
+    sendControl(PEEP, 60u);
+    sendControl(PlateauPressure, 250u);
+    record(5u * SECOND_US);
+    sendControl(SensorCaptureEnabled, 0u);
+    run(200u * SAMPLE_PERIOD_US);
+
+    std::vector<uint8_t> records = capturedRecords();
+    ASSERT_GT(records.size(), SENSOR_CAPTURE_START_SIZE);
+    EXPECT_EQ(SENSOR_CAPTURE_START, records[0]);
+    EXPECT_EQ(SENSOR_CAPTURE_END, records[records.size() - 2u]);
+    EXPECT_EQ(SENSOR_CAPTURE_STOPPED, records[records.size() - 1u]);
+    EXPECT_EQ(0u, sensorCapture.overflows());
+
+    std::vector<ReplayedTick> ticks;
+    EXPECT_TRUE(replaySensorCapture(records, &ticks));
+
+    uint32_t compared = 0u;
+    uint32_t cycles = 0u;
+    for (const ReplayedTick& tick : ticks) {
+        std::map<uint64_t, Outputs>::const_iterator original = recorded.find(tick.dateUs);
+        if (original != recorded.end()) {
+            SCOPED_TRACE(tick.dateUs);
+            ASSERT_EQ(original->second.pressureCommand, tick.pressureCommand);
+            ASSERT_EQ(original->second.blowerPulse, tick.blowerPulse);
+            ASSERT_EQ(original->second.inspiratoryValvePulse, tick.inspiratoryValvePulse);
+            ASSERT_EQ(original->second.expiratoryValvePulse, tick.expiratoryValvePulse);
+            compared++;
+            cycles = tick.cycle;
+        }
+    }
+    // The machine only leaves the stopped state, and its 10 ms period, on the tick after the start
+    EXPECT_GE(compared, recorded.size() - 10u);
+    EXPECT_GE(cycles, 3u);
+
+    // The settings received during the capture were replayed too
+    EXPECT_EQ(60, ventilator.mainController.peepNextCommand());
+    EXPECT_EQ(250, ventilator.mainController.plateauPressureNextCommand());
+}
+
+TEST_F(SensorCaptureTest, captureStartsOnceTheMachineIsStopped) {
+    run(SECOND_US);
+    activationController.onStartButton();
+    run(SECOND_US);
+
+    sendControl(SensorCaptureEnabled, 1u);
+    run(SECOND_US);
+    EXPECT_TRUE(sensorCapture.isActive());
+    EXPECT_TRUE(capturedRecords().empty());
+
+    sendControl(RespirationEnabled, 0u);
+    run(SECOND_US);
+    std::vector<uint8_t> records = capturedRecords();
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(SENSOR_CAPTURE_START, records[0]);
+}
+
+TEST_F(SensorCaptureTest, captureEndsWhenTheRecordsAreNotSent) {
+    run(SECOND_US);
+    sendControl(SensorCaptureEnabled, 1u);
+    run(100u * SAMPLE_PERIOD_US);
+    activationController.onStartButton();
+
+    // Nothing is sent while the background loop is stuck
+    size_t sentBefore = capturedRecords().size();
+    setSimulatedBackgroundLoop(false);
+    run(SECOND_US);
+    setSimulatedBackgroundLoop(true);
+    run(SECOND_US);
+
+    EXPECT_EQ(1u, sensorCapture.overflows());
+    EXPECT_FALSE(sensorCapture.isActive());
+    std::vector<uint8_t> records = capturedRecords();
+    ASSERT_GT(records.size(), SENSOR_CAPTURE_START_SIZE);
+    EXPECT_LE(records.size(), sentBefore + SENSOR_CAPTURE_BUFFER_SIZE);
+    EXPECT_EQ(SENSOR_CAPTURE_END, records[records.size() - 2u]);
+    EXPECT_EQ(SENSOR_CAPTURE_OVERFLOW, records[records.size() - 1u]);
+
+    // What was captured still replays
+    std::vector<ReplayedTick> ticks;
+    EXPECT_TRUE(replaySensorCapture(records, &ticks));
+    EXPECT_GT(ticks.size(), 100u);
+}
+
+TEST_F(SensorCaptureTest, controlInterruptDoesNotBreakACaptureMessage) {
+    run(SECOND_US);
+    sendControl(SensorCaptureEnabled, 1u);
+    run(100u * SAMPLE_PERIOD_US);
+    activationController.onStartButton();
+    run(100u * SAMPLE_PERIOD_US);
+    telemetry.clear();
+
+    // The control interrupt fires after the first bytes the background loop sends
+    interruptHostTelemetryWrite(HAL_TIMER_CONTROL, &sendInterruptingSnapshot, 20u);
+    run(50u * SAMPLE_PERIOD_US);
+
+    uint32_t captureMessages = 0u;
+    bool snapshotAfterCapture = false;
+    char previousType = 0;
+    size_t offset = 0u;
+    while (offset < telemetry.size()) {
+        TelemetryFrame frame;
+        TelemetryDecoding decoding =
+            decodeTelemetryFrame(&telemetry[offset], telemetry.size() - offset, &frame);
+        ASSERT_EQ(TELEMETRY_FRAME_DECODED, decoding) << "at byte " << offset;
+        if (frame.type == 'R') {
+            captureMessages++;
+        }
+        if ((frame.type == 'D') && (frame.fields.size() >= 2u)
+            && (((frame.fields[0] << 8u) | frame.fields[1]) == INTERRUPTING_SNAPSHOT_TICK)) {
+            snapshotAfterCapture = (previousType == 'R');
+        }
+        previousType = frame.type;
+        offset += frame.size;
+    }
+    EXPECT_GT(captureMessages, 0u);
+    EXPECT_TRUE(snapshotAfterCapture);
+}
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * @file test_session_sweep.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the parameter sweep of simulated ventilation sessions
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../includes/cycle.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/parameters.h"
+#include "pid_tuner.h"
+#include "session_sweep.h"
+
+TEST(SessionSweepTest, sessionsCoverTheSettingsRanges) {
+    SweepRanges ranges = defaultSweepRanges(3u);
+    std::vector<SweepSession> sessions = sweepSessions(ranges);
+    ASSERT_FALSE(sessions.empty());
+
+    int16_t lowestPeep = CONST_MAX_PEEP_PRESSURE;
+    int16_t highestPeep = CONST_MIN_PEEP_PRESSURE;
+    uint16_t lowestRate = CONST_MAX_CYCLE;
+    uint16_t highestRate = CONST_MIN_CYCLE;
+    uint16_t highestVolume = 0u;
+    for (const SweepSession& session : sessions) {
+        lowestPeep = std::min(lowestPeep, session.peep);
+        highestPeep = std::max(highestPeep, session.peep);
+        lowestRate = std::min(lowestRate, session.cyclesPerMinute);
+        highestRate = std::max(highestRate, session.cyclesPerMinute);
+        if ((session.mode == VC_CMV) || (session.mode == VC_AC)) {
+            highestVolume = std::max(highestVolume, session.tidalVolume);
+        } else {
+            EXPECT_LT(session.peep, session.plateauPressure);
+        }
+    }
+    EXPECT_EQ(CONST_MIN_PEEP_PRESSURE, lowestPeep);
+    EXPECT_EQ(CONST_MAX_PEEP_PRESSURE, highestPeep);
+    EXPECT_EQ(CONST_MIN_CYCLE, lowestRate);
+    EXPECT_EQ(CONST_MAX_CYCLE, highestRate);
+    EXPECT_EQ(CONST_MAX_TIDAL_VOLUME, highestVolume);
+}
+
+TEST(SessionSweepTest, sessionMeasuresTheRegulation) {
+    // The blower speed converges over several cycles
+    SweepSession pressureSession = {PC_CMV, 50, 200, 20u, 400u, {10.0, 50.0}};
+    SessionMetrics pressure = runSweepSession(pressureSession, 8u, 2u);
+    EXPECT_EQ(2u, pressure.cycles);
+    EXPECT_GT(pressure.riseTimeMs, 0.0);
+    EXPECT_LT(pressure.riseTimeMs, 300.0);
+    EXPECT_NEAR(0.0, pressure.plateauError, 20.0);
+    EXPECT_NEAR(0.0, pressure.peepError, 5.0);
+    EXPECT_GT(pressure.tidalVolume, 500.0);
+    EXPECT_GT(pressure.convergenceCycles, 0u);
+    EXPECT_LE(pressure.convergenceCycles, 8u);
+
+    SweepSession volumeSession = {VC_CMV, 50, 200, 20u, 400u, {10.0, 50.0}};
+    SessionMetrics volume = runSweepSession(volumeSession, 2u, 2u);
+    EXPECT_EQ(2u, volume.cycles);
+    EXPECT_NEAR(0.0, volume.tidalVolumeError, 40.0);
+}
+
+TEST(SessionSweepTest, workersGiveTheSameMetricsAsOneProcess) {
+    std::vector<SweepSession> sessions;
+    sessions.push_back({PC_CMV, 50, 250, 20u, 400u, {10.0, 50.0}});
+    sessions.push_back({PC_VSAI, 100, 300, 30u, 400u, {10.0, 20.0}});
+    sessions.push_back({VC_AC, 50, 200, 12u, 600u, {25.0, 60.0}});
+
+    std::vector<SessionMetrics> metrics;
+    ASSERT_TRUE(runSessionSweep(sessions, 1u, 1u, 2u, &metrics));
+    ASSERT_EQ(sessions.size(), metrics.size());
+
+    for (size_t i = 0; i < sessions.size(); i++) {
+        SCOPED_TRACE(i);
+        SessionMetrics expected = runSweepSession(sessions[i], 1u, 1u);
+        EXPECT_EQ(expected.cycles, metrics[i].cycles);
+        EXPECT_EQ(expected.riseTimeMs, metrics[i].riseTimeMs);
+        EXPECT_EQ(expected.plateauError, metrics[i].plateauError);
+        EXPECT_EQ(expected.peepError, metrics[i].peepError);
+        EXPECT_EQ(expected.tidalVolume, metrics[i].tidalVolume);
+        EXPECT_EQ(expected.alarms, metrics[i].alarms);
+        EXPECT_EQ(expected.convergenceCycles, metrics[i].convergenceCycles);
+    }
+}
+
+/// Mean metrics of the PC_CMV tuning sessions, with the valves regulated every p_periodMs
+static SessionMetrics meanTuningMetrics(uint32_t p_periodMs) {
+    std::vector<SweepSession> sessions = tuningSessions();
+    SessionMetrics mean = {};
+    setInnerLoopPeriod(p_periodMs);
+    for (const SweepSession& session : sessions) {
+        // Past 20 cycles, the blower speed has converged
+        SessionMetrics metrics = runSweepSession(session, 20u, 5u);
+        mean.riseTimeMs += metrics.riseTimeMs / sessions.size();
+        mean.overshoot += metrics.overshoot / sessions.size();
+        mean.plateauError += std::fabs(metrics.plateauError) / sessions.size();
+        mean.peepError += std::fabs(metrics.peepError) / sessions.size();
+    }
+    setInnerLoopPeriod(1u);
+    return mean;
+}
+
+TEST(SessionSweepTest, valvesRegulatedOnEveryPressureSampleDoNoWorse) {
+    SessionMetrics everySample = meanTuningMetrics(1u);
+    SessionMetrics everyCompute = meanTuningMetrics(MAIN_CONTROLLER_COMPUTE_PERIOD_MS);
+
+    EXPECT_LE(everySample.plateauError, everyCompute.plateauError);
+    EXPECT_LE(everySample.peepError, everyCompute.peepError);
+    EXPECT_LT(everySample.overshoot, everyCompute.overshoot);
+    // The blower and the valve slew set the rise time, more than the rate of the valve PIDs
+    EXPECT_NEAR(everyCompute.riseTimeMs, everySample.riseTimeMs, 0.1 * everyCompute.riseTimeMs);
+}
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * @file test_simulator.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the simulation of the firmware timers
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "../includes/activation.h"
+#include "../includes/buzzer.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/main_state_machine.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "host_board.h"
+#include "simulator.h"
+
+/// Test fixture booting the board like respirator.cpp does, without starting the state machine
+class SimulatorTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() { boot(0u); }
+
+    void boot(uint64_t p_startMicros) {
+        resetSimulation(p_startMicros);
+
+        bootHostBoard();
+    }
+
+    /// Start the state machine, then the ventilation once it reached the STOPPED state
+    void startVentilation() {
+        // Without a patient, an assisted mode could trigger on the sensor noise
+        ventilator.mainController.onVentilationModeSet(PC_CMV);
+        mainStateMachine.setupAndStart();
+        halReloadWatchdog();
+        runSimulation(SECOND_US);
+        activationController.onStartButton();
+    }
+};
+
+TEST_F(SimulatorTest, clockFollowsTheSimulatedDuration) {
+    runSimulation(2500u * 1000u);
+
+    EXPECT_EQ(2500000u, monotonicMicros());
+    EXPECT_EQ(2500u, monotonicMillis());
+}
+
+TEST_F(SimulatorTest, timersFireAtTheirPeriod) {
+    startVentilation();
+    uint64_t controlEvents = simulatedTimerEvents(HAL_TIMER_CONTROL);
+    uint64_t flowMeterEvents = simulatedTimerEvents(HAL_TIMER_FLOW_METER);
+
+    runSimulation(10u * SECOND_US);
+
+    EXPECT_EQ(10000u, simulatedTimerEvents(HAL_TIMER_CONTROL) - controlEvents);
+    EXPECT_EQ(10000u / HOST_FLOW_METER_PERIOD_MS,
+              simulatedTimerEvents(HAL_TIMER_FLOW_METER) - flowMeterEvents);
+    EXPECT_EQ(0u, mainStateMachine.missedTimerTicks());
+}
+
+TEST_F(SimulatorTest, stoppedStateUsesTheLowPowerProfile) {
+    mainStateMachine.setupAndStart();
+    runSimulation(SECOND_US);
+    uint64_t controlEvents = simulatedTimerEvents(HAL_TIMER_CONTROL);
+    uint64_t flowMeterEvents = simulatedTimerEvents(HAL_TIMER_FLOW_METER);
+
+    runSimulation(SECOND_US);
+
+    EXPECT_EQ(100u, simulatedTimerEvents(HAL_TIMER_CONTROL) - controlEvents);
+    EXPECT_EQ(0u, simulatedTimerEvents(HAL_TIMER_FLOW_METER) - flowMeterEvents);
+}
+
+TEST_F(SimulatorTest, ventilationRunsCyclesAtTheCommandedRate) {
+    startVentilation();
+    uint32_t cycles = ventilator.mainController.cycleNumber();
+
+    runSimulation(60u * SECOND_US);
+
+    EXPECT_NEAR(ventilator.mainController.cyclesPerMinuteCommand(),
+                static_cast<double>(ventilator.mainController.cycleNumber() - cycles), 1.0);
+    EXPECT_EQ(0u, simulatedWatchdogResets());
+    EXPECT_EQ(0u, mainStateMachine.missedControlDeadlines());
+}
+
+TEST_F(SimulatorTest, millisecondCounterWrapDoesNotDisturbTheVentilation) {
+    // The 32-bit millisecond counter wraps 30 s after the start of the ventilation
+    boot(((static_cast<uint64_t>(UINT32_MAX) + 1u) - 31000u) * 1000u);
+    startVentilation();
+    uint32_t cycles = ventilator.mainController.cycleNumber();
+
+    runSimulation(60u * SECOND_US);
+
+    EXPECT_EQ(30000u, monotonicMillis());
+    EXPECT_NEAR(ventilator.mainController.cyclesPerMinuteCommand(),
+                static_cast<double>(ventilator.mainController.cycleNumber() - cycles), 1.0);
+    EXPECT_EQ(0u, mainStateMachine.missedTimerTicks());
+    EXPECT_EQ(0u, simulatedWatchdogResets());
+}
+
+TEST_F(SimulatorTest, stuckBackgroundLoopLetsTheWatchdogExpire) {
+    startVentilation();
+    runSimulation(SECOND_US);
+    EXPECT_EQ(0u, simulatedWatchdogResets());
+
+    setSimulatedBackgroundLoop(false);
+    runSimulation(2u * SECOND_US);
+
+    EXPECT_EQ(1u, simulatedWatchdogResets());
+}
+
+TEST_F(SimulatorTest, buzzerPatternFollowsTheSimulatedClock) {
+    // Boot pattern: after 10 ms, 250 ms on, 250 ms off, 250 ms on, 250 ms off, then stop
+    Buzzer_Boot_Start();
+
+    runSimulation(100u * 1000u);
+    EXPECT_TRUE(hostBuzzerOn());
+    runSimulation(300u * 1000u);
+    EXPECT_FALSE(hostBuzzerOn());
+    runSimulation(200u * 1000u);
+    EXPECT_TRUE(hostBuzzerOn());
+    runSimulation(SECOND_US);
+    EXPECT_FALSE(hostBuzzerOn());
+
+    EXPECT_EQ(2u, hostBuzzerSwitchOns());
+    EXPECT_EQ(5u, simulatedTimerEvents(HAL_TIMER_BUZZER));
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * @file test_timebase.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for timebase.cpp
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "../includes/timebase.h"
+
+/// Test fixture resetting the host clock before each test
+class TimebaseTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() { initTimebase(); }
+};
+
+TEST_F(TimebaseTest, countWithoutOverflow) {
+    EXPECT_EQ(0u, extendTimebaseCount(0u, 0u, false));
+    EXPECT_EQ(123456u, extendTimebaseCount(0u, 123456u, false));
+    EXPECT_EQ(0xFFFFFFFEu, extendTimebaseCount(0u, 0xFFFFFFFEu, false));
+}
+
+TEST_F(TimebaseTest, countAfterHandledOverflows) {
+    EXPECT_EQ(TIMEBASE_PERIOD_COUNTS, extendTimebaseCount(1u, 0u, false));
+    EXPECT_EQ((3u * TIMEBASE_PERIOD_COUNTS) + 42u, extendTimebaseCount(3u, 42u, false));
+}
+
+TEST_F(TimebaseTest, pendingOverflowCountsOnlyOnceWrapped) {
+    // Counter already wrapped, interrupt not served yet
+    EXPECT_EQ(TIMEBASE_PERIOD_COUNTS + 5u, extendTimebaseCount(0u, 5u, true));
+
+    // Counter read just before the wrap, flag raised right after
+    EXPECT_EQ(0xFFFFFFFDu, extendTimebaseCount(0u, 0xFFFFFFFDu, true));
+}
+
+TEST_F(TimebaseTest, extendedCountIsMonotonicAcrossTheWrap) {
+    uint64_t beforeWrap = extendTimebaseCount(7u, 0xFFFFFFFEu, false);
+    uint64_t wrappedNotServed = extendTimebaseCount(7u, 0u, true);
+    uint64_t wrappedServed = extendTimebaseCount(8u, 1u, false);
+
+    EXPECT_EQ(beforeWrap + 1u, wrappedNotServed);
+    EXPECT_EQ(wrappedNotServed + 1u, wrappedServed);
+}
+
+TEST_F(TimebaseTest, hostClockMovesOnlyForward) {
+    EXPECT_EQ(0u, monotonicMicros());
+
+    advanceMonotonicMicros(1500u);
+    EXPECT_EQ(1500u, monotonicMicros());
+    EXPECT_EQ(1u, monotonicMillis());
+
+    setMonotonicMicros(1000u);
+    EXPECT_EQ(1500u, monotonicMicros());
+
+    setMonotonicMicros(5000000000000ull);
+    EXPECT_EQ(5000000000000ull, monotonicMicros());
+    EXPECT_EQ(static_cast<uint32_t>(5000000000ull), monotonicMillis());
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+ * @file test_ui_link.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the link between the simulated board and the UI stand-in
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../includes/cpu_load.h"
+#include "../includes/cycle.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/serial_control.h"
+#include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "simulator.h"
+#include "ui_link.h"
+
+/// Code of the mains disconnected alarm
+#define MAINS_DISCONNECTED_ALARM 31u
+
+/// Take everything sent on the telemetry serial link
+static std::vector<uint8_t> takeTelemetry() {
+    std::vector<uint8_t> output(HOST_TELEMETRY_OUTPUT_SIZE);
+    output.resize(popHostTelemetryOutput(output.data(), output.size()));
+    return output;
+}
+
+class UiLinkTest : public ::testing::Test {
+ protected:
+    void SetUp() override {
+        (void)bootLinkedBoard(defaultSweepSession());
+        ASSERT_TRUE(link.open());
+        ASSERT_TRUE(ui.open(link.devicePath()));
+    }
+
+    /// Run the board, the link and the UI, one ms at a time
+    void run(uint64_t p_durationUs) {
+        uint64_t end = monotonicMicros() + p_durationUs;
+        while (monotonicMicros() < end) {
+            runSimulation(1000u);
+            link.exchange(1000u);
+            ui.poll(monotonicMicros());
+            raspberryPowerCuts += (!hostRaspberryPowered() && raspberryPowered) ? 1u : 0u;
+            raspberryPowered = hostRaspberryPowered();
+        }
+    }
+
+    PtyLink link;
+    UiStandIn ui;
+    bool raspberryPowered = true;
+    uint32_t raspberryPowerCuts = 0u;
+};
+
+TEST(TelemetryDecodingTest, bootMessageIsDecoded) {
+    (void)bootLinkedBoard(defaultSweepSession());
+    std::vector<uint8_t> telemetry = takeTelemetry();
+    sendBootMessage();
+    std::vector<uint8_t> frame = takeTelemetry();
+
+    TelemetryFrame decoded;
+    ASSERT_EQ(TELEMETRY_FRAME_DECODED, decodeTelemetryFrame(frame.data(), frame.size(), &decoded));
+    EXPECT_EQ('B', decoded.type);
+    EXPECT_EQ(frame.size(), decoded.size);
+    EXPECT_EQ(monotonicMicros(), decoded.systick);
+
+    // The telemetry of the boot ends with the same boot message
+    ASSERT_GE(telemetry.size(), frame.size());
+    EXPECT_TRUE(std::equal(frame.begin(), frame.end(), telemetry.end() - frame.size()));
+}
+
+TEST(TelemetryDecodingTest, partialAndDamagedFramesAreTold) {
+    (void)bootLinkedBoard(defaultSweepSession());
+    (void)takeTelemetry();
+    sendControlAck(PEEP, 80u);
+    std::vector<uint8_t> frame = takeTelemetry();
+
+    TelemetryFrame decoded;
+    ASSERT_EQ(TELEMETRY_FRAME_DECODED, decodeTelemetryFrame(frame.data(), frame.size(), &decoded));
+    uint8_t setting = 0u;
+    uint16_t value = 0u;
+    ASSERT_TRUE(decodeControlAck(decoded, &setting, &value));
+    EXPECT_EQ(PEEP, setting);
+    EXPECT_EQ(80u, value);
+
+    EXPECT_EQ(TELEMETRY_FRAME_INCOMPLETE,
+              decodeTelemetryFrame(frame.data(), frame.size() - 1u, &decoded));
+    EXPECT_EQ(TELEMETRY_FRAME_INVALID,
+              decodeTelemetryFrame(&frame[1], frame.size() - 1u, &decoded));
+
+    // A damaged frame is only told once the next one starts
+    std::vector<uint8_t> damaged = frame;
+    damaged[damaged.size() - 8u] ^= 0x01u;
+    EXPECT_EQ(TELEMETRY_FRAME_INCOMPLETE,
+              decodeTelemetryFrame(damaged.data(), damaged.size(), &decoded));
+    damaged.insert(damaged.end(), frame.begin(), frame.end());
+    EXPECT_EQ(TELEMETRY_FRAME_INVALID,
+              decodeTelemetryFrame(damaged.data(), damaged.size(), &decoded));
+}
+
+TEST(TelemetryDecodingTest, machineStateEndsWithTheLoadOfEachSubsystem) {
+    (void)bootLinkedBoard(defaultSweepSession());
+    (void)takeTelemetry();
+    ventilator.mainController.sendMachineState();
+    std::vector<uint8_t> telemetry = takeTelemetry();
+
+    TelemetryFrame decoded;
+    ASSERT_EQ(TELEMETRY_FRAME_DECODED,
+              decodeTelemetryFrame(telemetry.data(), telemetry.size(), &decoded));
+    EXPECT_EQ('S', decoded.type);
+
+    // A '\t' and 16 bits per subsystem, in the order of CpuLoadSubsystem
+    ASSERT_GT(decoded.fields.size(), 3u * CPU_LOAD_SUBSYSTEMS);
+    const uint8_t* loads = &decoded.fields[decoded.fields.size() - (3u * CPU_LOAD_SUBSYSTEMS)];
+    for (uint8_t i = 0u; i < CPU_LOAD_SUBSYSTEMS; i++) {
+        SCOPED_TRACE(i);
+        EXPECT_EQ('\t', loads[3u * i]);
+        uint16_t load = static_cast<uint16_t>((loads[(3u * i) + 1u] << 8) | loads[(3u * i) + 2u]);
+        EXPECT_EQ(readCpuLoadPerMille(static_cast<CpuLoadSubsystem>(i)), load);
+    }
+}
+
+TEST_F(UiLinkTest, settingsAreAckedOverThePty) {
+    run(1000000u);
+    ui.sendSetting(RespirationEnabled, 1u, monotonicMicros());
+    run(5000000u);
+    ui.sendSetting(PEEP, 80u, monotonicMicros());
+    run(1000000u);
+
+    UiLinkReport report = ui.report();
+    EXPECT_EQ(1u, report.frames['B']);
+    EXPECT_GT(report.frames['D'], 100u);
+    EXPECT_GT(report.frames['S'], 0u);
+    EXPECT_EQ(0u, report.invalidBytes);
+    EXPECT_EQ(80, ventilator.mainController.peepNextCommand());
+
+    // The breathing activation has no ack, the PEEP has one
+    EXPECT_EQ(2u, report.settingsSent);
+    ASSERT_EQ(1u, report.settingsAcked);
+    EXPECT_GT(report.ackLatenciesUs[0], 0u);
+    EXPECT_LT(report.ackLatenciesUs[0], 100000u);
+
+    // The line carries the telemetry at the bit rate of the UART, no faster
+    EXPECT_EQ(link.bytesSent(), report.bytesReceived);
+    EXPECT_LE(report.bytesReceived * TELEMETRY_BITS_PER_BYTE,
+              (static_cast<uint64_t>(TELEMETRY_BAUD_RATE) * monotonicMicros()) / 1000000u);
+    EXPECT_EQ(report.bytesSent, link.bytesReceived());
+}
+
+TEST_F(UiLinkTest, heartbeatsKeepTheRaspberryPiPowered) {
+    run(70000000u);
+
+    EXPECT_EQ(0u, raspberryPowerCuts);
+    EXPECT_GE(ui.report().heartbeatsSent, 70u);
+}
+
+TEST_F(UiLinkTest, theRpiWatchdogRestartsASilentUi) {
+    ui.setHeartbeatPeriod(0u);
+    run(70000000u);
+
+    EXPECT_EQ(1u, raspberryPowerCuts);
+    EXPECT_TRUE(hostRaspberryPowered());
+    EXPECT_EQ(0u, ui.report().heartbeatsSent);
+}
+
+TEST_F(UiLinkTest, alarmsReachTheUi) {
+    run(1000000u);
+    ui.sendSetting(RespirationEnabled, 1u, monotonicMicros());
+    run(5000000u);
+    setHostMainsInputs(false, true);
+    run(5000000u);
+
+    UiLinkReport report = ui.report();
+    ASSERT_NE(report.alarmsTriggered.end(),
+              std::find(report.alarmsTriggered.begin(), report.alarmsTriggered.end(),
+                        MAINS_DISCONNECTED_ALARM));
+    ASSERT_EQ(report.alarmsTriggered.size(), report.alarmLatenciesUs.size());
+    EXPECT_LT(*std::max_element(report.alarmLatenciesUs.begin(), report.alarmLatenciesUs.end()),
+              100000u);
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * @file test_ventilation_core.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the ventilation core built on the host
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CRC32.h"
+
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/mass_flow_meter.h"
+#include "../includes/pressure_valve.h"
+#include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "host_board.h"
+
+/// Test fixture setting up the actuators and the controllers like respirator.cpp does
+class VentilationCoreTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() {
+        initTimebase();
+        resetHostHal();
+        resetHostBoard();
+
+        bootHostBoard();
+    }
+
+    /// Take everything sent on the telemetry serial link
+    std::vector<uint8_t> takeTelemetry() {
+        std::vector<uint8_t> output(HOST_TELEMETRY_OUTPUT_SIZE);
+        output.resize(popHostTelemetryOutput(output.data(), output.size()));
+        return output;
+    }
+
+    /// Run one respiratory cycle at a constant pressure, one computation every period
+    void runCycle(int16_t p_pressure) {
+        ventilator.mainController.initRespiratoryCycle();
+        for (uint32_t tick = 0; tick < ventilator.mainController.ticksPerCycle(); tick++) {
+            advanceMonotonicMicros(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS);
+            ventilator.mainController.updatePressure(p_pressure);
+            ventilator.mainController.updateInspiratoryFlow(0);
+            ventilator.mainController.updateExpiratoryFlow(0);
+            ventilator.mainController.updateDt(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS);
+            ventilator.mainController.updateTick(tick);
+            ventilator.mainController.compute();
+            ventilator.mainController.computeInnerLoop(MAIN_CONTROLLER_COMPUTE_PERIOD_MICROSECONDS);
+        }
+        ventilator.mainController.endRespiratoryCycle(monotonicMillis());
+    }
+};
+
+TEST_F(VentilationCoreTest, bootMessageIsAFrameWithAValidChecksum) {
+    sendBootMessage();
+    std::vector<uint8_t> frame = takeTelemetry();
+
+    ASSERT_GT(frame.size(), 8u);
+    EXPECT_EQ(0x03u, frame[0]);
+    EXPECT_EQ(0x0Cu, frame[1]);
+    EXPECT_EQ('B', frame[2]);
+    EXPECT_EQ(':', frame[3]);
+    EXPECT_EQ(0x30u, frame[frame.size() - 2u]);
+    EXPECT_EQ(0xC0u, frame[frame.size() - 1u]);
+
+    // The checksum covers everything between the header and itself
+    CRC32 crc32;
+    crc32.update(&frame[2], frame.size() - 8u);
+    uint32_t expected = crc32.finalize();
+    size_t crcIndex = frame.size() - 6u;
+    uint32_t sent = (static_cast<uint32_t>(frame[crcIndex]) << 24)
+                    | (static_cast<uint32_t>(frame[crcIndex + 1u]) << 16)
+                    | (static_cast<uint32_t>(frame[crcIndex + 2u]) << 8) | frame[crcIndex + 3u];
+    EXPECT_EQ(expected, sent);
+}
+
+TEST_F(VentilationCoreTest, setupReachesTheSafetyPosition) {
+    ventilator.mainController.setup();
+
+    EXPECT_EQ(valveAngle2MicroSeconds(VALVE_OPEN_STATE),
+              hostPwmOutputPulse(HAL_PWM_INSPIRATORY_VALVE));
+    EXPECT_EQ(valveAngle2MicroSeconds(VALVE_OPEN_STATE),
+              hostPwmOutputPulse(HAL_PWM_EXPIRATORY_VALVE));
+    EXPECT_EQ(BlowerSpeed2MicroSeconds(0), hostPwmOutputPulse(HAL_PWM_BLOWER));
+}
+
+TEST_F(VentilationCoreTest, cycleDrivesTheActuatorsAndSendsTelemetry) {
+    ventilator.mainController.setup();
+    (void)takeTelemetry();
+
+    runCycle(100);
+
+    EXPECT_EQ(1u, ventilator.mainController.cycleNumber());
+    EXPECT_GT(hostPwmOutputPulse(HAL_PWM_BLOWER), BlowerSpeed2MicroSeconds(0));
+    EXPECT_FALSE(takeTelemetry().empty());
+}
+
+TEST_F(VentilationCoreTest, flowMeterStandInIntegratesTheVolume) {
+    // 60 L/min during 1 s is 1 L
+    setHostFlows(60000, 0);
+    for (uint32_t i = 0; i < (1000u / HOST_FLOW_METER_PERIOD_MS); i++) {
+        MFM_acquire();
+    }
+
+    // The word of the sensor tells the flow by steps of about 15 mL/min
+    EXPECT_NEAR(60000, MFM_read_airflow(), 16);
+    EXPECT_EQ(1000, MFM_read_milliliters(true));
+    EXPECT_EQ(0, MFM_read_milliliters(false));
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+ * @file test_ventilator_context.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the independence of ventilator contexts
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../includes/blower.h"
+#include "../includes/hal.h"
+#include "../includes/main_controller.h"
+#include "../includes/telemetry.h"
+#include "../includes/timebase.h"
+#include "../includes/ventilator_context.h"
+#include "golden_trace.h"
+#include "host_board.h"
+
+/// Test fixture with a second context next to the global one
+class VentilatorContextTest : public ::testing::Test {
+ protected:
+    virtual void SetUp() {
+        initTimebase();
+        resetHostHal();
+        resetHostBoard();
+
+        bootHostBoard();
+
+        m_other.reset(new VentilatorContext());
+        m_other->blower = Blower(HAL_PWM_BLOWER);
+    }
+
+    /// Context built next to the global one
+    std::unique_ptr<VentilatorContext> m_other;
+};
+
+TEST_F(VentilatorContextTest, mainControllerUsesTheControllersOfItsContext) {
+    m_other->mainController.onVentilationModeSet(VC_CMV);
+    EXPECT_EQ(&m_other->vcCmvController,
+              m_other->mainController.ventilationControllerNextCommand());
+
+    ventilator.mainController.onVentilationModeSet(PC_VSAI);
+    EXPECT_EQ(&ventilator.pcVsaiController,
+              ventilator.mainController.ventilationControllerNextCommand());
+    EXPECT_EQ(&m_other->vcCmvController,
+              m_other->mainController.ventilationControllerNextCommand());
+}
+
+TEST_F(VentilatorContextTest, settingsOfAContextDoNotChangeTheOthers) {
+    int16_t peep = ventilator.mainController.peepNextCommand();
+
+    m_other->mainController.onPeepPressureIncrease();
+
+    EXPECT_EQ(peep, ventilator.mainController.peepNextCommand());
+    EXPECT_NE(peep, m_other->mainController.peepNextCommand());
+}
+
+TEST_F(VentilatorContextTest, controllersDriveTheActuatorsOfTheirContext) {
+    m_other->pcCmvController.setup();
+    m_other->pcCmvController.initCycle();
+
+    EXPECT_EQ(DEFAULT_BLOWER_SPEED, m_other->blower.getTargetSpeed());
+    EXPECT_EQ(0u, ventilator.blower.getTargetSpeed());
+}
+
+TEST(VentilatorThreadTest, everyThreadRunsItsOwnVentilator) {
+    VentilatorContext* other = nullptr;
+    std::thread thread([&]() { other = &ventilator; });
+    thread.join();
+
+    EXPECT_NE(&ventilator, other);
+}
+
+TEST(VentilatorThreadTest, parallelSessionsTraceAsSerialOnes) {
+    // A pressure and a volume controlled scenario, whose traces differ from the first cycle
+    std::vector<GoldenScenario> grid = goldenScenarioGrid();
+    const GoldenScenario& first = grid.front();
+    const GoldenScenario& second = grid.back();
+    std::vector<std::string> serialFirst = runGoldenScenario(first, 3u);
+    std::vector<std::string> serialSecond = runGoldenScenario(second, 3u);
+    ASSERT_NE(serialFirst, serialSecond);
+
+    std::vector<std::string> parallelFirst;
+    std::vector<std::string> parallelSecond;
+    std::thread firstThread([&]() { parallelFirst = runGoldenScenario(first, 3u); });
+    std::thread secondThread([&]() { parallelSecond = runGoldenScenario(second, 3u); });
+    firstThread.join();
+    secondThread.join();
+
+    EXPECT_EQ("", diffGoldenTraces(serialFirst, parallelFirst));
+    EXPECT_EQ("", diffGoldenTraces(serialSecond, parallelSecond));
+}
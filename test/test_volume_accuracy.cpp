@@ -0,0 +1,138 @@
+/******************************************************************************
+ * @file test_volume_accuracy.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Unit tests for the sensor models and the volume accuracy study
+ *****************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../includes/mass_flow_meter_utl.h"
+#include "sensor_model.h"
+#include "volume_accuracy.h"
+
+TEST(SensorModelTest, idealFlowMetersConvertAsTheBoard) {
+    SensorModel inspiratory(idealSensor(SENSOR_HONEYWELL_HAF), 1u);
+    SensorModel expiratory(idealSensor(SENSOR_SFM3300), 1u);
+
+    uint16_t word = inspiratory.sample(30000.0, 1000u);
+    EXPECT_EQ(convertInspiratoryFlowSensor(word), inspiratory.measure(word));
+    EXPECT_NEAR(30000.0, inspiratory.measure(word), 15.26);
+
+    word = expiratory.sample(-20000.0, 1000u);
+    EXPECT_EQ(convertExpiratoryFlowSensor(word), expiratory.measure(word));
+    EXPECT_NEAR(-20000.0, expiratory.measure(word), 8.34);
+}
+
+TEST(SensorModelTest, pressureAdcHasTwelveBits) {
+    SensorModel pressure(idealSensor(SENSOR_PRESSURE_ADC), 1u);
+
+    EXPECT_EQ(12u, sensorBits(SENSOR_PRESSURE_ADC));
+    EXPECT_NEAR(200.0, pressure.measure(pressure.sample(200.0, 1000u)), 0.5);
+    EXPECT_EQ(0u, pressure.sample(-100.0, 1000u));
+    EXPECT_EQ(4095u, pressure.sample(2000.0, 1000u));
+}
+
+TEST(SensorModelTest, sfm3019WordIsSigned) {
+    SensorModel flowMeter(idealSensor(SENSOR_SFM3019), 1u);
+
+    uint16_t word = flowMeter.sample(0.0, 1000u);
+    EXPECT_EQ(-24576, static_cast<int16_t>(word));
+    EXPECT_EQ(0, flowMeter.measure(word));
+    EXPECT_EQ(0x8000u, flowMeter.sample(-1000000.0, 1000u));
+}
+
+TEST(SensorModelTest, sfm3019IsConvertedToTheWordOfTheBoardSensor) {
+    SensorModel flowMeter(idealSensor(SENSOR_SFM3019), 1u);
+
+    uint16_t word = flowMeter.boardWord(30000.0, 1000u, BOARD_INSPIRATORY_SENSOR);
+    EXPECT_NEAR(30000.0, convertInspiratoryFlowSensor(word), 20.0);
+}
+
+TEST(SensorModelTest, effectiveResolutionRoundsTheCode) {
+    SensorModelSettings settings = idealSensor(SENSOR_HONEYWELL_HAF);
+    settings.bits = 10u;
+    SensorModel flowMeter(settings, 1u);
+
+    for (double flow = 0.0; flow < 100000.0; flow += 3333.0) {
+        EXPECT_EQ(0u, flowMeter.sample(flow, 1000u) % 16u);
+    }
+}
+
+TEST(SensorModelTest, offsetDrifts) {
+    SensorModelSettings settings = idealSensor(SENSOR_SFM3300);
+    settings.offset = 100.0;
+    settings.offsetDrift = 50.0;
+    SensorModel flowMeter(settings, 1u);
+
+    for (uint32_t i = 0; i < 1000u; i++) {
+        (void)flowMeter.sample(0.0, 1000u);
+    }
+    EXPECT_NEAR(150.0, flowMeter.offset(), 1e-6);
+    EXPECT_NEAR(150.0, flowMeter.measure(flowMeter.sample(0.0, 0u)), 8.34);
+}
+
+TEST(SensorModelTest, noiseHasItsStandardDeviation) {
+    SensorModelSettings settings = idealSensor(SENSOR_SFM3300);
+    settings.noise = 200.0;
+    SensorModel flowMeter(settings, 42u);
+    SensorModel sameSeed(settings, 42u);
+
+    std::vector<double> measures;
+    for (uint32_t i = 0; i < 5000u; i++) {
+        uint16_t word = flowMeter.sample(10000.0, 1000u);
+        ASSERT_EQ(word, sameSeed.sample(10000.0, 1000u));
+        measures.push_back(flowMeter.measure(word) - 10000.0);
+    }
+    ErrorDistribution distribution = errorDistribution(measures);
+    EXPECT_NEAR(0.0, distribution.mean, 10.0);
+    EXPECT_NEAR(200.0, distribution.standardDeviation, 10.0);
+}
+
+TEST(VolumeAccuracyTest, errorDistributionOfKnownErrors) {
+    std::vector<double> errors;
+    for (int32_t i = 100; i >= -100; i--) {
+        errors.push_back(i);
+    }
+    ErrorDistribution distribution = errorDistribution(errors);
+
+    EXPECT_EQ(201u, distribution.samples);
+    EXPECT_NEAR(0.0, distribution.mean, 1e-9);
+    EXPECT_NEAR(58.17, distribution.standardDeviation, 0.01);
+    EXPECT_DOUBLE_EQ(-90.0, distribution.low);
+    EXPECT_DOUBLE_EQ(0.0, distribution.median);
+    EXPECT_DOUBLE_EQ(90.0, distribution.high);
+    EXPECT_DOUBLE_EQ(100.0, distribution.maxAbs);
+    EXPECT_EQ(0u, errorDistribution(std::vector<double>()).samples);
+}
+
+TEST(VolumeAccuracyTest, idealSensorsMeasureTheTruth) {
+    VolumeAccuracySettings settings = defaultVolumeAccuracySettings(1u);
+    settings.pressure = idealSensor(SENSOR_PRESSURE_ADC);
+    settings.inspiratoryFlow = idealSensor(BOARD_INSPIRATORY_SENSOR);
+    settings.expiratoryFlow = idealSensor(BOARD_EXPIRATORY_SENSOR);
+    settings.measuredCycles = 3u;
+    VolumeAccuracyReport report = runVolumeAccuracy(settings, 1u);
+
+    ASSERT_TRUE(report.complete);
+    EXPECT_EQ(3u, report.tidalVolumeError.samples);
+    EXPECT_GT(report.tidalVolume, 100.0);
+    EXPECT_LT(report.relativeTidalVolumeError.maxAbs, 5.0);
+    EXPECT_LT(report.peepError.maxAbs, 5.0);
+}
+
+TEST(VolumeAccuracyTest, trialsAreReproducible) {
+    VolumeAccuracySettings settings = defaultVolumeAccuracySettings(2u);
+    settings.measuredCycles = 2u;
+    VolumeAccuracyReport first = runVolumeAccuracy(settings, 2u);
+    VolumeAccuracyReport second = runVolumeAccuracy(settings, 1u);
+
+    ASSERT_TRUE(first.complete);
+    EXPECT_EQ(4u, first.tidalVolumeError.samples);
+    EXPECT_DOUBLE_EQ(first.tidalVolumeError.mean, second.tidalVolumeError.mean);
+    EXPECT_DOUBLE_EQ(first.peepError.mean, second.peepError.mean);
+    EXPECT_DOUBLE_EQ(first.minuteVolumeError.mean, second.minuteVolumeError.mean);
+}
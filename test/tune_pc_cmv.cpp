@@ -0,0 +1,59 @@
+/******************************************************************************
+ * @file tune_pc_cmv.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Search of the PID and blower regulation coefficients of the PC modes
+ *
+ * Usage: tune_pc_cmv <pc_cmv_tuning.h> [passes over the coefficients, 10 by default] [workers,
+ * one per CPU core by default]
+ *
+ * The search starts from the coefficients the tool was built with, and writes the tuned ones as
+ * a header to compile in the firmware, usually includes/pc_cmv_tuning.h.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "pid_tuner.h"
+
+int main(int argc, char** argv) {
+    if ((argc < 2) || (argc > 4)) {
+        fprintf(stderr, "Usage: %s <pc_cmv_tuning.h> [passes] [workers]\n", argv[0]);
+        return 2;
+    }
+    uint32_t passes = (argc > 2) ? static_cast<uint32_t>(atoi(argv[2])) : 10u;
+    uint32_t workers = (argc > 3) ? static_cast<uint32_t>(atoi(argv[3])) : 0u;
+
+    SweepRanges ranges = defaultSweepRanges(1u);
+    std::vector<SweepSession> sessions = tuningSessions();
+    fprintf(stderr, "Scoring every tuning over %zu sessions\n", sessions.size());
+
+    time_t start = time(nullptr);
+    TuningCost cost;
+    PcCmvTuning tuning = tunePcCmv(PC_CMV_DEFAULT_TUNING, tuningCoefficients(), sessions,
+                                   ranges.settlingCycles, ranges.measuredCycles, passes, workers,
+                                   &cost, stderr);
+
+    char origin[256];
+    (void)snprintf(origin, sizeof(origin),
+                   "cost %.3f over %zu simulated PC_CMV sessions, rise time %.0f ms, overshoot "
+                   "%.1f mmH2O, PEEP error %.1f mmH2O, %.1f cycles to converge",
+                   cost.total, sessions.size(), cost.riseTimeMs, cost.overshoot, cost.peepError,
+                   cost.convergenceCycles);
+
+    FILE* header = fopen(argv[1], "w");
+    if (header == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", argv[1]);
+        return 1;
+    }
+    std::string source = tuningHeader(tuning, origin);
+    (void)fwrite(source.data(), 1u, source.size(), header);
+    (void)fclose(header);
+
+    fprintf(stderr, "Cost %.3f in %ld s\n", cost.total, static_cast<long>(time(nullptr) - start));
+    return 0;
+}
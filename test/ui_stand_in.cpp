@@ -0,0 +1,118 @@
+/******************************************************************************
+ * @file ui_stand_in.cpp
+ * @copyright Copyright (c) 2020 Makers For Life
+ * @author Makers For Life
+ * @brief Stand-in of the control UI on a terminal or serial device
+ *
+ * Usage: ui_stand_in [-d duration in s, 30 by default] [-p heartbeat period in ms, 1000 by
+ * default, 0 for none] [-c <date in ms>:<setting>:<value>]... <device>
+ *
+ * The device is the terminal of simulate_board, or the serial device of a board. Heartbeats are
+ * sent like the UI does, and the settings of the -c options at their dates, the setting being a
+ * number of ControlSetting (serial_control.h): `-c 1000:8:1` starts the breathing after 1 s. The
+ * alarm traps are written as they arrive, and the report of the link at the end.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ui_link.h"
+
+/// Period of the polls of the device, in µs
+#define UI_STAND_IN_POLL_PERIOD_US 500u
+
+/// Setting sent at a date
+struct ScheduledSetting {
+    /// Date in ms after the start
+    uint32_t dateMs;
+    uint8_t setting;
+    uint16_t value;
+};
+
+/// Wall clock, in µs
+static uint64_t wallMicros() {
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<uint64_t>(now.tv_sec) * 1000000u)
+           + (static_cast<uint64_t>(now.tv_nsec) / 1000u);
+}
+
+int main(int argc, char** argv) {
+    double durationS = 30.0;
+    uint32_t heartbeatPeriodMs = UI_HEARTBEAT_PERIOD_MS;
+    std::vector<ScheduledSetting> settings;
+    const char* device = nullptr;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        unsigned int dateMs = 0u;
+        unsigned int setting = 0u;
+        unsigned int value = 0u;
+        if ((strcmp(argv[i], "-d") == 0) && ((i + 1) < argc)) {
+            i++;
+            durationS = atof(argv[i]);
+        } else if ((strcmp(argv[i], "-p") == 0) && ((i + 1) < argc)) {
+            i++;
+            heartbeatPeriodMs = static_cast<uint32_t>(atoi(argv[i]));
+        } else if ((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc)
+                   && (sscanf(argv[i + 1], "%u:%u:%u", &dateMs, &setting, &value) == 3)) {
+            i++;
+            ScheduledSetting scheduled = {dateMs, static_cast<uint8_t>(setting),
+                                          static_cast<uint16_t>(value)};
+            settings.push_back(scheduled);
+        } else if ((device == nullptr) && (argv[i][0] != '-')) {
+            device = argv[i];
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || (device == nullptr)) {
+        fprintf(stderr, "Usage: %s [-d duration] [-p heartbeat period] [-c ms:setting:value]... "
+                        "<device>\n",
+                argv[0]);
+        return 2;
+    }
+
+    std::stable_sort(settings.begin(), settings.end(),
+                     [](const ScheduledSetting& p_first, const ScheduledSetting& p_second) {
+                         return p_first.dateMs < p_second.dateMs;
+                     });
+
+    UiStandIn ui;
+    if (!ui.open(device)) {
+        fprintf(stderr, "Cannot open %s\n", device);
+        return 1;
+    }
+    ui.setHeartbeatPeriod(heartbeatPeriodMs);
+
+    uint64_t startUs = wallMicros();
+    uint64_t endUs = startUs + static_cast<uint64_t>(durationS * 1000000.0);
+    size_t nextSetting = 0u;
+    size_t alarmsSeen = 0u;
+    uint64_t nowUs = startUs;
+    while (nowUs < endUs) {
+        while ((nextSetting < settings.size())
+               && (((nowUs - startUs) / 1000u) >= settings[nextSetting].dateMs)) {
+            ui.sendSetting(settings[nextSetting].setting, settings[nextSetting].value, nowUs);
+            nextSetting++;
+        }
+        ui.poll(nowUs);
+
+        UiLinkReport report = ui.report();
+        for (; alarmsSeen < report.alarmsTriggered.size(); alarmsSeen++) {
+            printf("Alarm %u triggered at %.1f s\n", report.alarmsTriggered[alarmsSeen],
+                   static_cast<double>(nowUs - startUs) / 1000000.0);
+        }
+
+        (void)usleep(UI_STAND_IN_POLL_PERIOD_US);
+        nowUs = wallMicros();
+    }
+
+    printUiLinkReport(ui.report(), stdout);
+    return 0;
+}